@@ -8,6 +8,7 @@
 #include <unordered_map>
 
 #include "db/page.h"
+#include "record_cache/record_cache_entry.h"
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/slice_transform.h"
 #include "rocksdb/table.h"
@@ -174,6 +175,67 @@ DEFINE_bool(optimistic_rec_caching, false,
 DEFINE_bool(rec_cache_use_lru, false,
             "Whether the record cache should use the LRU eviction policy.");
 
+DEFINE_bool(rec_cache_background_writeback, false,
+            "If true, PGTreeLine will write out dirty records from the record "
+            "cache in the background once the fraction of dirty records "
+            "exceeds `rec_cache_writeback_high_watermark`.");
+DEFINE_double(rec_cache_writeback_high_watermark, 0.5,
+              "The fraction of dirty records in the record cache at which "
+              "background writeback starts.");
+DEFINE_double(rec_cache_writeback_low_watermark, 0.25,
+              "The fraction of dirty records in the record cache at which "
+              "background writeback stops.");
+DEFINE_uint64(rec_cache_writeback_batch_size, 4096,
+              "The maximum number of dirty records the background writer "
+              "writes out in one batch.");
+
+DEFINE_bool(pg_numa_aware, false,
+            "If true, PGTreeLine will spread its background threads across "
+            "NUMA nodes, allocate I/O buffers on the local node, and record "
+            "the fraction of remote memory accesses.");
+DEFINE_bool(rec_cache_numa_interleave, false,
+            "If true (and `pg_numa_aware` is set), PGTreeLine will interleave "
+            "its record cache entries across NUMA nodes.");
+
+DEFINE_bool(rec_cache_persist, false,
+            "If true, PGTreeLine will record the keys in its record cache when "
+            "it shuts down and will read them back into the cache on reopen.");
+DEFINE_bool(rec_cache_persist_values, false,
+            "If true (and `rec_cache_persist` is set), PGTreeLine will also "
+            "record the cached values when it shuts down.");
+
+DEFINE_bool(pg_index_checkpoint, false,
+            "If true, PGTreeLine will checkpoint its segment index when it "
+            "shuts down and will load the index from the checkpoint on "
+            "reopen.");
+DEFINE_uint64(pg_index_checkpoint_interval, 0,
+              "If nonzero (and `pg_index_checkpoint` is set), PGTreeLine will "
+              "also checkpoint its segment index after this many "
+              "reorganizations.");
+
+DEFINE_bool(pg_write_combining, false,
+            "If true, PGTreeLine will combine concurrent writes to the same "
+            "page into larger batches before applying them.");
+
+DEFINE_bool(pg_snapshot_scans, false,
+            "If true, PGTreeLine will run range scans without segment locks "
+            "so that they do not block reorganizations.");
+
+DEFINE_bool(pg_prefetch_scans, false,
+            "If true, PGTreeLine range scans will prefetch segments using the "
+            "background threads. Unlike --use_experimental_scan_prefetching, "
+            "this is safe to use with concurrent writers.");
+
+DEFINE_string(pg_io_trace_path, "",
+              "If set, PGTreeLine will record every segment file read and "
+              "write in a binary trace at this path (replay it using "
+              "pg_io_replay).");
+
+DEFINE_uint32(pg_key_range_stats_buckets, 0,
+              "If nonzero, PGTreeLine will keep write amplification and "
+              "reorganization counters for this many key ranges (written to "
+              "key_range_stats.csv).");
+
 DEFINE_bool(
     skip_load, false,
     "If set to true, the workload runner will skip the initial data load.");
@@ -301,15 +363,35 @@ tl::pg::PageGroupedDBOptions BuildPGTreeLineOptions() {
   options.records_per_page_goal = FLAGS_records_per_page_goal;
   options.records_per_page_epsilon = FLAGS_records_per_page_epsilon;
   options.num_bg_threads = FLAGS_bg_threads;
-  // Each record cache entry takes 96 bytes of space (metadata).
-  options.record_cache_capacity = (FLAGS_cache_size_mib * 1024ULL * 1024ULL) /
-                                  (FLAGS_record_size_bytes + 96ULL);
+  // Account for the space used by each record cache entry (metadata).
+  options.record_cache_capacity =
+      (FLAGS_cache_size_mib * 1024ULL * 1024ULL) /
+      (FLAGS_record_size_bytes + sizeof(tl::RecordCacheEntry));
   options.use_memory_based_io = FLAGS_pg_use_memory_based_io;
   options.bypass_cache = FLAGS_pg_bypass_cache;
   options.rec_cache_batch_writeout = FLAGS_rec_cache_batch_writeout;
   options.parallelize_final_flush = FLAGS_pg_parallelize_final_flush;
   options.optimistic_caching = FLAGS_optimistic_rec_caching;
   options.rec_cache_use_lru = FLAGS_rec_cache_use_lru;
+  options.rec_cache_background_writeback =
+      FLAGS_rec_cache_background_writeback;
+  options.rec_cache_writeback_high_watermark =
+      FLAGS_rec_cache_writeback_high_watermark;
+  options.rec_cache_writeback_low_watermark =
+      FLAGS_rec_cache_writeback_low_watermark;
+  options.rec_cache_writeback_batch_size =
+      FLAGS_rec_cache_writeback_batch_size;
+  options.rec_cache_persist = FLAGS_rec_cache_persist;
+  options.rec_cache_persist_values = FLAGS_rec_cache_persist_values;
+  options.index_checkpoint = FLAGS_pg_index_checkpoint;
+  options.index_checkpoint_interval = FLAGS_pg_index_checkpoint_interval;
+  options.write_combining = FLAGS_pg_write_combining;
+  options.snapshot_scans = FLAGS_pg_snapshot_scans;
+  options.prefetch_scans = FLAGS_pg_prefetch_scans;
+  options.io_trace_path = FLAGS_pg_io_trace_path;
+  options.key_range_stats_buckets = FLAGS_pg_key_range_stats_buckets;
+  options.numa_aware = FLAGS_pg_numa_aware;
+  options.rec_cache_numa_interleave = FLAGS_rec_cache_numa_interleave;
   options.use_pgm_builder = FLAGS_pg_use_pgm_builder;
   options.disable_overflow_creation = FLAGS_pg_disable_overflow_creation;
   options.rewrite_search_radius = FLAGS_pg_rewrite_search_radius;
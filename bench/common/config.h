@@ -113,6 +113,41 @@ DECLARE_bool(optimistic_rec_caching);
 // Whether the record cache should use the LRU eviction policy.
 DECLARE_bool(rec_cache_use_lru);
 
+// Background record cache writeback (PGTreeLine only). Dirty records are
+// written out once the fraction of dirty records exceeds the high watermark,
+// until the fraction falls below the low watermark.
+DECLARE_bool(rec_cache_background_writeback);
+DECLARE_double(rec_cache_writeback_high_watermark);
+DECLARE_double(rec_cache_writeback_low_watermark);
+DECLARE_uint64(rec_cache_writeback_batch_size);
+
+// NUMA-aware placement (PGTreeLine only).
+DECLARE_bool(pg_numa_aware);
+DECLARE_bool(rec_cache_numa_interleave);
+
+// Persist the record cache's contents across restarts (PGTreeLine only).
+DECLARE_bool(rec_cache_persist);
+DECLARE_bool(rec_cache_persist_values);
+
+// Segment index checkpoints for fast reopens (PGTreeLine only).
+DECLARE_bool(pg_index_checkpoint);
+DECLARE_uint64(pg_index_checkpoint_interval);
+
+// Combine concurrent page writes into larger batches (PGTreeLine only).
+DECLARE_bool(pg_write_combining);
+
+// Run range scans without segment locks (PGTreeLine only).
+DECLARE_bool(pg_snapshot_scans);
+
+// Prefetch segments during range scans (PGTreeLine only).
+DECLARE_bool(pg_prefetch_scans);
+
+// Record a trace of the segment file I/O (PGTreeLine only).
+DECLARE_string(pg_io_trace_path);
+
+// Track per key range write amplification statistics (PGTreeLine only).
+DECLARE_uint32(pg_key_range_stats_buckets);
+
 // If set to true, the workload runner will skip the initial data load.
 DECLARE_bool(skip_load);
 
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "perf_counters.h"
+#include "ycsbr/ycsbr.h"
+
+namespace tl {
+namespace bench {
+
+// Wraps a YCSBR database interface so that each of the session's worker
+// threads is registered with `PerfCounters` and the operations it runs are
+// counted.
+template <typename DB>
+class PerfCountedInterface : public DB {
+ public:
+  void InitializeWorker(const std::thread::id& id) {
+    PerfCounters::RegisterThread();
+    DB::InitializeWorker(id);
+  }
+
+  void BulkLoad(const ycsbr::BulkLoadTrace& load) {
+    PerfCounters::RegisterThread();
+    PerfCounters::CountOperations(load.size());
+    DB::BulkLoad(load);
+  }
+
+  bool Update(ycsbr::Request::Key key, const char* value, size_t value_size) {
+    PerfCounters::CountOperations(1);
+    return DB::Update(key, value, value_size);
+  }
+
+  bool Insert(ycsbr::Request::Key key, const char* value, size_t value_size) {
+    PerfCounters::CountOperations(1);
+    return DB::Insert(key, value, value_size);
+  }
+
+  bool Read(ycsbr::Request::Key key, std::string* value_out) {
+    PerfCounters::CountOperations(1);
+    return DB::Read(key, value_out);
+  }
+
+  bool Scan(
+      ycsbr::Request::Key key, size_t amount,
+      std::vector<std::pair<ycsbr::Request::Key, std::string>>* scan_out) {
+    PerfCounters::CountOperations(1);
+    return DB::Scan(key, amount, scan_out);
+  }
+};
+
+}  // namespace bench
+}  // namespace tl
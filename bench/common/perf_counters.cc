@@ -0,0 +1,291 @@
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+using tl::bench::PerfCounterValues;
+
+constexpr size_t kNumEvents = 4;
+constexpr std::array<uint64_t, kNumEvents> kEvents = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+// The layout of a counter group read (see `PERF_FORMAT_GROUP`).
+struct GroupReadFormat {
+  uint64_t nr;
+  uint64_t time_enabled;
+  uint64_t time_running;
+  uint64_t values[kNumEvents];
+};
+
+int OpenEvent(const uint64_t config, const int group_fd,
+              const bool exclude_kernel) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  // The group is enabled once all of its events have been opened.
+  attr.disabled = group_fd == -1 ? 1 : 0;
+  attr.exclude_kernel = exclude_kernel ? 1 : 0;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // Measure the calling thread, on any CPU.
+  return syscall(SYS_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1, group_fd,
+                 /*flags=*/0);
+}
+
+struct ThreadCounters {
+  ~ThreadCounters() {
+    for (const int fd : fds) {
+      if (fd >= 0) close(fd);
+    }
+  }
+
+  // Opens the counter group. Returns false (and sets `errno`) on failure.
+  bool Open(const bool exclude_kernel) {
+    for (size_t i = 0; i < kNumEvents; ++i) {
+      fds[i] = OpenEvent(kEvents[i], i == 0 ? -1 : fds[0], exclude_kernel);
+      if (fds[i] < 0) return false;
+    }
+    ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+  }
+
+  // Reads the counters. If the counters were multiplexed with other events,
+  // the values are scaled up to estimate the full counts.
+  PerfCounterValues Read() const {
+    PerfCounterValues values;
+    GroupReadFormat data;
+    if (fds[0] < 0 || read(fds[0], &data, sizeof(data)) != sizeof(data)) {
+      return values;
+    }
+    double scale = 1.0;
+    if (data.time_running > 0 && data.time_running < data.time_enabled) {
+      scale = static_cast<double>(data.time_enabled) / data.time_running;
+    }
+    values.cycles = data.values[0] * scale;
+    values.instructions = data.values[1] * scale;
+    values.llc_misses = data.values[2] * scale;
+    values.branch_misses = data.values[3] * scale;
+    return values;
+  }
+
+  std::array<int, kNumEvents> fds = {-1, -1, -1, -1};
+  std::atomic<uint64_t> operations{0};
+};
+
+struct Sample {
+  PerfCounterValues counters;
+  uint64_t operations = 0;
+};
+
+struct PhaseResult {
+  std::string name;
+  // Indexed by thread registration order.
+  std::vector<Sample> threads;
+};
+
+struct State {
+  std::atomic<bool> enabled{false};
+
+  // Protects the fields below.
+  std::mutex mutex;
+  // Set once opening a counter group has failed.
+  bool unavailable = false;
+  bool exclude_kernel = false;
+  std::vector<std::unique_ptr<ThreadCounters>> threads;
+
+  bool in_phase = false;
+  std::string phase_name;
+  std::vector<Sample> phase_start;
+  std::vector<PhaseResult> results;
+
+  // The caller must hold `mutex`.
+  std::vector<Sample> SampleAll() const {
+    std::vector<Sample> samples(threads.size());
+    for (size_t i = 0; i < threads.size(); ++i) {
+      samples[i].counters = threads[i]->Read();
+      samples[i].operations =
+          threads[i]->operations.load(std::memory_order_relaxed);
+    }
+    return samples;
+  }
+};
+
+State& GetState() {
+  static State state;
+  return state;
+}
+
+thread_local ThreadCounters* local_counters = nullptr;
+
+void PrintRow(std::ostream& out, const std::string& phase,
+              const std::string& thread, const Sample& sample) {
+  const PerfCounterValues& c = sample.counters;
+  out << phase << "," << thread << "," << sample.operations << "," << c.cycles
+      << "," << c.instructions << "," << c.llc_misses << ","
+      << c.branch_misses << ",";
+  if (sample.operations > 0) {
+    const double ops = sample.operations;
+    out << c.cycles / ops << "," << c.instructions / ops << ","
+        << c.llc_misses / ops << "," << c.branch_misses / ops;
+  } else {
+    out << ",,,";
+  }
+  out << ",";
+  if (c.cycles > 0) {
+    out << static_cast<double>(c.instructions) / c.cycles;
+  }
+  out << std::endl;
+}
+
+}  // namespace
+
+namespace tl {
+namespace bench {
+
+PerfCounterValues& PerfCounterValues::operator+=(
+    const PerfCounterValues& other) {
+  cycles += other.cycles;
+  instructions += other.instructions;
+  llc_misses += other.llc_misses;
+  branch_misses += other.branch_misses;
+  return *this;
+}
+
+PerfCounterValues PerfCounterValues::operator-(
+    const PerfCounterValues& other) const {
+  PerfCounterValues result;
+  result.cycles = cycles - other.cycles;
+  result.instructions = instructions - other.instructions;
+  result.llc_misses = llc_misses - other.llc_misses;
+  result.branch_misses = branch_misses - other.branch_misses;
+  return result;
+}
+
+void PerfCounters::SetEnabled(const bool enabled) {
+  GetState().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool PerfCounters::IsEnabled() {
+  return GetState().enabled.load(std::memory_order_relaxed);
+}
+
+void PerfCounters::RegisterThread() {
+  if (!IsEnabled() || local_counters != nullptr) return;
+  State& state = GetState();
+  auto counters = std::make_unique<ThreadCounters>();
+
+  std::unique_lock<std::mutex> lock(state.mutex);
+  if (!state.unavailable) {
+    bool opened = counters->Open(state.exclude_kernel);
+    if (!opened && !state.exclude_kernel &&
+        (errno == EACCES || errno == EPERM)) {
+      // Kernel-mode counting may be disallowed for unprivileged users.
+      counters = std::make_unique<ThreadCounters>();
+      opened = counters->Open(/*exclude_kernel=*/true);
+      if (opened) {
+        state.exclude_kernel = true;
+        std::cerr << "> WARNING: Only counting user-mode hardware events."
+                  << std::endl;
+      }
+    }
+    if (!opened) {
+      state.unavailable = true;
+      std::cerr << "> WARNING: Failed to open the hardware performance "
+                   "counters: "
+                << strerror(errno) << std::endl;
+      counters = std::make_unique<ThreadCounters>();
+    }
+  }
+  local_counters = counters.get();
+  state.threads.push_back(std::move(counters));
+}
+
+void PerfCounters::CountOperations(const uint64_t num_operations) {
+  if (local_counters == nullptr) return;
+  local_counters->operations.fetch_add(num_operations,
+                                       std::memory_order_relaxed);
+}
+
+void PerfCounters::StartPhase(const std::string& name) {
+  if (!IsEnabled()) return;
+  State& state = GetState();
+  std::unique_lock<std::mutex> lock(state.mutex);
+  state.in_phase = true;
+  state.phase_name = name;
+  state.phase_start = state.SampleAll();
+}
+
+void PerfCounters::FinishPhase() {
+  if (!IsEnabled()) return;
+  State& state = GetState();
+  std::unique_lock<std::mutex> lock(state.mutex);
+  if (!state.in_phase) return;
+  state.in_phase = false;
+  if (state.unavailable) return;
+
+  PhaseResult result;
+  result.name = state.phase_name;
+  result.threads = state.SampleAll();
+  // Threads registered during the phase started counting from zero.
+  for (size_t i = 0; i < state.phase_start.size(); ++i) {
+    Sample& sample = result.threads[i];
+    sample.counters = sample.counters - state.phase_start[i].counters;
+    sample.operations -= state.phase_start[i].operations;
+  }
+  state.results.push_back(std::move(result));
+}
+
+bool PerfCounters::HasResults() {
+  State& state = GetState();
+  std::unique_lock<std::mutex> lock(state.mutex);
+  return !state.results.empty();
+}
+
+void PerfCounters::ClearResults() {
+  State& state = GetState();
+  std::unique_lock<std::mutex> lock(state.mutex);
+  state.results.clear();
+}
+
+void PerfCounters::PrintAsCsv(std::ostream& out) {
+  State& state = GetState();
+  std::unique_lock<std::mutex> lock(state.mutex);
+  out << "phase,thread,operations,cycles,instructions,llc_misses,"
+         "branch_misses,cycles_per_op,instructions_per_op,llc_misses_per_op,"
+         "branch_misses_per_op,ipc"
+      << std::endl;
+  for (const auto& result : state.results) {
+    Sample total;
+    for (size_t i = 0; i < result.threads.size(); ++i) {
+      const Sample& sample = result.threads[i];
+      // Skip threads that were idle during this phase.
+      if (sample.operations == 0 && sample.counters.instructions == 0) {
+        continue;
+      }
+      PrintRow(out, result.name, std::to_string(i), sample);
+      total.counters += sample.counters;
+      total.operations += sample.operations;
+    }
+    PrintRow(out, result.name, "all", total);
+  }
+}
+
+}  // namespace bench
+}  // namespace tl
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tl {
+namespace bench {
+
+// Hardware performance counter values (see `PerfCounters`).
+struct PerfCounterValues {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  // The generic "cache misses" event, which counts last level cache misses on
+  // most CPUs.
+  uint64_t llc_misses = 0;
+  uint64_t branch_misses = 0;
+
+  PerfCounterValues& operator+=(const PerfCounterValues& other);
+  PerfCounterValues operator-(const PerfCounterValues& other) const;
+};
+
+// Measures CPU cycles, instructions, last level cache misses, and branch
+// misses on the benchmark's worker threads using `perf_event_open()`. Each
+// registered thread gets its own counter group; the counters are read at
+// workload phase boundaries (`StartPhase()` / `FinishPhase()`) and the
+// per-phase differences are reported per thread and in total, along with the
+// number of operations each thread ran during the phase.
+//
+// Threads that the database creates itself (e.g., background I/O threads) are
+// not measured. If the counters cannot be opened (e.g., because of the
+// system's `perf_event_paranoid` setting), a warning is printed and no values
+// are reported. If only kernel-mode counting is disallowed, the counters only
+// count user-mode events.
+//
+// Counting is disabled by default; all methods are no-ops when it is
+// disabled. All methods are thread-safe.
+class PerfCounters {
+ public:
+  // Must be called before any threads are registered.
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+
+  // Opens a counter group for the calling thread. Does nothing if the thread
+  // is already registered.
+  static void RegisterThread();
+
+  // Adds to the calling thread's operation count (the thread must be
+  // registered).
+  static void CountOperations(uint64_t num_operations);
+
+  // Marks the start and end of a workload phase. Phases must not overlap.
+  static void StartPhase(const std::string& name);
+  static void FinishPhase();
+
+  // Returns true if any phase results are available.
+  static bool HasResults();
+  // Discards the phase results recorded so far.
+  static void ClearResults();
+
+  // Writes the phase results as a CSV table (with a header row). Each phase
+  // has one row per thread that was active during the phase and a row with
+  // the totals (with thread "all").
+  static void PrintAsCsv(std::ostream& out);
+};
+
+}  // namespace bench
+}  // namespace tl
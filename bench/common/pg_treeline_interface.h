@@ -4,6 +4,8 @@
 #include <filesystem>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "config.h"
 #include "treeline/pg_db.h"
@@ -36,6 +38,8 @@ class PGTreeLineInterface {
       out << "cache_misses," << stats.GetCacheMisses() << std::endl;
       out << "cache_clean_evictions," << stats.GetCacheCleanEvictions() << std::endl;
       out << "cache_dirty_evictions," << stats.GetCacheDirtyEvictions() << std::endl;
+      out << "cache_background_writebacks," << stats.GetCacheBackgroundWritebacks() << std::endl;
+      out << "cache_range_hits," << stats.GetCacheRangeHits() << std::endl;
 
       out << "overflows_created," << stats.GetOverflowsCreated() << std::endl;
       out << "rewrites," << stats.GetRewrites() << std::endl;
@@ -49,8 +53,32 @@ class PGTreeLineInterface {
       out << "cache_bytes," << stats.GetCacheBytes() << std::endl;
 
       out << "overfetched_pages," << stats.GetOverfetchedPages() << std::endl;
+
+      out << "numa_local_accesses," << stats.GetNumaLocalAccesses() << std::endl;
+      out << "numa_remote_accesses," << stats.GetNumaRemoteAccesses() << std::endl;
+      out << "numa_remote_access_ratio," << stats.GetNumaRemoteAccessRatio() << std::endl;
+      out << "combined_write_batches," << stats.GetCombinedWriteBatches() << std::endl;
+      out << "combined_write_records," << stats.GetCombinedWriteRecords() << std::endl;
+
+      using LockWaitMode = tl::pg::PageGroupedDBStats::LockWaitMode;
+      const std::vector<std::pair<LockWaitMode, std::string>> lock_wait_modes = {
+          {LockWaitMode::kSegmentPageRead, "segment_page_read"},
+          {LockWaitMode::kSegmentPageWrite, "segment_page_write"},
+          {LockWaitMode::kSegmentReorg, "segment_reorg"},
+          {LockWaitMode::kSegmentReorgExclusive, "segment_reorg_exclusive"},
+          {LockWaitMode::kPageShared, "page_shared"},
+          {LockWaitMode::kPageExclusive, "page_exclusive"}};
+      for (const auto& [mode, name] : lock_wait_modes) {
+        out << "lock_waits_" << name << "," << stats.GetLockWaits(mode) << std::endl;
+        out << "lock_wait_ns_" << name << "," << stats.GetLockWaitNanos(mode) << std::endl;
+      }
       // clang-format on
     });
+
+    if (!key_range_stats_csv_.empty()) {
+      std::ofstream ranges(out_dir / "key_range_stats.csv");
+      ranges << key_range_stats_csv_;
+    }
   }
 
   // Called once before the benchmark.
@@ -95,6 +123,10 @@ class PGTreeLineInterface {
     if (db_ == nullptr) {
       return;
     }
+    // Keep the per key range statistics for `WriteOutStats()`.
+    if (!db_->GetProperty("pg.key-range-stats", &key_range_stats_csv_).ok()) {
+      key_range_stats_csv_.clear();
+    }
     delete db_;
     db_ = nullptr;
   }
@@ -162,4 +194,6 @@ class PGTreeLineInterface {
   }
 
   tl::pg::PageGroupedDB* db_;
+  // Saved when the DB is shut down (empty if the statistics were disabled).
+  std::string key_range_stats_csv_;
 };
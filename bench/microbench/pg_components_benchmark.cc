@@ -0,0 +1,403 @@
+// Microbenchmarks for the page-grouped engine's hot components (pages, the
+// segment index, page models, the segment builder, the lock manager and the
+// page merge iterator).
+//
+// The benchmarks run on synthetic key distributions and, optionally, on the
+// taxi and wiki datasets (see `bench/data`). Pass the key files written by
+// those generators using `--taxi_dataset` and `--wiki_dataset`.
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench/common/load_data.h"
+#include "benchmark/benchmark.h"
+#include "bufmgr/page_memory_allocator.h"
+#include "gflags/gflags.h"
+#include "page_grouping/key.h"
+#include "page_grouping/lock_manager.h"
+#include "page_grouping/persist/merge_iterator.h"
+#include "page_grouping/persist/page.h"
+#include "page_grouping/segment_builder.h"
+#include "page_grouping/segment_index.h"
+#include "util/key.h"
+
+DEFINE_uint64(num_keys, 1000000,
+              "The number of keys in each synthetic dataset.");
+DEFINE_string(taxi_dataset, "",
+              "The path to a taxi dataset key file (one key per line).");
+DEFINE_string(wiki_dataset, "",
+              "The path to a wiki dataset key file (one key per line).");
+
+namespace {
+
+// N.B. `tl::Page` is the legacy TreeLine page.
+using namespace tl::pg;
+using tl::PageBuffer;
+using tl::PageMemoryAllocator;
+using tl::Slice;
+namespace key_utils = tl::key_utils;
+
+constexpr size_t kRecordsPerPageGoal = 44;
+constexpr double kRecordsPerPageEpsilon = 5;
+constexpr size_t kNumLookups = 1 << 16;
+constexpr size_t kNumPages = 1024;
+
+// All records use this 8 byte value (for 16 byte records).
+const std::string kValue(8, 'v');
+
+// A sorted set of distinct keys, along with a random sample of the keys that
+// is used for lookups.
+struct Dataset {
+  std::string name;
+  std::vector<Record> records;
+  std::vector<Key> lookups;
+};
+
+Dataset MakeDataset(std::string name, std::vector<Key> keys) {
+  // Keys 0 and 2^64 - 1 are reserved.
+  keys.erase(std::remove_if(keys.begin(), keys.end(),
+                            [](const Key key) {
+                              return key == 0 ||
+                                     key == std::numeric_limits<Key>::max();
+                            }),
+             keys.end());
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  Dataset dataset;
+  dataset.name = std::move(name);
+  dataset.records.reserve(keys.size());
+  for (const Key key : keys) {
+    dataset.records.emplace_back(key, Slice(kValue));
+  }
+  std::mt19937 prng(42);
+  std::uniform_int_distribution<size_t> dist(0, keys.size() - 1);
+  dataset.lookups.resize(kNumLookups);
+  for (auto& key : dataset.lookups) {
+    key = keys[dist(prng)];
+  }
+  return dataset;
+}
+
+std::vector<Dataset> LoadDatasets() {
+  std::vector<Dataset> datasets;
+  std::mt19937_64 prng(42);
+
+  // Uniformly distributed 64-bit keys.
+  std::vector<Key> uniform(FLAGS_num_keys);
+  for (auto& key : uniform) {
+    key = prng();
+  }
+  datasets.push_back(MakeDataset("uniform", std::move(uniform)));
+
+  // Dense runs of consecutive keys separated by random gaps (e.g., keys that
+  // are assigned sequentially by different clients).
+  std::vector<Key> runs;
+  runs.reserve(FLAGS_num_keys);
+  std::uniform_int_distribution<size_t> run_length(1, 1000);
+  std::uniform_int_distribution<Key> gap(1, 1ULL << 32);
+  for (Key key = 1; runs.size() < FLAGS_num_keys; key += gap(prng)) {
+    for (size_t i = run_length(prng); i > 0 && runs.size() < FLAGS_num_keys;
+         --i) {
+      runs.push_back(key++);
+    }
+  }
+  datasets.push_back(MakeDataset("runs", std::move(runs)));
+
+  if (!FLAGS_taxi_dataset.empty()) {
+    datasets.push_back(MakeDataset(
+        "taxi", tl::bench::LoadDatasetFromTextFile(FLAGS_taxi_dataset)));
+  }
+  if (!FLAGS_wiki_dataset.empty()) {
+    datasets.push_back(MakeDataset(
+        "wiki", tl::bench::LoadDatasetFromTextFile(FLAGS_wiki_dataset)));
+  }
+  return datasets;
+}
+
+// Fills `page` with `records` (which must be sorted). Returns false if the
+// records do not fit.
+bool FillPage(void* buffer, std::vector<Record>::const_iterator begin,
+              std::vector<Record>::const_iterator end) {
+  const key_utils::IntKeyAsSlice lower(begin->first);
+  const key_utils::IntKeyAsSlice upper((end - 1)->first);
+  Page page(buffer, lower.as<Slice>(), upper.as<Slice>());
+  for (auto it = begin; it != end; ++it) {
+    const key_utils::IntKeyAsSlice key(it->first);
+    if (!page.Put(key.as<Slice>(), it->second).ok()) return false;
+  }
+  return true;
+}
+
+// The number of records used by the page benchmarks.
+size_t NumPageRecords(const Dataset& dataset) {
+  return std::min(dataset.records.size() / kRecordsPerPageGoal, kNumPages) *
+         kRecordsPerPageGoal;
+}
+
+// Looks up keys in pages that each hold `kRecordsPerPageGoal` records.
+void PageGet(benchmark::State& state, const Dataset* dataset) {
+  const size_t num_records = NumPageRecords(*dataset);
+  const size_t num_pages = num_records / kRecordsPerPageGoal;
+  PageBuffer pages = PageMemoryAllocator::Allocate(num_pages);
+  for (size_t i = 0; i < num_pages; ++i) {
+    const auto begin = dataset->records.begin() + i * kRecordsPerPageGoal;
+    FillPage(pages.get() + i * Page::kSize, begin,
+             begin + kRecordsPerPageGoal);
+  }
+  std::mt19937 prng(42);
+  std::uniform_int_distribution<size_t> dist(0, num_records - 1);
+  std::vector<size_t> lookups(kNumLookups);
+  for (auto& idx : lookups) {
+    idx = dist(prng);
+  }
+
+  std::string value_out;
+  size_t i = 0;
+  for (auto _ : state) {
+    const size_t idx = lookups[i++ % lookups.size()];
+    Page page(pages.get() + (idx / kRecordsPerPageGoal) * Page::kSize);
+    const key_utils::IntKeyAsSlice key(dataset->records[idx].first);
+    benchmark::DoNotOptimize(page.Get(key.as<Slice>(), &value_out));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Fills a page with `kRecordsPerPageGoal` records, inserted in key order or in
+// a random order.
+void PagePut(benchmark::State& state, const Dataset* dataset, bool shuffle) {
+  const size_t num_pages = NumPageRecords(*dataset) / kRecordsPerPageGoal;
+  std::vector<Record> records(
+      dataset->records.begin(),
+      dataset->records.begin() + num_pages * kRecordsPerPageGoal);
+  if (shuffle) {
+    std::mt19937 prng(42);
+    for (size_t i = 0; i < num_pages; ++i) {
+      const auto begin = records.begin() + i * kRecordsPerPageGoal;
+      std::shuffle(begin, begin + kRecordsPerPageGoal, prng);
+    }
+  }
+  PageBuffer buffer = PageMemoryAllocator::Allocate(/*num_pages=*/1);
+
+  size_t page_idx = 0;
+  for (auto _ : state) {
+    const auto begin = dataset->records.begin() +
+                       (page_idx % num_pages) * kRecordsPerPageGoal;
+    const auto end = begin + kRecordsPerPageGoal;
+    const key_utils::IntKeyAsSlice lower(begin->first);
+    const key_utils::IntKeyAsSlice upper((end - 1)->first);
+    Page page(buffer.get(), lower.as<Slice>(), upper.as<Slice>());
+    const auto to_insert =
+        records.begin() + (page_idx % num_pages) * kRecordsPerPageGoal;
+    for (auto it = to_insert; it != to_insert + kRecordsPerPageGoal; ++it) {
+      const key_utils::IntKeyAsSlice key(it->first);
+      benchmark::DoNotOptimize(page.Put(key.as<Slice>(), it->second));
+    }
+    ++page_idx;
+  }
+  state.SetItemsProcessed(state.iterations() * kRecordsPerPageGoal);
+}
+
+// Merges the records in a main page and its overflow page (the records are
+// interleaved between the two pages).
+void PageMergeIteratorScan(benchmark::State& state, const Dataset* dataset) {
+  const size_t num_pairs = NumPageRecords(*dataset) / (2 * kRecordsPerPageGoal);
+  PageBuffer pages = PageMemoryAllocator::Allocate(2 * num_pairs);
+  for (size_t i = 0; i < num_pairs; ++i) {
+    const auto begin = dataset->records.begin() + i * 2 * kRecordsPerPageGoal;
+    std::vector<Record> main_records, overflow_records;
+    for (size_t j = 0; j < 2 * kRecordsPerPageGoal; ++j) {
+      (j % 2 == 0 ? main_records : overflow_records).push_back(*(begin + j));
+    }
+    FillPage(pages.get() + 2 * i * Page::kSize, main_records.begin(),
+             main_records.end());
+    FillPage(pages.get() + (2 * i + 1) * Page::kSize, overflow_records.begin(),
+             overflow_records.end());
+  }
+
+  size_t pair_idx = 0;
+  for (auto _ : state) {
+    const size_t idx = pair_idx++ % num_pairs;
+    Page main_page(pages.get() + 2 * idx * Page::kSize);
+    Page overflow_page(pages.get() + (2 * idx + 1) * Page::kSize);
+    PageMergeIterator pmi(
+        {main_page.GetIterator(), overflow_page.GetIterator()});
+    for (; pmi.Valid(); pmi.Next()) {
+      benchmark::DoNotOptimize(pmi.key());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * kRecordsPerPageGoal);
+}
+
+// Builds segments over the whole dataset.
+void SegmentBuilderBuild(benchmark::State& state, const Dataset* dataset,
+                         SegmentBuilder::Strategy strategy) {
+  size_t num_segments = 0;
+  for (auto _ : state) {
+    SegmentBuilder builder(kRecordsPerPageGoal, kRecordsPerPageEpsilon,
+                           strategy);
+    num_segments = builder.BuildFromDataset(dataset->records).size();
+    benchmark::DoNotOptimize(num_segments);
+  }
+  state.SetItemsProcessed(state.iterations() * dataset->records.size());
+  state.counters["segments"] = num_segments;
+}
+
+// The segments built over a dataset, loaded into a `SegmentIndex`.
+class IndexedSegments {
+ public:
+  explicit IndexedSegments(const Dataset& dataset)
+      : index_(std::make_shared<LockManager>()) {
+    SegmentBuilder builder(kRecordsPerPageGoal, kRecordsPerPageEpsilon);
+    const std::vector<Segment> segments =
+        builder.BuildFromDataset(dataset.records);
+    std::vector<size_t> next_offset(SegmentBuilder::SegmentPageCounts().size(),
+                                    0);
+    std::vector<std::pair<Key, SegmentInfo>> entries;
+    entries.reserve(segments.size());
+    for (const auto& seg : segments) {
+      const size_t file_id =
+          SegmentBuilder::PageCountToSegment().at(seg.page_count);
+      const SegmentId id(file_id, next_offset[file_id]);
+      next_offset[file_id] += seg.page_count;
+      entries.emplace_back(
+          seg.base_key,
+          SegmentInfo(id, seg.model.has_value()
+                              ? seg.model->line()
+                              : std::optional<plr::Line64>()));
+    }
+    index_.BulkLoadFromEmpty(entries.begin(), entries.end());
+  }
+
+  const SegmentIndex& index() const { return index_; }
+
+ private:
+  SegmentIndex index_;
+};
+
+// Finds the segment that holds each key (without locking it).
+void SegmentIndexLookup(benchmark::State& state, const Dataset* dataset) {
+  const IndexedSegments segments(*dataset);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        segments.index().SegmentForKey(dataset->lookups[i++ % kNumLookups]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Evaluates the page models of multi-page segments.
+void PageForKeyModel(benchmark::State& state, const Dataset* dataset) {
+  struct Lookup {
+    Key base_key;
+    plr::Line64 model;
+    size_t page_count;
+    Key key;
+  };
+  const IndexedSegments segments(*dataset);
+  std::vector<Lookup> lookups;
+  for (const Key key : dataset->lookups) {
+    const auto seg = segments.index().SegmentForKey(key);
+    if (seg.sinfo.page_count() == 1) continue;
+    lookups.push_back(
+        {seg.lower, *seg.sinfo.model(), seg.sinfo.page_count(), key});
+  }
+  if (lookups.empty()) {
+    state.SkipWithError("The dataset has no multi-page segments.");
+    return;
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    const Lookup& lookup = lookups[i++ % lookups.size()];
+    benchmark::DoNotOptimize(PageForKey(lookup.base_key, lookup.model,
+                                        lookup.page_count, lookup.key));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Acquires and releases the locks a reader takes (a segment lock in
+// `kPageRead` mode and a shared page lock) on random pages. Shared by all the
+// benchmark threads.
+LockManager& SharedLockManager() {
+  static LockManager lock_manager;
+  return lock_manager;
+}
+
+void LockManagerAcquireRelease(benchmark::State& state, bool exclusive) {
+  constexpr size_t kNumSegments = 1024;
+  constexpr size_t kPagesPerSegment = 16;
+  LockManager& lock_manager = SharedLockManager();
+  std::mt19937 prng(state.thread_index());
+  std::uniform_int_distribution<size_t> segment_dist(0, kNumSegments - 1);
+  std::uniform_int_distribution<size_t> page_dist(0, kPagesPerSegment - 1);
+  const auto page_mode = exclusive ? LockManager::PageMode::kExclusive
+                                   : LockManager::PageMode::kShared;
+
+  for (auto _ : state) {
+    const SegmentId seg_id(/*file_id=*/4,
+                           segment_dist(prng) * kPagesPerSegment);
+    const size_t page_idx = page_dist(prng);
+    while (!lock_manager.TryAcquireSegmentLock(
+        seg_id, LockManager::SegmentMode::kPageRead)) {
+    }
+    lock_manager.AcquirePageLock(seg_id, page_idx, page_mode);
+    lock_manager.ReleasePageLock(seg_id, page_idx, page_mode);
+    lock_manager.ReleaseSegmentLock(seg_id,
+                                    LockManager::SegmentMode::kPageRead);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CAPTURE(LockManagerAcquireRelease, shared, /*exclusive=*/false)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(LockManagerAcquireRelease, exclusive, /*exclusive=*/true)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+void RegisterDatasetBenchmarks(const std::vector<Dataset>& datasets) {
+  for (const auto& dataset : datasets) {
+    const std::string& name = dataset.name;
+    benchmark::RegisterBenchmark(("PageGet/" + name).c_str(), PageGet,
+                                 &dataset);
+    benchmark::RegisterBenchmark(("PagePut/in_order/" + name).c_str(), PagePut,
+                                 &dataset, /*shuffle=*/false);
+    benchmark::RegisterBenchmark(("PagePut/shuffled/" + name).c_str(), PagePut,
+                                 &dataset, /*shuffle=*/true);
+    benchmark::RegisterBenchmark(("PageMergeIterator/" + name).c_str(),
+                                 PageMergeIteratorScan, &dataset);
+    benchmark::RegisterBenchmark(("SegmentBuilder/greedy/" + name).c_str(),
+                                 SegmentBuilderBuild, &dataset,
+                                 SegmentBuilder::Strategy::kGreedy)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(("SegmentBuilder/pgm/" + name).c_str(),
+                                 SegmentBuilderBuild, &dataset,
+                                 SegmentBuilder::Strategy::kPGM)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(("SegmentIndexLookup/" + name).c_str(),
+                                 SegmentIndexLookup, &dataset);
+    benchmark::RegisterBenchmark(("PageForKey/" + name).c_str(),
+                                 PageForKeyModel, &dataset);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage(
+      "Microbenchmarks for the page-grouped engine's components.");
+  benchmark::Initialize(&argc, argv);
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+
+  const std::vector<Dataset> datasets = LoadDatasets();
+  RegisterDatasetBenchmarks(datasets);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
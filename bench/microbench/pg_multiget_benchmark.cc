@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "treeline/pg_db.h"
+#include "treeline/pg_options.h"
+
+namespace {
+
+using namespace tl;
+using namespace tl::pg;
+
+constexpr size_t kNumRecords = 1000000;
+constexpr size_t kNumLookups = 1 << 16;
+constexpr size_t kValueSize = 16;
+
+// Loads a database whose records all fit in the record cache and warms up the
+// cache, so that the lookups do not do any I/O.
+class CachedDB {
+ public:
+  CachedDB()
+      : db_path_(std::filesystem::temp_directory_path() /
+                 "pg_multiget_benchmark") {
+    std::filesystem::remove_all(db_path_);
+    PageGroupedDBOptions options;
+    options.use_memory_based_io = true;
+    options.num_bg_threads = 0;
+    options.record_cache_capacity = kNumRecords;
+
+    PageGroupedDB* db = nullptr;
+    if (!PageGroupedDB::Open(options, db_path_, &db).ok()) {
+      throw std::runtime_error("Failed to open the database.");
+    }
+    db_.reset(db);
+
+    const std::string value(kValueSize, 'v');
+    std::vector<Record> records;
+    records.reserve(kNumRecords);
+    for (size_t i = 1; i <= kNumRecords; ++i) {
+      records.emplace_back(i, Slice(value));
+    }
+    if (!db_->BulkLoad(records).ok()) {
+      throw std::runtime_error("Failed to bulk load the database.");
+    }
+
+    std::string value_out;
+    for (size_t i = 1; i <= kNumRecords; ++i) {
+      db_->Get(i, &value_out);
+    }
+
+    // The lookups use uniformly random keys.
+    lookup_keys_.resize(kNumLookups);
+    std::mt19937 prng(42);
+    std::uniform_int_distribution<Key> dist(1, kNumRecords);
+    for (auto& key : lookup_keys_) {
+      key = dist(prng);
+    }
+  }
+
+  ~CachedDB() {
+    db_.reset();
+    std::filesystem::remove_all(db_path_);
+  }
+
+  PageGroupedDB* db() const { return db_.get(); }
+  const std::vector<Key>& lookup_keys() const { return lookup_keys_; }
+
+ private:
+  std::filesystem::path db_path_;
+  std::unique_ptr<PageGroupedDB> db_;
+  std::vector<Key> lookup_keys_;
+};
+
+const CachedDB& GetCachedDB() {
+  static const CachedDB db;
+  return db;
+}
+
+// Looks up the keys one at a time, in batches of `state.range(0)` keys.
+void PGScalarGet(benchmark::State& state) {
+  const CachedDB& cached = GetCachedDB();
+  const size_t batch_size = state.range(0);
+  const std::vector<Key>& keys = cached.lookup_keys();
+  std::vector<std::string> values(batch_size);
+
+  size_t offset = 0;
+  for (auto _ : state) {
+    if (offset + batch_size > keys.size()) offset = 0;
+    for (size_t i = 0; i < batch_size; ++i) {
+      cached.db()->Get(keys[offset + i], &values[i]);
+    }
+    benchmark::DoNotOptimize(values.data());
+    offset += batch_size;
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+// Looks up the keys in batches of `state.range(0)` keys using `MultiGet()`.
+void PGMultiGet(benchmark::State& state) {
+  const CachedDB& cached = GetCachedDB();
+  const size_t batch_size = state.range(0);
+  const std::vector<Key>& keys = cached.lookup_keys();
+  std::vector<Key> batch(batch_size);
+  std::vector<std::string> values;
+  std::vector<Status> statuses;
+
+  size_t offset = 0;
+  for (auto _ : state) {
+    if (offset + batch_size > keys.size()) offset = 0;
+    std::copy(keys.begin() + offset, keys.begin() + offset + batch_size,
+              batch.begin());
+    cached.db()->MultiGet(batch, &values, &statuses);
+    benchmark::DoNotOptimize(values.data());
+    offset += batch_size;
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+BENCHMARK(PGScalarGet)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK(PGMultiGet)->Arg(16)->Arg(64)->Arg(256);
+
+}  // namespace
@@ -1,4 +1,4 @@
-// Benchmarks that measure the `ThreadPool`'s submit overhead.
+// Benchmarks that measure the `ThreadPool`'s submit and join overhead.
 //
 // Build the benchmarks by enabling the `TL_BUILD_BENCHMARKS` option when
 // configuring the project. Then run the `microbench` executable under `bench`.
@@ -65,6 +65,45 @@ void BM_ThreadPoolSubmitNoWaitOverhead(benchmark::State& state) {
   }
 }
 
+void BM_ThreadPoolSubmitLatchOverhead(benchmark::State& state) {
+  tl::ThreadPool pool(state.range(0));
+  tl::Latch latch(state.max_iterations);
+  for (auto _ : state) {
+    pool.Submit(latch, NoOp);
+  }
+  pool.Wait(latch);
+}
+
+// Measures the time it takes to run (and wait for) a batch of small tasks, as
+// done when issuing I/O in parallel on the background threads.
+constexpr size_t kFanOutTasks = 64;
+
+void BM_ThreadPoolFanOutFutures(benchmark::State& state) {
+  tl::ThreadPool pool(state.range(0));
+  std::vector<std::future<void>> futures;
+  futures.reserve(kFanOutTasks);
+  for (auto _ : state) {
+    for (size_t i = 0; i < kFanOutTasks; ++i) {
+      futures.emplace_back(pool.Submit(NoOp));
+    }
+    for (auto& f : futures) {
+      f.get();
+    }
+    futures.clear();
+  }
+}
+
+void BM_ThreadPoolFanOutLatch(benchmark::State& state) {
+  tl::ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    tl::Latch latch(kFanOutTasks);
+    for (size_t i = 0; i < kFanOutTasks; ++i) {
+      pool.Submit(latch, NoOp);
+    }
+    pool.Wait(latch);
+  }
+}
+
 BENCHMARK(BM_ThreadPoolSubmitOverhead)
     ->RangeMultiplier(2)
     ->Range(1, 16);  // Number of threads to use
@@ -73,4 +112,16 @@ BENCHMARK(BM_ThreadPoolSubmitNoWaitOverhead)
     ->RangeMultiplier(2)
     ->Range(1, 16);  // Number of threads to use
 
+BENCHMARK(BM_ThreadPoolSubmitLatchOverhead)
+    ->RangeMultiplier(2)
+    ->Range(1, 16);  // Number of threads to use
+
+BENCHMARK(BM_ThreadPoolFanOutFutures)
+    ->RangeMultiplier(2)
+    ->Range(1, 16);  // Number of threads to use
+
+BENCHMARK(BM_ThreadPoolFanOutLatch)
+    ->RangeMultiplier(2)
+    ->Range(1, 16);  // Number of threads to use
+
 }  // namespace
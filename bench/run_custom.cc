@@ -1,10 +1,13 @@
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <string_view>
 
 #include "bench/common/config.h"
 #include "bench/common/leanstore_interface.h"
 #include "bench/common/load_data.h"
+#include "bench/common/perf_counted_interface.h"
+#include "bench/common/perf_counters.h"
 #include "bench/common/pg_treeline_interface.h"
 #include "bench/common/rocksdb_interface.h"
 #include "bench/common/startup.h"
@@ -34,6 +37,11 @@ DEFINE_uint64(throughput_sample_period, 0,
 DEFINE_bool(notify_after_init, false,
             "If set to true, this process will send a SIGUSR1 signal to its "
             "parent process after database initialization completes.");
+DEFINE_bool(perf_counters, false,
+            "If set, hardware performance counters (cycles, instructions, "
+            "LLC misses, branch misses) are measured on each worker thread "
+            "for each workload phase and written to perf_counters.csv in "
+            "--output_path.");
 
 DEFINE_string(
     custom_inserts, "",
@@ -44,7 +52,10 @@ DEFINE_string(
 
 template <class DatabaseInterface>
 ycsbr::BenchmarkResult Run(const ycsbr::gen::PhasedWorkload& workload) {
-  ycsbr::Session<DatabaseInterface> session(FLAGS_threads);
+  // Only report the counters of this database's run.
+  PerfCounters::ClearResults();
+  ycsbr::Session<PerfCountedInterface<DatabaseInterface>> session(
+      FLAGS_threads);
   if (!FLAGS_skip_load) {
     auto load = workload.GetLoadTrace(/*sort_requests=*/true);
     auto minmax = load.GetKeyRange();
@@ -55,7 +66,9 @@ ycsbr::BenchmarkResult Run(const ycsbr::gen::PhasedWorkload& workload) {
     if (FLAGS_verbose) {
       std::cerr << "> Loading " << load.size() << " records..." << std::endl;
     }
+    PerfCounters::StartPhase("load");
     session.ReplayBulkLoadTrace(load);
+    PerfCounters::FinishPhase();
   } else {
     if (FLAGS_verbose) {
       std::cerr << "> Skipping the initial data load." << std::endl;
@@ -80,11 +93,17 @@ ycsbr::BenchmarkResult Run(const ycsbr::gen::PhasedWorkload& workload) {
   options.throughput_sample_period = FLAGS_throughput_sample_period;
   options.output_dir = std::filesystem::path(FLAGS_output_path);
   options.throughput_output_file_prefix = "throughput-";
+  PerfCounters::StartPhase("run");
   const auto result = session.RunWorkload(workload, options);
+  PerfCounters::FinishPhase();
   session.Terminate();
 
   if (!FLAGS_output_path.empty()) {
     session.db().WriteOutStats(fs::path(FLAGS_output_path));
+    if (PerfCounters::HasResults()) {
+      std::ofstream out(fs::path(FLAGS_output_path) / "perf_counters.csv");
+      PerfCounters::PrintAsCsv(out);
+    }
   }
   return result;
 }
@@ -164,6 +183,8 @@ int main(int argc, char* argv[]) {
     fs::create_directory(FLAGS_output_path);
   }
 
+  PerfCounters::SetEnabled(FLAGS_perf_counters);
+
   std::cout << "db,";
   ycsbr::BenchmarkResult::PrintCSVHeader(std::cout);
 
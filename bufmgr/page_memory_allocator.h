@@ -7,6 +7,7 @@
 #include <new>
 
 #include "db/page.h"
+#include "util/numa.h"
 
 namespace tl {
 namespace detail {
@@ -26,8 +27,10 @@ using PageBuffer = std::unique_ptr<char[], detail::PageBufferDeleter>;
 class PageMemoryAllocator {
  public:
   // Get a heap-allocated buffer that is large enough to hold `num_pages` pages.
-  // The memory buffer will be zeroed out before it is returned.
-  static PageBuffer Allocate(size_t num_pages);
+  // The memory buffer will be zeroed out before it is returned. If
+  // `numa_local` is true, the buffer is placed on the NUMA node of the
+  // allocating thread (instead of wherever the pages are first touched).
+  static PageBuffer Allocate(size_t num_pages, bool numa_local = false);
 
   // Sets the memory alignment for future `PageBuffer`s returned by
   // `Allocate()`. See the comments above `kDefaultAlignment` for more
@@ -49,13 +52,17 @@ class PageMemoryAllocator {
 
 // Additional implementation details follow.
 
-inline PageBuffer PageMemoryAllocator::Allocate(const size_t num_pages) {
+inline PageBuffer PageMemoryAllocator::Allocate(const size_t num_pages,
+                                                const bool numa_local) {
   const size_t buffer_size = num_pages * Page::kSize;
   void* const buffer =
       aligned_alloc(PageMemoryAllocator::alignment_, buffer_size);
   if (buffer == nullptr) {
     throw std::bad_alloc();
   }
+  if (numa_local) {
+    numa::PreferNode(buffer, buffer_size, numa::CurrentNode());
+  }
   memset(buffer, 0, buffer_size);
   return PageBuffer(reinterpret_cast<char*>(buffer));
 }
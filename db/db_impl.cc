@@ -264,20 +264,15 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
 Status DBImpl::GetWithPage(const ReadOptions& options, const Slice& key,
                            std::string* value_out, PageBuffer* page_out) {
   // 1. Search the record cache.
-  uint64_t cache_index;
-  Status status =
-      rec_cache_->GetCacheIndex(key, /*exclusive = */ false, &cache_index);
+  format::WriteType write_type;
+  Status status = rec_cache_->GetCacheValue(key, value_out, &write_type);
   if (status.ok()) {
-    auto entry = &RecordCache::cache_entries[cache_index];
     ++stats_.temp_user_reads_cache_hits_records_;
 
-    if (entry->IsDelete()) {
-      entry->Unlock();
+    if (write_type == format::WriteType::kDelete) {
+      value_out->clear();
       return Status::NotFound("Key not found.");
     }
-
-    value_out->assign(entry->GetValue().data(), entry->GetValue().size());
-    entry->Unlock();
     return Status::OK();
   }
 
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "treeline/pg_options.h"
+#include "treeline/pg_stats.h"
 #include "treeline/slice.h"
 #include "treeline/status.h"
 
@@ -65,6 +68,17 @@ class PageGroupedDB {
   // will be returned where `Status::IsNotFound()` evaluates to true.
   virtual Status Get(const Key key, std::string* value_out) = 0;
 
+  // Retrieve the values corresponding to a batch of `keys`. For each `i`,
+  // `(*statuses_out)[i]` and `(*values_out)[i]` are set as if
+  // `Get(keys[i], &(*values_out)[i])` had been called.
+  //
+  // The record cache lookups for the batch are interleaved to overlap their
+  // memory stalls. The keys that are not cached are then read from disk in
+  // ascending order, so keys stored on the same page share one page read.
+  virtual Status MultiGet(const std::vector<Key>& keys,
+                          std::vector<std::string>* values_out,
+                          std::vector<Status>* statuses_out) = 0;
+
   // Retrieve an ascending range of at most `num_records` records, starting from
   // the smallest record whose key is greater than or equal to `start_key`.
   //
@@ -77,6 +91,32 @@ class PageGroupedDB {
                           std::vector<std::pair<Key, std::string>>* results_out,
                           bool use_experimental_prefetch = false) = 0;
 
+  // Receives a batch of records (sorted by key) produced by `ParallelScan()`.
+  using ScanCallback =
+      std::function<void(std::vector<std::pair<Key, std::string>> records)>;
+
+  // Retrieve all records with keys in the range [start_key, end_key) using up
+  // to `num_threads` threads (including the calling thread).
+  //
+  // The range is split into partitions along segment boundaries and each
+  // partition is scanned by one thread. Each thread reads whole segments and
+  // prefetches the next segment in its partition while it processes the
+  // current one. Prefetching relies on background threads, so
+  // `PageGroupedDBOptions::num_bg_threads` should be greater than 0.
+  //
+  // The records are passed to `callback` in batches. If `ordered` is true, the
+  // batches are delivered in ascending key order and `callback` is never called
+  // concurrently (batches that are read early are buffered until they can be
+  // delivered). Otherwise each batch is delivered as soon as it has been read
+  // and `callback` may be called concurrently by different threads. This
+  // method returns after all the batches have been delivered.
+  //
+  // This method is thread-safe.
+  virtual Status ParallelScan(const Key start_key, const Key end_key,
+                              const size_t num_threads,
+                              const ScanCallback& callback,
+                              bool ordered = true) = 0;
+
   // Removes all overflow pages in the specified key range. The `end_key` is
   // exclusive.
   //
@@ -96,6 +136,69 @@ class PageGroupedDB {
   virtual Status FlattenRange(
       const Key start_key = 1,
       const Key end_key = std::numeric_limits<Key>::max()) = 0;
+
+  // Blocks until the record cache has been warmed up after reopening the DB
+  // (see `PageGroupedDBOptions::rec_cache_persist`). The warm-up runs in the
+  // background, so `Open()` can return before it finishes. Returns right away
+  // if there is no warm-up in progress.
+  //
+  // This method is thread-safe.
+  virtual Status WaitForCacheWarmUp() = 0;
+
+  // Retrieves a summary of the database's current statistics (see
+  // `PageGroupedDBLiveStats`). The thread local counters are aggregated on
+  // demand, without pausing the threads that update them, and the segment
+  // statistics are computed from the current segment index. This method is
+  // meant to be polled periodically (e.g., for monitoring); it takes time
+  // linear in the number of segments.
+  //
+  // This method is thread-safe.
+  virtual Status GetStats(PageGroupedDBLiveStats* stats_out) = 0;
+
+  // Retrieves the per key range write amplification and reorganization
+  // statistics (see `PageGroupedDBKeyRangeStats`), one entry per range in
+  // ascending key order. Returns `Status::NotSupported` if
+  // `PageGroupedDBOptions::key_range_stats_buckets` is 0.
+  //
+  // This method is thread-safe.
+  virtual Status GetKeyRangeStats(
+      std::vector<PageGroupedDBKeyRangeStats>* stats_out) = 0;
+
+  // Retrieves the lock contention statistics (see
+  // `PageGroupedDBLockContentionStats`). Returns `Status::NotSupported` if
+  // `PageGroupedDBOptions::lock_profiling_top_n` is 0.
+  //
+  // This method is thread-safe.
+  virtual Status GetLockContentionStats(
+      PageGroupedDBLockContentionStats* stats_out) = 0;
+
+  // Retrieves a single statistic, formatted as a string. Returns
+  // `Status::NotFound` if `property` is not a known property. The supported
+  // properties are:
+  //
+  //   "pg.cache-hit-ratio"       Record cache hits / (hits + misses).
+  //   "pg.cache-dirty-ratio"     Dirty cache records / cache capacity.
+  //   "pg.segments-by-size"      The number of segments of each size, as a
+  //                              comma-separated list of "<pages>:<count>".
+  //   "pg.overflowed-segments"   The number of segments with an overflow page.
+  //   "pg.reorg-backlog-pages"   The number of pages in segments that have an
+  //                              overflow page.
+  //   "pg.free-list-bytes"       The memory used by the free list.
+  //   "pg.page-reads-by-size"    The number of reads of each size, as a
+  //                              comma-separated list of "<pages>:<count>".
+  //   "pg.page-writes-by-size"   Same as above, for writes.
+  //   "pg.stats"                 All of the above, one "<property>: <value>"
+  //                              pair per line.
+  //   "pg.key-range-stats"       The per key range statistics (see
+  //                              `GetKeyRangeStats()`) as a CSV table.
+  //   "pg.lock-contention"       The per lock mode contention statistics (see
+  //                              `GetLockContentionStats()`) as a CSV table,
+  //                              followed by a blank line and a CSV table of
+  //                              the most contended locks.
+  //
+  // This method is thread-safe.
+  virtual Status GetProperty(const std::string& property,
+                             std::string* value_out) = 0;
 };
 
 }  // namespace pg
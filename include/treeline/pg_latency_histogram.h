@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace tl {
+namespace pg {
+
+// A log-linear histogram of latencies (in nanoseconds).
+//
+// Each power-of-two range of values is split into `kSubBuckets` equally sized
+// buckets, so a recorded value is known to within 1 / `kSubBuckets` (about 6%)
+// of its magnitude. Recording a value is a few arithmetic instructions and one
+// increment, which keeps the histogram cheap enough to use on the hot path.
+//
+// This class is not thread safe; it is meant to be used through the thread
+// local `PageGroupedDBStats` instances and merged when needed.
+class LatencyHistogram {
+ public:
+  static constexpr size_t kSubBucketBits = 4;
+  static constexpr size_t kSubBuckets = 1ULL << kSubBucketBits;
+  // Values of 2^`kMaxValueBits` ns (about 18 minutes) or more are all placed
+  // in the last bucket.
+  static constexpr size_t kMaxValueBits = 40;
+  static constexpr size_t kNumBuckets =
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+  LatencyHistogram() { Reset(); }
+
+  void Record(uint64_t nanos) {
+    ++buckets_[BucketFor(nanos)];
+    ++count_;
+    sum_ += nanos;
+    if (nanos < min_) min_ = nanos;
+    if (nanos > max_) max_ = nanos;
+  }
+
+  // Adds the values recorded in `other` to this histogram.
+  void Merge(const LatencyHistogram& other);
+  void Reset();
+
+  uint64_t Count() const { return count_; }
+  uint64_t Min() const { return count_ == 0 ? 0 : min_; }
+  uint64_t Max() const { return max_; }
+  double Mean() const {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+  }
+
+  // Returns an upper bound on the `p`-th percentile (0 < `p` <= 100) of the
+  // recorded values. The bound is within the precision of the bucket that
+  // holds the percentile. Returns 0 if no values have been recorded.
+  uint64_t Percentile(double p) const;
+
+ private:
+  static size_t BucketFor(uint64_t nanos) {
+    if (nanos < kSubBuckets) return nanos;
+    const size_t exp = 63 - __builtin_clzll(nanos);
+    if (exp >= kMaxValueBits) return kNumBuckets - 1;
+    return (exp - kSubBucketBits + 1) * kSubBuckets +
+           ((nanos >> (exp - kSubBucketBits)) & (kSubBuckets - 1));
+  }
+  // The smallest value that is placed in bucket `idx`.
+  static uint64_t BucketLowerBound(size_t idx);
+
+  std::array<uint64_t, kNumBuckets> buckets_;
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t min_;
+  uint64_t max_;
+};
+
+}  // namespace pg
+}  // namespace tl
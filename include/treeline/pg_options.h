@@ -1,10 +1,14 @@
 #pragma once
 
 #include <cstdlib>
+#include <memory>
+#include <string>
 
 namespace tl {
 namespace pg {
 
+class SimulatedSSD;
+
 struct InsertForecastingOptions {
   bool use_insert_forecasting = true;
 
@@ -87,6 +91,112 @@ struct PageGroupedDBOptions {
   // parallel when it shuts down.
   bool parallelize_final_flush = false;
 
+  // If true, a background thread will write out dirty records from the record
+  // cache (in parallel, grouped by page) once the fraction of dirty cache
+  // entries exceeds `rec_cache_writeback_high_watermark`. It stops once the
+  // fraction falls below `rec_cache_writeback_low_watermark`. This way,
+  // foreground evictions should rarely need to write out a dirty record.
+  //
+  // If enabled, `PageGroupedDB::Open()` requires
+  // 0 <= low watermark < high watermark <= 1.
+  bool rec_cache_background_writeback = false;
+  double rec_cache_writeback_high_watermark = 0.5;
+  double rec_cache_writeback_low_watermark = 0.25;
+
+  // The maximum number of dirty records the background writer will write out
+  // in one batch.
+  size_t rec_cache_writeback_batch_size = 4096;
+
+  // If true, the DB will record the keys (and their eviction priorities) of
+  // the records in the record cache when it shuts down. When the DB is
+  // reopened, a background thread will read these records back into the cache
+  // (using batched reads) so that it does not start with a cold cache. `Open()`
+  // does not wait for the warm-up (see `PageGroupedDB::WaitForCacheWarmUp()`).
+  bool rec_cache_persist = false;
+
+  // If true (and `rec_cache_persist` is true), the DB will also record the
+  // cached records' values when it shuts down. This avoids the reads needed to
+  // warm up the cache on reopen, at the cost of a larger file.
+  bool rec_cache_persist_values = false;
+
+  // If true, the DB will try to avoid remote NUMA memory accesses: the
+  // background threads are pinned to cores spread across the NUMA nodes (and
+  // tasks are queued on workers on the submitting thread's node), and I/O
+  // buffers are allocated on the allocating thread's node. The DB will also
+  // sample memory accesses to record the fraction of remote accesses (see
+  // `PageGroupedDBStats`). This option has no placement effect on machines with
+  // one NUMA node.
+  bool numa_aware = false;
+
+  // If true (and `numa_aware` is true), the record cache's entries are
+  // interleaved across the NUMA nodes (instead of being placed on the node of
+  // the thread that opens the DB).
+  bool rec_cache_numa_interleave = false;
+
+  // If true, the DB will write a checkpoint of its segment index (the segment
+  // boundaries, models, and overflow flags) and its free list when it shuts
+  // down. When the DB is reopened, it will load the index from the checkpoint
+  // instead of reading every segment on disk.
+  bool index_checkpoint = false;
+
+  // If nonzero (and `index_checkpoint` is true), the DB will also write an
+  // index checkpoint after every `index_checkpoint_interval` reorganizations.
+  // This way, reopening the DB after a crash only requires reading the
+  // segments that may have been written after the latest checkpoint. To make
+  // this possible, segments freed by a reorganization are only reused after
+  // the next checkpoint has been written.
+  size_t index_checkpoint_interval = 0;
+
+  // If true, concurrent writes that go directly to the page files (i.e.,
+  // writes when `bypass_cache` is true and record cache write outs) are
+  // combined into larger sorted batches. Writers targeting the same page are
+  // grouped together and one of them writes all of the group's records at
+  // once, which reduces lock contention and page rewrites under write-heavy
+  // workloads with many threads.
+  bool write_combining = false;
+
+  // If true, range scans do not acquire segment locks, so long scans do not
+  // stall reorganizations (and the writers waiting on them). Scans instead
+  // keep the segments they may read from being reused until they finish:
+  // segments replaced by a reorganization are only added to the free list
+  // once every scan that started before the reorganization has finished.
+  bool snapshot_scans = false;
+
+  // If true, range scans prefetch the segments they expect to read using the
+  // background threads (so `num_bg_threads` must be greater than 0). Unlike
+  // `GetRange()`'s experimental prefetching, these scans keep the segments
+  // they prefetch locked until they have been scanned, so they can run
+  // concurrently with writes. This option has no effect if `snapshot_scans`
+  // is true.
+  bool prefetch_scans = false;
+
+  // If nonempty, every read and write of the segment files is recorded in a
+  // compact binary trace at this path (see `page_grouping/persist/io_trace.h`)
+  // along with the operation that caused it. The trace can be replayed against
+  // a file or device with `pg_io_replay`. I/O issued while reopening the DB
+  // (before the DB is ready to serve requests) is not recorded.
+  std::string io_trace_path;
+
+  // If nonzero, the DB keeps write amplification and reorganization counters
+  // for (up to) this many ranges of the key space (see
+  // `PageGroupedDB::GetKeyRangeStats()`). The ranges are chosen when the DB is
+  // bulk loaded or reopened so that each range starts out with roughly the
+  // same number of segments.
+  size_t key_range_stats_buckets = 0;
+
+  // If nonzero, the lock manager records lock contention statistics (see
+  // `PageGroupedDB::GetLockContentionStats()`) and reports this many of the
+  // most contended segment and page locks. Profiling adds a small amount of
+  // work to every lock acquisition.
+  size_t lock_profiling_top_n = 0;
+
+  // If set, the segment files are stored on this simulated device instead of
+  // the file system (see `SimulatedSSD` in `treeline/pg_simulated_ssd.h`).
+  // The device models the latency of each segment file read and write, which
+  // makes I/O-bound measurements reproducible across machines. When set,
+  // `use_memory_based_io` has no effect.
+  std::shared_ptr<SimulatedSSD> simulated_ssd;
+
   // Options for insert forecasting.
   InsertForecastingOptions forecasting;
 
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "treeline/pg_latency_histogram.h"
+
+namespace tl {
+namespace pg {
+
+// The performance model of a `SimulatedSSD`.
+//
+// Each request is serviced by one of `queue_depth` parallel channels. A
+// request waits for a free channel, then takes the fixed per-request latency,
+// and then transfers its data. Transfers are serialized across the channels
+// and proceed at the read (write) bandwidth.
+//
+// If `gc_interval_bytes` is nonzero, the device also simulates garbage
+// collection: every time `gc_interval_bytes` more bytes have been written, the
+// device stops servicing requests for `gc_stall_us` microseconds.
+struct SimulatedSSDOptions {
+  uint64_t read_latency_us = 80;
+  uint64_t write_latency_us = 20;
+  // In MiB per second.
+  uint64_t read_bandwidth_mib = 2048;
+  uint64_t write_bandwidth_mib = 1024;
+  size_t queue_depth = 32;
+
+  uint64_t gc_interval_bytes = 0;
+  uint64_t gc_stall_us = 2000;
+
+  // If true, threads are blocked until their requests' modeled completion
+  // time. If false, the device only accounts for the modeled latencies and
+  // returns immediately; in this mode requests never wait for a channel, so
+  // the modeled latencies only depend on the sequence of requests (which makes
+  // them reproducible across runs and machines).
+  bool emulate_latency = true;
+};
+
+// The I/O counts and modeled latencies of a `SimulatedSSD` (see
+// `SimulatedSSD::GetStats()`).
+struct SimulatedSSDStats {
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+  uint64_t gc_stalls = 0;
+  // The modeled latency of each request (in nanoseconds), including the time
+  // spent waiting for a channel and for garbage collection.
+  LatencyHistogram read_latency;
+  LatencyHistogram write_latency;
+};
+
+// An in-memory storage device that emulates the performance of an SSD (see
+// `SimulatedSSDOptions`). When a device is set in
+// `PageGroupedDBOptions::simulated_ssd`, the DB stores its segment files on
+// the device instead of the file system.
+//
+// The device keeps its files in memory for as long as it exists, so a DB can
+// be closed and reopened on the same device. The DB's other files (e.g., its
+// manifest) are still stored in the DB's directory, so a new device should
+// only be used with an empty (or nonexistent) DB directory.
+//
+// This class's methods are thread-safe.
+class SimulatedSSD {
+ public:
+  static std::shared_ptr<SimulatedSSD> Create(
+      const SimulatedSSDOptions& options = SimulatedSSDOptions());
+
+  virtual ~SimulatedSSD() = default;
+
+  virtual const SimulatedSSDOptions& options() const = 0;
+
+  // Retrieves the statistics collected since the device was created (or since
+  // the last call to `ResetStats()`).
+  virtual void GetStats(SimulatedSSDStats* stats_out) const = 0;
+  virtual void ResetStats() = 0;
+
+  // The total size of the files stored on the device (in bytes).
+  virtual size_t StoredBytes() const = 0;
+};
+
+}  // namespace pg
+}  // namespace tl
@@ -1,20 +1,191 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <vector>
+
+#include "treeline/pg_latency_histogram.h"
 
 namespace tl {
 namespace pg {
 
+// A point-in-time summary of a running database, returned by
+// `PageGroupedDB::GetStats()`. The counters are cumulative across all the
+// threads in the process (including threads that have exited).
+struct PageGroupedDBLiveStats {
+  // Record cache.
+  uint64_t cache_hits = 0;
+  uint64_t cache_misses = 0;
+  double cache_hit_ratio = 0.0;
+  uint64_t cache_capacity = 0;
+  uint64_t cache_dirty_records = 0;
+  // The fraction of the cache's capacity that holds dirty records.
+  double cache_dirty_ratio = 0.0;
+
+  // Segments. `segments_by_size[i]` is the number of segments that have
+  // `segment_page_counts[i]` pages.
+  std::vector<size_t> segment_page_counts;
+  std::vector<uint64_t> segments_by_size;
+  // The number of segments that have an overflow page.
+  uint64_t overflowed_segments = 0;
+  // The reorganization backlog: the number of pages in segments that have an
+  // overflow page (these pages need to be rewritten to remove the overflows).
+  uint64_t reorg_backlog_pages = 0;
+  uint64_t free_list_entries = 0;
+  uint64_t free_list_bytes = 0;
+
+  // I/O. `page_reads_by_size[i]` is the number of reads of `i + 1` contiguous
+  // pages (and similarly for the writes).
+  std::vector<uint64_t> page_reads_by_size;
+  std::vector<uint64_t> page_writes_by_size;
+
+  // Reorganization.
+  uint64_t overflows_created = 0;
+  uint64_t rewrites = 0;
+  uint64_t rewrite_input_pages = 0;
+  uint64_t rewrite_output_pages = 0;
+};
+
+// Write amplification and reorganization statistics for one range of the key
+// space, returned by `PageGroupedDB::GetKeyRangeStats()` (see
+// `PageGroupedDBOptions::key_range_stats_buckets`). The counters are
+// cumulative since the DB was opened; writes made by the bulk load are not
+// counted.
+struct PageGroupedDBKeyRangeStats {
+  // The range covers the keys in [lower, upper).
+  uint64_t lower = 0;
+  uint64_t upper = 0;
+
+  // User writes (`Put()`s) and their total size (keys and values).
+  uint64_t user_writes = 0;
+  uint64_t user_bytes = 0;
+
+  // Bytes written to the segment files, by cause: in-place segment page
+  // writes when records are written out, overflow page writes, and pages
+  // written or invalidated by reorganizations (segment rewrites and page chain
+  // flattens). Reorganization writes are attributed to the range that the
+  // first reorganized segment starts in.
+  uint64_t writeout_bytes = 0;
+  uint64_t overflow_bytes = 0;
+  uint64_t rewrite_bytes = 0;
+  // The number of reorganizations that started in this range.
+  uint64_t rewrites = 0;
+
+  // Insert forecast accuracy (only tracked when insert forecasting is
+  // enabled). Over the last `forecast_epochs` insert tracker epochs, the
+  // forecasts predicted `forecast_inserts` inserts into this range and
+  // `actual_inserts` inserts were made. `forecast_abs_error` is the sum of the
+  // absolute forecast errors of each epoch.
+  uint64_t forecast_epochs = 0;
+  double forecast_inserts = 0.0;
+  uint64_t actual_inserts = 0;
+  double forecast_abs_error = 0.0;
+
+  uint64_t PageBytesWritten() const {
+    return writeout_bytes + overflow_bytes + rewrite_bytes;
+  }
+
+  // Page bytes written per user byte written (0 if there were no user writes).
+  double WriteAmplification() const {
+    return user_bytes == 0
+               ? 0.0
+               : static_cast<double>(PageBytesWritten()) / user_bytes;
+  }
+};
+
 // This class stores counters used by the page-grouped TreeLine database.
 //
 // This class only supports counters that can be aggregated across threads. The
 // counters are meant to be manipulated using thread local instances and then
-// aggregated when needed (e.g., when an experiment has completed).
+// aggregated when needed (e.g., when an experiment has completed, or on demand
+// using `RunOnLive()`).
 class PageGroupedDBStats {
  public:
+  // A counter that is only updated by the thread that owns it, but that other
+  // threads may read while it is being updated (see `RunOnLive()`). The
+  // relaxed atomic operations compile to plain loads and stores.
+  class Counter {
+   public:
+    Counter(uint64_t value = 0) : value_(value) {}
+    Counter(const Counter& other) : value_(other) {}
+    Counter& operator=(const Counter& other) { return *this = other.load(); }
+    Counter& operator=(uint64_t value) {
+      value_.store(value, std::memory_order_relaxed);
+      return *this;
+    }
+    Counter& operator+=(uint64_t delta) { return *this = load() + delta; }
+    Counter& operator++() { return *this += 1; }
+    operator uint64_t() const { return load(); }
+
+   private:
+    uint64_t load() const { return value_.load(std::memory_order_relaxed); }
+    std::atomic<uint64_t> value_;
+  };
+
+  // The lock modes that threads can block on (see `LockManager`).
+  enum class LockWaitMode : size_t {
+    kSegmentPageRead = 0,
+    kSegmentPageWrite = 1,
+    kSegmentReorg = 2,
+    kSegmentReorgExclusive = 3,
+    kPageShared = 4,
+    kPageExclusive = 5
+  };
+  static constexpr size_t kNumLockWaitModes = 6;
+  static const char* LockWaitModeName(LockWaitMode mode);
+
+  // The operation phases whose latencies are tracked (when enabled with
+  // `SetLatencyTracking()`).
+  enum class LatencyPhase : size_t {
+    // `PageGroupedDB::Get()`, end to end.
+    kGet = 0,
+    // Looking up the key in the record cache.
+    kGetCacheLookup = 1,
+    // Finding (and locking) the segment that holds the key.
+    kGetIndexLookup = 2,
+    // Acquiring the page lock.
+    kGetPageLock = 3,
+    // Reading a page (main or overflow) from disk.
+    kGetPageRead = 4,
+    // Searching for the key within a page.
+    kGetPageSearch = 5,
+    // `PageGroupedDB::Put()`, end to end.
+    kPut = 6,
+    // `PageGroupedDB::GetRange()`, end to end.
+    kGetRange = 7,
+    // Scanning the pages on disk (`Manager::Scan()`).
+    kScan = 8,
+    // Writing a batch of records to their pages (`Manager::PutBatch()`).
+    kWriteout = 9,
+    // `Manager::RewriteSegmentsImpl()`, end to end.
+    kRewrite = 10,
+    // Reading and merging the old segments, and writing the new segments.
+    kRewriteMerge = 11,
+    // Invalidating the old segments and installing the new segments.
+    kRewriteInstall = 12
+  };
+  static constexpr size_t kNumLatencyPhases = 13;
+
+  // I/O sizes are tracked up to this many contiguous pages (the size of the
+  // largest segment). Larger I/Os are counted as `kMaxIOPages` pages.
+  static constexpr size_t kMaxIOPages = 16;
+  static const char* LatencyPhaseName(LatencyPhase phase);
+
+  // Latency tracking is disabled by default. When disabled, the phase timers
+  // do not read the clock.
+  static void SetLatencyTracking(bool enabled) {
+    latency_tracking_.store(enabled, std::memory_order_relaxed);
+  }
+  static bool LatencyTrackingEnabled() {
+    return latency_tracking_.load(std::memory_order_relaxed);
+  }
+
   static PageGroupedDBStats& Local() {
-    static thread_local PageGroupedDBStats local;
+    static thread_local PageGroupedDBStats local(/*is_local=*/true);
     return local;
   }
 
@@ -24,6 +195,23 @@ class PageGroupedDBStats {
     c(global_);
   }
 
+  // Runs `c` on the sum of the counters of every thread's local instance
+  // (including the instances of threads that have exited). The counters are
+  // read while the threads keep updating them, so this can be used to monitor
+  // a running database. These sums are independent of the values posted using
+  // `PostToGlobal()`. The latency histograms are not included.
+  template <typename Callable>
+  static void RunOnLive(const Callable& c) {
+    std::unique_lock<std::mutex> lock(class_mutex_);
+    PageGroupedDBStats live(/*is_local=*/false);
+    exited_.AddTo(&live, /*include_latencies=*/false);
+    for (const PageGroupedDBStats* local : locals_) {
+      local->AddTo(&live, /*include_latencies=*/false);
+    }
+    c(live);
+  }
+
+  ~PageGroupedDBStats();
   PageGroupedDBStats(const PageGroupedDBStats&) = delete;
   PageGroupedDBStats& operator=(const PageGroupedDBStats&) = delete;
 
@@ -31,6 +219,10 @@ class PageGroupedDBStats {
   uint64_t GetCacheMisses() const { return cache_misses_; }
   uint64_t GetCacheCleanEvictions() const { return cache_clean_evictions_; }
   uint64_t GetCacheDirtyEvictions() const { return cache_dirty_evictions_; }
+  uint64_t GetCacheBackgroundWritebacks() const {
+    return cache_background_writebacks_;
+  }
+  uint64_t GetCacheRangeHits() const { return cache_range_hits_; }
 
   uint64_t GetOverflowsCreated() const { return overflows_created_; }
   uint64_t GetRewrites() const { return rewrites_; }
@@ -46,11 +238,48 @@ class PageGroupedDBStats {
 
   uint64_t GetOverfetchedPages() const { return overfetched_pages_; }
 
+  uint64_t GetNumaLocalAccesses() const { return numa_local_accesses_; }
+  uint64_t GetNumaRemoteAccesses() const { return numa_remote_accesses_; }
+  // The fraction of sampled accesses that went to a remote NUMA node.
+  double GetNumaRemoteAccessRatio() const {
+    const uint64_t total = numa_local_accesses_ + numa_remote_accesses_;
+    return total == 0 ? 0.0
+                      : static_cast<double>(numa_remote_accesses_) / total;
+  }
+
+  uint64_t GetCombinedWriteBatches() const { return combined_write_batches_; }
+  uint64_t GetCombinedWriteRecords() const { return combined_write_records_; }
+
+  uint64_t GetLockWaits(LockWaitMode mode) const {
+    return lock_waits_[static_cast<size_t>(mode)];
+  }
+  uint64_t GetLockWaitNanos(LockWaitMode mode) const {
+    return lock_wait_nanos_[static_cast<size_t>(mode)];
+  }
+
+  const LatencyHistogram& GetLatency(LatencyPhase phase) const;
+
+  // The number of reads (writes) of `num_pages` contiguous pages.
+  uint64_t GetPageReads(size_t num_pages) const {
+    return page_reads_[IOSizeIndex(num_pages)];
+  }
+  uint64_t GetPageWrites(size_t num_pages) const {
+    return page_writes_[IOSizeIndex(num_pages)];
+  }
+
   void BumpCacheHits() { ++cache_hits_; }
   void BumpCacheMisses() { ++cache_misses_; }
   void BumpCacheCleanEvictions() { ++cache_clean_evictions_; }
   void BumpCacheDirtyEvictions() { ++cache_dirty_evictions_; }
 
+  // Number of fully cached key ranges used to serve scans without I/O.
+  void BumpCacheRangeHits() { ++cache_range_hits_; }
+
+  // Number of dirty records written out by the background writer.
+  void BumpCacheBackgroundWritebacks(uint64_t delta = 1) {
+    cache_background_writebacks_ += delta;
+  }
+
   void BumpOverflowsCreated() { ++overflows_created_; }
 
   // Number of times a reorganization was initiated.
@@ -64,6 +293,47 @@ class PageGroupedDBStats {
 
   void BumpOverfetchedPages(uint64_t delta = 1) { overfetched_pages_ += delta; }
 
+  // Sampled accesses to record cache entries and I/O buffers (only recorded
+  // when `PageGroupedDBOptions::numa_aware` is set).
+  void BumpNumaAccesses(bool is_local) {
+    if (is_local) {
+      ++numa_local_accesses_;
+    } else {
+      ++numa_remote_accesses_;
+    }
+  }
+
+  // Number of batches (and the records in them) applied by a write combiner
+  // (only recorded when `PageGroupedDBOptions::write_combining` is set).
+  void BumpCombinedWrites(uint64_t records) {
+    ++combined_write_batches_;
+    combined_write_records_ += records;
+  }
+
+  // Number of times a thread blocked while acquiring a lock in `mode`, and the
+  // total time it spent blocked.
+  void BumpLockWait(LockWaitMode mode, uint64_t wait_nanos) {
+    ++lock_waits_[static_cast<size_t>(mode)];
+    lock_wait_nanos_[static_cast<size_t>(mode)] += wait_nanos;
+  }
+
+  // Number of reads (writes) of `num_pages` contiguous pages.
+  void BumpPageReads(size_t num_pages) {
+    ++page_reads_[IOSizeIndex(num_pages)];
+  }
+  void BumpPageWrites(size_t num_pages) {
+    ++page_writes_[IOSizeIndex(num_pages)];
+  }
+
+  // Records that an operation spent `nanos` in `phase`. The histograms are
+  // only allocated once a latency is recorded.
+  void RecordLatency(LatencyPhase phase, uint64_t nanos) {
+    if (latencies_ == nullptr) {
+      latencies_ = std::make_unique<LatencyHistograms>();
+    }
+    (*latencies_)[static_cast<size_t>(phase)].Record(nanos);
+  }
+
   void SetSegments(uint64_t segments) { segments_ = segments; }
   void SetFreeListEntries(uint64_t entries) { free_list_entries_ = entries; }
   void SetFreeListBytes(uint64_t bytes) { free_list_bytes_ = bytes; }
@@ -77,35 +347,120 @@ class PageGroupedDBStats {
   void Reset();
 
  private:
-  PageGroupedDBStats();
+  // Thread local instances (`is_local`) are registered so that `RunOnLive()`
+  // can read their counters.
+  explicit PageGroupedDBStats(bool is_local);
+
+  using LatencyHistograms = std::array<LatencyHistogram, kNumLatencyPhases>;
+
+  static size_t IOSizeIndex(size_t num_pages) {
+    return (num_pages < kMaxIOPages ? num_pages : kMaxIOPages) - 1;
+  }
+
+  // Adds this instance's values to `target`. The caller must hold
+  // `class_mutex_`.
+  void AddTo(PageGroupedDBStats* target, bool include_latencies) const;
 
   static std::mutex class_mutex_;
   static PageGroupedDBStats global_;
+  static std::atomic<bool> latency_tracking_;
+  // The registered thread local instances, and the sum of the counters of the
+  // thread local instances that have been destroyed. Protected by
+  // `class_mutex_`.
+  static std::vector<const PageGroupedDBStats*> locals_;
+  static PageGroupedDBStats exited_;
+
+  const bool is_local_;
 
   // Record-cache related counters.
-  uint64_t cache_hits_;
-  uint64_t cache_misses_;
-  uint64_t cache_clean_evictions_;
-  uint64_t cache_dirty_evictions_;
+  Counter cache_hits_;
+  Counter cache_misses_;
+  Counter cache_clean_evictions_;
+  Counter cache_dirty_evictions_;
+  Counter cache_background_writebacks_;
+  Counter cache_range_hits_;
 
   // Reorganization related counters.
   // N.B. Rewrite/reorganization are used interchangeably.
-  uint64_t overflows_created_;
-  uint64_t rewrites_;
-  uint64_t rewrite_input_pages_;
-  uint64_t rewrite_output_pages_;
+  Counter overflows_created_;
+  Counter rewrites_;
+  Counter rewrite_input_pages_;
+  Counter rewrite_output_pages_;
 
   // Size-related stats. These are meant to be set once.
-  uint64_t segments_;
-  uint64_t free_list_entries_;
-  uint64_t free_list_bytes_;
-  uint64_t segment_index_bytes_;
-  uint64_t lock_manager_bytes_;
+  Counter segments_;
+  Counter free_list_entries_;
+  Counter free_list_bytes_;
+  Counter segment_index_bytes_;
+  Counter lock_manager_bytes_;
   // The size footprint of the cache (in bytes).
-  uint64_t cache_bytes_;
+  Counter cache_bytes_;
 
   // Prefetching debug stats.
-  uint64_t overfetched_pages_;
+  Counter overfetched_pages_;
+
+  // NUMA placement stats.
+  Counter numa_local_accesses_;
+  Counter numa_remote_accesses_;
+
+  // Write combining stats.
+  Counter combined_write_batches_;
+  Counter combined_write_records_;
+
+  // Lock wait stats, indexed by `LockWaitMode`.
+  std::array<Counter, kNumLockWaitModes> lock_waits_;
+  std::array<Counter, kNumLockWaitModes> lock_wait_nanos_;
+
+  // I/O sizes, indexed by the number of contiguous pages minus one.
+  std::array<Counter, kMaxIOPages> page_reads_;
+  std::array<Counter, kMaxIOPages> page_writes_;
+
+  // Latency histograms, indexed by `LatencyPhase`.
+  std::unique_ptr<LatencyHistograms> latencies_;
+};
+
+// Lock contention statistics, returned by
+// `PageGroupedDB::GetLockContentionStats()` (see
+// `PageGroupedDBOptions::lock_profiling_top_n`). The statistics are cumulative
+// since the DB was opened.
+struct PageGroupedDBLockContentionStats {
+  using LockWaitMode = PageGroupedDBStats::LockWaitMode;
+
+  struct ModeStats {
+    // The number of locks granted in this mode, and the number of those that
+    // were only granted after at least one failed attempt.
+    uint64_t acquisitions = 0;
+    uint64_t contended_acquisitions = 0;
+    // The number of failed attempts to acquire a lock in this mode.
+    uint64_t failed_tries = 0;
+    // The acquisition latencies: the time from a thread's first failed attempt
+    // to the grant. Uncontended acquisitions are recorded as 0 ns.
+    LatencyHistogram latency;
+  };
+
+  // A segment or page lock that threads contended for.
+  struct HotLock {
+    // The segment's file and page offset within the file.
+    uint64_t file_id = 0;
+    uint64_t segment_offset = 0;
+    // The page's index within the segment (page locks only).
+    uint64_t page_idx = 0;
+    uint64_t failed_tries = 0;
+    uint64_t contended_acquisitions = 0;
+    // The total latency of the lock's contended acquisitions.
+    uint64_t wait_nanos = 0;
+  };
+
+  const ModeStats& Get(LockWaitMode mode) const {
+    return modes[static_cast<size_t>(mode)];
+  }
+
+  // Indexed by `LockWaitMode`.
+  std::array<ModeStats, PageGroupedDBStats::kNumLockWaitModes> modes;
+  // The most contended segment and page locks, in descending order of their
+  // `wait_nanos`.
+  std::vector<HotLock> hot_segments;
+  std::vector<HotLock> hot_pages;
 };
 
 }  // namespace pg
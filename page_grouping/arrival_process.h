@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace tl {
+namespace pg {
+
+// Generates request arrival times for open-loop load generation (requests are
+// issued at their arrival times, regardless of whether earlier requests have
+// completed).
+//
+// - `kPoisson`: Exponentially distributed inter-arrival times with a fixed
+//   mean rate.
+// - `kBursty`: A Poisson process whose rate alternates between a "burst" rate
+//   (`burst_factor` times the mean rate, for the first `burst_duty` fraction
+//   of every `burst_period`) and a lower "idle" rate for the rest of the
+//   period. The idle rate is chosen so that the long run mean rate is `rate`,
+//   so `burst_factor * burst_duty` must be at most 1.
+class ArrivalProcess {
+ public:
+  using Nanos = std::chrono::nanoseconds;
+
+  enum class Kind { kPoisson, kBursty };
+
+  struct Options {
+    Kind kind = Kind::kPoisson;
+    // The mean arrival rate, in requests per second.
+    double rate = 1000.0;
+    double burst_factor = 4.0;
+    double burst_duty = 0.2;
+    Nanos burst_period = std::chrono::milliseconds(100);
+  };
+
+  ArrivalProcess(const Options& options, uint32_t seed)
+      : options_(options), prng_(seed), now_(0) {
+    assert(options_.rate > 0);
+    if (options_.kind == Kind::kBursty) {
+      assert(options_.burst_factor >= 1.0);
+      assert(options_.burst_duty > 0 && options_.burst_duty < 1.0);
+      assert(options_.burst_factor * options_.burst_duty <= 1.0);
+      assert(options_.burst_period.count() > 0);
+    }
+  }
+
+  // Returns the next arrival time, relative to the start of the process.
+  Nanos Next() {
+    if (options_.kind == Kind::kPoisson) {
+      now_ += SampleGap(options_.rate);
+      return Nanos(static_cast<int64_t>(now_));
+    }
+
+    // Inter-arrival times are memoryless, so when a sampled arrival falls past
+    // the end of the current burst/idle interval, we can restart the sampling
+    // at the interval boundary using the next interval's rate.
+    const double period = options_.burst_period.count();
+    const double burst_end = period * options_.burst_duty;
+    const double idle_rate =
+        options_.rate * (1.0 - options_.burst_factor * options_.burst_duty) /
+        (1.0 - options_.burst_duty);
+    while (true) {
+      double period_start = std::floor(now_ / period) * period;
+      // Guard against rounding when `now_` is on a period boundary.
+      if (now_ - period_start >= period) period_start += period;
+      const double offset = now_ - period_start;
+      const bool in_burst = offset < burst_end;
+      const double rate =
+          in_burst ? options_.rate * options_.burst_factor : idle_rate;
+      const double interval_end =
+          period_start + (in_burst ? burst_end : period);
+      if (rate <= 0) {
+        now_ = interval_end;
+        continue;
+      }
+      const double arrival = now_ + SampleGap(rate);
+      if (arrival < interval_end) {
+        now_ = arrival;
+        return Nanos(static_cast<int64_t>(now_));
+      }
+      now_ = interval_end;
+    }
+  }
+
+ private:
+  // Samples an exponentially distributed gap (in nanoseconds) for a process
+  // with the given rate (in requests per second).
+  double SampleGap(const double rate) {
+    std::exponential_distribution<double> dist(rate / 1e9);
+    return dist(prng_);
+  }
+
+  const Options options_;
+  std::mt19937_64 prng_;
+  // The most recent arrival time, in nanoseconds.
+  double now_;
+};
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,210 @@
+#include "cache_manifest.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <fstream>
+
+#include "persist/sync_directory.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace {
+
+// All cache manifest files start with these two bytes.
+const std::string kSignature = u8"TC";
+
+// The current cache manifest file format version. This value should be
+// incremented when a breaking change is made to the file format.
+constexpr uint32_t kFormatVersion = 1;
+
+// Cache manifest file format
+// ==========================
+// [Header]
+// Signature (2 bytes)
+// Format version (uint32; 4 bytes)
+// Flags (uint32; 4 bytes)
+// Payload size (uint64; 8 bytes)
+// CRC32C checksum of the payload (4 bytes)
+//
+// [Payload]
+// Number of entries (varint64)
+// Entries, sorted by key. Each entry contains:
+//   - The difference between its key and the previous key (varint64)
+//   - Its eviction priority (1 byte)
+//   - Its value (length-prefixed; only if `kHasValuesFlag` is set)
+
+constexpr size_t kHeaderSize = 22;
+constexpr size_t kPayloadSizeOffset = 10;
+constexpr size_t kChecksumOffset = 18;
+constexpr size_t kPayloadOffset = kHeaderSize;
+
+constexpr uint32_t kHasValuesFlag = 1;
+
+}  // namespace
+
+namespace tl {
+namespace pg {
+
+std::optional<CacheManifest> CacheManifest::LoadFrom(
+    const std::filesystem::path& manifest_file, Status* status_out) {
+  std::ifstream in(manifest_file, std::ios_base::in | std::ios_base::binary);
+  std::string buffer;
+
+  // Load the header.
+  buffer.resize(kHeaderSize);
+  in.read(buffer.data(), kHeaderSize);
+  if (in.fail()) {
+    *status_out = Status::IOError("Failed to read cache manifest header.");
+    return std::optional<CacheManifest>();
+  }
+
+  // Validate the signature.
+  Slice header(buffer);
+  if (!header.starts_with(Slice(kSignature))) {
+    *status_out = Status::Corruption("Invalid cache manifest file signature.");
+    return std::optional<CacheManifest>();
+  }
+  header.remove_prefix(kSignature.size());
+
+  // Validate the format version.
+  const uint32_t format_version = DecodeFixed32(header.data());
+  if (format_version != kFormatVersion) {
+    *status_out =
+        Status::NotSupported("Cache manifest format version is unsupported:",
+                             std::to_string(format_version));
+    return std::optional<CacheManifest>();
+  }
+  header.remove_prefix(sizeof(uint32_t));
+
+  // Decode the flags, payload size, and expected checksum.
+  const uint32_t flags = DecodeFixed32(header.data());
+  header.remove_prefix(4);
+  const uint64_t payload_size = DecodeFixed64(header.data());
+  header.remove_prefix(8);
+  const uint32_t expected_checksum = DecodeFixed32(header.data());
+  header.remove_prefix(4);
+
+  // Should be done parsing the header.
+  assert(header.size() == 0);
+
+  // Load the rest of the payload.
+  buffer.resize(payload_size);
+  in.read(buffer.data(), payload_size);
+  if (in.fail()) {
+    *status_out = Status::IOError("Failed to read cache manifest payload.");
+    return std::optional<CacheManifest>();
+  }
+
+  // Validate the checksum.
+  const uint32_t computed_checksum = crc32c::Value(
+      reinterpret_cast<const uint8_t*>(buffer.data()), payload_size);
+  if (computed_checksum != expected_checksum) {
+    *status_out = Status::Corruption("Cache manifest checksum does not match.");
+    return std::optional<CacheManifest>();
+  }
+
+  // Decode the entries.
+  const bool has_values = (flags & kHasValuesFlag) != 0;
+  Slice payload(buffer);
+  uint64_t num_entries = 0;
+  if (!GetVarint64(&payload, &num_entries)) {
+    *status_out = Status::Corruption("Cache manifest payload is malformed.");
+    return std::optional<CacheManifest>();
+  }
+  std::vector<Entry> entries;
+  entries.reserve(num_entries);
+  Key prev_key = 0;
+  for (uint64_t i = 0; i < num_entries; ++i) {
+    uint64_t key_delta = 0;
+    Slice value;
+    if (!GetVarint64(&payload, &key_delta) || payload.empty()) {
+      *status_out = Status::Corruption("Cache manifest payload is malformed.");
+      return std::optional<CacheManifest>();
+    }
+    const uint8_t priority = static_cast<uint8_t>(payload[0]);
+    payload.remove_prefix(1);
+    if (has_values && !GetLengthPrefixedSlice(&payload, &value)) {
+      *status_out = Status::Corruption("Cache manifest payload is malformed.");
+      return std::optional<CacheManifest>();
+    }
+    prev_key += key_delta;
+    entries.push_back(Entry{prev_key, priority, value.ToString()});
+  }
+
+  *status_out = Status::OK();
+  return std::optional<CacheManifest>(
+      CacheManifest(std::move(entries), has_values));
+}
+
+Status CacheManifest::WriteTo(
+    const std::filesystem::path& manifest_file) const {
+  std::string buffer;
+  buffer.append(kSignature);
+  PutFixed32(&buffer, kFormatVersion);
+  PutFixed32(&buffer, has_values_ ? kHasValuesFlag : 0);
+  PutFixed64(&buffer, 0);  // Payload length placeholder
+  PutFixed32(&buffer, 0);  // Checksum placeholder
+  assert(buffer.size() == kHeaderSize);
+
+  PutVarint64(&buffer, entries_.size());
+  Key prev_key = 0;
+  for (const auto& entry : entries_) {
+    assert(entry.key >= prev_key);
+    PutVarint64(&buffer, entry.key - prev_key);
+    buffer.push_back(static_cast<char>(entry.priority));
+    if (has_values_) {
+      PutLengthPrefixedSlice(&buffer, Slice(entry.value));
+    }
+    prev_key = entry.key;
+  }
+
+  const size_t payload_size = buffer.size() - kHeaderSize;
+  EncodeFixed64(&buffer[kPayloadSizeOffset], payload_size);
+
+  const uint32_t checksum = crc32c::Value(
+      reinterpret_cast<const uint8_t*>(&buffer[kPayloadOffset]), payload_size);
+  EncodeFixed32(&buffer[kChecksumOffset], checksum);
+
+  // Write the manifest data (will overwrite).
+  {
+    std::ofstream out(manifest_file, std::ios_base::out |
+                                         std::ios_base::binary |
+                                         std::ios_base::trunc);
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    if (out.fail()) {
+      return Status::IOError("Failed to write cache manifest");
+    }
+  }
+
+  // Sync the file and directory.
+  const int manifest_fd = open(manifest_file.c_str(), O_RDONLY);
+  if (manifest_fd < 0) {
+    return Status::FromPosixError("Opening cache manifest:", errno);
+  }
+  if (fdatasync(manifest_fd) < 0) {
+    const int err_code = errno;
+    close(manifest_fd);
+    return Status::FromPosixError("Syncing cache manifest:", err_code);
+  }
+  close(manifest_fd);
+
+  return SyncDirectory(manifest_file.parent_path());
+}
+
+Status CacheManifest::Remove(const std::filesystem::path& manifest_file) {
+  std::error_code err;
+  if (!std::filesystem::remove(manifest_file, err)) {
+    // The manifest did not exist (or could not be removed).
+    return err ? Status::FromPosixError("Removing cache manifest:", err.value())
+               : Status::OK();
+  }
+  return SyncDirectory(manifest_file.parent_path());
+}
+
+}  // namespace pg
+}  // namespace tl
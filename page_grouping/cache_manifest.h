@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "key.h"
+#include "treeline/status.h"
+
+namespace tl {
+namespace pg {
+
+// Holds the "hot" records in the record cache so that the cache can be warmed
+// up when a database is reopened. This class is mainly meant to help with
+// serializing and deserializing the cache manifest file.
+class CacheManifest {
+ public:
+  struct Entry {
+    Key key;
+    // The record's eviction priority in the cache.
+    uint8_t priority;
+    // Empty unless the manifest includes values.
+    std::string value;
+  };
+
+  // `entries` must be sorted in ascending order by key.
+  CacheManifest(std::vector<Entry> entries, bool has_values)
+      : entries_(std::move(entries)), has_values_(has_values) {}
+
+  // Loads the manifest from `manifest_file`. If there was an error loading the
+  // manifest, `status` will be set accordingly and the returned optional will
+  // not contain a value.
+  static std::optional<CacheManifest> LoadFrom(
+      const std::filesystem::path& manifest_file, Status* status_out);
+
+  // Writes the manifest to `manifest_file` and ensures it is persisted.
+  Status WriteTo(const std::filesystem::path& manifest_file) const;
+
+  // Removes `manifest_file` (if it exists) and ensures the removal is
+  // persisted. A manifest is only valid for the database state at the time it
+  // was written, so it must be removed before the database is modified.
+  static Status Remove(const std::filesystem::path& manifest_file);
+
+  const std::vector<Entry>& entries() const { return entries_; }
+  bool has_values() const { return has_values_; }
+
+ private:
+  std::vector<Entry> entries_;
+  bool has_values_;
+};
+
+}  // namespace pg
+}  // namespace tl
@@ -8,8 +8,8 @@ namespace pg {
 
 class CircularPageBuffer {
  public:
-  CircularPageBuffer(size_t num_pages)
-      : buf_(PageMemoryAllocator::Allocate(num_pages)),
+  CircularPageBuffer(size_t num_pages, bool numa_local = false)
+      : buf_(PageMemoryAllocator::Allocate(num_pages, numa_local)),
         base_(buf_.get()),
         num_pages_(num_pages),
         head_idx_(0),
@@ -15,3 +15,36 @@ DEFINE_bool(use_memory_based_io, false,
             "should NOT be set when running actual performance benchmarks.");
 DEFINE_uint32(write_batch_size, 1000000,
               "The number of records to batch before initiating a write.");
+DEFINE_string(io_trace_path, "",
+              "If set, every segment file read and write is recorded in a "
+              "binary trace at this path (replay it using pg_io_replay).");
+DEFINE_uint32(key_range_stats_buckets, 0,
+              "If nonzero, write amplification and reorganization counters "
+              "are kept for this many key ranges and written to "
+              "key_range_stats.csv.");
+DEFINE_uint32(lock_profiling_top_n, 0,
+              "If nonzero, lock contention statistics are recorded and "
+              "written to lock_contention.csv, and this many of the most "
+              "contended segment and page locks are written to hot_locks.csv.");
+DEFINE_bool(sim_ssd, false,
+            "If set, the segment files are stored on an in-memory simulated "
+            "SSD that models I/O latency (the database directory must be "
+            "empty). The device's statistics are written to sim_ssd.csv.");
+DEFINE_uint64(sim_ssd_read_latency_us, 80,
+              "The simulated SSD's fixed per-request read latency.");
+DEFINE_uint64(sim_ssd_write_latency_us, 20,
+              "The simulated SSD's fixed per-request write latency.");
+DEFINE_uint64(sim_ssd_read_bandwidth_mib, 2048,
+              "The simulated SSD's read bandwidth (in MiB/s).");
+DEFINE_uint64(sim_ssd_write_bandwidth_mib, 1024,
+              "The simulated SSD's write bandwidth (in MiB/s).");
+DEFINE_uint32(sim_ssd_queue_depth, 32,
+              "The number of requests the simulated SSD services in parallel.");
+DEFINE_uint64(sim_ssd_gc_interval_mib, 0,
+              "If nonzero, the simulated SSD stalls for --sim_ssd_gc_stall_us "
+              "every time this many MiB have been written.");
+DEFINE_uint64(sim_ssd_gc_stall_us, 2000,
+              "The duration of the simulated SSD's garbage collection stalls.");
+DEFINE_bool(sim_ssd_emulate_latency, true,
+            "If set, I/O requests block for their modeled latency. Otherwise "
+            "the latencies are only accounted for (and are reproducible).");
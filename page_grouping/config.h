@@ -9,3 +9,15 @@ DECLARE_double(records_per_page_epsilon);
 DECLARE_uint32(bg_threads);
 DECLARE_bool(use_memory_based_io);
 DECLARE_uint32(write_batch_size);
+DECLARE_string(io_trace_path);
+DECLARE_uint32(key_range_stats_buckets);
+DECLARE_uint32(lock_profiling_top_n);
+DECLARE_bool(sim_ssd);
+DECLARE_uint64(sim_ssd_read_latency_us);
+DECLARE_uint64(sim_ssd_write_latency_us);
+DECLARE_uint64(sim_ssd_read_bandwidth_mib);
+DECLARE_uint64(sim_ssd_write_bandwidth_mib);
+DECLARE_uint32(sim_ssd_queue_depth);
+DECLARE_uint64(sim_ssd_gc_interval_mib);
+DECLARE_uint64(sim_ssd_gc_stall_us);
+DECLARE_bool(sim_ssd_emulate_latency);
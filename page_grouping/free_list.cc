@@ -28,7 +28,7 @@ std::optional<SegmentId> FreeList::Get(const size_t page_count) {
     return std::optional<SegmentId>();
   }
   const SegmentId free = list_[file_id].front();
-  list_[file_id].pop();
+  list_[file_id].pop_front();
   return free;
 }
 
@@ -39,7 +39,16 @@ void FreeList::AddBatch(const std::vector<SegmentId>& ids) {
   }
 }
 
-void FreeList::AddImpl(SegmentId id) { list_[id.GetFileId()].push(id); }
+void FreeList::AddImpl(SegmentId id) { list_[id.GetFileId()].push_back(id); }
+
+std::vector<SegmentId> FreeList::GetAll() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::vector<SegmentId> all;
+  for (const auto& l : list_) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+  return all;
+}
 
 uint64_t FreeList::GetSizeFootprint() const {
   std::unique_lock<std::mutex> lock(mutex_);
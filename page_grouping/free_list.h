@@ -3,7 +3,6 @@
 #include <deque>
 #include <mutex>
 #include <optional>
-#include <queue>
 #include <scoped_allocator>
 #include <vector>
 
@@ -22,6 +21,9 @@ class FreeList {
   void AddBatch(const std::vector<SegmentId>& ids);
   std::optional<SegmentId> Get(size_t page_count);
 
+  // Returns all the segments currently in the free list.
+  std::vector<SegmentId> GetAll() const;
+
   uint64_t GetSizeFootprint() const;
   uint64_t GetNumEntries() const;
 
@@ -29,9 +31,7 @@ class FreeList {
   void AddImpl(SegmentId id);
 
   mutable std::mutex mutex_;
-  using SegmentList =
-      std::queue<SegmentId,
-                 std::deque<SegmentId, TrackingAllocator<SegmentId>>>;
+  using SegmentList = std::deque<SegmentId, TrackingAllocator<SegmentId>>;
   uint64_t bytes_allocated_;
   std::vector<SegmentList,
               std::scoped_allocator_adaptor<TrackingAllocator<SegmentList>>>
@@ -0,0 +1,323 @@
+#include "index_checkpoint.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+
+#include "persist/sync_directory.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace {
+
+// All index checkpoint files start with these two bytes.
+const std::string kSignature = u8"TI";
+
+// The current index checkpoint file format version. This value should be
+// incremented when a breaking change is made to the file format.
+constexpr uint32_t kFormatVersion = 1;
+
+// Index checkpoint file format
+// ============================
+// [Header]
+// Signature (2 bytes)
+// Format version (uint32; 4 bytes)
+// Flags (uint32; 4 bytes)
+// Payload size (uint64; 8 bytes)
+// CRC32C checksum of the payload (4 bytes)
+//
+// [Payload]
+// Next sequence number (varint32)
+// Number of segment files (varint32)
+// Number of allocated segments in each file (varint64 each)
+// Number of index entries (varint64)
+// Index entries, sorted by key. Each entry contains:
+//   - The difference between its key and the previous key (varint64)
+//   - Its segment ID (varint64)
+//   - Entry flags (1 byte)
+//   - Its model's slope and intercept (2 doubles, 8 bytes each; only if
+//     `kEntryHasModelFlag` is set)
+// Number of free segments (varint64)
+// The free segment IDs (varint64 each)
+//
+// NOTE: The header flags are not covered by the checksum so that they can be
+// updated in place (see `IndexCheckpoint::MarkDirty()`).
+
+constexpr size_t kHeaderSize = 22;
+constexpr size_t kFlagsOffset = 6;
+constexpr size_t kPayloadSizeOffset = 10;
+constexpr size_t kChecksumOffset = 18;
+constexpr size_t kPayloadOffset = kHeaderSize;
+
+constexpr uint32_t kCleanFlag = 1;
+
+constexpr uint8_t kEntryHasOverflowFlag = 1;
+constexpr uint8_t kEntryHasModelFlag = 2;
+
+void PutDouble(std::string* dst, double value) {
+  uint64_t raw = 0;
+  memcpy(&raw, &value, sizeof(raw));
+  tl::PutFixed64(dst, raw);
+}
+
+bool GetDouble(tl::Slice* input, double* value) {
+  if (input->size() < sizeof(uint64_t)) return false;
+  const uint64_t raw = tl::DecodeFixed64(input->data());
+  memcpy(value, &raw, sizeof(raw));
+  input->remove_prefix(sizeof(uint64_t));
+  return true;
+}
+
+tl::Status SyncFileAndDirectory(const std::filesystem::path& file) {
+  const int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return tl::Status::FromPosixError("Opening index checkpoint:", errno);
+  }
+  if (fdatasync(fd) < 0) {
+    const int err_code = errno;
+    close(fd);
+    return tl::Status::FromPosixError("Syncing index checkpoint:", err_code);
+  }
+  close(fd);
+  return tl::pg::SyncDirectory(file.parent_path());
+}
+
+}  // namespace
+
+namespace tl {
+namespace pg {
+
+std::optional<IndexCheckpoint> IndexCheckpoint::LoadFrom(
+    const std::filesystem::path& checkpoint_file, Status* status_out) {
+  std::ifstream in(checkpoint_file, std::ios_base::in | std::ios_base::binary);
+  std::string buffer;
+
+  // Load the header.
+  buffer.resize(kHeaderSize);
+  in.read(buffer.data(), kHeaderSize);
+  if (in.fail()) {
+    *status_out = Status::IOError("Failed to read index checkpoint header.");
+    return std::optional<IndexCheckpoint>();
+  }
+
+  // Validate the signature.
+  Slice header(buffer);
+  if (!header.starts_with(Slice(kSignature))) {
+    *status_out =
+        Status::Corruption("Invalid index checkpoint file signature.");
+    return std::optional<IndexCheckpoint>();
+  }
+  header.remove_prefix(kSignature.size());
+
+  // Validate the format version.
+  const uint32_t format_version = DecodeFixed32(header.data());
+  if (format_version != kFormatVersion) {
+    *status_out =
+        Status::NotSupported("Index checkpoint format version is unsupported:",
+                             std::to_string(format_version));
+    return std::optional<IndexCheckpoint>();
+  }
+  header.remove_prefix(sizeof(uint32_t));
+
+  // Decode the flags, payload size, and expected checksum.
+  const uint32_t flags = DecodeFixed32(header.data());
+  header.remove_prefix(4);
+  const uint64_t payload_size = DecodeFixed64(header.data());
+  header.remove_prefix(8);
+  const uint32_t expected_checksum = DecodeFixed32(header.data());
+  header.remove_prefix(4);
+
+  // Should be done parsing the header.
+  assert(header.size() == 0);
+
+  // Load the rest of the payload.
+  buffer.resize(payload_size);
+  in.read(buffer.data(), payload_size);
+  if (in.fail()) {
+    *status_out = Status::IOError("Failed to read index checkpoint payload.");
+    return std::optional<IndexCheckpoint>();
+  }
+
+  // Validate the checksum.
+  const uint32_t computed_checksum = crc32c::Value(
+      reinterpret_cast<const uint8_t*>(buffer.data()), payload_size);
+  if (computed_checksum != expected_checksum) {
+    *status_out =
+        Status::Corruption("Index checkpoint checksum does not match.");
+    return std::optional<IndexCheckpoint>();
+  }
+
+  const auto malformed = [status_out]() {
+    *status_out = Status::Corruption("Index checkpoint payload is malformed.");
+    return std::optional<IndexCheckpoint>();
+  };
+
+  // Decode the sequence number and segment file sizes.
+  Slice payload(buffer);
+  uint32_t next_sequence_number = 0, num_files = 0;
+  if (!GetVarint32(&payload, &next_sequence_number) ||
+      !GetVarint32(&payload, &num_files)) {
+    return malformed();
+  }
+  std::vector<size_t> allocated_segments;
+  allocated_segments.reserve(num_files);
+  for (uint32_t i = 0; i < num_files; ++i) {
+    uint64_t num_segments = 0;
+    if (!GetVarint64(&payload, &num_segments)) return malformed();
+    allocated_segments.push_back(num_segments);
+  }
+
+  // Decode the index entries.
+  uint64_t num_entries = 0;
+  if (!GetVarint64(&payload, &num_entries)) return malformed();
+  std::vector<std::pair<Key, SegmentInfo>> boundaries;
+  boundaries.reserve(num_entries);
+  Key prev_key = 0;
+  for (uint64_t i = 0; i < num_entries; ++i) {
+    uint64_t key_delta = 0, raw_id = 0;
+    if (!GetVarint64(&payload, &key_delta) ||
+        !GetVarint64(&payload, &raw_id) || payload.empty()) {
+      return malformed();
+    }
+    const uint8_t entry_flags = static_cast<uint8_t>(payload[0]);
+    payload.remove_prefix(1);
+    std::optional<plr::Line64> model;
+    if ((entry_flags & kEntryHasModelFlag) != 0) {
+      double slope = 0.0, intercept = 0.0;
+      if (!GetDouble(&payload, &slope) || !GetDouble(&payload, &intercept)) {
+        return malformed();
+      }
+      model = plr::Line64(slope, intercept);
+    }
+    prev_key += key_delta;
+    boundaries.emplace_back(prev_key, SegmentInfo(SegmentId(raw_id), model));
+    boundaries.back().second.SetOverflow(
+        (entry_flags & kEntryHasOverflowFlag) != 0);
+  }
+
+  // Decode the free list.
+  uint64_t num_free = 0;
+  if (!GetVarint64(&payload, &num_free)) return malformed();
+  std::vector<SegmentId> free;
+  free.reserve(num_free);
+  for (uint64_t i = 0; i < num_free; ++i) {
+    uint64_t raw_id = 0;
+    if (!GetVarint64(&payload, &raw_id)) return malformed();
+    free.emplace_back(raw_id);
+  }
+
+  *status_out = Status::OK();
+  return std::optional<IndexCheckpoint>(IndexCheckpoint(
+      next_sequence_number, std::move(allocated_segments),
+      std::move(boundaries), std::move(free), (flags & kCleanFlag) != 0));
+}
+
+Status IndexCheckpoint::WriteTo(
+    const std::filesystem::path& checkpoint_file) const {
+  std::string buffer;
+  buffer.append(kSignature);
+  PutFixed32(&buffer, kFormatVersion);
+  PutFixed32(&buffer, clean_ ? kCleanFlag : 0);
+  PutFixed64(&buffer, 0);  // Payload length placeholder
+  PutFixed32(&buffer, 0);  // Checksum placeholder
+  assert(buffer.size() == kHeaderSize);
+
+  PutVarint32(&buffer, next_sequence_number_);
+  PutVarint32(&buffer, allocated_segments_.size());
+  for (const auto& num_segments : allocated_segments_) {
+    PutVarint64(&buffer, num_segments);
+  }
+
+  PutVarint64(&buffer, boundaries_.size());
+  Key prev_key = 0;
+  for (const auto& [lower, sinfo] : boundaries_) {
+    assert(lower >= prev_key);
+    PutVarint64(&buffer, lower - prev_key);
+    PutVarint64(&buffer, sinfo.id().value());
+    uint8_t entry_flags = 0;
+    if (sinfo.HasOverflow()) entry_flags |= kEntryHasOverflowFlag;
+    if (sinfo.model().has_value()) entry_flags |= kEntryHasModelFlag;
+    buffer.push_back(static_cast<char>(entry_flags));
+    if (sinfo.model().has_value()) {
+      PutDouble(&buffer, sinfo.model()->slope());
+      PutDouble(&buffer, sinfo.model()->intercept());
+    }
+    prev_key = lower;
+  }
+
+  PutVarint64(&buffer, free_.size());
+  for (const auto& id : free_) {
+    PutVarint64(&buffer, id.value());
+  }
+
+  const size_t payload_size = buffer.size() - kHeaderSize;
+  EncodeFixed64(&buffer[kPayloadSizeOffset], payload_size);
+
+  const uint32_t checksum = crc32c::Value(
+      reinterpret_cast<const uint8_t*>(&buffer[kPayloadOffset]), payload_size);
+  EncodeFixed32(&buffer[kChecksumOffset], checksum);
+
+  // Write the checkpoint to a temporary file first and then rename it so that
+  // a crash while writing never leaves a partially written checkpoint behind.
+  std::filesystem::path temp_file = checkpoint_file;
+  temp_file += ".tmp";
+  {
+    std::ofstream out(temp_file, std::ios_base::out | std::ios_base::binary |
+                                     std::ios_base::trunc);
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    if (out.fail()) {
+      return Status::IOError("Failed to write index checkpoint");
+    }
+  }
+  Status status = SyncFileAndDirectory(temp_file);
+  if (!status.ok()) return status;
+
+  std::error_code err;
+  std::filesystem::rename(temp_file, checkpoint_file, err);
+  if (err) {
+    return Status::FromPosixError("Renaming index checkpoint:", err.value());
+  }
+  return SyncFileAndDirectory(checkpoint_file);
+}
+
+Status IndexCheckpoint::Remove(const std::filesystem::path& checkpoint_file) {
+  std::error_code err;
+  if (!std::filesystem::remove(checkpoint_file, err)) {
+    // The checkpoint did not exist (or could not be removed).
+    return err ? Status::FromPosixError("Removing index checkpoint:",
+                                        err.value())
+               : Status::OK();
+  }
+  return SyncDirectory(checkpoint_file.parent_path());
+}
+
+Status IndexCheckpoint::MarkDirty(
+    const std::filesystem::path& checkpoint_file) {
+  const int fd = open(checkpoint_file.c_str(), O_WRONLY);
+  if (fd < 0) {
+    return Status::FromPosixError("Opening index checkpoint:", errno);
+  }
+  char flags[sizeof(uint32_t)];
+  EncodeFixed32(flags, 0);
+  if (pwrite(fd, flags, sizeof(flags), kFlagsOffset) != sizeof(flags)) {
+    const int err_code = errno;
+    close(fd);
+    return Status::FromPosixError("Updating index checkpoint:", err_code);
+  }
+  if (fdatasync(fd) < 0) {
+    const int err_code = errno;
+    close(fd);
+    return Status::FromPosixError("Syncing index checkpoint:", err_code);
+  }
+  close(fd);
+  return Status::OK();
+}
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "key.h"
+#include "persist/segment_id.h"
+#include "segment_info.h"
+#include "treeline/status.h"
+
+namespace tl {
+namespace pg {
+
+// A persisted copy of the `Manager`'s in-memory segment index (the segment
+// boundaries, models, and overflow flags) and its free list. This class is
+// mainly meant to help with serializing and deserializing the checkpoint file.
+//
+// A checkpoint is "clean" if it was written when the database was shut down
+// (it describes the segment files exactly). Otherwise it was written while the
+// database was running and it may be stale; see `Manager::Reopen()` for how
+// stale checkpoints are validated.
+class IndexCheckpoint {
+ public:
+  // `boundaries` must be sorted in ascending order by key.
+  IndexCheckpoint(uint32_t next_sequence_number,
+                  std::vector<size_t> allocated_segments,
+                  std::vector<std::pair<Key, SegmentInfo>> boundaries,
+                  std::vector<SegmentId> free, bool clean)
+      : next_sequence_number_(next_sequence_number),
+        allocated_segments_(std::move(allocated_segments)),
+        boundaries_(std::move(boundaries)),
+        free_(std::move(free)),
+        clean_(clean) {}
+
+  // Loads the checkpoint from `checkpoint_file`. If there was an error loading
+  // the checkpoint, `status` will be set accordingly and the returned optional
+  // will not contain a value.
+  static std::optional<IndexCheckpoint> LoadFrom(
+      const std::filesystem::path& checkpoint_file, Status* status_out);
+
+  // Writes the checkpoint to `checkpoint_file` and ensures it is persisted.
+  Status WriteTo(const std::filesystem::path& checkpoint_file) const;
+
+  // Clears the "clean" flag in an existing checkpoint file (without rewriting
+  // the rest of the file).
+  static Status MarkDirty(const std::filesystem::path& checkpoint_file);
+
+  // Removes `checkpoint_file` (if it exists) and ensures the removal is
+  // persisted, so that the checkpoint cannot reappear after a crash.
+  static Status Remove(const std::filesystem::path& checkpoint_file);
+
+  // The sequence number that the next reorganization would have used when the
+  // checkpoint was taken.
+  uint32_t next_sequence_number() const { return next_sequence_number_; }
+
+  // The number of allocated segments in each segment file.
+  const std::vector<size_t>& allocated_segments() const {
+    return allocated_segments_;
+  }
+
+  const std::vector<std::pair<Key, SegmentInfo>>& boundaries() const {
+    return boundaries_;
+  }
+  const std::vector<SegmentId>& free() const { return free_; }
+  bool clean() const { return clean_; }
+
+ private:
+  uint32_t next_sequence_number_;
+  std::vector<size_t> allocated_segments_;
+  std::vector<std::pair<Key, SegmentInfo>> boundaries_;
+  std::vector<SegmentId> free_;
+  bool clean_;
+};
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,147 @@
+#include "key_range_stats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "persist/page.h"
+
+namespace tl {
+namespace pg {
+
+KeyRangeStats::KeyRangeStats(std::vector<Key> lower_bounds)
+    : lower_bounds_(std::move(lower_bounds)),
+      buckets_(new Bucket[lower_bounds_.size()]),
+      forecast_epoch_(0) {
+  assert(!lower_bounds_.empty());
+  assert(std::is_sorted(lower_bounds_.begin(), lower_bounds_.end()));
+}
+
+std::vector<Key> KeyRangeStats::ChooseBounds(
+    const std::vector<Key>& sorted_keys, const size_t num_buckets) {
+  std::vector<Key> bounds;
+  if (sorted_keys.empty() || num_buckets == 0) return bounds;
+  bounds.reserve(num_buckets);
+  for (size_t i = 0; i < num_buckets; ++i) {
+    const Key bound = sorted_keys[i * sorted_keys.size() / num_buckets];
+    // Skip duplicates (there are fewer keys than buckets).
+    if (!bounds.empty() && bounds.back() == bound) continue;
+    bounds.push_back(bound);
+  }
+  return bounds;
+}
+
+size_t KeyRangeStats::BucketFor(const Key key) const {
+  const auto it =
+      std::upper_bound(lower_bounds_.begin(), lower_bounds_.end(), key);
+  if (it == lower_bounds_.begin()) return 0;
+  return (it - lower_bounds_.begin()) - 1;
+}
+
+void KeyRangeStats::RecordUserWrite(const Key key, const size_t bytes,
+                                    const bool is_insert,
+                                    InsertTracker* tracker) {
+  Bucket& bucket = buckets_[BucketFor(key)];
+  bucket.user_writes.fetch_add(1, std::memory_order_relaxed);
+  bucket.user_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  if (!is_insert || tracker == nullptr) return;
+
+  bucket.window_inserts.fetch_add(1, std::memory_order_relaxed);
+  const size_t completed_epochs = tracker->NumCompletedEpochs();
+  if (completed_epochs != forecast_epoch_.load(std::memory_order_relaxed)) {
+    FinishForecastWindow(completed_epochs, tracker);
+  }
+}
+
+void KeyRangeStats::RecordPageWrites(const Key segment_lower,
+                                     const PageWrite kind,
+                                     const size_t num_pages) {
+  buckets_[BucketFor(segment_lower)]
+      .page_writes[static_cast<size_t>(kind)]
+      .fetch_add(num_pages, std::memory_order_relaxed);
+}
+
+void KeyRangeStats::RecordRewrite(const Key segment_lower) {
+  buckets_[BucketFor(segment_lower)].rewrites.fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+void KeyRangeStats::FinishForecastWindow(const size_t completed_epochs,
+                                         InsertTracker* tracker) {
+  std::unique_lock<std::mutex> lock(forecast_mutex_);
+  const size_t window_start = forecast_epoch_.load(std::memory_order_relaxed);
+  // Another thread may have already finished this window.
+  if (completed_epochs <= window_start) return;
+  // Usually 1, but the tracker can complete more than one epoch at once.
+  const size_t window_epochs = completed_epochs - window_start;
+
+  for (size_t i = 0; i < lower_bounds_.size(); ++i) {
+    Bucket& bucket = buckets_[i];
+    const uint64_t actual =
+        bucket.window_inserts.exchange(0, std::memory_order_relaxed);
+    if (bucket.has_forecast) {
+      const double predicted = bucket.forecast * window_epochs;
+      bucket.forecast_epochs += window_epochs;
+      bucket.forecast_inserts += predicted;
+      bucket.actual_inserts += actual;
+      bucket.forecast_abs_error += std::abs(predicted - actual);
+    }
+    const Key upper = i + 1 < lower_bounds_.size()
+                          ? lower_bounds_[i + 1]
+                          : std::numeric_limits<Key>::max();
+    bucket.has_forecast = tracker->GetNumInsertsInKeyRangeForNumFutureEpochs(
+        lower_bounds_[i], upper, /*num_future_epochs=*/1, &bucket.forecast);
+  }
+  forecast_epoch_.store(completed_epochs, std::memory_order_relaxed);
+}
+
+void KeyRangeStats::GetStats(
+    std::vector<PageGroupedDBKeyRangeStats>* stats_out) const {
+  stats_out->clear();
+  stats_out->resize(lower_bounds_.size());
+  std::unique_lock<std::mutex> lock(forecast_mutex_);
+  for (size_t i = 0; i < lower_bounds_.size(); ++i) {
+    const Bucket& bucket = buckets_[i];
+    PageGroupedDBKeyRangeStats& out = (*stats_out)[i];
+    out.lower = lower_bounds_[i];
+    out.upper = i + 1 < lower_bounds_.size()
+                    ? lower_bounds_[i + 1]
+                    : std::numeric_limits<Key>::max();
+    out.user_writes = bucket.user_writes.load(std::memory_order_relaxed);
+    out.user_bytes = bucket.user_bytes.load(std::memory_order_relaxed);
+    const auto page_bytes = [&bucket](const PageWrite kind) {
+      return bucket.page_writes[static_cast<size_t>(kind)].load(
+                 std::memory_order_relaxed) *
+             Page::kSize;
+    };
+    out.writeout_bytes = page_bytes(PageWrite::kWriteout);
+    out.overflow_bytes = page_bytes(PageWrite::kOverflow);
+    out.rewrite_bytes = page_bytes(PageWrite::kRewrite);
+    out.rewrites = bucket.rewrites.load(std::memory_order_relaxed);
+    out.forecast_epochs = bucket.forecast_epochs;
+    out.forecast_inserts = bucket.forecast_inserts;
+    out.actual_inserts = bucket.actual_inserts;
+    out.forecast_abs_error = bucket.forecast_abs_error;
+  }
+}
+
+void KeyRangeStats::PrintAsCsv(
+    std::ostream& out, const std::vector<PageGroupedDBKeyRangeStats>& stats) {
+  out << "lower,upper,user_writes,user_bytes,writeout_bytes,overflow_bytes,"
+         "rewrite_bytes,write_amplification,rewrites,forecast_epochs,"
+         "forecast_inserts,actual_inserts,forecast_abs_error"
+      << std::endl;
+  for (const auto& range : stats) {
+    out << range.lower << "," << range.upper << "," << range.user_writes << ","
+        << range.user_bytes << "," << range.writeout_bytes << ","
+        << range.overflow_bytes << "," << range.rewrite_bytes << ","
+        << range.WriteAmplification() << "," << range.rewrites << ","
+        << range.forecast_epochs << "," << range.forecast_inserts << ","
+        << range.actual_inserts << "," << range.forecast_abs_error
+        << std::endl;
+  }
+}
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "key.h"
+#include "treeline/pg_stats.h"
+#include "util/insert_tracker.h"
+
+namespace tl {
+namespace pg {
+
+// Counts user writes, page writes, and reorganizations per key range, along
+// with how well the insert forecasts (see `InsertTracker`) predicted each
+// range's inserts. The ranges ("buckets") are fixed when this object is
+// created.
+//
+// The counters are shared by all threads and are updated using relaxed atomic
+// operations (each bucket is on its own cache line). All methods are
+// thread-safe.
+class KeyRangeStats {
+ public:
+  enum class PageWrite : size_t {
+    // In-place writes of a segment's pages when records are written out.
+    kWriteout = 0,
+    kOverflow = 1,
+    // Pages written (or invalidated) by segment rewrites and flattens.
+    kRewrite = 2
+  };
+  static constexpr size_t kNumPageWriteKinds = 3;
+
+  // Creates one bucket per key in `lower_bounds` (which must be sorted and
+  // nonempty). Bucket `i` covers the keys in
+  // `[lower_bounds[i], lower_bounds[i + 1])` and the last bucket covers all
+  // keys that are at least `lower_bounds.back()`. Keys smaller than
+  // `lower_bounds.front()` are counted in the first bucket.
+  explicit KeyRangeStats(std::vector<Key> lower_bounds);
+
+  // Selects (at most) `num_buckets` bucket lower bounds from `sorted_keys` so
+  // that each bucket starts out with roughly the same number of keys.
+  static std::vector<Key> ChooseBounds(const std::vector<Key>& sorted_keys,
+                                       size_t num_buckets);
+
+  // Records a user write of `bytes` bytes (key and value). If `is_insert` is
+  // true and `tracker` is not null, the write is also counted against the
+  // range's insert forecast. Genuine inserts should be added to `tracker`
+  // before calling this method.
+  void RecordUserWrite(Key key, size_t bytes, bool is_insert,
+                       InsertTracker* tracker);
+  // Records `num_pages` pages written to the segment files on behalf of the
+  // segment (or page) that starts at `segment_lower`.
+  void RecordPageWrites(Key segment_lower, PageWrite kind, size_t num_pages);
+  // Records a reorganization of the segments that start at `segment_lower`.
+  void RecordRewrite(Key segment_lower);
+
+  // Replaces the contents of `stats_out` with the current statistics, one
+  // entry per bucket (in ascending key order).
+  void GetStats(std::vector<PageGroupedDBKeyRangeStats>* stats_out) const;
+
+  // Prints `stats` as a CSV table (with a header row), one row per key range.
+  static void PrintAsCsv(std::ostream& out,
+                         const std::vector<PageGroupedDBKeyRangeStats>& stats);
+
+ private:
+  struct alignas(64) Bucket {
+    std::atomic<uint64_t> user_writes{0};
+    std::atomic<uint64_t> user_bytes{0};
+    std::atomic<uint64_t> page_writes[kNumPageWriteKinds] = {};
+    std::atomic<uint64_t> rewrites{0};
+    // Inserts made since the current forecast window started.
+    std::atomic<uint64_t> window_inserts{0};
+
+    // Protected by `forecast_mutex_`.
+    bool has_forecast = false;
+    // The forecasted number of inserts for one epoch.
+    double forecast = 0.0;
+    uint64_t forecast_epochs = 0;
+    double forecast_inserts = 0.0;
+    uint64_t actual_inserts = 0;
+    double forecast_abs_error = 0.0;
+  };
+
+  size_t BucketFor(Key key) const;
+
+  // Called when the insert tracker completes an epoch. Compares each bucket's
+  // forecast with the inserts made since the previous epoch completed, and
+  // then records the forecasts for the next epoch.
+  void FinishForecastWindow(size_t completed_epochs, InsertTracker* tracker);
+
+  const std::vector<Key> lower_bounds_;
+  std::unique_ptr<Bucket[]> buckets_;
+
+  mutable std::mutex forecast_mutex_;
+  // The number of insert tracker epochs that had completed when the current
+  // forecast window started.
+  std::atomic<size_t> forecast_epoch_;
+};
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+
+#include "treeline/pg_stats.h"
+
+namespace tl {
+namespace pg {
+
+// Times the phases of an operation and records each phase's latency in the
+// calling thread's `PageGroupedDBStats` histograms. The current phase ends
+// when `Next()` or `Stop()` is called, or when the timer is destroyed.
+//
+// When latency tracking is disabled (the default), the timer does not read the
+// clock and does not record anything.
+class PhaseTimer {
+ public:
+  using Phase = PageGroupedDBStats::LatencyPhase;
+
+  explicit PhaseTimer(Phase phase)
+      : enabled_(PageGroupedDBStats::LatencyTrackingEnabled()),
+        running_(enabled_),
+        phase_(phase) {
+    if (enabled_) start_ = Clock::now();
+  }
+
+  ~PhaseTimer() { Stop(); }
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+  // Ends the current phase (if it has not already ended) and starts `next`.
+  void Next(Phase next) {
+    if (!enabled_) return;
+    const Clock::time_point now = Clock::now();
+    if (running_) Record(now);
+    phase_ = next;
+    start_ = now;
+    running_ = true;
+  }
+
+  // Ends the current phase. This is a no-op if the phase has already ended.
+  void Stop() {
+    if (!running_) return;
+    Record(Clock::now());
+    running_ = false;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  void Record(Clock::time_point now) const {
+    PageGroupedDBStats::Local().RecordLatency(
+        phase_,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_)
+            .count());
+  }
+
+  const bool enabled_;
+  bool running_;
+  Phase phase_;
+  Clock::time_point start_;
+};
+
+}  // namespace pg
+}  // namespace tl
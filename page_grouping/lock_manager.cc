@@ -2,17 +2,39 @@
 
 #include <cassert>
 
-#include "rand_exp_backoff.h"
-
 namespace {
 
-constexpr uint32_t kBackoffSaturate = 12;
+using LockWaitMode = tl::pg::PageGroupedDBStats::LockWaitMode;
 
+LockWaitMode ToStatsMode(tl::pg::LockManager::SegmentMode mode) {
+  switch (mode) {
+    case tl::pg::LockManager::SegmentMode::kPageRead:
+      return LockWaitMode::kSegmentPageRead;
+    case tl::pg::LockManager::SegmentMode::kPageWrite:
+      return LockWaitMode::kSegmentPageWrite;
+    case tl::pg::LockManager::SegmentMode::kReorg:
+      return LockWaitMode::kSegmentReorg;
+    case tl::pg::LockManager::SegmentMode::kReorgExclusive:
+      return LockWaitMode::kSegmentReorgExclusive;
+  }
+  return LockWaitMode::kSegmentPageRead;
 }
 
+LockWaitMode ToStatsMode(tl::pg::LockManager::PageMode mode) {
+  return mode == tl::pg::LockManager::PageMode::kShared
+             ? LockWaitMode::kPageShared
+             : LockWaitMode::kPageExclusive;
+}
+
+}  // namespace
+
 namespace tl {
 namespace pg {
 
+LockManager::LockManager(std::unique_ptr<LockProfiler> profiler)
+    : wait_slots_(std::make_unique<WaitSlot[]>(kNumWaitSlots)),
+      profiler_(std::move(profiler)) {}
+
 bool LockManager::TryAcquireSegmentLock(const SegmentId& seg_id,
                                         SegmentMode requested_mode) {
   const LockId id = SegmentLockId(seg_id);
@@ -20,39 +42,35 @@ bool LockManager::TryAcquireSegmentLock(const SegmentId& seg_id,
   const bool inserted_new = segment_locks_.uprase_fn(
       id,
       [&granted, &requested_mode](SegmentLockState& lock_state) {
-        switch (requested_mode) {
-          case SegmentMode::kPageRead: {
-            if (lock_state.num_reorg_exclusive == 0) {
+        // Not supposed to acquire OX mode directly.
+        assert(requested_mode != SegmentMode::kReorgExclusive);
+        granted = CanGrant(lock_state, requested_mode);
+        if (granted) {
+          switch (requested_mode) {
+            case SegmentMode::kPageRead: {
               ++lock_state.num_page_read;
-              granted = true;
+              break;
             }
-            break;
-          }
-          case SegmentMode::kPageWrite: {
-            if (lock_state.num_reorg == 0 &&
-                lock_state.num_reorg_exclusive == 0) {
+            case SegmentMode::kPageWrite: {
               ++lock_state.num_page_write;
-              granted = true;
+              break;
             }
-            break;
-          }
-          case SegmentMode::kReorg: {
-            if (lock_state.num_page_write == 0 && lock_state.num_reorg == 0 &&
-                lock_state.num_reorg_exclusive == 0) {
+            case SegmentMode::kReorg: {
               ++lock_state.num_reorg;
-              granted = true;
+              break;
+            }
+            case SegmentMode::kReorgExclusive: {
+              break;
             }
-            break;
-          }
-          case SegmentMode::kReorgExclusive: {
-            // Not supposed to acquire OX mode directly.
-            assert(false);
-            break;
           }
         }
         return false;  // Return false to keep the lock state.
       },
       requested_mode);
+  if (profiler_ != nullptr) {
+    profiler_->RecordSegmentTry(seg_id, ToStatsMode(requested_mode),
+                                inserted_new || granted);
+  }
   return inserted_new || granted;
 }
 
@@ -90,6 +108,45 @@ void LockManager::ReleaseSegmentLock(const SegmentId& seg_id,
       });
   // Should not attempt to release a lock that was never acquired.
   assert(lock_state_found);
+  NotifyWaiters(id);
+}
+
+LockManager::WaitTicket LockManager::GetSegmentWaitTicket(
+    const SegmentId& seg_id) const {
+  return GetWaitTicket(SegmentLockId(seg_id));
+}
+
+bool LockManager::WaitForSegmentLock(const SegmentId& seg_id,
+                                     const SegmentMode mode,
+                                     const WaitTicket ticket,
+                                     const Deadline deadline) {
+  const LockId id = SegmentLockId(seg_id);
+  const bool released =
+      Wait(id, ticket, deadline, ToStatsMode(mode),
+           [this, id, mode]() { return IsGrantable(id, mode); });
+  if (!released && profiler_ != nullptr) {
+    // The caller gives up on the lock once the deadline passes.
+    profiler_->RecordSegmentGiveUp(seg_id, ToStatsMode(mode));
+  }
+  return released;
+}
+
+void LockManager::SwitchSegmentLockWait(const SegmentId& from,
+                                        const SegmentId& to,
+                                        const SegmentMode mode) {
+  if (profiler_ == nullptr || from == to) return;
+  if (to.IsValid()) {
+    profiler_->RecordSegmentSwitch(from, to, ToStatsMode(mode));
+  } else {
+    profiler_->RecordSegmentGiveUp(from, ToStatsMode(mode));
+  }
+}
+
+size_t LockManager::NumSegmentLockWaiters(const SegmentId& seg_id) const {
+  WaitSlot& slot = WaitSlotFor(SegmentLockId(seg_id));
+  // Waiters hold the mutex from registering until they block (see `Wait()`).
+  std::unique_lock<std::mutex> lock(slot.mutex);
+  return slot.num_waiters.load();
 }
 
 void LockManager::UpgradeSegmentLockToReorgExclusive(const SegmentId& seg_id) {
@@ -107,17 +164,28 @@ void LockManager::UpgradeSegmentLockToReorgExclusive(const SegmentId& seg_id) {
       });
   assert(lock_state_found);
 
-  // Spin wait until the readers are done.
-  if (!can_return) {
-    RandExpBackoff backoff(kBackoffSaturate);
-    while (!can_return) {
-      backoff.Wait();
-      const bool found = segment_locks_.find_fn(
-          id, [&can_return](const SegmentLockState& lock_state) {
-            can_return = (lock_state.num_page_read == 0);
-          });
-      assert(found);
-    }
+  // Wait until the readers are done. The last reader to release its lock will
+  // wake us up.
+  if (profiler_ != nullptr && !can_return) {
+    profiler_->RecordSegmentTry(seg_id, LockWaitMode::kSegmentReorgExclusive,
+                                /*granted=*/false);
+  }
+  while (!can_return) {
+    const WaitTicket ticket = GetWaitTicket(id);
+    const bool found = segment_locks_.find_fn(
+        id, [&can_return](const SegmentLockState& lock_state) {
+          can_return = (lock_state.num_page_read == 0);
+        });
+    assert(found);
+    if (can_return) break;
+    Wait(id, ticket, Deadline::max(), LockWaitMode::kSegmentReorgExclusive,
+         [this, id]() {
+           return IsGrantable(id, SegmentMode::kReorgExclusive);
+         });
+  }
+  if (profiler_ != nullptr) {
+    profiler_->RecordSegmentTry(seg_id, LockWaitMode::kSegmentReorgExclusive,
+                                /*granted=*/true);
   }
 }
 
@@ -150,17 +218,25 @@ bool LockManager::TryAcquirePageLock(const SegmentId& seg_id,
         return false;  // Return false to keep the lock state.
       },
       requested_mode);
+  if (profiler_ != nullptr) {
+    profiler_->RecordPageTry(seg_id, page_idx, ToStatsMode(requested_mode),
+                             inserted_new || granted);
+  }
   return inserted_new || granted;
 }
 
 void LockManager::AcquirePageLock(const SegmentId& seg_id,
                                   const size_t page_idx,
                                   const PageMode requested_mode) {
-  RandExpBackoff backoff(kBackoffSaturate);
+  const LockId id = PageLockId(seg_id, page_idx);
   while (true) {
+    const WaitTicket ticket = GetWaitTicket(id);
     const bool granted = TryAcquirePageLock(seg_id, page_idx, requested_mode);
     if (granted) return;
-    backoff.Wait();
+    Wait(id, ticket, Deadline::max(), ToStatsMode(requested_mode),
+         [this, id, requested_mode]() {
+           return IsGrantable(id, requested_mode);
+         });
   }
 }
 
@@ -188,6 +264,50 @@ void LockManager::ReleasePageLock(const SegmentId& seg_id,
         return lock_state.num_shared == 0 && lock_state.num_exclusive == 0;
       });
   assert(found);
+  NotifyWaiters(id);
+}
+
+bool LockManager::CanGrant(const SegmentLockState& lock_state,
+                           const SegmentMode mode) {
+  switch (mode) {
+    case SegmentMode::kPageRead:
+      return lock_state.num_reorg_exclusive == 0;
+    case SegmentMode::kPageWrite:
+      return lock_state.num_reorg == 0 && lock_state.num_reorg_exclusive == 0;
+    case SegmentMode::kReorg:
+      return lock_state.num_page_write == 0 && lock_state.num_reorg == 0 &&
+             lock_state.num_reorg_exclusive == 0;
+    case SegmentMode::kReorgExclusive:
+      return lock_state.num_page_read == 0;
+  }
+  return false;
+}
+
+bool LockManager::CanGrant(const PageLockState& lock_state,
+                           const PageMode mode) {
+  switch (mode) {
+    case PageMode::kShared:
+      return lock_state.num_exclusive == 0;
+    case PageMode::kExclusive:
+      return lock_state.num_exclusive == 0 && lock_state.num_shared == 0;
+  }
+  return false;
+}
+
+bool LockManager::IsGrantable(const LockId id, const SegmentMode mode) const {
+  bool grantable = true;
+  segment_locks_.find_fn(id, [&grantable, mode](const SegmentLockState& state) {
+    grantable = CanGrant(state, mode);
+  });
+  return grantable;
+}
+
+bool LockManager::IsGrantable(const LockId id, const PageMode mode) const {
+  bool grantable = true;
+  page_locks_.find_fn(id, [&grantable, mode](const PageLockState& state) {
+    grantable = CanGrant(state, mode);
+  });
+  return grantable;
 }
 
 LockManager::LockId LockManager::SegmentLockId(const SegmentId& seg_id) const {
@@ -202,6 +322,70 @@ LockManager::LockId LockManager::PageLockId(const SegmentId& seg_id,
   return seg_id.value() + page_idx;
 }
 
+LockManager::WaitSlot& LockManager::WaitSlotFor(const LockId id) const {
+  // Segment IDs are aligned to the segment's size (in pages), so the lower bits
+  // of `id` are often zero. Mix the bits before choosing a slot (Fibonacci
+  // hashing).
+  return wait_slots_[(id * 0x9E3779B97F4A7C15ULL) >> (64 - kWaitSlotBits)];
+}
+
+LockManager::WaitTicket LockManager::GetWaitTicket(const LockId id) const {
+  return WaitSlotFor(id).version.load();
+}
+
+void LockManager::NotifyWaiters(const LockId id) {
+  WaitSlot& slot = WaitSlotFor(id);
+  // Waiters register before re-checking the lock's state (see `Wait()`), so
+  // releases that happen while no waiter is registered need not invalidate
+  // any ticket. This keeps uncontended releases free of writes to the slot.
+  if (slot.num_waiters.load() == 0) return;
+  slot.version.fetch_add(1);
+  {
+    // Acquiring the mutex ensures that a waiter is either blocked on `cv` or
+    // has not yet checked `version` (avoids a lost wake up).
+    std::unique_lock<std::mutex> lock(slot.mutex);
+  }
+  slot.cv.notify_all();
+}
+
+bool LockManager::Wait(const LockId id, const WaitTicket ticket,
+                       const Deadline deadline,
+                       const PageGroupedDBStats::LockWaitMode stats_mode,
+                       const std::function<bool()>& is_grantable) {
+  WaitSlot& slot = WaitSlotFor(id);
+  if (slot.version.load() != ticket) return true;
+
+  const auto start = std::chrono::steady_clock::now();
+  bool deadline_passed = false;
+  {
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    // A release that happened before this thread registered may not have
+    // changed `version`. So the lock's state is checked again after
+    // registering: any release that it does not reflect will see this waiter
+    // (the lock table's bucket locks order the check and the release).
+    slot.num_waiters.fetch_add(1);
+    if (is_grantable()) {
+      slot.num_waiters.fetch_sub(1);
+      return true;
+    }
+    const auto released = [&slot, ticket]() {
+      return slot.version.load() != ticket;
+    };
+    if (deadline == Deadline::max()) {
+      slot.cv.wait(lock, released);
+    } else {
+      deadline_passed = !slot.cv.wait_until(lock, deadline, released);
+    }
+  }
+  slot.num_waiters.fetch_sub(1);
+
+  const auto waited = std::chrono::steady_clock::now() - start;
+  PageGroupedDBStats::Local().BumpLockWait(
+      stats_mode,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+  return !deadline_passed;
+}
+
 LockManager::SegmentLockState::SegmentLockState(SegmentMode initial_mode) {
   switch (initial_mode) {
     case SegmentMode::kPageRead:
@@ -1,9 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 #include "libcuckoo/cuckoohash_map.hh"
+#include "lock_profiler.h"
 #include "persist/segment_id.h"
+#include "treeline/pg_stats.h"
 
 namespace tl {
 namespace pg {
@@ -15,6 +23,15 @@ namespace pg {
 // if you are granted an `kShared` page lock, you must eventually call
 // `ReleasePageLock()` with `kShared` as the mode).
 //
+// Threads that cannot be granted a lock can block until the lock's state
+// changes (see `WaitForSegmentLock()`) instead of retrying in a loop. Waiting
+// threads are parked on a condition variable that is shared by a small group
+// of locks, so a waiter may occasionally be woken up by a release of an
+// unrelated lock; waiters must always retry their acquisition after waking up.
+//
+// If a `LockProfiler` is provided, every acquisition attempt is also recorded
+// in the profiler (see `PageGroupedDBOptions::lock_profiling_top_n`).
+//
 // This class's methods are safe to call concurrently.
 class LockManager {
  public:
@@ -53,6 +70,12 @@ class LockManager {
     kExclusive = 1  // X
   };
 
+  // Returned by `GetSegmentWaitTicket()`. Used to avoid missed wake ups.
+  using WaitTicket = uint64_t;
+  using Deadline = std::chrono::steady_clock::time_point;
+
+  explicit LockManager(std::unique_ptr<LockProfiler> profiler = nullptr);
+
   // Try to acquire a segment lock on `seg_id` with mode `mode`. Returns true
   // iff the acquisiton was successful.
   //
@@ -64,6 +87,40 @@ class LockManager {
   // `mode`.
   void ReleaseSegmentLock(const SegmentId& seg_id, SegmentMode mode);
 
+  // Used to block until a segment lock might be grantable. To avoid missing a
+  // release, the ticket must be retrieved *before* the failed acquisition:
+  //
+  //   const auto ticket = lock_manager.GetSegmentWaitTicket(seg_id);
+  //   if (!lock_manager.TryAcquireSegmentLock(seg_id, mode)) {
+  //     lock_manager.WaitForSegmentLock(seg_id, mode, ticket);
+  //     // Retry the acquisition.
+  //   }
+  WaitTicket GetSegmentWaitTicket(const SegmentId& seg_id) const;
+
+  // Blocks until a lock on `seg_id` has been released since `ticket` was
+  // retrieved, or until `deadline` passes. Returns false iff the deadline
+  // passed, in which case the caller is assumed to give up on the lock (its
+  // wait is not charged to a later acquisition in the `LockProfiler`). `mode`
+  // is the mode the caller wants to acquire (used for the wait time statistics
+  // in `PageGroupedDBStats`).
+  bool WaitForSegmentLock(const SegmentId& seg_id, SegmentMode mode,
+                          WaitTicket ticket,
+                          Deadline deadline = Deadline::max());
+
+  // Used by callers that look up the segment to lock (e.g., in the segment
+  // index) and waited for the segment lock on `from` in `mode`, when the
+  // lookup now returns `to` instead (e.g., a reorganization replaced `from`).
+  // `to` may be invalid if the lookup no longer finds a segment. This only
+  // affects the `LockProfiler` statistics: the wait is charged to the
+  // acquisition of `to` (or dropped).
+  void SwitchSegmentLockWait(const SegmentId& from, const SegmentId& to,
+                             SegmentMode mode);
+
+  // Returns the number of threads that are blocked waiting for `seg_id`'s lock
+  // (this may include threads waiting for other locks that share its wait
+  // slot). Meant for tests.
+  size_t NumSegmentLockWaiters(const SegmentId& seg_id) const;
+
   // Upgrade the segment lock on `seg_id` to `kReorgExclusive`. The caller must
   // already hold the lock in `kReorg` mode. This method will block until the
   // upgraded lock can be granted (it will wait for any concurrent readers to
@@ -86,6 +143,9 @@ class LockManager {
   // `page_idx` with mode `mode`.
   void ReleasePageLock(const SegmentId& seg_id, size_t page_idx, PageMode mode);
 
+  // Returns the lock profiler (null if profiling is disabled).
+  const LockProfiler* profiler() const { return profiler_.get(); }
+
  private:
   using LockCount = uint16_t;
   using LockId = size_t;
@@ -103,11 +163,46 @@ class LockManager {
     LockCount num_exclusive = 0;
   };
 
+  // Threads waiting for a lock are parked on the wait slot that the lock's ID
+  // hashes to. `version` is incremented whenever one of the slot's locks is
+  // released while a waiter is registered on the slot.
+  struct alignas(64) WaitSlot {
+    std::atomic<uint64_t> version = 0;
+    std::atomic<uint32_t> num_waiters = 0;
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+  static constexpr size_t kWaitSlotBits = 8;
+  static constexpr size_t kNumWaitSlots = 1ULL << kWaitSlotBits;
+
+  // Returns true iff a lock in `mode` is compatible with `lock_state`. For
+  // `kReorgExclusive`, returns true iff an upgrade to that mode can complete.
+  static bool CanGrant(const SegmentLockState& lock_state, SegmentMode mode);
+  static bool CanGrant(const PageLockState& lock_state, PageMode mode);
+  // Returns true iff `mode` is compatible with the lock's current state (the
+  // lock is not acquired).
+  bool IsGrantable(LockId id, SegmentMode mode) const;
+  bool IsGrantable(LockId id, PageMode mode) const;
+
   LockId SegmentLockId(const SegmentId& seg_id) const;
   LockId PageLockId(const SegmentId& seg_id, size_t page_idx) const;
 
+  WaitSlot& WaitSlotFor(LockId id) const;
+  // Wakes up the threads waiting on `id`'s slot (if any).
+  void NotifyWaiters(LockId id);
+  WaitTicket GetWaitTicket(LockId id) const;
+  // Blocks until the version of `id`'s slot differs from `ticket` or until
+  // `deadline` passes. Returns false iff the deadline passed. Returns right
+  // away if `is_grantable` returns true once the caller is registered as a
+  // waiter. The time spent blocked is recorded under `stats_mode`.
+  bool Wait(LockId id, WaitTicket ticket, Deadline deadline,
+            PageGroupedDBStats::LockWaitMode stats_mode,
+            const std::function<bool()>& is_grantable);
+
   libcuckoo::cuckoohash_map<LockId, SegmentLockState> segment_locks_;
   libcuckoo::cuckoohash_map<LockId, PageLockState> page_locks_;
+  std::unique_ptr<WaitSlot[]> wait_slots_;
+  std::unique_ptr<LockProfiler> profiler_;
 };
 
 }  // namespace pg
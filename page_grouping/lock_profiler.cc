@@ -0,0 +1,202 @@
+#include "lock_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+using tl::pg::PageGroupedDBLockContentionStats;
+using tl::pg::PageGroupedDBStats;
+
+uint64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Threads are assigned to shards in a round robin order.
+size_t LocalShardIndex(const size_t num_shards) {
+  static std::atomic<size_t> next_index(0);
+  static thread_local const size_t index = next_index.fetch_add(1);
+  return index % num_shards;
+}
+
+void PrintHotLocks(
+    std::ostream& out, const char* kind,
+    const std::vector<PageGroupedDBLockContentionStats::HotLock>& locks,
+    const bool is_page) {
+  for (const auto& lock : locks) {
+    out << kind << "," << lock.file_id << "," << lock.segment_offset << ",";
+    if (is_page) out << lock.page_idx;
+    out << "," << lock.failed_tries << "," << lock.contended_acquisitions
+        << "," << lock.wait_nanos << std::endl;
+  }
+}
+
+}  // namespace
+
+namespace tl {
+namespace pg {
+
+LockProfiler::LockProfiler(const size_t top_n)
+    : top_n_(top_n), shards_(new Shard[kNumShards]) {}
+
+std::vector<LockProfiler::PendingStart>& LockProfiler::PendingStarts() {
+  static thread_local std::vector<PendingStart> pending_starts;
+  return pending_starts;
+}
+
+LockProfiler::PendingStart* LockProfiler::FindPendingStart(
+    const LockKey& key, const Mode mode) const {
+  for (auto& pending_start : PendingStarts()) {
+    if (pending_start.profiler == this && pending_start.mode == mode &&
+        pending_start.key == key) {
+      return &pending_start;
+    }
+  }
+  return nullptr;
+}
+
+uint64_t LockProfiler::TakePendingStart(const LockKey& key,
+                                        const Mode mode) const {
+  PendingStart* const pending_start = FindPendingStart(key, mode);
+  if (pending_start == nullptr) return 0;
+  const uint64_t start_nanos = pending_start->start_nanos;
+  auto& pending_starts = PendingStarts();
+  *pending_start = pending_starts.back();
+  pending_starts.pop_back();
+  return start_nanos;
+}
+
+void LockProfiler::RecordSegmentSwitch(const SegmentId& from,
+                                       const SegmentId& to, const Mode mode) {
+  const LockKey from_key{from.value(), /*page_idx=*/0, /*is_page=*/false};
+  const LockKey to_key{to.value(), /*page_idx=*/0, /*is_page=*/false};
+  PendingStart* const pending_start = FindPendingStart(from_key, mode);
+  if (pending_start == nullptr) return;
+  if (FindPendingStart(to_key, mode) != nullptr) {
+    TakePendingStart(from_key, mode);
+    return;
+  }
+  pending_start->key = to_key;
+}
+
+void LockProfiler::RecordTry(const LockKey& key, const Mode mode,
+                             const bool granted) {
+  const size_t mode_idx = static_cast<size_t>(mode);
+  Shard& shard = shards_[LocalShardIndex(kNumShards)];
+
+  if (!granted) {
+    if (FindPendingStart(key, mode) == nullptr) {
+      PendingStarts().push_back(PendingStart{this, key, mode, NowNanos()});
+    }
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    ++shard.modes[mode_idx].failed_tries;
+    ++shard.locks[key].failed_tries;
+    return;
+  }
+
+  const uint64_t pending_start = TakePendingStart(key, mode);
+  const bool contended = pending_start != 0;
+  uint64_t latency = 0;
+  if (contended) {
+    latency = NowNanos() - pending_start;
+  }
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  ModeCounters& counters = shard.modes[mode_idx];
+  ++counters.acquisitions;
+  counters.latency.Record(latency);
+  if (!contended) return;
+  ++counters.contended_acquisitions;
+  LockCounters& lock_counters = shard.locks[key];
+  ++lock_counters.contended_acquisitions;
+  lock_counters.wait_nanos += latency;
+}
+
+void LockProfiler::GetStats(
+    PageGroupedDBLockContentionStats* stats_out) const {
+  std::unordered_map<LockKey, LockCounters, LockKeyHash> locks;
+  for (auto& mode : stats_out->modes) {
+    mode = PageGroupedDBLockContentionStats::ModeStats();
+  }
+  for (size_t i = 0; i < kNumShards; ++i) {
+    Shard& shard = shards_[i];
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    for (size_t m = 0; m < PageGroupedDBStats::kNumLockWaitModes; ++m) {
+      const ModeCounters& counters = shard.modes[m];
+      auto& out = stats_out->modes[m];
+      out.acquisitions += counters.acquisitions;
+      out.contended_acquisitions += counters.contended_acquisitions;
+      out.failed_tries += counters.failed_tries;
+      out.latency.Merge(counters.latency);
+    }
+    for (const auto& [key, counters] : shard.locks) {
+      LockCounters& total = locks[key];
+      total.failed_tries += counters.failed_tries;
+      total.contended_acquisitions += counters.contended_acquisitions;
+      total.wait_nanos += counters.wait_nanos;
+    }
+  }
+
+  stats_out->hot_segments.clear();
+  stats_out->hot_pages.clear();
+  for (const auto& [key, counters] : locks) {
+    const SegmentId seg_id(key.seg_id);
+    PageGroupedDBLockContentionStats::HotLock hot;
+    hot.file_id = seg_id.GetFileId();
+    hot.segment_offset = seg_id.GetOffset();
+    hot.page_idx = key.page_idx;
+    hot.failed_tries = counters.failed_tries;
+    hot.contended_acquisitions = counters.contended_acquisitions;
+    hot.wait_nanos = counters.wait_nanos;
+    (key.is_page ? stats_out->hot_pages : stats_out->hot_segments)
+        .push_back(hot);
+  }
+
+  // Keep the `top_n_` locks that threads spent the most time waiting for
+  // (breaking ties using the number of failed attempts).
+  const auto more_contended = [](const auto& left, const auto& right) {
+    if (left.wait_nanos != right.wait_nanos) {
+      return left.wait_nanos > right.wait_nanos;
+    }
+    return left.failed_tries > right.failed_tries;
+  };
+  for (auto* hot_locks : {&stats_out->hot_segments, &stats_out->hot_pages}) {
+    const size_t keep = std::min(top_n_, hot_locks->size());
+    std::partial_sort(hot_locks->begin(), hot_locks->begin() + keep,
+                      hot_locks->end(), more_contended);
+    hot_locks->resize(keep);
+  }
+}
+
+void LockProfiler::PrintAsCsv(std::ostream& out,
+                              const PageGroupedDBLockContentionStats& stats) {
+  out << "mode,acquisitions,contended_acquisitions,failed_tries,mean_ns,"
+         "p50_ns,p90_ns,p99_ns,p999_ns,max_ns"
+      << std::endl;
+  for (size_t i = 0; i < PageGroupedDBStats::kNumLockWaitModes; ++i) {
+    const auto mode = static_cast<Mode>(i);
+    const auto& mode_stats = stats.modes[i];
+    const auto& latency = mode_stats.latency;
+    out << PageGroupedDBStats::LockWaitModeName(mode) << ","
+        << mode_stats.acquisitions << "," << mode_stats.contended_acquisitions
+        << "," << mode_stats.failed_tries << "," << latency.Mean() << ","
+        << latency.Percentile(50) << "," << latency.Percentile(90) << ","
+        << latency.Percentile(99) << "," << latency.Percentile(99.9) << ","
+        << latency.Max() << std::endl;
+  }
+}
+
+void LockProfiler::PrintHotLocksAsCsv(
+    std::ostream& out, const PageGroupedDBLockContentionStats& stats) {
+  out << "kind,file_id,segment_offset,page_idx,failed_tries,"
+         "contended_acquisitions,wait_ns"
+      << std::endl;
+  PrintHotLocks(out, "segment", stats.hot_segments, /*is_page=*/false);
+  PrintHotLocks(out, "page", stats.hot_pages, /*is_page=*/true);
+}
+
+}  // namespace pg
+}  // namespace tl
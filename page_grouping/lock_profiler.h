@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "persist/segment_id.h"
+#include "treeline/pg_latency_histogram.h"
+#include "treeline/pg_stats.h"
+
+namespace tl {
+namespace pg {
+
+// Records lock contention statistics for a `LockManager` (see
+// `PageGroupedDBLockContentionStats`): per lock mode, the number of granted
+// and failed acquisition attempts along with a histogram of the acquisition
+// latencies, and per lock, how often threads had to wait for it.
+//
+// An acquisition is "contended" if the thread failed to acquire the lock at
+// least once before it was granted. A contended acquisition's latency is the
+// time from the thread's first failed attempt (on the same lock, in the same
+// mode) to the grant; uncontended acquisitions are recorded with a latency of
+// 0 and do not read the clock. If a thread gives up on a lock, it must call
+// `RecordSegmentGiveUp()` so that the wait is not charged to a later
+// acquisition. If it needs a different lock instead (e.g., a reorganization
+// replaced the segment it waited for), it calls `RecordSegmentSwitch()` and
+// the wait is charged to the acquisition of the new lock.
+//
+// The statistics are kept in a fixed number of shards; each thread always
+// uses the same shard, so the shard locks are rarely contended. The per lock
+// counters are only updated on contention. All methods are thread-safe.
+class LockProfiler {
+ public:
+  using Mode = PageGroupedDBStats::LockWaitMode;
+
+  // The statistics report (at most) `top_n` of the most contended segment
+  // locks and page locks.
+  explicit LockProfiler(size_t top_n);
+
+  // Records an attempt to acquire the segment lock on `seg_id` (or the page
+  // lock on `seg_id` and `page_idx`) in `mode`.
+  void RecordSegmentTry(const SegmentId& seg_id, Mode mode, bool granted) {
+    RecordTry(LockKey{seg_id.value(), /*page_idx=*/0, /*is_page=*/false}, mode,
+              granted);
+  }
+  void RecordPageTry(const SegmentId& seg_id, size_t page_idx, Mode mode,
+                     bool granted) {
+    RecordTry(LockKey{seg_id.value(), page_idx, /*is_page=*/true}, mode,
+              granted);
+  }
+
+  // Records that the calling thread stopped trying to acquire the segment lock
+  // on `seg_id` in `mode` (e.g., because a deadline passed). Its failed
+  // attempts remain counted, but the time spent waiting is not recorded as an
+  // acquisition latency.
+  void RecordSegmentGiveUp(const SegmentId& seg_id, Mode mode) {
+    TakePendingStart(LockKey{seg_id.value(), /*page_idx=*/0, /*is_page=*/false},
+                     mode);
+  }
+
+  // Records that the calling thread stopped waiting for the segment lock on
+  // `from` in `mode` because it now needs the segment lock on `to` (e.g., a
+  // reorganization replaced `from`). The pending wait carries over to `to`.
+  void RecordSegmentSwitch(const SegmentId& from, const SegmentId& to,
+                           Mode mode);
+
+  // Replaces the contents of `stats_out` with the current statistics.
+  void GetStats(PageGroupedDBLockContentionStats* stats_out) const;
+
+  // Prints the per mode statistics (`PrintAsCsv()`) or the most contended
+  // locks (`PrintHotLocksAsCsv()`) as a CSV table (with a header row).
+  static void PrintAsCsv(std::ostream& out,
+                         const PageGroupedDBLockContentionStats& stats);
+  static void PrintHotLocksAsCsv(
+      std::ostream& out, const PageGroupedDBLockContentionStats& stats);
+
+ private:
+  struct LockKey {
+    size_t seg_id;
+    size_t page_idx;
+    bool is_page;
+
+    bool operator==(const LockKey& other) const {
+      return seg_id == other.seg_id && page_idx == other.page_idx &&
+             is_page == other.is_page;
+    }
+  };
+  struct LockKeyHash {
+    size_t operator()(const LockKey& key) const {
+      return (key.seg_id + key.page_idx) * 0x9E3779B97F4A7C15ULL +
+             key.is_page;
+    }
+  };
+  struct LockCounters {
+    uint64_t failed_tries = 0;
+    uint64_t contended_acquisitions = 0;
+    uint64_t wait_nanos = 0;
+  };
+  struct ModeCounters {
+    uint64_t acquisitions = 0;
+    uint64_t contended_acquisitions = 0;
+    uint64_t failed_tries = 0;
+    LatencyHistogram latency;
+  };
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    ModeCounters modes[PageGroupedDBStats::kNumLockWaitModes];
+    std::unordered_map<LockKey, LockCounters, LockKeyHash> locks;
+  };
+  static constexpr size_t kNumShards = 64;
+
+  // The time of a thread's first failed attempt to acquire a lock. A thread
+  // only waits for a few locks at a time, so these are kept in a short
+  // thread-local list (shared by all profilers).
+  struct PendingStart {
+    const LockProfiler* profiler;
+    LockKey key;
+    Mode mode;
+    uint64_t start_nanos;
+  };
+  static std::vector<PendingStart>& PendingStarts();
+  // Returns the calling thread's pending start for `key` in `mode`, if any.
+  PendingStart* FindPendingStart(const LockKey& key, Mode mode) const;
+
+  void RecordTry(const LockKey& key, Mode mode, bool granted);
+  // Removes the calling thread's pending start for `key` in `mode` and returns
+  // its time (0 if the thread has not failed to acquire the lock).
+  uint64_t TakePendingStart(const LockKey& key, Mode mode) const;
+
+  const size_t top_n_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace pg
+}  // namespace tl
@@ -1,5 +1,6 @@
 #include "manager.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -8,15 +9,19 @@
 #include <sstream>
 
 #include "bufmgr/page_memory_allocator.h"
+#include "index_checkpoint.h"
 #include "key.h"
+#include "latency_timer.h"
 #include "persist/merge_iterator.h"
 #include "persist/page.h"
 #include "persist/segment_file.h"
+#include "persist/simulated_ssd.h"
 #include "persist/segment_wrap.h"
 #include "segment_builder.h"
 #include "treeline/pg_db.h"
 #include "treeline/pg_stats.h"
 #include "util/key.h"
+#include "util/numa.h"
 
 namespace fs = std::filesystem;
 
@@ -28,6 +33,284 @@ using PageMode = LockManager::PageMode;
 
 thread_local Workspace Manager::w_;
 const std::string Manager::kSegmentFilePrefix = "sf-";
+const std::string Manager::kIndexCheckpointFile = "INDEX_CHECKPOINT";
+
+namespace {
+
+// The contents of a segment slot in a segment file (read when reopening a
+// database).
+struct SlotContents {
+  enum class Type { kFree, kOverflow, kSegment };
+  Type type;
+  // The segment's key boundaries (the upper boundary is inclusive). Not set for
+  // free slots.
+  Key lower, upper;
+  // Holds the slot's ID, even for free and overflow slots.
+  SegmentInfo sinfo;
+  uint32_t sequence_number;
+};
+
+// Classifies the segment stored in `data` (the contents of the slot `id`).
+SlotContents ClassifySlot(void* data, const size_t pages_per_segment,
+                          const SegmentId id) {
+  SlotContents contents;
+  SegmentWrap sw(data, pages_per_segment);
+  Page first_page(data);
+  if (!sw.CheckChecksum() || !first_page.IsValid()) {
+    // This segment is a "hole" in the file and can be reused.
+    contents.type = SlotContents::Type::kFree;
+    contents.sinfo = SegmentInfo(id, std::optional<plr::Line64>());
+    return contents;
+  }
+
+  contents.lower = sw.EncodedBaseKey();
+  contents.upper = sw.EncodedUpperKey();
+  contents.sequence_number = sw.GetSequenceNumber();
+  if (first_page.IsOverflow()) {
+    contents.type = SlotContents::Type::kOverflow;
+    contents.sinfo = SegmentInfo(id, std::optional<plr::Line64>());
+    return contents;
+  }
+
+  contents.type = SlotContents::Type::kSegment;
+  if (pages_per_segment == 1) {
+    contents.sinfo = SegmentInfo(id, std::optional<plr::Line64>());
+  } else {
+    contents.sinfo = SegmentInfo(id, first_page.GetModel());
+  }
+  // Keep track of whether or not the segment has an overflow.
+  contents.sinfo.SetOverflow(sw.HasOverflow());
+  return contents;
+}
+
+// The slots read by `ScanSegmentFiles()`, grouped by their contents.
+struct ScanResult {
+  std::vector<SlotContents> segments;
+  std::vector<SegmentId> free;
+  // The lower boundaries of the overflow pages.
+  std::vector<Key> overflow_keys;
+};
+
+// The maximum number of pages to read using one I/O when scanning the segment
+// files.
+constexpr size_t kScanReadPages = 64;
+
+// The maximum number of pages in a range of a segment file that is scanned by
+// one background thread.
+constexpr size_t kScanRangePages = 64 * kScanReadPages;
+
+// Reads and classifies each allocated slot in `segment_files` for which
+// `should_read(file_id, seg_idx)` returns true. Consecutive slots are read
+// using one I/O. If `pool` is not null, the files are split into ranges that
+// are scanned in parallel on the pool's threads.
+//
+// The slots in the returned `ScanResult` are ordered by file and offset.
+template <typename ShouldRead>
+ScanResult ScanSegmentFiles(
+    const std::vector<std::unique_ptr<SegmentFile>>& segment_files,
+    const ShouldRead& should_read, ThreadPool* pool) {
+  struct Range {
+    size_t file_id, start_idx, end_idx;
+  };
+  std::vector<Range> ranges;
+  const size_t num_threads = pool != nullptr ? pool->NumThreads() : 1;
+  for (size_t file_id = 0; file_id < segment_files.size(); ++file_id) {
+    const SegmentFile& sf = *segment_files[file_id];
+    const size_t num_segments = sf.NumAllocatedSegments();
+    // Use (at least) a few ranges per thread so that the work is balanced.
+    const size_t range_segments = std::max<size_t>(
+        1, std::min(kScanRangePages / sf.PagesPerSegment(),
+                    num_segments / (num_threads * 4)));
+    for (size_t start = 0; start < num_segments; start += range_segments) {
+      ranges.push_back(
+          Range{file_id, start, std::min(start + range_segments, num_segments)});
+    }
+  }
+
+  std::vector<ScanResult> range_results(ranges.size());
+  const auto scan_range = [&segment_files, &should_read](const Range& range,
+                                                         ScanResult* out) {
+    const SegmentFile& sf = *segment_files[range.file_id];
+    const size_t pages_per_segment = sf.PagesPerSegment();
+    const size_t max_segments_per_read = kScanReadPages / pages_per_segment;
+    PageBuffer buf = PageMemoryAllocator::Allocate(kScanReadPages);
+
+    size_t seg_idx = range.start_idx;
+    while (seg_idx < range.end_idx) {
+      if (!should_read(range.file_id, seg_idx)) {
+        ++seg_idx;
+        continue;
+      }
+      size_t num_to_read = 1;
+      while (num_to_read < max_segments_per_read &&
+             seg_idx + num_to_read < range.end_idx &&
+             should_read(range.file_id, seg_idx + num_to_read)) {
+        ++num_to_read;
+      }
+      sf.ReadPages(seg_idx * pages_per_segment * Page::kSize, buf.get(),
+                   num_to_read * pages_per_segment);
+
+      for (size_t i = 0; i < num_to_read; ++i) {
+        // Offset in `id` is the page offset.
+        const SegmentId id(range.file_id, (seg_idx + i) * pages_per_segment);
+        SlotContents contents =
+            ClassifySlot(buf.get() + i * pages_per_segment * Page::kSize,
+                         pages_per_segment, id);
+        switch (contents.type) {
+          case SlotContents::Type::kFree:
+            out->free.push_back(id);
+            break;
+          case SlotContents::Type::kOverflow:
+            out->overflow_keys.push_back(contents.lower);
+            break;
+          case SlotContents::Type::kSegment:
+            out->segments.push_back(std::move(contents));
+            break;
+        }
+      }
+      seg_idx += num_to_read;
+    }
+  };
+
+  if (pool != nullptr) {
+    Latch ranges_scanned(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      pool->Submit(ranges_scanned,
+                   [&scan_range, &ranges, &range_results, i]() {
+                     scan_range(ranges[i], &range_results[i]);
+                   });
+    }
+    pool->Wait(ranges_scanned);
+  } else {
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      scan_range(ranges[i], &range_results[i]);
+    }
+  }
+
+  // Merge the results (in range order).
+  ScanResult result;
+  for (auto& range_result : range_results) {
+    result.segments.insert(
+        result.segments.end(),
+        std::make_move_iterator(range_result.segments.begin()),
+        std::make_move_iterator(range_result.segments.end()));
+    result.free.insert(result.free.end(), range_result.free.begin(),
+                       range_result.free.end());
+    result.overflow_keys.insert(result.overflow_keys.end(),
+                                range_result.overflow_keys.begin(),
+                                range_result.overflow_keys.end());
+  }
+  return result;
+}
+
+// Rebuilds the segment index and free list from `checkpoint`. Segments that
+// are no longer valid are added to `superseded_out`; they still need to be
+// added to the free list.
+//
+// If the checkpoint was written at shutdown, it is used as-is. Otherwise, it
+// may be stale. While a database with periodic checkpoints is running, a
+// segment that the latest checkpoint considers valid is never overwritten
+// (see `Manager::FreeSegments()`). So every segment written after the
+// checkpoint is stored in a slot that the checkpoint does not consider valid;
+// these are the only slots that need to be read. Checkpointed segments that
+// overlap with segments found this way have been replaced by a reorganization.
+void RecoverFromCheckpoint(
+    const IndexCheckpoint& checkpoint,
+    const std::vector<std::unique_ptr<SegmentFile>>& segment_files,
+    ThreadPool* pool, std::vector<std::pair<Key, SegmentInfo>>* boundaries_out,
+    FreeList* free,
+    std::vector<SegmentId>* superseded_out, uint32_t* next_sequence_out) {
+  // A segment file's allocated size is determined by its last valid segment.
+  // Checkpointed segments past this point are no longer valid (and free
+  // segments past this point are no longer allocated).
+  const auto is_allocated = [&segment_files](const SegmentId id) {
+    if (id.GetFileId() >= segment_files.size()) return false;
+    const auto& sf = segment_files[id.GetFileId()];
+    return id.GetOffset() / sf->PagesPerSegment() < sf->NumAllocatedSegments();
+  };
+
+  if (checkpoint.clean()) {
+    for (const auto& entry : checkpoint.boundaries()) {
+      if (!is_allocated(entry.second.id())) continue;
+      boundaries_out->push_back(entry);
+    }
+    for (const auto& id : checkpoint.free()) {
+      if (!is_allocated(id)) continue;
+      free->Add(id);
+    }
+    *next_sequence_out = checkpoint.next_sequence_number();
+    return;
+  }
+
+  std::vector<std::vector<bool>> is_checkpointed(segment_files.size());
+  for (size_t i = 0; i < segment_files.size(); ++i) {
+    is_checkpointed[i].resize(segment_files[i]->NumAllocatedSegments(), false);
+  }
+  for (const auto& entry : checkpoint.boundaries()) {
+    const SegmentId id = entry.second.id();
+    if (!is_allocated(id)) continue;
+    is_checkpointed[id.GetFileId()]
+                   [id.GetOffset() /
+                    segment_files[id.GetFileId()]->PagesPerSegment()] = true;
+  }
+
+  // Read the slots that may have been written after the checkpoint.
+  ScanResult scanned = ScanSegmentFiles(
+      segment_files,
+      [&is_checkpointed](const size_t file_id, const size_t seg_idx) {
+        return !is_checkpointed[file_id][seg_idx];
+      },
+      pool);
+  free->AddBatch(scanned.free);
+  uint32_t next_sequence = checkpoint.next_sequence_number();
+  for (const auto& contents : scanned.segments) {
+    next_sequence = std::max(next_sequence, contents.sequence_number + 1);
+  }
+  std::vector<SlotContents>& written = scanned.segments;
+  const std::vector<Key>& overflow_keys = scanned.overflow_keys;
+  std::sort(written.begin(), written.end(),
+            [](const SlotContents& left, const SlotContents& right) {
+              return left.lower < right.lower;
+            });
+
+  // Keep the checkpointed segments that were not replaced.
+  for (const auto& entry : checkpoint.boundaries()) {
+    if (!is_allocated(entry.second.id())) continue;
+    auto it = std::upper_bound(
+        written.begin(), written.end(), entry.first,
+        [](const Key key, const SlotContents& contents) {
+          return key < contents.lower;
+        });
+    if (it != written.begin() && entry.first <= std::prev(it)->upper) {
+      superseded_out->push_back(entry.second.id());
+      continue;
+    }
+    boundaries_out->push_back(entry);
+  }
+  for (const auto& contents : written) {
+    boundaries_out->emplace_back(contents.lower, contents.sinfo);
+  }
+  std::sort(boundaries_out->begin(), boundaries_out->end(),
+            [](const std::pair<Key, SegmentInfo>& left,
+               const std::pair<Key, SegmentInfo>& right) {
+              return left.first < right.first;
+            });
+
+  // Overflow pages may have been added to checkpointed segments.
+  for (const Key overflow_key : overflow_keys) {
+    auto it = std::upper_bound(
+        boundaries_out->begin(), boundaries_out->end(), overflow_key,
+        [](const Key key, const std::pair<Key, SegmentInfo>& entry) {
+          return key < entry.first;
+        });
+    if (it == boundaries_out->begin()) continue;
+    std::prev(it)->second.SetOverflow(true);
+  }
+
+  *next_sequence_out = next_sequence;
+}
+
+}  // namespace
 
 Manager::Manager(fs::path db_path,
                  std::vector<std::pair<Key, SegmentInfo>> boundaries,
@@ -35,20 +318,43 @@ Manager::Manager(fs::path db_path,
                  PageGroupedDBOptions options, uint32_t next_sequence_number,
                  std::unique_ptr<FreeList> free)
     : db_path_(std::move(db_path)),
-      lock_manager_(std::make_shared<LockManager>()),
+      lock_manager_(std::make_shared<LockManager>(
+          options.lock_profiling_top_n == 0
+              ? nullptr
+              : std::make_unique<LockProfiler>(options.lock_profiling_top_n))),
       index_(std::make_unique<SegmentIndex>(lock_manager_)),
+      io_tracer_(options.io_trace_path.empty()
+                     ? nullptr
+                     : std::make_unique<IOTracer>(options.io_trace_path)),
       segment_files_(std::move(segment_files)),
       next_sequence_number_(next_sequence_number),
       free_(std::move(free)),
+      checkpoint_(std::make_unique<CheckpointState>()),
+      snapshot_(options.snapshot_scans ? std::make_unique<SnapshotState>()
+                                       : nullptr),
       options_(std::move(options)) {
   if (!boundaries.empty()) {
     index_->BulkLoadFromEmpty(boundaries.begin(), boundaries.end());
+    InitKeyRangeStats();
+  }
+  if (io_tracer_ != nullptr) {
+    for (size_t file_id = 0; file_id < segment_files_.size(); ++file_id) {
+      segment_files_[file_id]->SetTracer(io_tracer_.get(), file_id);
+    }
   }
   if (options_.num_bg_threads > 0) {
-    bg_threads_ = std::make_unique<ThreadPool>(options_.num_bg_threads, []() {
+    const auto post_stats = []() {
       // Make sure all locally recorded stats are exposed.
       PageGroupedDBStats::Local().PostToGlobal();
-    });
+    };
+    if (options_.numa_aware && numa::NumNodes() > 1) {
+      bg_threads_ = std::make_unique<ThreadPool>(
+          options_.num_bg_threads,
+          numa::SpreadAcrossNodes(options_.num_bg_threads), post_stats);
+    } else {
+      bg_threads_ =
+          std::make_unique<ThreadPool>(options_.num_bg_threads, post_stats);
+    }
   }
 }
 
@@ -66,69 +372,95 @@ Manager Manager::LoadIntoNew(const fs::path& db,
 
 Manager Manager::Reopen(const fs::path& db,
                         const PageGroupedDBOptions& options) {
-  // Figure out if there are segments in this DB.
-  const bool uses_segments = fs::exists(db / (kSegmentFilePrefix + "1"));
-  PageBuffer buf = PageMemoryAllocator::Allocate(
-      /*num_pages=*/SegmentBuilder::SegmentPageCounts().back());
-  Page first_page(buf.get());
+  // Load the index checkpoint, if there is one.
+  const fs::path checkpoint_file = db / kIndexCheckpointFile;
+  std::optional<IndexCheckpoint> checkpoint;
+  if (options.index_checkpoint && fs::exists(checkpoint_file)) {
+    Status status;
+    checkpoint = IndexCheckpoint::LoadFrom(checkpoint_file, &status);
+  }
+  // A checkpoint that becomes stale must be durably removed before the
+  // database is modified; otherwise it could be trusted after a crash.
+  const auto remove_checkpoint = [&checkpoint_file]() {
+    const Status status = IndexCheckpoint::Remove(checkpoint_file);
+    if (!status.ok()) {
+      throw std::runtime_error(status.ToString());
+    }
+  };
+  if (checkpoint.has_value() && options.index_checkpoint_interval > 0) {
+    // The checkpoint stays valid while the database runs (see
+    // `FreeSegments()`), but it no longer describes the segments exactly.
+    if (checkpoint->clean() &&
+        !IndexCheckpoint::MarkDirty(checkpoint_file).ok()) {
+      checkpoint.reset();
+      remove_checkpoint();
+    }
+  } else {
+    // The checkpoint becomes stale once the database is modified.
+    remove_checkpoint();
+  }
 
+  // Figure out if there are segments in this DB.
+  const bool uses_segments = SegmentFileExists(db, /*file_idx=*/1, options);
   std::vector<std::unique_ptr<SegmentFile>> segment_files;
-  std::vector<std::pair<Key, SegmentInfo>> segment_boundaries;
-  std::unique_ptr<FreeList> free = std::make_unique<FreeList>();
-  uint32_t max_sequence = 0;
-
   for (size_t i = 0; i < SegmentBuilder::SegmentPageCounts().size(); ++i) {
     if (i > 0 && !uses_segments) break;
-    const size_t pages_per_segment = SegmentBuilder::SegmentPageCounts()[i];
-    segment_files.push_back(std::make_unique<SegmentFile>(
-        db / (kSegmentFilePrefix + std::to_string(i)), pages_per_segment,
-        options.use_memory_based_io));
-    std::unique_ptr<SegmentFile>& sf = segment_files.back();
-
-    const size_t num_segments = sf->NumAllocatedSegments();
-    const size_t bytes_per_segment = pages_per_segment * Page::kSize;
-    for (size_t seg_idx = 0; seg_idx < num_segments; ++seg_idx) {
-      // Offset in `id` is the page offset.
-      SegmentId id(i, seg_idx * pages_per_segment);
-      sf->ReadPages(seg_idx * bytes_per_segment, buf.get(), pages_per_segment);
-
-      SegmentWrap sw(buf.get(), pages_per_segment);
-      if (!sw.CheckChecksum() || !first_page.IsValid()) {
-        // This segment is a "hole" in the file and can be reused.
-        free->Add(id);
-        continue;
-      }
-      if (first_page.IsOverflow()) {
-        continue;
-      }
+    segment_files.push_back(OpenSegmentFile(db, i, options));
+  }
 
-      const Key base_key =
-          key_utils::ExtractHead64(first_page.GetLowerBoundary());
-      if (pages_per_segment == 1) {
-        segment_boundaries.emplace_back(
-            base_key, SegmentInfo(id, std::optional<plr::Line64>()));
-      } else {
-        segment_boundaries.emplace_back(base_key,
-                                        SegmentInfo(id, first_page.GetModel()));
-      }
+  // The segment files are scanned in parallel using a temporary thread pool
+  // (the background threads are only created along with the `Manager`).
+  std::unique_ptr<ThreadPool> scan_threads;
+  if (options.num_bg_threads > 0) {
+    scan_threads = std::make_unique<ThreadPool>(options.num_bg_threads);
+  }
+
+  std::vector<std::pair<Key, SegmentInfo>> segment_boundaries;
+  std::unique_ptr<FreeList> free = std::make_unique<FreeList>();
+  std::vector<SegmentId> superseded;
+  uint32_t next_sequence = 0;
 
-      // Extract the sequence number.
-      max_sequence = std::max(max_sequence, sw.GetSequenceNumber());
+  if (checkpoint.has_value() &&
+      checkpoint->allocated_segments().size() == segment_files.size()) {
+    RecoverFromCheckpoint(*checkpoint, segment_files, scan_threads.get(),
+                          &segment_boundaries, free.get(), &superseded,
+                          &next_sequence);
 
-      // Keep track of whether or not the segment has an overflow.
-      segment_boundaries.back().second.SetOverflow(sw.HasOverflow());
+  } else {
+    const ScanResult scanned = ScanSegmentFiles(
+        segment_files, [](size_t, size_t) { return true; },
+        scan_threads.get());
+    free->AddBatch(scanned.free);
+
+    uint32_t max_sequence = 0;
+    segment_boundaries.reserve(scanned.segments.size());
+    for (const auto& contents : scanned.segments) {
+      segment_boundaries.emplace_back(contents.lower, contents.sinfo);
+      max_sequence = std::max(max_sequence, contents.sequence_number);
     }
+    next_sequence = max_sequence + 1;
+
+    std::sort(segment_boundaries.begin(), segment_boundaries.end(),
+              [](const std::pair<Key, SegmentInfo>& left,
+                 const std::pair<Key, SegmentInfo>& right) {
+                return left.first < right.first;
+              });
   }
+  scan_threads.reset();
 
-  std::sort(segment_boundaries.begin(), segment_boundaries.end(),
-            [](const std::pair<Key, SegmentInfo>& left,
-               const std::pair<Key, SegmentInfo>& right) {
-              return left.first < right.first;
-            });
+  Manager m(db, std::move(segment_boundaries), std::move(segment_files),
+            options, next_sequence, std::move(free));
+  m.FreeSegments(superseded);
+  return m;
+}
 
-  return Manager(db, std::move(segment_boundaries), std::move(segment_files),
-                 options, /*next_segment_index=*/max_sequence + 1,
-                 std::move(free));
+Manager::~Manager() {
+  // No scans can be running at this point.
+  if (snapshot_ != nullptr) ReclaimRetiredSegments();
+  // A moved-from `Manager` has no state.
+  if (checkpoint_ == nullptr || !options_.index_checkpoint) return;
+  std::unique_lock<std::mutex> lock(checkpoint_->write_mutex);
+  WriteIndexCheckpoint(/*clean=*/true);
 }
 
 void Manager::SetTracker(std::shared_ptr<InsertTracker> tracker) {
@@ -140,53 +472,64 @@ Status Manager::Get(const Key& key, std::string* value_out) {
 }
 
 std::pair<Status, std::vector<pg::Page>> Manager::GetWithPages(
-    const Key& key, std::string* value_out) {
-  void* main_page_buf = w_.buffer().get();
-  void* overflow_page_buf = w_.buffer().get() + pg::Page::kSize;
+    const Key& key, std::string* value_out, const PagesReadFn& on_pages_read) {
+  IOCauseScope io_cause(IOCause::kGet);
+  void* main_page_buf = WorkspaceBuffer();
+  void* overflow_page_buf = WorkspaceBuffer() + pg::Page::kSize;
 
   // 1. Find the segment that should hold the key.
+  PhaseTimer timer(PhaseTimer::Phase::kGetIndexLookup);
   const auto seg = index_->SegmentForKeyWithLock(key, SegmentMode::kPageRead);
 
   // 2. Figure out the page offset, lock the page, and then read it in.
   const size_t page_idx = seg.sinfo.PageForKey(seg.lower, key);
+  timer.Next(PhaseTimer::Phase::kGetPageLock);
   lock_manager_->AcquirePageLock(seg.sinfo.id(), page_idx, PageMode::kShared);
+  const auto finish = [&](Status status, std::vector<pg::Page> pages) {
+    if (on_pages_read) on_pages_read(status, pages);
+    lock_manager_->ReleasePageLock(seg.sinfo.id(), page_idx, PageMode::kShared);
+    lock_manager_->ReleaseSegmentLock(seg.sinfo.id(), SegmentMode::kPageRead);
+    return std::make_pair(std::move(status), std::move(pages));
+  };
+  timer.Next(PhaseTimer::Phase::kGetPageRead);
   ReadPage(seg.sinfo.id(), page_idx, main_page_buf);
 
   // 3. Search for the record on the page.
+  timer.Next(PhaseTimer::Phase::kGetPageSearch);
   pg::Page main_page(main_page_buf);
   key_utils::IntKeyAsSlice key_slice(key);
   auto status = main_page.Get(key_slice.as<Slice>(), value_out);
+  timer.Stop();
   if (status.ok()) {
-    lock_manager_->ReleasePageLock(seg.sinfo.id(), page_idx, PageMode::kShared);
-    lock_manager_->ReleaseSegmentLock(seg.sinfo.id(), SegmentMode::kPageRead);
-    return {status, {main_page}};
+    return finish(status, {main_page});
   }
 
   // 4. Check the overflow page if it exists.
   // TODO: We always assume at most 1 overflow page.
   if (!main_page.HasOverflow()) {
-    lock_manager_->ReleasePageLock(seg.sinfo.id(), page_idx, PageMode::kShared);
-    lock_manager_->ReleaseSegmentLock(seg.sinfo.id(), SegmentMode::kPageRead);
-    return {Status::NotFound("Record does not exist."), {main_page}};
+    return finish(Status::NotFound("Record does not exist."), {main_page});
   }
   const SegmentId overflow_id = main_page.GetOverflow();
   // All overflow pages are single pages.
   assert(overflow_id.GetFileId() == 0);
+  timer.Next(PhaseTimer::Phase::kGetPageRead);
   ReadPage(overflow_id, /*page_idx=*/0, overflow_page_buf);
+  timer.Next(PhaseTimer::Phase::kGetPageSearch);
   pg::Page overflow_page(overflow_page_buf);
   status = overflow_page.Get(key_slice.as<Slice>(), value_out);
+  timer.Stop();
 
-  lock_manager_->ReleasePageLock(seg.sinfo.id(), page_idx, PageMode::kShared);
-  lock_manager_->ReleaseSegmentLock(seg.sinfo.id(), SegmentMode::kPageRead);
-  return {status, {main_page, overflow_page}};
+  return finish(status, {main_page, overflow_page});
 }
 
 Status Manager::PutBatch(const std::vector<std::pair<Key, Slice>>& records) {
+  PhaseTimer timer(PhaseTimer::Phase::kWriteout);
   return PutBatchImpl(records, 0, records.size());
 }
 
 Status Manager::PutBatchImpl(const std::vector<std::pair<Key, Slice>>& records,
                              const size_t start_idx, const size_t end_idx) {
+  IOCauseScope io_cause(IOCause::kWriteout);
   static constexpr size_t kMaxAttempts = 1000;
 
   if (start_idx >= end_idx) return Status::OK();
@@ -234,19 +577,29 @@ Status Manager::PutBatchImpl(const std::vector<std::pair<Key, Slice>>& records,
   return Status::OK();
 }
 
+std::future<void> Manager::RunInBackground(std::function<void()> task) {
+  if (bg_threads_ == nullptr) {
+    std::promise<void> done;
+    task();
+    done.set_value();
+    return done.get_future();
+  }
+  return bg_threads_->Submit(std::move(task));
+}
+
 Status Manager::PutBatchParallel(
     const std::vector<std::pair<Key, Slice>>& records) {
+  PhaseTimer timer(PhaseTimer::Phase::kWriteout);
   if (bg_threads_ == nullptr) {
     // No background workers available; just fall back to a synchronous write.
     return PutBatchImpl(records, 0, records.size());
   }
 
   // TODO: Support deletes.
-  // TODO: This parallelization strategy can lead to a synchronization deadlock
-  // if `PutBatchImpl()` requires a reorg. This is because the segment rewrite
-  // logic uses background threads to issue I/O in parallel, which shares the
-  // same thread pool.
-  std::vector<std::future<void>> write_futures;
+  // NOTE: `PutBatchImpl()` may need to run a reorg, which also issues I/O on
+  // the background threads. This does not deadlock because pool threads run
+  // other tasks while they wait (see `ThreadPool::Wait()`).
+  std::vector<std::pair<size_t, size_t>> ranges;
   size_t left_idx = 0;
   while (left_idx < records.size()) {
     const auto [_, upper] = GetPageBoundsFor(records[left_idx].first);
@@ -257,22 +610,92 @@ Status Manager::PutBatchParallel(
                            return rec.first < next_page_start;
                          });
     const size_t range_size = cutoff_it - left_it;
-    write_futures.push_back(bg_threads_->Submit(
-        [this, &records, start = left_idx, end = left_idx + range_size]() {
-          PutBatchImpl(records, start, end);
-        }));
+    ranges.emplace_back(left_idx, left_idx + range_size);
     left_idx += range_size;
   }
 
-  // Wait for the writes to complete.
-  for (auto& f : write_futures) {
-    f.get();
+  Latch writes_done(ranges.size());
+  for (const auto& [start, end] : ranges) {
+    bg_threads_->Submit(writes_done,
+                        [this, &records, start = start, end = end]() {
+                          PutBatchImpl(records, start, end);
+                        });
   }
 
+  // Wait for the writes to complete.
+  bg_threads_->Wait(writes_done);
+
   // `PutBatchImpl()` always returns this.
   return Status::OK();
 }
 
+Status Manager::GetBatchParallel(
+    const std::vector<Key>& keys,
+    std::vector<std::pair<Key, std::string>>* records_out) {
+  if (bg_threads_ == nullptr) {
+    GetBatchImpl(keys, 0, keys.size(), records_out);
+    return Status::OK();
+  }
+
+  // Split the keys into contiguous chunks (a few per background thread, to
+  // balance the load).
+  static constexpr size_t kChunksPerThread = 4;
+  const size_t num_chunks = options_.num_bg_threads * kChunksPerThread;
+  const size_t chunk_size = std::max<size_t>(
+      1, (keys.size() + num_chunks - 1) / num_chunks);
+  std::vector<std::vector<std::pair<Key, std::string>>> chunk_records(
+      (keys.size() + chunk_size - 1) / chunk_size);
+  Latch reads_done(chunk_records.size());
+  for (size_t i = 0; i < chunk_records.size(); ++i) {
+    const size_t start = i * chunk_size;
+    const size_t end = std::min(start + chunk_size, keys.size());
+    bg_threads_->Submit(reads_done,
+                        [this, &keys, start, end, out = &chunk_records[i]]() {
+                          GetBatchImpl(keys, start, end, out);
+                        });
+  }
+  bg_threads_->Wait(reads_done);
+
+  for (auto& chunk : chunk_records) {
+    for (auto& record : chunk) {
+      records_out->push_back(std::move(record));
+    }
+  }
+  return Status::OK();
+}
+
+void Manager::GetBatchImpl(
+    const std::vector<Key>& keys, const size_t start_idx, const size_t end_idx,
+    std::vector<std::pair<Key, std::string>>* records_out) {
+  std::string value;
+  size_t idx = start_idx;
+  while (idx < end_idx) {
+    auto [status, pages] = GetWithPages(keys[idx], &value);
+    if (status.ok()) records_out->emplace_back(keys[idx], value);
+    ++idx;
+
+    // Serve the following keys using the same page(s), if possible. The page
+    // fences are inclusive.
+    const bool read_all_pages = pages.size() > 1 || !pages[0].HasOverflow();
+    const Key page_upper =
+        key_utils::ExtractHead64(pages[0].GetUpperBoundary());
+    while (idx < end_idx && keys[idx] <= page_upper) {
+      const key_utils::IntKeyAsSlice key_slice(keys[idx]);
+      bool found = false;
+      for (auto& page : pages) {
+        if (page.Get(key_slice.as<Slice>(), &value).ok()) {
+          found = true;
+          break;
+        }
+      }
+      // The record may be on an overflow page that we did not read.
+      if (!found && !read_all_pages) break;
+      if (found) records_out->emplace_back(keys[idx], value);
+      ++idx;
+    }
+  }
+}
+
 size_t Manager::WriteToSegment(
     const SegmentIndex::Entry& segment,
     const std::vector<std::pair<Key, Slice>>& records, const size_t start_idx,
@@ -305,8 +728,8 @@ size_t Manager::WriteToSegment(
     return status.ok() ? (end_idx - start_idx) : 0;
   }
 
-  void* orig_page_buf = w_.buffer().get();
-  void* overflow_page_buf = w_.buffer().get() + pg::Page::kSize;
+  void* orig_page_buf = WorkspaceBuffer();
+  void* overflow_page_buf = WorkspaceBuffer() + pg::Page::kSize;
   pg::Page orig_page(orig_page_buf);
   pg::Page overflow_page(overflow_page_buf);
 
@@ -324,9 +747,17 @@ size_t Manager::WriteToSegment(
     // Write out overflow first to avoid dangling overflow pointers.
     if (overflow_page_dirty) {
       WritePage(overflow_page_id, 0, overflow_page_buf);
+      if (key_range_stats_ != nullptr) {
+        key_range_stats_->RecordPageWrites(
+            segment_base, KeyRangeStats::PageWrite::kOverflow, 1);
+      }
     }
     if (curr_page_dirty) {
       WritePage(sinfo.id(), curr_page_idx, orig_page_buf);
+      if (key_range_stats_ != nullptr) {
+        key_range_stats_->RecordPageWrites(
+            segment_base, KeyRangeStats::PageWrite::kWriteout, 1);
+      }
     }
   };
   auto write_record_to_chain = [&](Key key, const Slice& value) {
@@ -456,6 +887,7 @@ void Manager::ReadPage(const SegmentId& seg_id, size_t page_idx,
   sf->ReadPages((seg_id.GetOffset() + page_idx) * pg::Page::kSize, buffer,
                 /*num_pages=*/1);
   w_.BumpReadCount(1);
+  SampleBufferAccess(buffer);
 }
 
 void Manager::WritePage(const SegmentId& seg_id, size_t page_idx,
@@ -470,23 +902,30 @@ void Manager::WritePage(const SegmentId& seg_id, size_t page_idx,
 void Manager::ReadSegment(const SegmentId& seg_id) const {
   assert(seg_id.IsValid());
   const std::unique_ptr<SegmentFile>& sf = segment_files_[seg_id.GetFileId()];
-  sf->ReadPages(seg_id.GetOffset() * pg::Page::kSize, w_.buffer().get(),
+  sf->ReadPages(seg_id.GetOffset() * pg::Page::kSize, WorkspaceBuffer(),
                 sf->PagesPerSegment());
   w_.BumpReadCount(sf->PagesPerSegment());
+  SampleBufferAccess(WorkspaceBuffer());
+}
+
+void Manager::SampleBufferAccess(const void* buffer) const {
+  if (!options_.numa_aware || !numa::ShouldSampleAccess()) return;
+  const std::optional<bool> is_local = numa::IsLocal(buffer);
+  if (is_local.has_value()) {
+    PageGroupedDBStats::Local().BumpNumaAccesses(*is_local);
+  }
 }
 
 void Manager::ReadOverflows(
     const std::vector<std::pair<SegmentId, void*>>& overflows_to_read) const {
   if (bg_threads_ != nullptr) {
-    std::vector<std::future<void>> futures;
-    futures.reserve(overflows_to_read.size());
+    Latch reads_done(overflows_to_read.size());
     for (const auto& otr : overflows_to_read) {
-      futures.push_back(bg_threads_->Submit(
-          [this, otr]() { ReadPage(otr.first, 0, otr.second); }));
-    }
-    for (auto& f : futures) {
-      f.get();
+      bg_threads_->Submit(reads_done, WithIOCause([this, otr]() {
+                            ReadPage(otr.first, 0, otr.second);
+                          }));
     }
+    bg_threads_->Wait(reads_done);
 
   } else {
     for (const auto& otr : overflows_to_read) {
@@ -528,6 +967,186 @@ std::pair<Key, Key> Manager::GetPageBoundsFor(const Key key) const {
   return {lower_bound, upper_bound};
 }
 
+void Manager::FreeSegments(const std::vector<SegmentId>& ids) {
+  if (ids.empty()) return;
+  if (snapshot_ == nullptr) {
+    ReleaseSegments(ids);
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(snapshot_->retired_mutex);
+    snapshot_->retired.emplace_back(snapshot_->epochs.Retire(), ids);
+  }
+  ReclaimRetiredSegments();
+}
+
+void Manager::ReclaimRetiredSegments() {
+  std::vector<SegmentId> reclaimed;
+  {
+    const EpochManager::Epoch min_active = snapshot_->epochs.MinActiveEpoch();
+    std::unique_lock<std::mutex> lock(snapshot_->retired_mutex);
+    auto& retired = snapshot_->retired;
+    while (!retired.empty() && retired.front().first < min_active) {
+      reclaimed.insert(reclaimed.end(), retired.front().second.begin(),
+                       retired.front().second.end());
+      retired.pop_front();
+    }
+  }
+  ReleaseSegments(reclaimed);
+}
+
+void Manager::InvalidatePage(const SegmentId& seg_id, void* zero) {
+  if (snapshot_ == nullptr) {
+    WritePage(seg_id, 0, zero);
+    return;
+  }
+  lock_manager_->AcquirePageLock(seg_id, 0, PageMode::kExclusive);
+  WritePage(seg_id, 0, zero);
+  lock_manager_->ReleasePageLock(seg_id, 0, PageMode::kExclusive);
+}
+
+void Manager::ReleaseSegments(const std::vector<SegmentId>& ids) {
+  if (ids.empty()) return;
+  if (options_.index_checkpoint && options_.index_checkpoint_interval > 0) {
+    std::unique_lock<std::mutex> lock(checkpoint_->pending_mutex);
+    checkpoint_->pending_free.insert(checkpoint_->pending_free.end(),
+                                     ids.begin(), ids.end());
+    return;
+  }
+  free_->AddBatch(ids);
+}
+
+void Manager::MaybeWriteIndexCheckpoint() {
+  if (!options_.index_checkpoint || options_.index_checkpoint_interval == 0) {
+    return;
+  }
+  const size_t reorgs = checkpoint_->reorgs_since_checkpoint.fetch_add(1) + 1;
+  if (reorgs < options_.index_checkpoint_interval) return;
+
+  std::unique_lock<std::mutex> lock(checkpoint_->write_mutex,
+                                    std::try_to_lock);
+  if (!lock.owns_lock()) {
+    // Another thread is already writing a checkpoint.
+    return;
+  }
+  checkpoint_->reorgs_since_checkpoint.store(0);
+  // If the write fails, the previous checkpoint is still valid (the segments
+  // freed since then are not released).
+  WriteIndexCheckpoint(/*clean=*/false);
+}
+
+Status Manager::WriteIndexCheckpoint(const bool clean) {
+  std::vector<SegmentId> released;
+  {
+    std::unique_lock<std::mutex> lock(checkpoint_->pending_mutex);
+    released.swap(checkpoint_->pending_free);
+  }
+
+  // NOTE: Segments that are allocated after the file sizes are recorded, or
+  // that are added to the index after it is copied, are not considered valid
+  // by the checkpoint. So they are read when validating the checkpoint.
+  std::vector<size_t> allocated_segments;
+  allocated_segments.reserve(segment_files_.size());
+  for (const auto& sf : segment_files_) {
+    allocated_segments.push_back(sf->NumAllocatedSegments());
+  }
+  std::vector<std::pair<Key, SegmentInfo>> boundaries =
+      index_->GetAllEntries();
+  std::vector<SegmentId> free = free_->GetAll();
+  free.insert(free.end(), released.begin(), released.end());
+
+  const IndexCheckpoint checkpoint(next_sequence_number_,
+                                   std::move(allocated_segments),
+                                   std::move(boundaries), std::move(free),
+                                   clean);
+  const Status status = checkpoint.WriteTo(db_path_ / kIndexCheckpointFile);
+  if (!status.ok()) {
+    std::unique_lock<std::mutex> lock(checkpoint_->pending_mutex);
+    checkpoint_->pending_free.insert(checkpoint_->pending_free.end(),
+                                     released.begin(), released.end());
+    return status;
+  }
+
+  // The new checkpoint considers these segments free, so they can be reused.
+  free_->AddBatch(released);
+  return Status::OK();
+}
+
+void Manager::GetSegmentStats(PageGroupedDBLiveStats* stats) const {
+  stats->segment_page_counts = SegmentBuilder::SegmentPageCounts();
+  stats->segments_by_size.assign(stats->segment_page_counts.size(), 0);
+  stats->overflowed_segments = 0;
+  stats->reorg_backlog_pages = 0;
+  const auto& size_classes = SegmentBuilder::PageCountToSegment();
+  index_->RunShared([stats, &size_classes](const auto& index) {
+    for (const auto& [base_key, sinfo] : index) {
+      ++stats->segments_by_size[size_classes.at(sinfo.page_count())];
+      if (sinfo.HasOverflow()) {
+        ++stats->overflowed_segments;
+        stats->reorg_backlog_pages += sinfo.page_count();
+      }
+    }
+  });
+  stats->free_list_entries = free_->GetNumEntries();
+  stats->free_list_bytes = free_->GetSizeFootprint();
+}
+
+void Manager::InitKeyRangeStats() {
+  if (options_.key_range_stats_buckets == 0) return;
+  std::vector<Key> segment_bounds;
+  index_->RunShared([&segment_bounds](const auto& index) {
+    segment_bounds.reserve(index.size());
+    for (const auto& entry : index) {
+      segment_bounds.push_back(entry.first);
+    }
+  });
+  if (segment_bounds.empty()) return;
+  key_range_stats_ = std::make_unique<KeyRangeStats>(
+      KeyRangeStats::ChooseBounds(segment_bounds,
+                                  options_.key_range_stats_buckets));
+}
+
+bool Manager::GetKeyRangeStats(
+    std::vector<PageGroupedDBKeyRangeStats>* stats_out) const {
+  if (key_range_stats_ == nullptr) return false;
+  key_range_stats_->GetStats(stats_out);
+  return true;
+}
+
+std::unique_ptr<SegmentFile> Manager::OpenSegmentFile(
+    const fs::path& db, const size_t file_idx,
+    const PageGroupedDBOptions& options) {
+  const fs::path path = db / (kSegmentFilePrefix + std::to_string(file_idx));
+  const size_t pages_per_segment =
+      SegmentBuilder::SegmentPageCounts()[file_idx];
+  if (options.simulated_ssd != nullptr) {
+    auto* device = static_cast<SimulatedSSDImpl*>(options.simulated_ssd.get());
+    return std::make_unique<SegmentFile>(device->OpenFile(path.string()),
+                                         pages_per_segment);
+  }
+  return std::make_unique<SegmentFile>(path, pages_per_segment,
+                                       options.use_memory_based_io);
+}
+
+bool Manager::SegmentFileExists(const fs::path& db, const size_t file_idx,
+                                const PageGroupedDBOptions& options) {
+  const fs::path path = db / (kSegmentFilePrefix + std::to_string(file_idx));
+  if (options.simulated_ssd != nullptr) {
+    const auto* device =
+        static_cast<const SimulatedSSDImpl*>(options.simulated_ssd.get());
+    return device->FileExists(path.string());
+  }
+  return fs::exists(path);
+}
+
+bool Manager::GetLockContentionStats(
+    PageGroupedDBLockContentionStats* stats_out) const {
+  const LockProfiler* profiler = lock_manager_->profiler();
+  if (profiler == nullptr) return false;
+  profiler->GetStats(stats_out);
+  return true;
+}
+
 void Manager::PostStats() const {
   PageGroupedDBStats::Local().SetFreeListBytes(free_->GetSizeFootprint());
   PageGroupedDBStats::Local().SetFreeListEntries(free_->GetNumEntries());
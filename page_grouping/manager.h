@@ -1,22 +1,32 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <limits>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "free_list.h"
 #include "key.h"
+#include "key_range_stats.h"
+#include "latency_timer.h"
 #include "treeline/pg_options.h"
+#include "treeline/pg_stats.h"
 #include "treeline/slice.h"
 #include "treeline/status.h"
 #include "lock_manager.h"
+#include "persist/io_trace.h"
 #include "persist/page.h"
 #include "persist/segment_file.h"
 #include "segment_index.h"
 #include "segment_info.h"
+#include "util/epoch_manager.h"
 #include "util/insert_tracker.h"
 #include "util/thread_pool.h"
 #include "workspace.h"
@@ -36,9 +46,28 @@ class Manager {
                              const std::vector<std::pair<Key, Slice>>& records,
                              const PageGroupedDBOptions& options);
 
+  // Reopens an existing database. If `options.index_checkpoint` is true and
+  // the database has an index checkpoint, the segment index is loaded from the
+  // checkpoint. If the checkpoint was not written at shutdown (i.e., the
+  // database crashed), only the segments that may have been written after the
+  // checkpoint are read to validate it. Otherwise, every segment on disk is
+  // read to rebuild the index.
   static Manager Reopen(const std::filesystem::path& db,
                         const PageGroupedDBOptions& options);
 
+  // Opens (or creates) the database's segment file that holds the segments in
+  // `SegmentBuilder::SegmentPageCounts()[file_idx]`. The file is stored on
+  // `options.simulated_ssd` if it is set. The database must not be open.
+  static std::unique_ptr<SegmentFile> OpenSegmentFile(
+      const std::filesystem::path& db, size_t file_idx,
+      const PageGroupedDBOptions& options);
+  static bool SegmentFileExists(const std::filesystem::path& db,
+                                size_t file_idx,
+                                const PageGroupedDBOptions& options);
+
+  // Writes out an index checkpoint if `options.index_checkpoint` is true.
+  ~Manager();
+
   void SetTracker(std::shared_ptr<InsertTracker> tracker);
 
   Status Get(const Key& key, std::string* value_out);
@@ -48,8 +77,23 @@ class Manager {
   //
   // Callers should not store the returned `Page`s because their backing memory
   // is only valid until the next call to a `Manager` method.
-  std::pair<Status, std::vector<pg::Page>> GetWithPages(const Key& key,
-                                                        std::string* value_out);
+  //
+  // If provided, `on_pages_read` is called with the lookup's status and the
+  // page(s) before their locks are released. Writes to the pages (e.g., record
+  // cache write backs) are ordered after the callback.
+  using PagesReadFn = std::function<void(
+      const Status& status, const std::vector<pg::Page>& pages)>;
+  std::pair<Status, std::vector<pg::Page>> GetWithPages(
+      const Key& key, std::string* value_out,
+      const PagesReadFn& on_pages_read = nullptr);
+
+  // Reads the records with the given keys and appends the ones that exist to
+  // `records_out` (in ascending key order). Keys that fall on the same page
+  // are served using one page read, and the reads are issued in parallel
+  // using the background threads (if available).
+  // Pre-condition: `keys` is sorted in ascending order.
+  Status GetBatchParallel(const std::vector<Key>& keys,
+                          std::vector<std::pair<Key, std::string>>* records_out);
 
   // Pre-condition: The batch is sorted in ascending order by key.
   Status PutBatch(const std::vector<std::pair<Key, Slice>>& records);
@@ -72,11 +116,58 @@ class Manager {
       const Key& start_key, const size_t amount,
       std::vector<std::pair<Key, std::string>>* values_out);
 
+  // Does not acquire segment locks, so it does not block reorganizations (or
+  // the writers waiting on them). Only available if
+  // `PageGroupedDBOptions::snapshot_scans` is true.
+  Status ScanSnapshot(const Key& start_key, const size_t amount,
+                      std::vector<std::pair<Key, std::string>>* values_out);
+
+  // Prefetches the segments it expects to read using the background threads
+  // (if there are none, this falls back to `ScanWithEstimates()`). The
+  // prefetched segments stay locked until they have been scanned, so this scan
+  // can run concurrently with writes. The prefetch window is sized from the
+  // number of records left to scan and the number of records per page observed
+  // so far, and is limited by the size of this thread's prefetch buffer.
+  Status ScanWithPrefetching(
+      const Key& start_key, const size_t amount,
+      std::vector<std::pair<Key, std::string>>* values_out);
+
   Status Scan(const Key& start_key, const size_t amount,
               std::vector<std::pair<Key, std::string>>* values_out) {
+    PhaseTimer timer(PhaseTimer::Phase::kScan);
+    if (snapshot_ != nullptr) {
+      return ScanSnapshot(start_key, amount, values_out);
+    }
+    if (options_.prefetch_scans) {
+      return ScanWithPrefetching(start_key, amount, values_out);
+    }
     return ScanWithEstimates(start_key, amount, values_out);
   }
 
+  // Used by `ParallelScan()`. `ScanBatchFn` is called with a batch of records
+  // (sorted by key) and the key range [lower, upper) that the batch covers.
+  using ScanBatchFn = std::function<void(
+      Key lower, Key upper, std::vector<std::pair<Key, std::string>>* batch)>;
+  using ScanDeliverFn =
+      std::function<void(std::vector<std::pair<Key, std::string>> batch)>;
+
+  // Scans the records in [start_key, end_key) using up to `num_threads`
+  // threads (the calling thread is one of them). The range is split into
+  // partitions along segment boundaries and the threads scan the partitions
+  // independently, one segment at a time. While a thread processes a segment,
+  // the next segment in its partition is read on the background threads (if
+  // available).
+  //
+  // Each batch is passed to `prepare` (if set) on the thread that read it and
+  // is then passed to `deliver` if it is non-empty. If `ordered` is true, the
+  // batches are delivered in ascending key order and `deliver` is never called
+  // concurrently. Otherwise `deliver` is called concurrently, as soon as each
+  // batch is ready.
+  Status ParallelScan(const Key start_key, const Key end_key,
+                      const size_t num_threads, const bool ordered,
+                      const ScanDeliverFn& deliver,
+                      const ScanBatchFn& prepare = nullptr);
+
   // Returns the boundaries of the page on which `key` should be stored.
   // The lower bound is inclusive and the upper bound is exclusive.
   std::pair<Key, Key> GetPageBoundsFor(const Key key) const;
@@ -92,6 +183,34 @@ class Manager {
   }
   void PostStats() const;
 
+  // Runs `task` on one of the background threads, or on the calling thread if
+  // there are none (see `PageGroupedDBOptions::num_bg_threads`). The returned
+  // future becomes ready once `task` has run.
+  std::future<void> RunInBackground(std::function<void()> task);
+
+  // Fills in the segment and free list fields of `stats` using the current
+  // state of the index and free list. This takes time linear in the number of
+  // segments, but does not block any operations other than reorganizations.
+  void GetSegmentStats(PageGroupedDBLiveStats* stats) const;
+
+  // Records a user write of `bytes` bytes to `key` in the per key range
+  // statistics (see `PageGroupedDBOptions::key_range_stats_buckets`). Genuine
+  // inserts should be added to the insert tracker (if there is one) first.
+  void RecordUserWrite(Key key, size_t bytes, bool is_insert) {
+    if (key_range_stats_ == nullptr) return;
+    key_range_stats_->RecordUserWrite(key, bytes, is_insert, tracker_.get());
+  }
+
+  // Retrieves the per key range statistics. Returns false if they are not
+  // being tracked.
+  bool GetKeyRangeStats(
+      std::vector<PageGroupedDBKeyRangeStats>* stats_out) const;
+
+  // Retrieves the lock contention statistics. Returns false if lock profiling
+  // is disabled.
+  bool GetLockContentionStats(
+      PageGroupedDBLockContentionStats* stats_out) const;
+
   Manager(const Manager&) = delete;
   Manager& operator=(const Manager&) = delete;
 
@@ -124,6 +243,9 @@ class Manager {
 
   Status PutBatchImpl(const std::vector<std::pair<Key, Slice>>& records,
                       size_t start_idx, size_t end_idx);
+  void GetBatchImpl(const std::vector<Key>& keys, size_t start_idx,
+                    size_t end_idx,
+                    std::vector<std::pair<Key, std::string>>* records_out);
 
   // Write the range [start_idx, end_idx) into the given segment. The caller
   // must already hold a `kPageWrite` lock on the segment. This method will
@@ -166,13 +288,58 @@ class Manager {
                       std::vector<Record>::const_iterator addtl_rec_begin,
                       std::vector<Record>::const_iterator addtl_rec_end);
 
+  // Scans the records in [lower, upper) for `ParallelScan()` and passes them
+  // to `emit`, one batch per segment.
+  void ScanPartition(const Key lower, const Key upper,
+                     const ScanBatchFn& emit);
+
   // Helpers for convenience.
   void ReadPage(const SegmentId& seg_id, size_t page_idx, void* buffer) const;
   void WritePage(const SegmentId& seg_id, size_t page_idx, void* buffer) const;
+  // Returns this thread's workspace buffer, placed according to this
+  // database's `numa_aware` option (the workspace is shared by all databases
+  // used by the thread).
+  char* WorkspaceBuffer() const { return w_.buffer(options_.numa_aware).get(); }
+
   // Reads the given segment into this thread's workspace buffer.
   void ReadSegment(const SegmentId& seg_id) const;
   void ReadOverflows(
       const std::vector<std::pair<SegmentId, void*>>& overflows_to_read) const;
+  // Samples whether `buffer` is on this thread's NUMA node (see
+  // `PageGroupedDBOptions::numa_aware`).
+  void SampleBufferAccess(const void* buffer) const;
+
+  // Adds segments that are no longer in use to the free list. If snapshot
+  // scans are enabled, the segments are first retired and are only released
+  // once no scan that may still read them is running (see `ScanSnapshot()`).
+  void FreeSegments(const std::vector<SegmentId>& ids);
+
+  // Releases retired segments that no running scan can read anymore.
+  void ReclaimRetiredSegments();
+
+  // Makes segments that are no longer in use available for reuse. If periodic
+  // index checkpoints are enabled, the segments are only added to the free
+  // list once the next checkpoint has been written (so that segments that the
+  // latest checkpoint considers valid are never overwritten).
+  void ReleaseSegments(const std::vector<SegmentId>& ids);
+
+  // Overwrites the first page of a replaced segment (or an overflow page)
+  // with `zero` to invalidate it. If snapshot scans are enabled, this holds
+  // the page's lock so that scans never read a partially overwritten page.
+  void InvalidatePage(const SegmentId& seg_id, void* zero);
+
+  // Called after a reorganization completes. Writes an index checkpoint if
+  // `options_.index_checkpoint_interval` reorganizations have completed since
+  // the last checkpoint.
+  void MaybeWriteIndexCheckpoint();
+
+  // Writes out an index checkpoint. The caller must hold
+  // `checkpoint_->write_mutex`.
+  Status WriteIndexCheckpoint(bool clean);
+
+  // Sets up the per key range statistics using the current segment
+  // boundaries (if `options_.key_range_stats_buckets` is nonzero).
+  void InitKeyRangeStats();
 
   std::pair<Key, SegmentInfo> LoadIntoNewSegment(uint32_t sequence_number,
                                                  const Segment& segment,
@@ -188,11 +355,40 @@ class Manager {
   std::filesystem::path db_path_;
   std::shared_ptr<LockManager> lock_manager_;
   std::unique_ptr<SegmentIndex> index_;
+  // Only set if `options_.io_trace_path` is nonempty. Declared before
+  // `segment_files_` so that it outlives them.
+  std::unique_ptr<IOTracer> io_tracer_;
   std::vector<std::unique_ptr<SegmentFile>> segment_files_;
   uint32_t next_sequence_number_;
   std::unique_ptr<FreeList> free_;
   std::unique_ptr<ThreadPool> bg_threads_;
   std::shared_ptr<InsertTracker> tracker_;
+  // Only set if `options_.key_range_stats_buckets` is nonzero.
+  std::unique_ptr<KeyRangeStats> key_range_stats_;
+
+  // State used to write index checkpoints.
+  struct CheckpointState {
+    // Held while writing a checkpoint.
+    std::mutex write_mutex;
+    std::atomic<size_t> reorgs_since_checkpoint{0};
+
+    // Segments freed since the last checkpoint was written (see
+    // `FreeSegments()`).
+    std::mutex pending_mutex;
+    std::vector<SegmentId> pending_free;
+  };
+  std::unique_ptr<CheckpointState> checkpoint_;
+
+  // State used to run scans without segment locks. Only set if
+  // `options_.snapshot_scans` is true.
+  struct SnapshotState {
+    EpochManager epochs;
+    // Segments freed by reorganizations that scans may still be reading,
+    // along with the epoch they were retired in (in ascending epoch order).
+    std::mutex retired_mutex;
+    std::deque<std::pair<EpochManager::Epoch, std::vector<SegmentId>>> retired;
+  };
+  std::unique_ptr<SnapshotState> snapshot_;
 
   // Options passed in when the `Manager` was created.
   PageGroupedDBOptions options_;
@@ -203,6 +399,7 @@ class Manager {
   static thread_local Workspace w_;
 
   static const std::string kSegmentFilePrefix;
+  static const std::string kIndexCheckpointFile;
 };
 
 }  // namespace pg
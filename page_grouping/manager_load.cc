@@ -112,10 +112,7 @@ Manager Manager::BulkLoadIntoSegments(
   // Open the segment files before constructing the `Manager`.
   std::vector<std::unique_ptr<SegmentFile>> segment_files;
   for (size_t i = 0; i < SegmentBuilder::SegmentPageCounts().size(); ++i) {
-    segment_files.push_back(std::make_unique<SegmentFile>(
-        db_path / (kSegmentFilePrefix + std::to_string(i)),
-        /*pages_per_segment=*/SegmentBuilder::SegmentPageCounts()[i],
-        options.use_memory_based_io));
+    segment_files.push_back(OpenSegmentFile(db_path, i, options));
   }
 
   Manager m(db_path, {}, std::move(segment_files), options,
@@ -125,6 +122,7 @@ Manager Manager::BulkLoadIntoSegments(
 }
 
 void Manager::BulkLoadIntoSegmentsImpl(const std::vector<Record>& records) {
+  IOCauseScope io_cause(IOCause::kLoad);
   std::vector<std::pair<Key, SegmentInfo>> segment_boundaries;
 
   // 1. Generate the segments.
@@ -142,7 +140,7 @@ void Manager::BulkLoadIntoSegmentsImpl(const std::vector<Record>& records) {
   }
 
   // 2. Load the data into pages on disk.
-  const PageBuffer& buf = w_.buffer();
+  const PageBuffer& buf = w_.buffer(options_.numa_aware);
   for (size_t seg_idx = 0; seg_idx < segments.size(); ++seg_idx) {
     const auto& seg = segments[seg_idx];
     const Key upper_bound = seg_idx == segments.size() - 1
@@ -155,6 +153,7 @@ void Manager::BulkLoadIntoSegmentsImpl(const std::vector<Record>& records) {
   // Bulk load the index.
   index_->BulkLoadFromEmpty(segment_boundaries.begin(),
                             segment_boundaries.end());
+  InitKeyRangeStats();
 }
 
 Manager Manager::BulkLoadIntoPages(
@@ -162,9 +161,7 @@ Manager Manager::BulkLoadIntoPages(
     const PageGroupedDBOptions& options) {
   // One single file containing 4 KiB pages.
   std::vector<std::unique_ptr<SegmentFile>> segment_files;
-  segment_files.push_back(std::make_unique<SegmentFile>(
-      db / (kSegmentFilePrefix + "0"),
-      /*pages_per_segment=*/1, options.use_memory_based_io));
+  segment_files.push_back(OpenSegmentFile(db, /*file_idx=*/0, options));
 
   Manager m(db, {}, std::move(segment_files), options,
             /*next_sequence_number=*/0, std::make_unique<FreeList>());
@@ -173,12 +170,14 @@ Manager Manager::BulkLoadIntoPages(
 }
 
 void Manager::BulkLoadIntoPagesImpl(const std::vector<Record>& records) {
+  IOCauseScope io_cause(IOCause::kLoad);
   std::vector<std::pair<Key, SegmentInfo>> segment_boundaries =
       LoadIntoNewPages(/*sequence_number=*/0, records.front().first,
                        std::numeric_limits<Key>::max(), records.begin(),
                        records.end());
   index_->BulkLoadFromEmpty(segment_boundaries.begin(),
                             segment_boundaries.end());
+  InitKeyRangeStats();
 }
 
 std::pair<Key, SegmentInfo> Manager::LoadIntoNewSegment(
@@ -186,7 +185,7 @@ std::pair<Key, SegmentInfo> Manager::LoadIntoNewSegment(
   assert(!seg.records.empty());
 
   const Key base_key = seg.records[0].first;
-  const PageBuffer& buf = w_.buffer();
+  const PageBuffer& buf = w_.buffer(options_.numa_aware);
   memset(buf.get(), 0, pg::Page::kSize * seg.page_count);
   if (seg.page_count > 1) {
     const auto lower_boundaries = ComputePageLowerBoundaries(seg);
@@ -267,7 +266,7 @@ std::vector<std::pair<Key, SegmentInfo>> Manager::LoadIntoNewPages(
   size_t page_end_idx = options_.records_per_page_goal;
   const size_t num_records = rec_end - rec_begin;
 
-  const PageBuffer& buf = w_.buffer();
+  const PageBuffer& buf = w_.buffer(options_.numa_aware);
   while (page_end_idx <= num_records) {
     memset(buf.get(), 0, pg::Page::kSize);
     const auto page_begin = rec_begin + page_start_idx;
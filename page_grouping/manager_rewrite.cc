@@ -4,6 +4,7 @@
 
 #include "../bufmgr/page_memory_allocator.h"
 #include "circular_page_buffer.h"
+#include "latency_timer.h"
 #include "manager.h"
 #include "persist/merge_iterator.h"
 #include "persist/page.h"
@@ -154,6 +155,7 @@ namespace pg {
 Status Manager::RewriteSegments(
     Key segment_base, std::vector<Record>::const_iterator addtl_rec_begin,
     std::vector<Record>::const_iterator addtl_rec_end) {
+  IOCauseScope io_cause(IOCause::kRewrite);
   std::vector<SegmentIndex::Entry> segments_to_rewrite;
 
   if (options_.rewrite_search_radius > 0) {
@@ -189,6 +191,8 @@ Status Manager::RewriteSegmentsImpl(
     std::vector<SegmentIndex::Entry> segments_to_rewrite,
     std::vector<Record>::const_iterator addtl_rec_begin,
     std::vector<Record>::const_iterator addtl_rec_end) {
+  PhaseTimer rewrite_timer(PhaseTimer::Phase::kRewrite);
+  PhaseTimer phase_timer(PhaseTimer::Phase::kRewriteMerge);
   std::vector<std::pair<Key, SegmentInfo>> rewritten_segments;
   std::vector<SegmentId> overflows_to_clear;
   // Track rewrite statistics.
@@ -196,6 +200,9 @@ Status Manager::RewriteSegmentsImpl(
   for (const auto& seg : segments_to_rewrite) {
     PageGroupedDBStats::Local().BumpRewriteInputPages(seg.sinfo.page_count());
   }
+  if (key_range_stats_ != nullptr) {
+    key_range_stats_->RecordRewrite(segments_to_rewrite.front().lower);
+  }
 
   // 2. Load and merge the segments.
   //
@@ -221,7 +228,8 @@ Status Manager::RewriteSegmentsImpl(
   // Used for recovery.
   const uint32_t sequence_number = next_sequence_number_++;
 
-  CircularPageBuffer page_buf(SegmentBuilder::SegmentPageCounts().back() * 4);
+  CircularPageBuffer page_buf(SegmentBuilder::SegmentPageCounts().back() * 4,
+                              options_.numa_aware);
 
   //
   // Insert forecasting
@@ -380,7 +388,7 @@ Status Manager::RewriteSegmentsImpl(
 
     // Load the segment and check for overflows.
     ReadSegment(seg_to_rewrite.sinfo.id());
-    SegmentWrap sw(w_.buffer().get(), seg_to_rewrite.sinfo.page_count());
+    SegmentWrap sw(WorkspaceBuffer(), seg_to_rewrite.sinfo.page_count());
     const size_t num_overflows = sw.NumOverflows();
     if (segment_pages + num_overflows > page_buf.NumFreePages()) {
       // Not enough memory to read the next segment's overflows. Flush the
@@ -454,38 +462,38 @@ Status Manager::RewriteSegmentsImpl(
 
   // The new segments have now been rewritten. Upgrade to exclusive mode before
   // exposing the new segments.
+  phase_timer.Next(PhaseTimer::Phase::kRewriteInstall);
   for (const auto& seg : segments_to_rewrite) {
     lock_manager_->UpgradeSegmentLockToReorgExclusive(seg.sinfo.id());
   }
 
   // 3. For crash consistency, we need to invalidate at least one of the old
-  // segments before exposing the newly rewritten segments. Ideally we would
-  // submit invalidations for all segments and wait for the first one to
-  // complete, but the C++ futures library does not provide this functionality.
-  // So we just wait for the first segment to be invalidated before proceeding.
+  // segments before exposing the newly rewritten segments. We wait for the
+  // first segment to be invalidated before proceeding.
 
-  void* zero = w_.buffer().get();
+  void* zero = WorkspaceBuffer();
   memset(zero, 0, pg::Page::kSize);
-  std::vector<std::future<void>> write_futures;
+  Latch first_invalidated(1);
+  Latch rest_invalidated(segments_to_rewrite.size() - 1 +
+                         overflows_to_clear.size());
   if (bg_threads_ != nullptr) {
-    write_futures.reserve(segments_to_rewrite.size() +
-                          overflows_to_clear.size());
-    for (const auto& seg_to_rewrite : segments_to_rewrite) {
-      const SegmentId seg_id = seg_to_rewrite.sinfo.id();
-      write_futures.push_back(bg_threads_->Submit(
-          [this, seg_id, zero]() { WritePage(seg_id, 0, zero); }));
+    for (size_t i = 0; i < segments_to_rewrite.size(); ++i) {
+      const SegmentId seg_id = segments_to_rewrite[i].sinfo.id();
+      bg_threads_->Submit(
+          i == 0 ? first_invalidated : rest_invalidated,
+          WithIOCause(
+              [this, seg_id, zero]() { InvalidatePage(seg_id, zero); }));
     }
     for (const auto& overflow_to_clear : overflows_to_clear) {
-      write_futures.push_back(
-          bg_threads_->Submit([this, overflow_to_clear, zero]() {
-            WritePage(overflow_to_clear, 0, zero);
-          }));
+      bg_threads_->Submit(rest_invalidated,
+                          WithIOCause([this, overflow_to_clear, zero]() {
+                            InvalidatePage(overflow_to_clear, zero);
+                          }));
     }
-    // Wait on the first future.
-    write_futures.front().get();
+    bg_threads_->Wait(first_invalidated);
   } else {
     // Clear the first segment synchronously.
-    WritePage(segments_to_rewrite.front().sinfo.id(), 0, zero);
+    InvalidatePage(segments_to_rewrite.front().sinfo.id(), zero);
   }
 
   // 4. Update in-memory index with the new segments. The new segments now
@@ -509,18 +517,16 @@ Status Manager::RewriteSegmentsImpl(
   // 5. Finish invalidating the remaining old segments. Then add them to the
   // free list.
   if (bg_threads_ != nullptr) {
-    // NOTE: We already called `get()` on the first future.
-    for (size_t i = 1; i < write_futures.size(); ++i) {
-      write_futures[i].get();
-    }
+    // NOTE: We already waited for the first segment to be invalidated.
+    bg_threads_->Wait(rest_invalidated);
   } else {
     // NOTE: We already synchronously invalidated the first segment.
     for (size_t i = 1; i < segments_to_rewrite.size(); ++i) {
       const SegmentId seg_id = segments_to_rewrite[i].sinfo.id();
-      WritePage(seg_id, 0, zero);
+      InvalidatePage(seg_id, zero);
     }
     for (const auto& overflow_to_clear : overflows_to_clear) {
-      WritePage(overflow_to_clear, 0, zero);
+      InvalidatePage(overflow_to_clear, zero);
     }
   }
   std::vector<SegmentId> to_free;
@@ -531,7 +537,7 @@ Status Manager::RewriteSegmentsImpl(
   for (const auto& overflow_to_clear : overflows_to_clear) {
     to_free.push_back(overflow_to_clear);
   }
-  free_->AddBatch(to_free);
+  FreeSegments(to_free);
 
   // TODO: Log that the rewrite has finished (this log record does not need to
   // be forced to disk for crash consistency).
@@ -545,13 +551,25 @@ Status Manager::RewriteSegmentsImpl(
   // Count invalidated pages (one per segment and each overflow page).
   PageGroupedDBStats::Local().BumpRewriteOutputPages(rewritten_segments.size() +
                                                      overflows_to_clear.size());
+  if (key_range_stats_ != nullptr) {
+    for (const auto& new_seg : rewritten_segments) {
+      key_range_stats_->RecordPageWrites(new_seg.first,
+                                         KeyRangeStats::PageWrite::kRewrite,
+                                         new_seg.second.page_count());
+    }
+    key_range_stats_->RecordPageWrites(
+        segments_to_rewrite.front().lower, KeyRangeStats::PageWrite::kRewrite,
+        rewritten_segments.size() + overflows_to_clear.size());
+  }
 
+  MaybeWriteIndexCheckpoint();
   return Status::OK();
 }
 
 Status Manager::FlattenChain(
     const Key base, const std::vector<Record>::const_iterator addtl_rec_begin,
     const std::vector<Record>::const_iterator addtl_rec_end) {
+  IOCauseScope io_cause(IOCause::kFlatten);
   const auto seg = index_->SegmentForKeyWithLock(base, SegmentMode::kReorg);
   if (base != seg.lower ||
       !ValidRangeForSegment(seg.lower, seg.upper, addtl_rec_begin,
@@ -569,7 +587,8 @@ Status Manager::FlattenChain(
   // Load the existing page(s).
   // NOTE: No need for page lock(s) if you hold the segment lock in `kReorg`
   // mode.
-  PageBuffer buf = PageMemoryAllocator::Allocate(/*num_pages=*/2);
+  PageBuffer buf =
+      PageMemoryAllocator::Allocate(/*num_pages=*/2, options_.numa_aware);
   ReadPage(main_page_id, 0, buf.get());
   pg::Page main(buf.get());
   const SegmentId overflow_page_id = main.GetOverflow();
@@ -585,6 +604,7 @@ Status Manager::FlattenChain(
 
   PageGroupedDBStats::Local().BumpRewrites();
   PageGroupedDBStats::Local().BumpRewriteInputPages(main.HasOverflow() ? 2 : 1);
+  if (key_range_stats_ != nullptr) key_range_stats_->RecordRewrite(base);
 
   // Merge the records in the chain with those in memory. If two records have
   // the same key, we prefer the in-memory one (it is a more recent write).
@@ -629,28 +649,29 @@ Status Manager::FlattenChain(
   lock_manager_->UpgradeSegmentLockToReorgExclusive(seg.sinfo.id());
 
   // For crash consistency, we need to invalidate at least one of the old pages
-  // before exposing the newly rewritten pages. Ideally we would submit
-  // invalidations for both pages and wait for the first one to complete, but
-  // the C++ futures library does not provide this functionality. So we just
-  // wait for the main page to be invalidated before proceeding.
+  // before exposing the newly rewritten pages. We wait for the main page to be
+  // invalidated before proceeding.
 
   void* const zero = buf.get();
   memset(zero, 0, pg::Page::kSize);
 
   // If we can run this additional invalidation in the background, do so.
-  std::future<void> main_invalidate, overflow_invalidate;
+  Latch main_invalidated(1);
+  Latch overflow_invalidated(overflow_page_id.IsValid() ? 1 : 0);
   if (bg_threads_ != nullptr) {
-    main_invalidate = bg_threads_->Submit(
-        [this, main_page_id, zero]() { WritePage(main_page_id, 0, zero); });
+    bg_threads_->Submit(main_invalidated,
+                        WithIOCause([this, main_page_id, zero]() {
+                          InvalidatePage(main_page_id, zero);
+                        }));
     if (overflow_page_id.IsValid()) {
-      overflow_invalidate =
-          bg_threads_->Submit([this, overflow_page_id, zero]() {
-            WritePage(overflow_page_id, 0, zero);
-          });
+      bg_threads_->Submit(overflow_invalidated,
+                          WithIOCause([this, overflow_page_id, zero]() {
+                            InvalidatePage(overflow_page_id, zero);
+                          }));
     }
-    main_invalidate.get();
+    bg_threads_->Wait(main_invalidated);
   } else {
-    WritePage(main_page_id, 0, zero);
+    InvalidatePage(main_page_id, zero);
   }
 
   // TODO: Log that the flatten (rewrite) has finished.
@@ -665,15 +686,14 @@ Status Manager::FlattenChain(
   lock_manager_->ReleaseSegmentLock(seg.sinfo.id(),
                                     SegmentMode::kReorgExclusive);
 
-  free_->Add(main_page_id);
+  FreeSegments({main_page_id});
   if (overflow_page_id.IsValid()) {
     if (bg_threads_ != nullptr) {
-      assert(overflow_invalidate.valid());
-      overflow_invalidate.get();
+      bg_threads_->Wait(overflow_invalidated);
     } else {
-      WritePage(overflow_page_id, 0, zero);
+      InvalidatePage(overflow_page_id, zero);
     }
-    free_->Add(overflow_page_id);
+    FreeSegments({overflow_page_id});
   }
 
   // Keep track of the number of affected pages.
@@ -683,12 +703,23 @@ Status Manager::FlattenChain(
   // Invalidated old pages.
   PageGroupedDBStats::Local().BumpRewriteOutputPages(
       overflow_page_id.IsValid() ? 2 : 1);
+  if (key_range_stats_ != nullptr) {
+    for (const auto& new_page : new_pages) {
+      key_range_stats_->RecordPageWrites(
+          new_page.first, KeyRangeStats::PageWrite::kRewrite, 1);
+    }
+    key_range_stats_->RecordPageWrites(base,
+                                       KeyRangeStats::PageWrite::kRewrite,
+                                       overflow_page_id.IsValid() ? 2 : 1);
+  }
 
+  MaybeWriteIndexCheckpoint();
   return Status::OK();
 }
 
 Status Manager::FlattenRange(const Key start_key, const Key end_key) {
   static const std::vector<Record> kEmptyRecords;
+  IOCauseScope io_cause(IOCause::kFlatten);
 
   Key curr_start = start_key;
   std::vector<SegmentIndex::Entry> to_rewrite;
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <vector>
 
 #include "manager.h"
@@ -13,6 +16,7 @@ using PageMode = LockManager::PageMode;
 Status Manager::ScanWithEstimates(
     const Key& start_key, const size_t amount,
     std::vector<std::pair<Key, std::string>>* values_out) {
+  IOCauseScope io_cause(IOCause::kScan);
   // Scan strategy (all scans are forward scans):
   // - Find segment containing starting key.
   // - Estimate how much of the segment to read based on the position of the
@@ -86,17 +90,17 @@ Status Manager::ScanWithEstimates(
   const size_t segment_byte_offset =
       start_seg.sinfo.id().GetOffset() * Page::kSize;
   sf->ReadPages(segment_byte_offset + start_page_idx * Page::kSize,
-                w_.buffer().get(), est_start_pages_to_read);
+                WorkspaceBuffer(), est_start_pages_to_read);
   w_.BumpReadCount(est_start_pages_to_read);
 
   // The workspace buffer has one extra page at the end for use as the overflow.
   void* overflow_buf =
-      w_.buffer().get() +
+      WorkspaceBuffer() +
       (SegmentBuilder::SegmentPageCounts().back()) * pg::Page::kSize;
   Page overflow_page(overflow_buf);
 
   // Scan the first page.
-  Page first_page(w_.buffer().get());
+  Page first_page(WorkspaceBuffer());
   std::vector<Page::Iterator> page_its = {first_page.GetIterator()};
   if (first_page.HasOverflow()) {
     ReadPage(first_page.GetOverflow(), 0, overflow_buf);
@@ -132,7 +136,7 @@ Status Manager::ScanWithEstimates(
   size_t start_seg_page_idx = start_page_idx + 1;
   while (records_left > 0 &&
          start_seg_page_idx < (start_page_idx + est_start_pages_to_read)) {
-    Page page(w_.buffer().get() +
+    Page page(WorkspaceBuffer() +
               (start_seg_page_idx - start_page_idx) * Page::kSize);
     scan_page(page);
     lock_manager_->ReleasePageLock(start_seg.sinfo.id(), start_seg_page_idx,
@@ -154,9 +158,9 @@ Status Manager::ScanWithEstimates(
     lock_manager_->AcquirePageLock(start_seg.sinfo.id(), start_seg_page_idx,
                                    PageMode::kShared);
     sf->ReadPages(segment_byte_offset + start_seg_page_idx * Page::kSize,
-                  w_.buffer().get(), /*num_pages=*/1);
+                  WorkspaceBuffer(), /*num_pages=*/1);
     w_.BumpReadCount(1);
-    Page page(w_.buffer().get());
+    Page page(WorkspaceBuffer());
     scan_page(page);
     lock_manager_->ReleasePageLock(start_seg.sinfo.id(), start_seg_page_idx,
                                    PageMode::kShared);
@@ -194,12 +198,12 @@ Status Manager::ScanWithEstimates(
     }
     const std::unique_ptr<SegmentFile>& sf =
         segment_files_[curr_seg->sinfo.id().GetFileId()];
-    sf->ReadPages(seg_byte_offset, w_.buffer().get(), pages_to_read);
+    sf->ReadPages(seg_byte_offset, WorkspaceBuffer(), pages_to_read);
     w_.BumpReadCount(pages_to_read);
 
     size_t page_idx = 0;
     while (records_left > 0 && page_idx < pages_to_read) {
-      Page page(w_.buffer().get() + page_idx * Page::kSize);
+      Page page(WorkspaceBuffer() + page_idx * Page::kSize);
       scan_page(page);
       lock_manager_->ReleasePageLock(curr_seg->sinfo.id(), page_idx,
                                      PageMode::kShared);
@@ -217,10 +221,10 @@ Status Manager::ScanWithEstimates(
       lock_manager_->AcquirePageLock(curr_seg->sinfo.id(), page_idx,
                                      PageMode::kShared);
       // Read 1 page at a time.
-      sf->ReadPages(seg_byte_offset + page_idx * Page::kSize, w_.buffer().get(),
+      sf->ReadPages(seg_byte_offset + page_idx * Page::kSize, WorkspaceBuffer(),
                     /*num_pages=*/1);
       w_.BumpReadCount(1);
-      Page page(w_.buffer().get());
+      Page page(WorkspaceBuffer());
       scan_page(page);
       lock_manager_->ReleasePageLock(curr_seg->sinfo.id(), page_idx,
                                      PageMode::kShared);
@@ -243,6 +247,7 @@ Status Manager::ScanWithEstimates(
 Status Manager::ScanWhole(
     const Key& start_key, const size_t amount,
     std::vector<std::pair<Key, std::string>>* values_out) {
+  IOCauseScope io_cause(IOCause::kScan);
   values_out->clear();
   values_out->reserve(amount);
 
@@ -276,17 +281,17 @@ Status Manager::ScanWhole(
     lock_manager_->AcquirePageLock(start_seg.sinfo.id(), page_idx,
                                    PageMode::kShared);
   }
-  sf->ReadPages(segment_byte_offset, w_.buffer().get(), first_segment_size);
+  sf->ReadPages(segment_byte_offset, WorkspaceBuffer(), first_segment_size);
   w_.BumpReadCount(first_segment_size);
 
   // The workspace buffer has one extra page at the end for use as the overflow.
   void* overflow_buf =
-      w_.buffer().get() +
+      WorkspaceBuffer() +
       (SegmentBuilder::SegmentPageCounts().back()) * pg::Page::kSize;
   Page overflow_page(overflow_buf);
 
   // 3. Scan the first matching page in the segment.
-  Page first_page(w_.buffer().get() + start_segment_page_idx * Page::kSize);
+  Page first_page(WorkspaceBuffer() + start_segment_page_idx * Page::kSize);
   std::vector<Page::Iterator> page_its = {first_page.GetIterator()};
   if (first_page.HasOverflow()) {
     ReadPage(first_page.GetOverflow(), 0, overflow_buf);
@@ -321,7 +326,7 @@ Status Manager::ScanWhole(
   // 4. Scan the rest of the pages in the segment.
   ++start_segment_page_idx;
   while (records_left > 0 && start_segment_page_idx < first_segment_size) {
-    Page page(w_.buffer().get() + start_segment_page_idx * Page::kSize);
+    Page page(WorkspaceBuffer() + start_segment_page_idx * Page::kSize);
     scan_page(page);
     lock_manager_->ReleasePageLock(start_seg.sinfo.id(), start_segment_page_idx,
                                    PageMode::kShared);
@@ -361,12 +366,12 @@ Status Manager::ScanWhole(
     }
     const std::unique_ptr<SegmentFile>& sf =
         segment_files_[curr_seg->sinfo.id().GetFileId()];
-    sf->ReadPages(seg_byte_offset, w_.buffer().get(), seg_page_count);
+    sf->ReadPages(seg_byte_offset, WorkspaceBuffer(), seg_page_count);
     w_.BumpReadCount(seg_page_count);
 
     size_t page_idx = 0;
     while (records_left > 0 && page_idx < seg_page_count) {
-      Page page(w_.buffer().get() + page_idx * Page::kSize);
+      Page page(WorkspaceBuffer() + page_idx * Page::kSize);
       scan_page(page);
       lock_manager_->ReleasePageLock(curr_seg->sinfo.id(), page_idx,
                                      PageMode::kShared);
@@ -390,5 +395,134 @@ Status Manager::ScanWhole(
   return Status::OK();
 }
 
+Status Manager::ScanSnapshot(
+    const Key& start_key, const size_t amount,
+    std::vector<std::pair<Key, std::string>>* values_out) {
+  IOCauseScope io_cause(IOCause::kScan);
+  assert(snapshot_ != nullptr);
+  values_out->clear();
+  values_out->reserve(amount);
+
+  // Scan strategy:
+  // - Enter an epoch before reading the index. Reorganizations write their
+  //   new segments to unused locations and the segments they replace are only
+  //   reused once every scan that started before the replacement finishes
+  //   (see `FreeSegments()`). So the segments we find in the index stay
+  //   readable for the rest of the scan, even if they are replaced.
+  // - Look up segments by key without acquiring segment locks (so we never
+  //   block a reorganization) and read them page by page.
+  // - A reorganization invalidates (zeroes) the first page of each segment it
+  //   replaces, as well as the overflow pages it merged. If we read such a
+  //   page, we look up the rest of the range again in the updated index.
+  //
+  // Locking strategy:
+  // - Page locks are acquired in shared mode while reading a page (and its
+  //   overflow), which prevents reading a page while a writer updates it in
+  //   place or a reorganization invalidates it.
+  if (amount == 0) return Status::OK();
+  size_t records_left = amount;
+
+  // The workspace buffer has one extra page at the end for use as the overflow.
+  void* overflow_buf =
+      WorkspaceBuffer() +
+      (SegmentBuilder::SegmentPageCounts().back()) * pg::Page::kSize;
+  Page overflow_page(overflow_buf);
+
+  {
+    const EpochManager::Guard guard = snapshot_->epochs.Enter();
+
+    // The smallest key that has not been scanned yet.
+    Key next_key = start_key;
+    while (records_left > 0) {
+      const auto seg = index_->SegmentForKey(next_key);
+      const SegmentId seg_id = seg.sinfo.id();
+      const size_t seg_page_count = seg.sinfo.page_count();
+      const size_t seg_byte_offset = seg_id.GetOffset() * Page::kSize;
+      const std::unique_ptr<SegmentFile>& sf =
+          segment_files_[seg_id.GetFileId()];
+      key_utils::IntKeyAsSlice next_key_slice_helper(next_key);
+      const Slice next_key_slice = next_key_slice_helper.as<Slice>();
+
+      bool invalidated = false;
+      size_t page_idx = seg.sinfo.PageForKey(seg.lower, next_key);
+      while (records_left > 0 && page_idx < seg_page_count && !invalidated) {
+        // Avoid reading the rest of the segment if we do not anticipate
+        // needing all of its records.
+        const size_t est_pages_left = std::ceil(
+            records_left / static_cast<double>(options_.records_per_page_goal));
+        const size_t pages_to_read = std::min(
+            seg_page_count - page_idx, std::max<size_t>(1, est_pages_left));
+        for (size_t i = 0; i < pages_to_read; ++i) {
+          lock_manager_->AcquirePageLock(seg_id, page_idx + i,
+                                         PageMode::kShared);
+        }
+        sf->ReadPages(seg_byte_offset + page_idx * Page::kSize,
+                      WorkspaceBuffer(), pages_to_read);
+        w_.BumpReadCount(pages_to_read);
+
+        for (size_t i = 0; i < pages_to_read && records_left > 0; ++i) {
+          Page page(WorkspaceBuffer() + i * Page::kSize);
+          if (!page.IsValid()) {
+            invalidated = true;
+            break;
+          }
+          std::vector<Page::Iterator> page_its = {page.GetIterator()};
+          if (page.HasOverflow()) {
+            const SegmentId overflow_id = page.GetOverflow();
+            lock_manager_->AcquirePageLock(overflow_id, 0, PageMode::kShared);
+            ReadPage(overflow_id, 0, overflow_buf);
+            lock_manager_->ReleasePageLock(overflow_id, 0, PageMode::kShared);
+            if (!overflow_page.IsValid()) {
+              invalidated = true;
+              break;
+            }
+            page_its.push_back(overflow_page.GetIterator());
+          }
+          // Skips the records that were already scanned (the first page may
+          // contain smaller keys).
+          PageMergeIterator pmi(std::move(page_its), &next_key_slice);
+          for (; records_left > 0 && pmi.Valid(); --records_left, pmi.Next()) {
+            values_out->emplace_back(key_utils::ExtractHead64(pmi.key()),
+                                     pmi.value().ToString());
+          }
+        }
+
+        for (size_t i = 0; i < pages_to_read; ++i) {
+          lock_manager_->ReleasePageLock(seg_id, page_idx + i,
+                                         PageMode::kShared);
+        }
+        page_idx += pages_to_read;
+      }
+
+      if (invalidated) {
+        // A reorganization replaced the segment. Continue after the last
+        // record we scanned.
+        if (!values_out->empty()) {
+          next_key = std::max(next_key, values_out->back().first + 1);
+        }
+        // The reorganization invalidates the first segment before it publishes
+        // the new segments, so the index may not have been updated yet. If so,
+        // wait until the reorganization releases its segment lock (it does so
+        // after updating the index).
+        const auto ticket = lock_manager_->GetSegmentWaitTicket(seg_id);
+        const auto current = index_->SegmentForKey(next_key);
+        if (current.sinfo.id() == seg_id) {
+          lock_manager_->WaitForSegmentLock(seg_id, SegmentMode::kPageRead,
+                                            ticket);
+        }
+        continue;
+      }
+
+      // Go to the next segment.
+      if (seg.upper == kMaxReservedKey) break;
+      next_key = seg.upper;
+    }
+  }
+
+  // Segments retired while we were scanning may now be reusable.
+  ReclaimRetiredSegments();
+  return Status::OK();
+}
+
 }  // namespace pg
 }  // namespace tl
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "manager.h"
+#include "persist/merge_iterator.h"
+#include "treeline/pg_stats.h"
+#include "util/key.h"
+
+namespace {
+
+// The number of partitions to create per scan thread. Using more partitions
+// than threads balances the load when some partitions are slower to scan.
+constexpr size_t kPartitionsPerThread = 4;
+
+}  // namespace
+
+namespace tl {
+namespace pg {
+
+using SegmentMode = LockManager::SegmentMode;
+using PageMode = LockManager::PageMode;
+
+Status Manager::ParallelScan(const Key start_key, const Key end_key,
+                             const size_t num_threads, const bool ordered,
+                             const ScanDeliverFn& deliver,
+                             const ScanBatchFn& prepare) {
+  if (num_threads == 0) {
+    return Status::InvalidArgument("Must use at least one scan thread.");
+  }
+  if (start_key >= end_key) return Status::OK();
+
+  // 1. Split the range into partitions along segment boundaries, giving each
+  // partition roughly the same number of pages.
+  const std::vector<SegmentIndex::Entry> segments =
+      index_->GetEntriesInRange(start_key, end_key);
+  if (segments.empty()) return Status::OK();
+  size_t total_pages = 0;
+  for (const auto& seg : segments) {
+    total_pages += seg.sinfo.page_count();
+  }
+  const size_t num_partitions =
+      std::min(segments.size(), num_threads * kPartitionsPerThread);
+  const size_t pages_per_partition =
+      (total_pages + num_partitions - 1) / num_partitions;
+
+  // Partition `i` covers the keys in [bounds[i], bounds[i + 1]).
+  std::vector<Key> bounds = {start_key};
+  size_t pages_so_far = 0;
+  for (size_t i = 0; i + 1 < segments.size(); ++i) {
+    pages_so_far += segments[i].sinfo.page_count();
+    if (pages_so_far >= pages_per_partition * bounds.size()) {
+      bounds.push_back(segments[i + 1].lower);
+    }
+  }
+  bounds.push_back(end_key);
+  const size_t partitions = bounds.size() - 1;
+
+  // 2. Scan the partitions. Threads claim partitions in ascending key order.
+  //
+  // Ordered delivery: batches from the lowest undelivered partition are
+  // delivered directly. Batches from other partitions are buffered until all
+  // the partitions before them have been delivered.
+  std::mutex delivery_mutex;
+  size_t next_to_deliver = 0;
+  std::vector<std::vector<std::vector<std::pair<Key, std::string>>>> buffered(
+      ordered ? partitions : 0);
+  std::vector<bool> finished(ordered ? partitions : 0, false);
+
+  const auto flush_buffered = [&buffered, &deliver](const size_t partition) {
+    for (auto& batch : buffered[partition]) {
+      deliver(std::move(batch));
+    }
+    buffered[partition].clear();
+  };
+
+  std::atomic<size_t> next_partition(0);
+  const auto scan_worker = [&]() {
+    for (size_t partition = next_partition++; partition < partitions;
+         partition = next_partition++) {
+      ScanPartition(
+          bounds[partition], bounds[partition + 1],
+          [&, partition](const Key lower, const Key upper,
+                         std::vector<std::pair<Key, std::string>>* batch) {
+            if (prepare) prepare(lower, upper, batch);
+            if (batch->empty()) return;
+            if (!ordered) {
+              deliver(std::move(*batch));
+              return;
+            }
+            std::unique_lock<std::mutex> lock(delivery_mutex);
+            if (partition == next_to_deliver) {
+              deliver(std::move(*batch));
+            } else {
+              buffered[partition].push_back(std::move(*batch));
+            }
+          });
+
+      if (!ordered) continue;
+      std::unique_lock<std::mutex> lock(delivery_mutex);
+      finished[partition] = true;
+      while (next_to_deliver < partitions && finished[next_to_deliver]) {
+        ++next_to_deliver;
+        if (next_to_deliver < partitions) flush_buffered(next_to_deliver);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  const size_t num_workers = std::min(num_threads, partitions);
+  threads.reserve(num_workers - 1);
+  for (size_t i = 1; i < num_workers; ++i) {
+    threads.emplace_back([&scan_worker]() {
+      scan_worker();
+      // The statistics are thread local.
+      PageGroupedDBStats::Local().PostToGlobal();
+    });
+  }
+  scan_worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return Status::OK();
+}
+
+void Manager::ScanPartition(const Key lower, const Key upper,
+                            const ScanBatchFn& emit) {
+  IOCauseScope io_cause(IOCause::kScan);
+  // Scan strategy:
+  // - Read whole segments, one at a time, using two buffers. While we process
+  //   the records in one buffer, the next segment is read into the other
+  //   buffer on the background threads (if available).
+  //
+  // Locking strategy:
+  // - Segment locks are acquired in `kPageRead` mode using lock coupling (we
+  //   lock the next segment before releasing the current one). Segment locks
+  //   are acquired in logically ascending order (by key).
+  // - All of a segment's page locks are acquired in shared mode before the
+  //   segment is read, and are released once it has been processed.
+  const size_t max_segment_pages = SegmentBuilder::SegmentPageCounts().back();
+  PageBuffer buffers[2] = {
+      PageMemoryAllocator::Allocate(max_segment_pages, options_.numa_aware),
+      PageMemoryAllocator::Allocate(max_segment_pages, options_.numa_aware)};
+  PageBuffer overflow_buf =
+      PageMemoryAllocator::Allocate(/*num_pages=*/1, options_.numa_aware);
+  Page overflow_page(overflow_buf.get());
+
+  const auto lock_and_read = [this](const SegmentIndex::Entry& seg,
+                                    char* buffer) {
+    const SegmentId seg_id = seg.sinfo.id();
+    for (size_t i = 0; i < seg.sinfo.page_count(); ++i) {
+      lock_manager_->AcquirePageLock(seg_id, i, PageMode::kShared);
+    }
+    auto read = WithIOCause([this, seg_id, page_count = seg.sinfo.page_count(),
+                             buffer]() {
+      segment_files_[seg_id.GetFileId()]->ReadPages(
+          seg_id.GetOffset() * Page::kSize, buffer, page_count);
+    });
+    w_.BumpReadCount(seg.sinfo.page_count());
+    if (bg_threads_ == nullptr) {
+      read();
+      return std::future<void>();
+    }
+    return bg_threads_->Submit(read);
+  };
+
+  std::vector<std::pair<Key, std::string>> batch;
+  std::optional<SegmentIndex::Entry> curr =
+      index_->SegmentForKeyWithLock(lower, SegmentMode::kPageRead);
+  std::future<void> curr_read = lock_and_read(*curr, buffers[0].get());
+  size_t curr_buf = 0;
+
+  while (curr.has_value()) {
+    // Prefetch the next segment in the partition.
+    std::optional<SegmentIndex::Entry> next;
+    std::future<void> next_read;
+    if (curr->upper < upper && curr->upper != kMaxReservedKey) {
+      next = index_->NextSegmentForKeyWithLock(curr->lower,
+                                               SegmentMode::kPageRead);
+      if (next.has_value()) {
+        next_read = lock_and_read(*next, buffers[curr_buf ^ 1].get());
+      }
+    }
+
+    if (curr_read.valid()) curr_read.get();
+    const Key batch_lower = std::max(lower, curr->lower);
+    const Key batch_upper = std::min(upper, curr->upper);
+    key_utils::IntKeyAsSlice batch_lower_slice_helper(batch_lower);
+    const Slice batch_lower_slice = batch_lower_slice_helper.as<Slice>();
+    const SegmentId seg_id = curr->sinfo.id();
+    const size_t seg_page_count = curr->sinfo.page_count();
+
+    batch.clear();
+    for (size_t page_idx = curr->sinfo.PageForKey(curr->lower, batch_lower);
+         page_idx < seg_page_count; ++page_idx) {
+      Page page(buffers[curr_buf].get() + page_idx * Page::kSize);
+      std::vector<Page::Iterator> page_its = {page.GetIterator()};
+      if (page.HasOverflow()) {
+        ReadPage(page.GetOverflow(), 0, overflow_buf.get());
+        page_its.push_back(overflow_page.GetIterator());
+      }
+      PageMergeIterator pmi(std::move(page_its), &batch_lower_slice);
+      bool past_upper = false;
+      for (; pmi.Valid(); pmi.Next()) {
+        const Key key = key_utils::ExtractHead64(pmi.key());
+        if (key >= batch_upper) {
+          past_upper = true;
+          break;
+        }
+        batch.emplace_back(key, pmi.value().ToString());
+      }
+      if (past_upper) break;
+    }
+
+    for (size_t i = 0; i < seg_page_count; ++i) {
+      lock_manager_->ReleasePageLock(seg_id, i, PageMode::kShared);
+    }
+    lock_manager_->ReleaseSegmentLock(seg_id, SegmentMode::kPageRead);
+
+    emit(batch_lower, batch_upper, &batch);
+
+    curr = std::move(next);
+    curr_read = std::move(next_read);
+    curr_buf ^= 1;
+  }
+}
+
+}  // namespace pg
+}  // namespace tl
@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <deque>
 #include <future>
 #include <new>
+#include <optional>
 #include <sstream>
 #include <utility>
 
@@ -32,6 +37,60 @@ class PrefetchBuffer {
   size_t pages_left_;
 };
 
+// Allocates contiguous page ranges from a fixed-size buffer. The ranges must be
+// freed in the order they were allocated. Unlike `PrefetchBuffer`, this class
+// reuses freed space and reports exhaustion by returning `nullptr`.
+class PrefetchRing {
+ public:
+  PrefetchRing(char* buf, size_t pages)
+      : buf_(buf), capacity_(pages), head_(0), wrapped_(false) {}
+
+  // Returns `nullptr` if there is not enough contiguous free space.
+  char* Allocate(size_t pages) {
+    if (live_.empty()) {
+      head_ = 0;
+      wrapped_ = false;
+    }
+    const size_t tail = live_.empty() ? 0 : live_.front();
+    size_t offset = 0;
+    if (!wrapped_ && head_ + pages <= capacity_) {
+      offset = head_;
+    } else if (!wrapped_ && pages <= tail) {
+      // Wrap around to the start of the buffer.
+      offset = 0;
+      wrapped_ = true;
+    } else if (wrapped_ && head_ + pages <= tail) {
+      offset = head_;
+    } else {
+      return nullptr;
+    }
+    head_ = offset + pages;
+    live_.push_back(offset);
+    return buf_ + offset * tl::pg::Page::kSize;
+  }
+
+  // Frees the oldest allocated range.
+  void Free() {
+    assert(!live_.empty());
+    const size_t freed = live_.front();
+    live_.pop_front();
+    if (!live_.empty() && live_.front() < freed) {
+      // The remaining ranges no longer wrap around.
+      wrapped_ = false;
+    }
+  }
+
+ private:
+  char* buf_;
+  size_t capacity_;
+  // The offsets (in pages) of the allocated ranges, oldest first.
+  std::deque<size_t> live_;
+  // The next allocation is made at `head_` (if there is space).
+  size_t head_;
+  // Set when the allocated ranges wrap around the end of the buffer.
+  bool wrapped_;
+};
+
 }  // namespace
 
 namespace tl {
@@ -43,6 +102,7 @@ using PageMode = LockManager::PageMode;
 Status Manager::ScanWithExperimentalPrefetching(
     const Key& start_key, const size_t amount,
     std::vector<std::pair<Key, std::string>>* values_out) {
+  IOCauseScope io_cause(IOCause::kScan);
   // Scan strategy (all scans are forward scans):
   // - Estimate how many pages we will need to read.
   // - Make read requests for as many segments as needed (prefetching).
@@ -93,13 +153,15 @@ Status Manager::ScanWithExperimentalPrefetching(
 
   // Used to handle prefetching.
   std::vector<std::future<std::pair<char*, size_t>>> ready_pages;
-  PrefetchBuffer prefetch_buf(w_.prefetch_buffer().get(),
+  PrefetchBuffer prefetch_buf(w_.prefetch_buffer(options_.numa_aware).get(),
                               Workspace::kPrefetchBufferPages);
 
   // 3. Fetch the first segment.
   ready_pages.emplace_back(
-      bg_threads_->Submit([this, start_seg, start_page_idx, start_pages_to_read,
-                           buf = prefetch_buf.Allocate(start_pages_to_read)]() {
+      bg_threads_->Submit(WithIOCause([this, start_seg, start_page_idx,
+                                       start_pages_to_read,
+                                       buf = prefetch_buf.Allocate(
+                                           start_pages_to_read)]() {
         const std::unique_ptr<SegmentFile>& sf =
             segment_files_[start_seg.sinfo.id().GetFileId()];
         const size_t segment_byte_offset =
@@ -108,7 +170,7 @@ Status Manager::ScanWithExperimentalPrefetching(
                       start_pages_to_read);
         w_.BumpReadCount(start_pages_to_read);
         return std::make_pair(buf, start_pages_to_read);
-      }));
+      })));
   pages_prefetched += start_pages_to_read;
 
   // 4. Fetch additional segments until we exhaust our estimate.
@@ -134,7 +196,7 @@ Status Manager::ScanWithExperimentalPrefetching(
       has_pages_remaining_in_last_segment = true;
     }
 
-    ready_pages.emplace_back(bg_threads_->Submit(
+    ready_pages.emplace_back(bg_threads_->Submit(WithIOCause(
         [this, curr_seg = *curr_seg, seg_byte_offset, pages_to_read,
          buf = prefetch_buf.Allocate(pages_to_read)]() {
           const std::unique_ptr<SegmentFile>& sf =
@@ -142,7 +204,7 @@ Status Manager::ScanWithExperimentalPrefetching(
           sf->ReadPages(seg_byte_offset, buf, pages_to_read);
           w_.BumpReadCount(pages_to_read);
           return std::make_pair(buf, pages_to_read);
-        }));
+        })));
     pages_prefetched += seg_page_count;
 
     // Go to the next segment. To avoid an unnecessary lock acquisiton, we check
@@ -161,7 +223,7 @@ Status Manager::ScanWithExperimentalPrefetching(
   // 5. Scan through the prefetched pages. For correctness, we need to load
   // overflows if they exist.
 
-  void* overflow_buf = w_.buffer().get();
+  void* overflow_buf = WorkspaceBuffer();
   Page overflow_page(overflow_buf);
 
   // Code used to scan the first page (requires a lower bound seek).
@@ -234,14 +296,202 @@ Status Manager::ScanWithExperimentalPrefetching(
     throw std::runtime_error(err_msg.str());
   }
 
+  // Wait for any remaining outstanding I/Os; they write into this thread's
+  // prefetch buffer, which the next scan will reuse.
+  for (auto& f : ready_pages) {
+    if (f.valid()) f.wait();
+  }
+
   // If we reach here, it must be the case that `est_pages_to_fetch >=
   // fetched_pages_used`. We track the number of "overfetched" pages.
-  // N.B. This thread will implicitly wait for any remaining outstanding I/Os.
   PageGroupedDBStats::Local().BumpOverfetchedPages(est_pages_to_fetch -
                                                    fetched_pages_used);
 
   return Status::OK();
 }
 
+Status Manager::ScanWithPrefetching(
+    const Key& start_key, const size_t amount,
+    std::vector<std::pair<Key, std::string>>* values_out) {
+  IOCauseScope io_cause(IOCause::kScan);
+  if (bg_threads_ == nullptr) {
+    return ScanWithEstimates(start_key, amount, values_out);
+  }
+
+  // Scan strategy (all scans are forward scans):
+  // - Keep a window of "chunks" (contiguous pages in a segment) whose reads
+  // have been issued to the background threads.
+  // - Size the window using the number of records left to scan and the number
+  // of records per page observed so far. Issue more reads as chunks are
+  // scanned, and stop issuing reads when the prefetch buffer is full.
+  //
+  // Locking strategy:
+  // - Segment locks are acquired in `kPageRead` mode in logically ascending
+  // order (by key), using lock coupling: the segment whose pages are being
+  // issued stays locked until the next segment has been locked.
+  // - A segment lock is released once all of the segment's issued chunks have
+  // been scanned (and we are no longer issuing reads for the segment).
+  // - Page locks are acquired in shared mode when a chunk's read is issued, and
+  // are released once the chunk has been scanned.
+  values_out->clear();
+  values_out->reserve(amount);
+
+  if (amount == 0) return Status::OK();
+  size_t records_left = amount;
+
+  struct Chunk {
+    SegmentId seg_id;
+    size_t page_idx;
+    size_t num_pages;
+    char* buf;
+    std::future<void> read;
+  };
+  std::deque<Chunk> window;
+  size_t pages_in_window = 0;
+  size_t pages_fetched = 0;
+  size_t pages_used = 0;
+  PrefetchRing ring(w_.prefetch_buffer(options_.numa_aware).get(),
+                    Workspace::kPrefetchBufferPages);
+
+  // The segment we are issuing reads for, and the next page to read.
+  std::optional<SegmentIndex::Entry> issue_seg =
+      index_->SegmentForKeyWithLock(start_key, SegmentMode::kPageRead);
+  size_t issue_page_idx =
+      issue_seg->sinfo.PageForKey(issue_seg->lower, start_key);
+
+  // Used to estimate the record density. We skip the first page because we
+  // may only scan part of it.
+  size_t pages_scanned = 0;
+  size_t records_scanned = 0;
+  const auto est_pages_needed = [this, &records_left, &pages_scanned,
+                                 &records_scanned]() -> size_t {
+    if (pages_scanned == 0) {
+      return std::ceil(records_left /
+                       static_cast<double>(options_.records_per_page_goal));
+    }
+    const double records_per_page =
+        std::max(1.0, records_scanned / static_cast<double>(pages_scanned));
+    return std::max<size_t>(1, std::ceil(records_left / records_per_page));
+  };
+  const auto in_window = [&window](const SegmentId& seg_id) {
+    return std::any_of(
+        window.begin(), window.end(),
+        [&seg_id](const Chunk& chunk) { return chunk.seg_id == seg_id; });
+  };
+
+  const auto issue_reads = [&]() {
+    const size_t pages_needed = est_pages_needed();
+    while (issue_seg.has_value() && pages_in_window < pages_needed) {
+      const SegmentId seg_id = issue_seg->sinfo.id();
+      const size_t seg_page_count = issue_seg->sinfo.page_count();
+      if (issue_page_idx >= seg_page_count) {
+        std::optional<SegmentIndex::Entry> next =
+            index_->NextSegmentForKeyWithLock(issue_seg->lower,
+                                              SegmentMode::kPageRead);
+        if (!in_window(seg_id)) {
+          lock_manager_->ReleaseSegmentLock(seg_id, SegmentMode::kPageRead);
+        }
+        issue_seg = std::move(next);
+        issue_page_idx = 0;
+        continue;
+      }
+
+      const size_t num_pages = std::min(seg_page_count - issue_page_idx,
+                                        pages_needed - pages_in_window);
+      char* const buf = ring.Allocate(num_pages);
+      // The buffer is full. We will issue more reads once the chunks in the
+      // window have been scanned.
+      if (buf == nullptr) break;
+
+      for (size_t i = 0; i < num_pages; ++i) {
+        lock_manager_->AcquirePageLock(seg_id, issue_page_idx + i,
+                                       PageMode::kShared);
+      }
+      const size_t byte_offset =
+          (seg_id.GetOffset() + issue_page_idx) * Page::kSize;
+      window.push_back(Chunk{
+          seg_id, issue_page_idx, num_pages, buf,
+          bg_threads_->Submit(
+              WithIOCause([this, seg_id, byte_offset, buf, num_pages]() {
+                segment_files_[seg_id.GetFileId()]->ReadPages(
+                    byte_offset, buf, num_pages);
+              }))});
+      w_.BumpReadCount(num_pages);
+      pages_in_window += num_pages;
+      pages_fetched += num_pages;
+      issue_page_idx += num_pages;
+    }
+  };
+
+  // Releases `chunk`'s page locks (and its segment lock, if no longer needed).
+  const auto release_chunk = [&](const Chunk& chunk) {
+    for (size_t i = 0; i < chunk.num_pages; ++i) {
+      lock_manager_->ReleasePageLock(chunk.seg_id, chunk.page_idx + i,
+                                     PageMode::kShared);
+    }
+    pages_in_window -= chunk.num_pages;
+    ring.Free();
+    if (!in_window(chunk.seg_id) &&
+        !(issue_seg.has_value() && issue_seg->sinfo.id() == chunk.seg_id)) {
+      lock_manager_->ReleaseSegmentLock(chunk.seg_id, SegmentMode::kPageRead);
+    }
+  };
+
+  // The workspace buffer is used for the overflow pages.
+  void* overflow_buf = WorkspaceBuffer();
+  Page overflow_page(overflow_buf);
+  key_utils::IntKeyAsSlice start_key_slice_helper(start_key);
+  const Slice start_key_slice = start_key_slice_helper.as<Slice>();
+  bool is_first_page = true;
+
+  issue_reads();
+  while (records_left > 0 && !window.empty()) {
+    Chunk chunk = std::move(window.front());
+    window.pop_front();
+    chunk.read.get();
+
+    for (size_t i = 0; i < chunk.num_pages && records_left > 0; ++i) {
+      Page page(chunk.buf + i * Page::kSize);
+      std::vector<Page::Iterator> page_its = {page.GetIterator()};
+      if (page.HasOverflow()) {
+        ReadPage(page.GetOverflow(), 0, overflow_buf);
+        page_its.push_back(overflow_page.GetIterator());
+      }
+      PageMergeIterator pmi(std::move(page_its),
+                            is_first_page ? &start_key_slice : nullptr);
+      const size_t records_before = records_left;
+      for (; records_left > 0 && pmi.Valid(); --records_left, pmi.Next()) {
+        values_out->emplace_back(key_utils::ExtractHead64(pmi.key()),
+                                 pmi.value().ToString());
+      }
+      if (!is_first_page && !pmi.Valid()) {
+        ++pages_scanned;
+        records_scanned += records_before - records_left;
+      }
+      is_first_page = false;
+      ++pages_used;
+    }
+
+    release_chunk(chunk);
+    if (records_left > 0) issue_reads();
+  }
+
+  // Wait for the reads we no longer need; they write into this thread's
+  // prefetch buffer, which the next scan will reuse.
+  while (!window.empty()) {
+    Chunk chunk = std::move(window.front());
+    window.pop_front();
+    chunk.read.wait();
+    release_chunk(chunk);
+  }
+  if (issue_seg.has_value()) {
+    lock_manager_->ReleaseSegmentLock(issue_seg->sinfo.id(),
+                                      SegmentMode::kPageRead);
+  }
+
+  PageGroupedDBStats::Local().BumpOverfetchedPages(pages_fetched - pages_used);
+  return Status::OK();
+}
+
 }  // namespace pg
 }  // namespace tl
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "arrival_process.h"
+#include "treeline/pg_latency_histogram.h"
+#include "ycsbr/ycsbr.h"
+
+namespace tl {
+namespace pg {
+
+struct OpenLoopResult {
+  // In requests per second.
+  double target_rate = 0;
+  double achieved_rate = 0;
+
+  size_t completed = 0;
+  // The number of requests that were issued after their intended start time
+  // (because their worker was still busy with earlier requests).
+  size_t late = 0;
+
+  // Measured from each request's intended start time (not from when it was
+  // actually issued), so queueing delays are included.
+  LatencyHistogram latency;
+};
+
+// Runs `workload`'s requests against `db` open-loop: requests are issued at
+// the arrival times generated by an `ArrivalProcess` (with `arrivals.rate`
+// split evenly across `num_workers` threads), whether or not earlier requests
+// have completed. The run ends after `duration` or when the workload runs out
+// of requests, whichever comes first.
+//
+// Each worker thread runs one of the workload's producers and has its own
+// arrival process (the sum of independent Poisson processes is a Poisson
+// process with the combined rate). A worker that falls behind issues its
+// queued requests back to back; their latency includes the time they spent
+// queued. This avoids the "coordinated omission" of closed-loop measurements.
+//
+// `DB` must implement the YCSBR database interface and `Workload` must
+// implement the YCSBR custom workload interface (`GetProducers()`). Writes
+// (`Insert()` and `Update()`) are serialized because
+// `PageGroupingInterface` buffers them in a single shared batch.
+template <typename DB, typename Workload>
+OpenLoopResult RunOpenLoop(DB& db, const Workload& workload,
+                           const ArrivalProcess::Options& arrivals,
+                           const size_t num_workers,
+                           const std::chrono::nanoseconds duration,
+                           const uint32_t seed) {
+  using Clock = std::chrono::steady_clock;
+  using Op = ycsbr::Request::Operation;
+
+  auto producers = workload.GetProducers(num_workers);
+  for (auto& producer : producers) {
+    producer.Prepare();
+  }
+
+  ArrivalProcess::Options worker_arrivals = arrivals;
+  worker_arrivals.rate = arrivals.rate / producers.size();
+
+  std::vector<OpenLoopResult> results(producers.size());
+  std::vector<Clock::time_point> last_completions(producers.size());
+  std::mutex write_mutex;
+
+  // Leave some time for the workers to start before the first arrival.
+  const Clock::time_point start = Clock::now() + std::chrono::milliseconds(10);
+  const Clock::time_point end = start + duration;
+
+  const auto run_worker = [&](const size_t worker_id) {
+    db.InitializeWorker(std::this_thread::get_id());
+    auto& producer = producers[worker_id];
+    OpenLoopResult& result = results[worker_id];
+    ArrivalProcess process(worker_arrivals, seed + worker_id);
+
+    std::string value_out;
+    std::vector<std::pair<ycsbr::Request::Key, std::string>> scan_out;
+    Clock::time_point last_completion = start;
+    while (producer.HasNext()) {
+      const Clock::time_point intended = start + process.Next();
+      if (intended >= end) break;
+
+      // Sleeping is too coarse for short waits, so we spin instead.
+      static constexpr auto kSpinThreshold = std::chrono::microseconds(100);
+      Clock::time_point now = Clock::now();
+      if (now >= intended) {
+        ++result.late;
+      } else {
+        if (intended - now > kSpinThreshold) {
+          std::this_thread::sleep_until(intended - kSpinThreshold);
+        }
+        while (Clock::now() < intended) {
+        }
+      }
+
+      const ycsbr::Request& req = producer.Next();
+      switch (req.op) {
+        case Op::kRead:
+        case Op::kNegativeRead:
+          db.Read(req.key, &value_out);
+          break;
+        case Op::kInsert: {
+          std::unique_lock<std::mutex> lock(write_mutex);
+          db.Insert(req.key, req.value, req.value_size);
+          break;
+        }
+        case Op::kUpdate: {
+          std::unique_lock<std::mutex> lock(write_mutex);
+          db.Update(req.key, req.value, req.value_size);
+          break;
+        }
+        case Op::kScan:
+          scan_out.clear();
+          db.Scan(req.key, req.scan_amount, &scan_out);
+          break;
+        default: {
+          // Read-modify-writes.
+          db.Read(req.key, &value_out);
+          std::unique_lock<std::mutex> lock(write_mutex);
+          db.Update(req.key, req.value, req.value_size);
+          break;
+        }
+      }
+
+      last_completion = Clock::now();
+      result.latency.Record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(last_completion -
+                                                               intended)
+              .count());
+      ++result.completed;
+    }
+    last_completions[worker_id] = last_completion;
+    db.ShutdownWorker(std::this_thread::get_id());
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(producers.size());
+  for (size_t i = 0; i < producers.size(); ++i) {
+    workers.emplace_back(run_worker, i);
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  OpenLoopResult total;
+  total.target_rate = arrivals.rate;
+  for (const auto& result : results) {
+    total.completed += result.completed;
+    total.late += result.late;
+    total.latency.Merge(result.latency);
+  }
+  const Clock::time_point last_completion =
+      *std::max_element(last_completions.begin(), last_completions.end());
+  const double elapsed_s =
+      std::chrono::duration<double>(last_completion - start).count();
+  if (elapsed_s > 0) {
+    total.achieved_rate = total.completed / elapsed_s;
+  }
+  return total;
+}
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,166 @@
+#include "io_trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "page.h"
+
+namespace {
+
+// All I/O trace files start with these eight bytes.
+constexpr char kSignature[8] = {'P', 'G', 'I', 'O', 'T', 'R', 'C', '\0'};
+
+// The current trace file format version. This value should be incremented
+// when a breaking change is made to the file format.
+constexpr uint32_t kFormatVersion = 1;
+
+// The number of records buffered before they are written to the trace file.
+constexpr size_t kBufferedRecords = 4096;
+
+// Used to assign compact thread IDs.
+std::atomic<uint32_t> next_thread_id(0);
+
+uint32_t ThreadId() {
+  thread_local const uint32_t id = next_thread_id.fetch_add(1);
+  return id;
+}
+
+void WriteAll(const int fd, const void* data, const size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  size_t written = 0;
+  while (written < size) {
+    const ssize_t res = write(fd, bytes + written, size - written);
+    if (res < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << __FILE__ << ":" << __LINE__ << " " << strerror(errno)
+                << std::endl;
+      exit(1);
+    }
+    written += res;
+  }
+}
+
+int OpenTraceFile(const std::filesystem::path& trace_file) {
+  const int fd = open(trace_file.c_str(), O_CREAT | O_WRONLY | O_TRUNC,
+                      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd < 0) {
+    std::cerr << __FILE__ << ":" << __LINE__ << " " << strerror(errno)
+              << std::endl;
+    exit(1);
+  }
+  return fd;
+}
+
+}  // namespace
+
+namespace tl {
+namespace pg {
+
+thread_local IOCause IOTracer::current_cause_ = IOCause::kUnknown;
+
+const char* IOCauseName(const IOCause cause) {
+  switch (cause) {
+    case IOCause::kUnknown:
+      return "unknown";
+    case IOCause::kGet:
+      return "get";
+    case IOCause::kScan:
+      return "scan";
+    case IOCause::kWriteout:
+      return "writeout";
+    case IOCause::kRewrite:
+      return "rewrite";
+    case IOCause::kFlatten:
+      return "flatten";
+    case IOCause::kLoad:
+      return "load";
+  }
+  return "unknown";
+}
+
+IOTracer::IOTracer(const std::filesystem::path& trace_file)
+    : start_(Clock::now()), fd_(OpenTraceFile(trace_file)) {
+  IOTraceHeader header;
+  memcpy(header.signature, kSignature, sizeof(kSignature));
+  header.version = kFormatVersion;
+  header.page_size = Page::kSize;
+  header.start_time_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  WriteAll(fd_, &header, sizeof(header));
+  buffer_.reserve(kBufferedRecords);
+}
+
+IOTracer::~IOTracer() {
+  Flush();
+  close(fd_);
+}
+
+void IOTracer::Record(const size_t file_id, const size_t offset,
+                      const size_t num_pages, const bool is_write) {
+  IOTraceRecord record;
+  record.timestamp_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start_)
+          .count();
+  record.offset = offset;
+  record.thread_id = ThreadId();
+  record.num_pages = num_pages;
+  record.file_id = file_id;
+  record.kind = (static_cast<uint8_t>(current_cause_) << 1) |
+                static_cast<uint8_t>(is_write);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  buffer_.push_back(record);
+  if (buffer_.size() >= kBufferedRecords) FlushImpl();
+}
+
+void IOTracer::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  FlushImpl();
+}
+
+void IOTracer::FlushImpl() {
+  if (buffer_.empty()) return;
+  WriteAll(fd_, buffer_.data(), buffer_.size() * sizeof(IOTraceRecord));
+  buffer_.clear();
+}
+
+Status IOTracer::ReadTrace(const std::filesystem::path& trace_file,
+                           IOTraceHeader* header_out,
+                           std::vector<IOTraceRecord>* records_out) {
+  std::ifstream in(trace_file, std::ios_base::in | std::ios_base::binary);
+  in.read(reinterpret_cast<char*>(header_out), sizeof(IOTraceHeader));
+  if (in.fail()) {
+    return Status::IOError("Failed to read I/O trace header.");
+  }
+  if (memcmp(header_out->signature, kSignature, sizeof(kSignature)) != 0) {
+    return Status::Corruption("Invalid I/O trace file signature.");
+  }
+  if (header_out->version != kFormatVersion) {
+    return Status::NotSupported("I/O trace format version is unsupported:",
+                                std::to_string(header_out->version));
+  }
+
+  records_out->clear();
+  IOTraceRecord record;
+  while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+    records_out->push_back(record);
+  }
+  if (in.gcount() != 0) {
+    return Status::Corruption("I/O trace ends with a partial record.");
+  }
+  return Status::OK();
+}
+
+}  // namespace pg
+}  // namespace tl
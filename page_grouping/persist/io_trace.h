@@ -0,0 +1,147 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "treeline/status.h"
+
+namespace tl {
+namespace pg {
+
+// The reason a segment file read or write was issued.
+enum class IOCause : uint8_t {
+  kUnknown = 0,
+  kGet = 1,
+  kScan = 2,
+  kWriteout = 3,
+  kRewrite = 4,
+  kFlatten = 5,
+  kLoad = 6,
+};
+inline constexpr size_t kNumIOCauses = 7;
+
+const char* IOCauseName(IOCause cause);
+
+// I/O trace file format
+// =====================
+// [Header]
+// Signature (8 bytes)
+// Format version (uint32; 4 bytes)
+// Page size (uint32; 4 bytes)
+// Wall clock time when the trace started (uint64 ns since the epoch; 8 bytes)
+//
+// [Records]
+// Zero or more `IOTraceRecord`s (24 bytes each), in the order in which they
+// were flushed. Records from different threads may be slightly out of
+// timestamp order.
+//
+// Both parts are written in the machine's native byte order.
+struct IOTraceHeader {
+  char signature[8];
+  uint32_t version;
+  uint32_t page_size;
+  uint64_t start_time_ns;
+};
+static_assert(sizeof(IOTraceHeader) == 24);
+
+struct IOTraceRecord {
+  // When the I/O was issued, relative to when the trace started.
+  uint64_t timestamp_ns;
+  // The byte offset in the segment file.
+  uint64_t offset;
+  // Identifies the issuing thread. The IDs are small integers assigned in the
+  // order in which threads first issue traced I/O.
+  uint32_t thread_id;
+  uint16_t num_pages;
+  // The index of the segment file (i.e., `SegmentId::GetFileId()`).
+  uint8_t file_id;
+  // The low bit is set for writes; the remaining bits store the `IOCause`.
+  uint8_t kind;
+
+  bool IsWrite() const { return (kind & 1) != 0; }
+  IOCause Cause() const { return static_cast<IOCause>(kind >> 1); }
+};
+static_assert(sizeof(IOTraceRecord) == 24);
+
+// Records the segment file I/O issued by the database into a compact binary
+// log (see `PageGroupedDBOptions::io_trace_path`). Each `SegmentFile` that has
+// a tracer attached calls `Record()` before issuing an I/O. The I/O's cause is
+// taken from the calling thread's current `IOCauseScope`.
+//
+// This class is thread-safe. Records are buffered in memory and appended to
+// the trace file in batches; the buffer is flushed when the tracer is
+// destroyed.
+class IOTracer {
+ public:
+  // Creates (or truncates) `trace_file`. The process exits if the file cannot
+  // be created (like `SegmentFile`).
+  explicit IOTracer(const std::filesystem::path& trace_file);
+  ~IOTracer();
+
+  IOTracer(const IOTracer&) = delete;
+  IOTracer& operator=(const IOTracer&) = delete;
+
+  void Record(size_t file_id, size_t offset, size_t num_pages, bool is_write);
+
+  // Writes out any buffered records.
+  void Flush();
+
+  // The cause that will be attributed to I/O issued by the calling thread.
+  static IOCause CurrentCause() { return current_cause_; }
+
+  // Reads a complete trace file.
+  static Status ReadTrace(const std::filesystem::path& trace_file,
+                          IOTraceHeader* header_out,
+                          std::vector<IOTraceRecord>* records_out);
+
+ private:
+  friend class IOCauseScope;
+  using Clock = std::chrono::steady_clock;
+
+  // The caller must hold `mutex_`.
+  void FlushImpl();
+
+  static thread_local IOCause current_cause_;
+
+  const Clock::time_point start_;
+  const int fd_;
+
+  std::mutex mutex_;
+  std::vector<IOTraceRecord> buffer_;
+};
+
+// Sets the calling thread's I/O cause for the lifetime of this object. Scopes
+// can be nested; the previous cause is restored when the scope ends (e.g., a
+// rewrite triggered during a write out is attributed to the rewrite).
+class IOCauseScope {
+ public:
+  explicit IOCauseScope(IOCause cause) : prev_(IOTracer::current_cause_) {
+    IOTracer::current_cause_ = cause;
+  }
+  ~IOCauseScope() { IOTracer::current_cause_ = prev_; }
+
+  IOCauseScope(const IOCauseScope&) = delete;
+  IOCauseScope& operator=(const IOCauseScope&) = delete;
+
+ private:
+  const IOCause prev_;
+};
+
+// Wraps `f` so that it runs with the calling thread's current I/O cause. This
+// is used to attribute I/O issued on the background threads to the operation
+// that submitted it.
+template <typename Function>
+auto WithIOCause(Function&& f) {
+  return [cause = IOTracer::CurrentCause(),
+          f = std::forward<Function>(f)]() mutable {
+    IOCauseScope scope(cause);
+    return f();
+  };
+}
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#define CHECK_ERROR(call)                                                    \
+  do {                                                                       \
+    if ((call) < 0) {                                                        \
+      const char* error = strerror(errno);                                   \
+      std::cerr << __FILE__ << ":" << __LINE__ << " " << error << std::endl; \
+      exit(1);                                                               \
+    }                                                                        \
+  } while (0)
+
+namespace tl {
+namespace pg {
+
+// The storage that a `SegmentFile` reads from and writes to. A `SegmentFile`
+// takes care of the page and segment bookkeeping; the backend only stores
+// bytes. Implementations must be thread-safe.
+class SegmentBackend {
+ public:
+  virtual ~SegmentBackend() = default;
+
+  // The size of the stored data (in bytes).
+  virtual size_t Size() const = 0;
+
+  // Reads (writes) `size` bytes at `offset`. The range must be within the
+  // stored data.
+  virtual void Read(size_t offset, void* data, size_t size) const = 0;
+  virtual void Write(size_t offset, const void* data, size_t size) const = 0;
+
+  // Extends the stored data by `size` zeroed bytes. Callers must serialize
+  // their calls to this method.
+  virtual void Grow(size_t size) = 0;
+
+  virtual void Sync() const = 0;
+};
+
+// Stores the data in a file. By default the file is opened for direct,
+// synchronous I/O.
+class PosixSegmentBackend : public SegmentBackend {
+ public:
+  PosixSegmentBackend(const std::filesystem::path& name,
+                      bool use_memory_based_io = false)
+      : fd_(-1), size_(0) {
+    int flags = O_CREAT | O_RDWR;
+    if (!use_memory_based_io) {
+      flags |= O_DIRECT;
+      flags |= O_SYNC;
+    }
+    CHECK_ERROR(
+        fd_ = open(name.c_str(), flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+
+    // Retrieve the file's size.
+    struct stat file_status;
+    CHECK_ERROR(fstat(fd_, &file_status));
+    assert(file_status.st_size >= 0);
+    size_ = file_status.st_size;
+  }
+
+  ~PosixSegmentBackend() override { close(fd_); }
+
+  PosixSegmentBackend(const PosixSegmentBackend&) = delete;
+  PosixSegmentBackend& operator=(const PosixSegmentBackend&) = delete;
+
+  size_t Size() const override { return size_; }
+
+  void Read(size_t offset, void* data, size_t size) const override {
+    CHECK_ERROR(pread(fd_, data, size, offset));
+  }
+
+  void Write(size_t offset, const void* data, size_t size) const override {
+    CHECK_ERROR(pwrite(fd_, data, size, offset));
+  }
+
+  // Uses `fallocate()` to expand the file; the newly allocated space is
+  // initialized to all zeros.
+  void Grow(size_t size) override {
+    CHECK_ERROR(fallocate(fd_, /*mode=*/0, /*offset=*/size_, /*len=*/size));
+    size_ += size;
+  }
+
+  void Sync() const override { CHECK_ERROR(fsync(fd_)); }
+
+ private:
+  int fd_;
+  size_t size_;
+};
+
+}  // namespace pg
+}  // namespace tl
@@ -1,33 +1,25 @@
 #pragma once
 
 #include <assert.h>
-#include <fcntl.h>
-#include <sys/stat.h>
-#include <unistd.h>
 
+#include <atomic>
 #include <cassert>
 #include <filesystem>
-#include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
 
 #include "bufmgr/page_memory_allocator.h"
 #include "treeline/status.h"
+#include "io_trace.h"
 #include "page.h"
-
-#define CHECK_ERROR(call)                                                    \
-  do {                                                                       \
-    if ((call) < 0) {                                                        \
-      const char* error = strerror(errno);                                   \
-      std::cerr << __FILE__ << ":" << __LINE__ << " " << error << std::endl; \
-      exit(1);                                                               \
-    }                                                                        \
-  } while (0)
+#include "segment_backend.h"
 
 namespace tl {
 namespace pg {
 
-// Adapted from `db/file.h`. This class is thread-safe.
+// Adapted from `db/file.h`. The pages are stored using a `SegmentBackend`
+// (a file, by default). This class is thread-safe.
 class SegmentFile {
   // The number of pages by which to grow a file when needed.
   const size_t kGrowthPages = 256;
@@ -36,31 +28,23 @@ class SegmentFile {
  public:
   // Represents an invalid file.
   SegmentFile()
-      : fd_(-1),
-        pages_per_segment_(0),
+      : pages_per_segment_(0),
         file_size_(0),
         next_page_allocation_offset_(0) {}
 
   SegmentFile(const std::filesystem::path& name, size_t pages_per_segment,
               bool use_memory_based_io = false)
-      : fd_(-1),
+      : SegmentFile(
+            std::make_unique<PosixSegmentBackend>(name, use_memory_based_io),
+            pages_per_segment) {}
+
+  SegmentFile(std::unique_ptr<SegmentBackend> backend,
+              size_t pages_per_segment)
+      : backend_(std::move(backend)),
         pages_per_segment_(pages_per_segment),
-        file_size_(0),
+        file_size_(backend_->Size()),
         next_page_allocation_offset_(0) {
     assert(pages_per_segment > 0);
-    int flags = O_CREAT | O_RDWR;
-    if (!use_memory_based_io) {
-      flags |= O_DIRECT;
-      flags |= O_SYNC;
-    }
-    CHECK_ERROR(
-        fd_ = open(name.c_str(), flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
-
-    // Retrieve the file's size.
-    struct stat file_status;
-    CHECK_ERROR(fstat(fd_, &file_status));
-    assert(file_status.st_size >= 0);
-    file_size_ = file_status.st_size;
 
     // If the file already existed, compute next_page_allocation_offset_. All
     // segments before this offset have been "allocated" (they are either valid
@@ -96,14 +80,6 @@ class SegmentFile {
     }
   }
 
-  ~SegmentFile() {
-    if (fd_ < 0) {
-      // A negative file descriptor signifies an invalid file.
-      return;
-    }
-    close(fd_);
-  }
-
   SegmentFile(const SegmentFile&) = delete;
   SegmentFile(const SegmentFile&&) = delete;
   SegmentFile& operator=(const SegmentFile&) = delete;
@@ -117,11 +93,22 @@ class SegmentFile {
 
   size_t PagesPerSegment() const { return pages_per_segment_; }
 
+  // Records all subsequent reads and writes to this file in `tracer` (if it
+  // is not null). `file_id` is the file's index among the segment files. This
+  // must be called before the file is used concurrently.
+  void SetTracer(IOTracer* tracer, size_t file_id) {
+    tracer_ = tracer;
+    file_id_ = file_id;
+  }
+
   Status ReadPages(size_t offset, void* data, size_t num_pages) const {
     if (offset >= next_page_allocation_offset_) {
       return Status::InvalidArgument("Tried to read from unallocated page.");
     }
-    CHECK_ERROR(pread(fd_, data, Page::kSize * num_pages, offset));
+    if (tracer_ != nullptr) {
+      tracer_->Record(file_id_, offset, num_pages, /*is_write=*/false);
+    }
+    backend_->Read(offset, data, Page::kSize * num_pages);
     return Status::OK();
   }
 
@@ -129,11 +116,14 @@ class SegmentFile {
     if (offset >= next_page_allocation_offset_) {
       return Status::InvalidArgument("Tried to write to unallocated page.");
     }
-    CHECK_ERROR(pwrite(fd_, data, Page::kSize * num_pages, offset));
+    if (tracer_ != nullptr) {
+      tracer_->Record(file_id_, offset, num_pages, /*is_write=*/true);
+    }
+    backend_->Write(offset, data, Page::kSize * num_pages);
     return Status::OK();
   }
 
-  void Sync() const { CHECK_ERROR(fsync(fd_)); }
+  void Sync() const { backend_->Sync(); }
 
   // Reserves space for an additional segment in the file. This might involve
   // growing the file if needed, otherwise it just updates the bookkeeping.
@@ -151,9 +141,9 @@ class SegmentFile {
   // Ensures that the underlying file is large enough to be able to read/write
   // `Page::kSize` bytes starting at the given `offset`.
   //
-  // If the file is too small, this method will use `fallocate()` to expand the
-  // file; the newly allocated space will be initialized to all zeros. If the
-  // file is already large enough, this method will be a no-op.
+  // If the file is too small, this method will grow the backend's storage;
+  // the newly allocated space will be initialized to all zeros. If the file is
+  // already large enough, this method will be a no-op.
   void ExpandToIfNeeded(size_t offset) {
     if (file_size_ >= (offset + Page::kSize)) return;
 
@@ -161,17 +151,19 @@ class SegmentFile {
     while ((file_size_ + bytes_to_add) < (offset + Page::kSize))
       bytes_to_add += kGrowthBytes;
 
-    // Ensures the byte range [offset, offset + len) in the file has been
-    // allocated (allocate it and zero it out if not).
-    CHECK_ERROR(fallocate(fd_, /*mode=*/0, /*offset=*/file_size_,
-                          /*len=*/bytes_to_add));
+    backend_->Grow(bytes_to_add);
     file_size_ += bytes_to_add;
   }
 
-  // Never changed after initialization.
-  int fd_;
+  // Never changed after initialization. `backend_` is null for an invalid
+  // file.
+  std::unique_ptr<SegmentBackend> backend_;
   size_t pages_per_segment_;
 
+  // Set before the file is used concurrently (see `SetTracer()`).
+  IOTracer* tracer_ = nullptr;
+  size_t file_id_ = 0;
+
   // Protected by the mutex.
   std::mutex allocation_mutex_;
   size_t file_size_;
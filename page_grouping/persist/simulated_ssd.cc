@@ -0,0 +1,187 @@
+#include "simulated_ssd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <thread>
+
+namespace tl {
+namespace pg {
+
+// Stores a file's data on a `SimulatedSSDImpl`.
+class SimulatedSegmentBackend : public SegmentBackend {
+ public:
+  using FileData = SimulatedSSDImpl::FileData;
+
+  SimulatedSegmentBackend(std::shared_ptr<SimulatedSSDImpl> device,
+                          std::shared_ptr<FileData> file)
+      : device_(std::move(device)), file_(std::move(file)) {}
+
+  size_t Size() const override {
+    std::shared_lock<std::shared_mutex> lock(file_->mutex);
+    return file_->size;
+  }
+
+  void Read(size_t offset, void* data, size_t size) const override {
+    device_->ModelRequest(/*is_write=*/false, size);
+    char* out = reinterpret_cast<char*>(data);
+    ForEachChunk(offset, size, [&out](char* chunk_data, size_t chunk_size) {
+      memcpy(out, chunk_data, chunk_size);
+      out += chunk_size;
+    });
+  }
+
+  void Write(size_t offset, const void* data, size_t size) const override {
+    device_->ModelRequest(/*is_write=*/true, size);
+    const char* in = reinterpret_cast<const char*>(data);
+    ForEachChunk(offset, size, [&in](char* chunk_data, size_t chunk_size) {
+      memcpy(chunk_data, in, chunk_size);
+      in += chunk_size;
+    });
+  }
+
+  void Grow(size_t size) override {
+    std::unique_lock<std::shared_mutex> lock(file_->mutex);
+    file_->size += size;
+    while (file_->chunks.size() * FileData::kChunkBytes < file_->size) {
+      // The chunks are zeroed when they are allocated.
+      file_->chunks.emplace_back(new char[FileData::kChunkBytes]());
+    }
+  }
+
+  // The device does not lose writes, so there is nothing to do.
+  void Sync() const override {}
+
+ private:
+  // Calls `fn` on each chunk-contiguous part of the byte range
+  // [offset, offset + size).
+  template <typename Callable>
+  void ForEachChunk(size_t offset, size_t size, const Callable& fn) const {
+    std::shared_lock<std::shared_mutex> lock(file_->mutex);
+    assert(offset + size <= file_->size);
+    while (size > 0) {
+      const size_t chunk_idx = offset / FileData::kChunkBytes;
+      const size_t chunk_offset = offset % FileData::kChunkBytes;
+      const size_t chunk_size =
+          std::min(size, FileData::kChunkBytes - chunk_offset);
+      fn(file_->chunks[chunk_idx].get() + chunk_offset, chunk_size);
+      offset += chunk_size;
+      size -= chunk_size;
+    }
+  }
+
+  std::shared_ptr<SimulatedSSDImpl> device_;
+  std::shared_ptr<FileData> file_;
+};
+
+std::shared_ptr<SimulatedSSD> SimulatedSSD::Create(
+    const SimulatedSSDOptions& options) {
+  return std::make_shared<SimulatedSSDImpl>(options);
+}
+
+SimulatedSSDImpl::SimulatedSSDImpl(const SimulatedSSDOptions& options)
+    : options_(options),
+      channel_free_(std::max<size_t>(options.queue_depth, 1)),
+      bytes_since_gc_(0) {}
+
+void SimulatedSSDImpl::GetStats(SimulatedSSDStats* stats_out) const {
+  std::unique_lock<std::mutex> lock(model_mutex_);
+  *stats_out = stats_;
+}
+
+void SimulatedSSDImpl::ResetStats() {
+  std::unique_lock<std::mutex> lock(model_mutex_);
+  stats_ = SimulatedSSDStats();
+}
+
+size_t SimulatedSSDImpl::StoredBytes() const {
+  std::unique_lock<std::mutex> lock(files_mutex_);
+  size_t total = 0;
+  for (const auto& [path, file] : files_) {
+    std::shared_lock<std::shared_mutex> file_lock(file->mutex);
+    total += file->size;
+  }
+  return total;
+}
+
+std::unique_ptr<SegmentBackend> SimulatedSSDImpl::OpenFile(
+    const std::string& path) {
+  std::shared_ptr<FileData> file;
+  {
+    std::unique_lock<std::mutex> lock(files_mutex_);
+    auto& entry = files_[path];
+    if (entry == nullptr) entry = std::make_shared<FileData>();
+    file = entry;
+  }
+  return std::make_unique<SimulatedSegmentBackend>(shared_from_this(),
+                                                   std::move(file));
+}
+
+bool SimulatedSSDImpl::FileExists(const std::string& path) const {
+  std::unique_lock<std::mutex> lock(files_mutex_);
+  return files_.count(path) > 0;
+}
+
+void SimulatedSSDImpl::ModelRequest(const bool is_write, const size_t size) {
+  const auto now = Clock::now();
+  const std::chrono::nanoseconds latency = std::chrono::microseconds(
+      is_write ? options_.write_latency_us : options_.read_latency_us);
+  const uint64_t bandwidth_mib =
+      is_write ? options_.write_bandwidth_mib : options_.read_bandwidth_mib;
+  const std::chrono::nanoseconds transfer(
+      bandwidth_mib == 0 ? 0 : size * 1000000000ULL / (bandwidth_mib << 20));
+  const std::chrono::nanoseconds gc_stall =
+      std::chrono::microseconds(options_.gc_stall_us);
+
+  std::unique_lock<std::mutex> lock(model_mutex_);
+  bool run_gc = false;
+  if (is_write) {
+    ++stats_.writes;
+    stats_.bytes_written += size;
+    if (options_.gc_interval_bytes > 0) {
+      bytes_since_gc_ += size;
+      if (bytes_since_gc_ >= options_.gc_interval_bytes) {
+        bytes_since_gc_ %= options_.gc_interval_bytes;
+        ++stats_.gc_stalls;
+        run_gc = true;
+      }
+    }
+  } else {
+    ++stats_.reads;
+    stats_.bytes_read += size;
+  }
+  LatencyHistogram& histogram =
+      is_write ? stats_.write_latency : stats_.read_latency;
+
+  if (!options_.emulate_latency) {
+    histogram.Record(
+        (latency + transfer +
+         (run_gc ? gc_stall : std::chrono::nanoseconds(0)))
+            .count());
+    return;
+  }
+
+  if (run_gc) {
+    // The device stops servicing requests until the collection finishes.
+    const auto gc_end = std::max(now, bus_free_) + gc_stall;
+    bus_free_ = gc_end;
+    for (auto& channel_free : channel_free_) {
+      channel_free = std::max(channel_free, gc_end);
+    }
+  }
+  const auto channel =
+      std::min_element(channel_free_.begin(), channel_free_.end());
+  const auto start = std::max(now, *channel);
+  const auto completion = std::max(start + latency, bus_free_) + transfer;
+  bus_free_ = completion;
+  *channel = completion;
+  histogram.Record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(completion - now)
+          .count());
+  lock.unlock();
+
+  std::this_thread::sleep_until(completion);
+}
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "segment_backend.h"
+#include "treeline/pg_simulated_ssd.h"
+
+namespace tl {
+namespace pg {
+
+class SimulatedSSDImpl : public SimulatedSSD,
+                         public std::enable_shared_from_this<SimulatedSSDImpl> {
+ public:
+  explicit SimulatedSSDImpl(const SimulatedSSDOptions& options);
+
+  const SimulatedSSDOptions& options() const override { return options_; }
+  void GetStats(SimulatedSSDStats* stats_out) const override;
+  void ResetStats() override;
+  size_t StoredBytes() const override;
+
+  // Opens the file at `path` on this device, creating an empty file if it
+  // does not exist. The returned backend keeps the device alive.
+  std::unique_ptr<SegmentBackend> OpenFile(const std::string& path);
+  bool FileExists(const std::string& path) const;
+
+ private:
+  friend class SimulatedSegmentBackend;
+  using Clock = std::chrono::steady_clock;
+
+  // A file's data is stored in fixed size chunks so that growing the file
+  // does not move the existing data.
+  struct FileData {
+    static constexpr size_t kChunkBytes = 1024 * 1024;
+
+    // Protects `chunks` and `size` (not the data in the chunks).
+    mutable std::shared_mutex mutex;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t size = 0;
+  };
+
+  // Applies the performance model to a request of `size` bytes (and blocks
+  // until the request completes if `options_.emulate_latency` is set).
+  void ModelRequest(bool is_write, size_t size);
+
+  const SimulatedSSDOptions options_;
+
+  mutable std::mutex files_mutex_;
+  std::unordered_map<std::string, std::shared_ptr<FileData>> files_;
+
+  // Protects the model state and the statistics.
+  mutable std::mutex model_mutex_;
+  // The time at which each channel (and the data bus) finishes its current
+  // request.
+  std::vector<Clock::time_point> channel_free_;
+  Clock::time_point bus_free_;
+  // Bytes written since the last simulated garbage collection.
+  uint64_t bytes_since_gc_;
+  SimulatedSSDStats stats_;
+};
+
+}  // namespace pg
+}  // namespace tl
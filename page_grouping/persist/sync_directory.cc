@@ -0,0 +1,25 @@
+#include "sync_directory.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace tl {
+namespace pg {
+
+Status SyncDirectory(const std::filesystem::path& dir) {
+  const int dir_fd = open(dir.c_str(), O_DIRECTORY | O_RDONLY);
+  if (dir_fd < 0) {
+    return Status::FromPosixError("Opening DB directory:", errno);
+  }
+  if (fsync(dir_fd) < 0) {
+    const int err_code = errno;
+    close(dir_fd);
+    return Status::FromPosixError("Syncing DB directory:", err_code);
+  }
+  close(dir_fd);
+  return Status::OK();
+}
+
+}  // namespace pg
+}  // namespace tl
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <filesystem>
+
+#include "treeline/status.h"
+
+namespace tl {
+namespace pg {
+
+// Calls `fsync()` on the directory `dir`. Used to persist the creation,
+// renaming, or removal of a file in `dir`.
+Status SyncDirectory(const std::filesystem::path& dir);
+
+}  // namespace pg
+}  // namespace tl
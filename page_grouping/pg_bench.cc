@@ -1,17 +1,29 @@
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "bench/common/load_data.h"
+#include "bench/common/perf_counted_interface.h"
+#include "bench/common/perf_counters.h"
 #include "bench/common/startup.h"
 #include "config.h"
 #include "gflags/gflags.h"
+#include "key_range_stats.h"
+#include "lock_profiler.h"
+#include "open_loop.h"
 #include "pg_interface.h"
+#include "treeline/pg_stats.h"
 #include "ycsbr/gen.h"
 
 namespace {
 
 namespace fs = std::filesystem;
+using Session = ycsbr::Session<
+    tl::bench::PerfCountedInterface<tl::pg::PageGroupingInterface>>;
 
 DEFINE_string(output_path, ".",
               "A path to where the results should be written.");
@@ -31,6 +43,37 @@ DEFINE_uint32(latency_sample_period, 1,
               "The number of requests between latency measurements (i.e., "
               "measure latency every N-th request).");
 
+DEFINE_bool(latency_breakdown, false,
+            "If set, the latency of each phase of the database's operations "
+            "(e.g., index lookups, page reads, rewrites) will be tracked and "
+            "written to latency_breakdown.csv.");
+
+DEFINE_string(open_loop_rates, "",
+              "If set, the workload is run open-loop (requests are issued at "
+              "a target rate, whether or not earlier requests have completed) "
+              "once for each of these comma-separated rates, in requests per "
+              "second across all threads. Latencies are measured from each "
+              "request's intended start time and the resulting "
+              "latency-throughput curve is written to open_loop.csv.");
+DEFINE_string(open_loop_arrivals, "poisson",
+              "The open-loop arrival process: 'poisson' or 'bursty'.");
+DEFINE_double(open_loop_duration_s, 10,
+              "The maximum duration of each open-loop run, in seconds. A run "
+              "also ends if the workload runs out of requests.");
+DEFINE_double(burst_factor, 4,
+              "With bursty arrivals, the rate during a burst is this many "
+              "times the target rate.");
+DEFINE_double(burst_duty, 0.2,
+              "With bursty arrivals, the fraction of each burst period spent "
+              "in a burst (burst_factor * burst_duty must be at most 1).");
+DEFINE_uint32(burst_period_ms, 100,
+              "With bursty arrivals, the length of each burst period.");
+
+DEFINE_bool(perf_counters, false,
+            "If set, hardware performance counters (cycles, instructions, "
+            "LLC misses, branch misses) are measured on each worker thread "
+            "for each workload phase and written to perf_counters.csv.");
+
 DEFINE_bool(verbose, false,
             "If set, benchmark information will be printed to stderr.");
 DEFINE_uint32(seed, 42,
@@ -39,16 +82,27 @@ DEFINE_bool(notify_after_init, false,
             "If set to true, this process will send a SIGUSR1 signal to its "
             "parent process after database initialization completes.");
 
-ycsbr::BenchmarkResult Run(
-    ycsbr::Session<tl::pg::PageGroupingInterface>& session,
-    const ycsbr::gen::PhasedWorkload& workload) {
+// The simulated SSD's statistics for each workload phase (see `--sim_ssd`).
+std::vector<std::pair<std::string, tl::pg::SimulatedSSDStats>> sim_ssd_phases;
+
+void FinishSimulatedSSDPhase(Session& session, const std::string& name) {
+  tl::pg::SimulatedSSDStats stats;
+  if (!session.db().TakeSimulatedSSDStats(&stats)) return;
+  sim_ssd_phases.emplace_back(name, std::move(stats));
+}
+
+void Initialize(Session& session,
+                const ycsbr::gen::PhasedWorkload& workload) {
   if (!FLAGS_skip_load) {
     const auto load = workload.GetLoadTrace();
     session.Initialize();
     if (FLAGS_verbose) {
       std::cerr << "> Loading " << load.size() << " records..." << std::endl;
     }
+    tl::bench::PerfCounters::StartPhase("load");
     session.ReplayBulkLoadTrace(load);
+    tl::bench::PerfCounters::FinishPhase();
+    FinishSimulatedSSDPhase(session, "load");
   } else {
     if (FLAGS_verbose) {
       std::cerr << "> Skipping the initial data load." << std::endl;
@@ -56,21 +110,79 @@ ycsbr::BenchmarkResult Run(
     session.Initialize();
   }
 
+  if (FLAGS_notify_after_init) {
+    tl::bench::SendReadySignalToParent();
+  }
+}
+
+ycsbr::BenchmarkResult Run(
+    Session& session,
+    const ycsbr::gen::PhasedWorkload& workload) {
+  Initialize(session, workload);
   if (FLAGS_verbose) {
     std::cerr << "> Running workload using " << FLAGS_threads
               << " application thread(s)." << std::endl;
   }
 
-  if (FLAGS_notify_after_init) {
-    tl::bench::SendReadySignalToParent();
-  }
-
   ycsbr::RunOptions options;
   options.latency_sample_period = FLAGS_latency_sample_period;
   options.throughput_sample_period = FLAGS_throughput_sample_period;
   options.output_dir = std::filesystem::path(FLAGS_output_path);
   options.throughput_output_file_prefix = "throughput-";
-  return session.RunWorkload(workload, options);
+  tl::bench::PerfCounters::StartPhase("run");
+  auto result = session.RunWorkload(workload, options);
+  tl::bench::PerfCounters::FinishPhase();
+  FinishSimulatedSSDPhase(session, "run");
+  return result;
+}
+
+// Parses a comma-separated list of positive rates. Returns false if the list
+// is invalid.
+bool ParseRates(const std::string& list, std::vector<double>* rates_out) {
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    try {
+      size_t parsed = 0;
+      const double rate = std::stod(item, &parsed);
+      if (parsed != item.size() || rate <= 0) return false;
+      rates_out->push_back(rate);
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+  return !rates_out->empty();
+}
+
+// Runs the workload open-loop at each rate (see `--open_loop_rates`).
+std::vector<tl::pg::OpenLoopResult> RunOpenLoopSweep(
+    Session& session,
+    const ycsbr::gen::PhasedWorkload& workload,
+    const std::vector<double>& rates,
+    const tl::pg::ArrivalProcess::Options& arrivals) {
+  Initialize(session, workload);
+  const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::duration<double>(FLAGS_open_loop_duration_s));
+
+  std::vector<tl::pg::OpenLoopResult> results;
+  for (const double rate : rates) {
+    if (FLAGS_verbose) {
+      std::cerr << "> Running workload open-loop at " << rate
+                << " requests/s using " << FLAGS_threads << " thread(s)."
+                << std::endl;
+    }
+    tl::pg::ArrivalProcess::Options rate_arrivals = arrivals;
+    rate_arrivals.rate = rate;
+    std::stringstream phase_name;
+    phase_name << "open_loop_" << rate;
+    tl::bench::PerfCounters::StartPhase(phase_name.str());
+    results.push_back(tl::pg::RunOpenLoop(session.db(), workload,
+                                          rate_arrivals, FLAGS_threads,
+                                          duration, FLAGS_seed));
+    tl::bench::PerfCounters::FinishPhase();
+    FinishSimulatedSSDPhase(session, phase_name.str());
+  }
+  return results;
 }
 
 }  // namespace
@@ -89,6 +201,35 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  std::vector<double> open_loop_rates;
+  tl::pg::ArrivalProcess::Options arrivals;
+  if (!FLAGS_open_loop_rates.empty()) {
+    if (!ParseRates(FLAGS_open_loop_rates, &open_loop_rates)) {
+      std::cerr << "ERROR: --open_loop_rates must be a comma-separated list "
+                   "of positive rates."
+                << std::endl;
+      return 1;
+    }
+    if (FLAGS_open_loop_arrivals == "poisson") {
+      arrivals.kind = tl::pg::ArrivalProcess::Kind::kPoisson;
+    } else if (FLAGS_open_loop_arrivals == "bursty") {
+      arrivals.kind = tl::pg::ArrivalProcess::Kind::kBursty;
+    } else {
+      std::cerr << "ERROR: Unknown --open_loop_arrivals: "
+                << FLAGS_open_loop_arrivals << std::endl;
+      return 1;
+    }
+    if (FLAGS_burst_factor < 1 || FLAGS_burst_duty <= 0 ||
+        FLAGS_burst_duty >= 1 || FLAGS_burst_factor * FLAGS_burst_duty > 1 ||
+        FLAGS_burst_period_ms == 0) {
+      std::cerr << "ERROR: Invalid burst parameters." << std::endl;
+      return 1;
+    }
+    arrivals.burst_factor = FLAGS_burst_factor;
+    arrivals.burst_duty = FLAGS_burst_duty;
+    arrivals.burst_period = std::chrono::milliseconds(FLAGS_burst_period_ms);
+  }
+
   std::unique_ptr<ycsbr::gen::PhasedWorkload> workload =
       ycsbr::gen::PhasedWorkload::LoadFrom(FLAGS_workload_config, FLAGS_seed,
                                            FLAGS_record_size_bytes);
@@ -115,19 +256,43 @@ int main(int argc, char* argv[]) {
     fs::create_directory(FLAGS_output_path);
   }
   const fs::path output_dir = fs::path(FLAGS_output_path);
+  tl::pg::PageGroupedDBStats::SetLatencyTracking(FLAGS_latency_breakdown);
+  tl::bench::PerfCounters::SetEnabled(FLAGS_perf_counters);
 
   // Run benchmark.
-  ycsbr::Session<tl::pg::PageGroupingInterface> session(FLAGS_threads);
-  const auto result = Run(session, *workload);
-  if (FLAGS_verbose) {
-    std::cerr << "> Done running workload." << std::endl;
-  }
-  session.Terminate();
+  Session session(FLAGS_threads);
+  if (open_loop_rates.empty()) {
+    const auto result = Run(session, *workload);
+    if (FLAGS_verbose) {
+      std::cerr << "> Done running workload." << std::endl;
+    }
+    session.Terminate();
 
-  // Overall performance results.
-  {
+    // Overall performance results.
     std::ofstream overall(output_dir / "overall.csv");
     result.PrintAsCSV(overall, /*print_header=*/true);
+
+  } else {
+    const auto results =
+        RunOpenLoopSweep(session, *workload, open_loop_rates, arrivals);
+    if (FLAGS_verbose) {
+      std::cerr << "> Done running workload." << std::endl;
+    }
+    session.Terminate();
+
+    // Latency-throughput curve (latencies in nanoseconds).
+    std::ofstream out(output_dir / "open_loop.csv");
+    out << "target_rate,achieved_rate,completed,late,mean_ns,p50_ns,p90_ns,"
+           "p99_ns,p999_ns,max_ns"
+        << std::endl;
+    for (const auto& result : results) {
+      const auto& latency = result.latency;
+      out << result.target_rate << "," << result.achieved_rate << ","
+          << result.completed << "," << result.late << "," << latency.Mean()
+          << "," << latency.Percentile(50) << "," << latency.Percentile(90)
+          << "," << latency.Percentile(99) << "," << latency.Percentile(99.9)
+          << "," << latency.Max() << std::endl;
+    }
   }
 
   // Read I/O statistics.
@@ -150,5 +315,73 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  // Per key range write amplification statistics.
+  {
+    std::vector<tl::pg::PageGroupedDBKeyRangeStats> key_range_stats;
+    if (session.db().GetKeyRangeStats(&key_range_stats)) {
+      std::ofstream out(output_dir / "key_range_stats.csv");
+      tl::pg::KeyRangeStats::PrintAsCsv(out, key_range_stats);
+    }
+  }
+
+  // Lock contention statistics.
+  {
+    tl::pg::PageGroupedDBLockContentionStats contention;
+    if (session.db().GetLockContentionStats(&contention)) {
+      std::ofstream out(output_dir / "lock_contention.csv");
+      tl::pg::LockProfiler::PrintAsCsv(out, contention);
+      std::ofstream hot_out(output_dir / "hot_locks.csv");
+      tl::pg::LockProfiler::PrintHotLocksAsCsv(hot_out, contention);
+    }
+  }
+
+  // Simulated SSD I/O counts and modeled latencies (in nanoseconds).
+  if (!sim_ssd_phases.empty()) {
+    std::ofstream out(output_dir / "sim_ssd.csv");
+    out << "phase,op,requests,bytes,gc_stalls,mean_ns,p50_ns,p90_ns,p99_ns,"
+           "p999_ns,max_ns"
+        << std::endl;
+    for (const auto& [phase, stats] : sim_ssd_phases) {
+      const auto print_row = [&out, &phase = phase](
+                                 const char* op, uint64_t requests,
+                                 uint64_t bytes, uint64_t gc_stalls,
+                                 const tl::pg::LatencyHistogram& latency) {
+        out << phase << "," << op << "," << requests << "," << bytes << ","
+            << gc_stalls << "," << latency.Mean() << ","
+            << latency.Percentile(50) << "," << latency.Percentile(90) << ","
+            << latency.Percentile(99) << "," << latency.Percentile(99.9)
+            << "," << latency.Max() << std::endl;
+      };
+      print_row("read", stats.reads, stats.bytes_read, 0, stats.read_latency);
+      print_row("write", stats.writes, stats.bytes_written, stats.gc_stalls,
+                stats.write_latency);
+    }
+  }
+
+  // Hardware performance counters.
+  if (tl::bench::PerfCounters::HasResults()) {
+    std::ofstream out(output_dir / "perf_counters.csv");
+    tl::bench::PerfCounters::PrintAsCsv(out);
+  }
+
+  // Per-phase latency statistics (in nanoseconds).
+  if (FLAGS_latency_breakdown) {
+    using tl::pg::PageGroupedDBStats;
+    std::ofstream out(output_dir / "latency_breakdown.csv");
+    out << "phase,count,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns"
+        << std::endl;
+    PageGroupedDBStats::RunOnGlobal([&out](const auto& stats) {
+      for (size_t i = 0; i < PageGroupedDBStats::kNumLatencyPhases; ++i) {
+        const auto phase = static_cast<PageGroupedDBStats::LatencyPhase>(i);
+        const auto& latency = stats.GetLatency(phase);
+        out << PageGroupedDBStats::LatencyPhaseName(phase) << ","
+            << latency.Count() << "," << latency.Mean() << ","
+            << latency.Percentile(50) << "," << latency.Percentile(90) << ","
+            << latency.Percentile(99) << "," << latency.Percentile(99.9)
+            << "," << latency.Max() << std::endl;
+      }
+    });
+  }
+
   return 0;
 }
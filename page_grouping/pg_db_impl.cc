@@ -3,12 +3,57 @@
 #include <algorithm>
 #include <cassert>
 #include <functional>
+#include <sstream>
 
+#include "cache_manifest.h"
+#include "key_range_stats.h"
+#include "lock_profiler.h"
+#include "latency_timer.h"
 #include "treeline/pg_stats.h"
 #include "util/key.h"
 
 namespace fs = std::filesystem;
 
+namespace {
+
+const std::string kCacheManifestFileName = "CACHE_MANIFEST";
+
+// Formats `counts[i]` as "<sizes[i]>:<counts[i]>", separated by commas.
+template <typename Size>
+std::string FormatCountsBySize(const std::vector<Size>& sizes,
+                               const std::vector<uint64_t>& counts) {
+  std::stringstream out;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (i > 0) out << ",";
+    out << sizes[i] << ":" << counts[i];
+  }
+  return out.str();
+}
+
+// The properties supported by `PageGroupedDB::GetProperty()`.
+std::vector<std::pair<std::string, std::string>> FormatProperties(
+    const tl::pg::PageGroupedDBLiveStats& stats) {
+  std::vector<size_t> io_sizes(stats.page_reads_by_size.size());
+  for (size_t i = 0; i < io_sizes.size(); ++i) {
+    io_sizes[i] = i + 1;
+  }
+  return {
+      {"pg.cache-hit-ratio", std::to_string(stats.cache_hit_ratio)},
+      {"pg.cache-dirty-ratio", std::to_string(stats.cache_dirty_ratio)},
+      {"pg.segments-by-size",
+       FormatCountsBySize(stats.segment_page_counts, stats.segments_by_size)},
+      {"pg.overflowed-segments", std::to_string(stats.overflowed_segments)},
+      {"pg.reorg-backlog-pages", std::to_string(stats.reorg_backlog_pages)},
+      {"pg.free-list-bytes", std::to_string(stats.free_list_bytes)},
+      {"pg.page-reads-by-size",
+       FormatCountsBySize(io_sizes, stats.page_reads_by_size)},
+      {"pg.page-writes-by-size",
+       FormatCountsBySize(io_sizes, stats.page_writes_by_size)},
+  };
+}
+
+}  // namespace
+
 namespace tl {
 namespace pg {
 
@@ -19,6 +64,16 @@ static thread_local size_t thread_id_ = ([]() {
 Status PageGroupedDB::Open(const PageGroupedDBOptions& options,
                            const std::filesystem::path& db_path,
                            PageGroupedDB** db_out) {
+  if (options.rec_cache_background_writeback &&
+      !(options.rec_cache_writeback_low_watermark >= 0.0 &&
+        options.rec_cache_writeback_low_watermark <
+            options.rec_cache_writeback_high_watermark &&
+        options.rec_cache_writeback_high_watermark <= 1.0)) {
+    return Status::InvalidArgument(
+        "The record cache writeback watermarks must satisfy 0 <= low < high "
+        "<= 1.");
+  }
+
   // TODO: This open logic could be improved, but it is good enough for our
   // current use cases.
   if (std::filesystem::exists(db_path) &&
@@ -53,33 +108,181 @@ PageGroupedDBImpl::PageGroupedDBImpl(fs::path db_path,
                          options_.forecasting.num_partitions,
                          options_.forecasting.sample_size,
                          options_.forecasting.random_seed)
-                   : nullptr) {
+                   : nullptr),
+      combiner_(options_.write_combining
+                    ? std::make_unique<WriteCombiner>(
+                          std::bind(&PageGroupedDBImpl::PutBatch, this,
+                                    std::placeholders::_1),
+                          std::bind(&PageGroupedDBImpl::GetPageBoundsFor, this,
+                                    std::placeholders::_1))
+                    : nullptr),
+      wrote_records_(false),
+      writeback_high_dirty_(options_.record_cache_capacity *
+                            options_.rec_cache_writeback_high_watermark),
+      writeback_low_dirty_(options_.record_cache_capacity *
+                           options_.rec_cache_writeback_low_watermark),
+      writeback_scheduled_(false),
+      writeback_shutdown_(false) {
+  if (options_.numa_aware) {
+    cache_.ConfigureNuma(options_.rec_cache_numa_interleave,
+                         /*sample_accesses=*/true);
+  }
   if (mgr_.has_value()) mgr_->SetTracker(tracker_);
+  if (mgr_.has_value()) {
+    if (options_.rec_cache_persist && !options_.bypass_cache) {
+      StartCacheWarmUp();
+    } else {
+      // A manifest left behind by an earlier run would become stale once this
+      // run modifies the DB, so it cannot be used by a later run either.
+      CacheManifest::Remove(db_path_ / kCacheManifestFileName);
+    }
+  }
+  if (options_.rec_cache_background_writeback && !options_.bypass_cache) {
+    writeback_worker_ =
+        std::thread(&PageGroupedDBImpl::WritebackWorkerMain, this);
+  }
 }
 
 PageGroupedDBImpl::~PageGroupedDBImpl() {
+  WaitForCacheWarmUp();
+  StopWritebackWorker();
   if (!mgr_.has_value()) return;
 
   // Record statistics before shutting down.
   mgr_->PostStats();
   PageGroupedDBStats::Local().SetCacheBytes(cache_.GetSizeFootprintEstimate());
 
-  if (!options_.parallelize_final_flush || options_.bypass_cache) return;
+  if (options_.bypass_cache) return;
+
+  if (options_.parallelize_final_flush) {
+    // When the destructor runs, no external threads should be running any
+    // methods on this class. So it is safe invoke non-thread-safe methods here.
+    const auto slice_records = cache_.ExtractDirty();
+    std::vector<std::pair<Key, Slice>> records;
+    records.reserve(slice_records.size());
+    for (const auto& slice_rec : slice_records) {
+      records.emplace_back(key_utils::ExtractHead64(slice_rec.first),
+                           slice_rec.second);
+    }
+    std::sort(records.begin(), records.end(),
+              [](const auto& left, const auto& right) {
+                return left.first < right.first;
+              });
+    mgr_->PutBatchParallel(records);
+  }
+
+  if (options_.rec_cache_persist) {
+    PersistCache();
+  }
+}
 
-  // When the destructor runs, no external threads should be running any methods
-  // on this class. So it is safe invoke non-thread-safe methods here.
-  const auto slice_records = cache_.ExtractDirty();
-  std::vector<std::pair<Key, Slice>> records;
-  records.reserve(slice_records.size());
-  for (const auto& slice_rec : slice_records) {
-    records.emplace_back(key_utils::ExtractHead64(slice_rec.first),
-                         slice_rec.second);
+void PageGroupedDBImpl::PersistCache() {
+  // Values are only persisted if they are clean (otherwise a crash before the
+  // cache is flushed could leave stale records on disk but newer records in
+  // the cache manifest).
+  if (options_.rec_cache_persist_values) {
+    cache_.WriteOutDirty();
   }
-  std::sort(records.begin(), records.end(),
+
+  std::vector<CacheManifest::Entry> entries;
+  cache_.ForEachRecord(
+      [this, &entries](const Slice& key, const Slice& value, uint8_t priority) {
+        entries.push_back(CacheManifest::Entry{
+            key_utils::ExtractHead64(key), priority,
+            options_.rec_cache_persist_values ? value.ToString()
+                                              : std::string()});
+      });
+  std::sort(entries.begin(), entries.end(),
             [](const auto& left, const auto& right) {
-              return left.first < right.first;
+              return left.key < right.key;
             });
-  mgr_->PutBatchParallel(records);
+
+  const CacheManifest manifest(std::move(entries),
+                               options_.rec_cache_persist_values);
+  // Persisting the cache is best-effort; the DB can still be reopened with a
+  // cold cache if this fails.
+  manifest.WriteTo(db_path_ / kCacheManifestFileName);
+}
+
+void PageGroupedDBImpl::StartCacheWarmUp() {
+  const fs::path manifest_path = db_path_ / kCacheManifestFileName;
+  if (!fs::exists(manifest_path)) return;
+
+  Status status;
+  std::optional<CacheManifest> manifest =
+      CacheManifest::LoadFrom(manifest_path, &status);
+  // The manifest is only valid for the DB state at shutdown, so it must be
+  // removed before the DB is modified. If it cannot be removed, it is not
+  // used either (a later run could otherwise load it again).
+  if (!CacheManifest::Remove(manifest_path).ok()) return;
+  if (!status.ok() || !manifest.has_value()) return;
+
+  std::vector<CacheManifest::Entry> entries = manifest->entries();
+
+  // Keep the highest priority records if the cache is now smaller.
+  if (entries.size() > options_.record_cache_capacity) {
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto& left, const auto& right) {
+                       return left.priority > right.priority;
+                     });
+    entries.resize(options_.record_cache_capacity);
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& left, const auto& right) {
+                return left.key < right.key;
+              });
+  }
+
+  warm_up_done_ =
+      mgr_->RunInBackground([this, entries = std::move(entries),
+                             has_values = manifest->has_values()]() {
+             WarmUpCache(entries, has_values);
+           }).share();
+}
+
+void PageGroupedDBImpl::WarmUpCache(
+    const std::vector<CacheManifest::Entry>& entries, const bool has_values) {
+  cache_.GetMasstreePointer()->thread_init(thread_id_);
+
+  // Records that are already cached are not overwritten (they are at least as
+  // fresh). The manifest's values match the page files until this run writes
+  // records to them, so the remaining records are read from disk after that.
+  auto entry_it = entries.begin();
+  if (has_values) {
+    for (; entry_it != entries.end(); ++entry_it) {
+      if (wrote_records_.load(std::memory_order_acquire)) break;
+      const key_utils::IntKeyAsSlice key_slice_helper(entry_it->key);
+      cache_.PutFromRead(key_slice_helper.as<Slice>(), entry_it->value,
+                         entry_it->priority);
+    }
+    if (entry_it == entries.end()) return;
+  }
+
+  // Read the records from disk. The keys are sorted, so the reads are batched
+  // by page.
+  std::vector<Key> keys;
+  keys.reserve(entries.end() - entry_it);
+  for (auto it = entry_it; it != entries.end(); ++it) {
+    keys.push_back(it->key);
+  }
+  std::vector<std::pair<Key, std::string>> records;
+  if (!mgr_->GetBatchParallel(keys, &records).ok()) return;
+
+  // `records` is sorted and is a subset of the remaining entries (some records
+  // may no longer exist).
+  for (const auto& record : records) {
+    while (entry_it != entries.end() && entry_it->key < record.first) {
+      ++entry_it;
+    }
+    if (entry_it == entries.end()) break;
+    const key_utils::IntKeyAsSlice key_slice_helper(record.first);
+    cache_.PutFromRead(key_slice_helper.as<Slice>(), record.second,
+                       entry_it->priority);
+  }
+}
+
+Status PageGroupedDBImpl::WaitForCacheWarmUp() {
+  if (warm_up_done_.valid()) warm_up_done_.wait();
+  return Status::OK();
 }
 
 Status PageGroupedDBImpl::BulkLoad(const std::vector<Record>& records) {
@@ -121,6 +324,7 @@ Status PageGroupedDBImpl::BulkLoad(const std::vector<Record>& records) {
 
 Status PageGroupedDBImpl::Put(const WriteOptions& options, const Key key,
                               const Slice& value) {
+  PhaseTimer timer(PhaseTimer::Phase::kPut);
   if (!mgr_.has_value()) {
     return Status::NotSupported(
         "DB must be bulk loaded before any writes are allowed.");
@@ -135,17 +339,22 @@ Status PageGroupedDBImpl::Put(const WriteOptions& options, const Key key,
     s = cache_.Put(key_slice.as<Slice>(), value, /*is_dirty=*/true,
                    format::WriteType::kWrite, RecordCache::kDefaultPriority,
                    /*safe=*/true);
+    MaybeScheduleWriteback();
   } else {
-    s = mgr_->PutBatch({{key, value}});
+    s = WriteSorted({{key, value}});
   }
 
   // Track successful genuine inserts.
   if (tracker_ != nullptr && s.ok() && !options.is_update) tracker_->Add(key);
+  if (s.ok()) {
+    mgr_->RecordUserWrite(key, sizeof(Key) + value.size(), !options.is_update);
+  }
 
   return s;
 }
 
 Status PageGroupedDBImpl::Get(const Key key, std::string* value_out) {
+  PhaseTimer timer(PhaseTimer::Phase::kGet);
   if (!mgr_.has_value()) return Status::NotFound("DB is empty.");
   cache_.GetMasstreePointer()->thread_init(thread_id_);
   if (key == Manager::kMinReservedKey || key == Manager::kMaxReservedKey) {
@@ -157,23 +366,43 @@ Status PageGroupedDBImpl::Get(const Key key, std::string* value_out) {
 
   // 1. Search the record cache.
   if (!options_.bypass_cache) {
-    uint64_t cache_index;
+    format::WriteType write_type;
+    PhaseTimer cache_timer(PhaseTimer::Phase::kGetCacheLookup);
     const Status cache_status =
-        cache_.GetCacheIndex(key_slice, /*exclusive=*/false, &cache_index);
+        cache_.GetCacheValue(key_slice, value_out, &write_type);
+    cache_timer.Stop();
     if (cache_status.ok()) {
-      auto entry = &RecordCache::cache_entries[cache_index];
-      if (entry->IsDelete()) {
-        entry->Unlock();
+      if (write_type == format::WriteType::kDelete) {
+        value_out->clear();
         return Status::NotFound("Key not found.");
       }
-      value_out->assign(entry->GetValue().data(), entry->GetValue().size());
-      entry->Unlock();
       return cache_status;
     }
   }
 
   // 2. Go to disk. Cache the record if found.
-  auto [status, pages] = mgr_->GetWithPages(key, value_out);
+  //
+  // If we read in every page that can hold keys in the main page's key range,
+  // the range will be fully cached after we optimistically cache the pages.
+  // The page fences are inclusive. The range must be registered while the
+  // pages are still locked: a record in the range that is written back (and
+  // evicted) after we read the pages would otherwise not invalidate the range.
+  bool cache_whole_range = false;
+  Key range_lower = 0, range_upper = 0;
+  const auto begin_caching_range = [&](const Status& status,
+                                       const std::vector<pg::Page>& pages) {
+    cache_whole_range =
+        status.ok() && (pages.size() > 1 || !pages[0].HasOverflow());
+    if (!cache_whole_range) return;
+    range_lower = key_utils::ExtractHead64(pages[0].GetLowerBoundary());
+    range_upper = key_utils::ExtractHead64(pages[0].GetUpperBoundary()) + 1;
+    cache_.BeginCachingRange(range_lower, range_upper);
+  };
+  auto [status, pages] = mgr_->GetWithPages(
+      key, value_out,
+      options_.optimistic_caching && !options_.bypass_cache
+          ? Manager::PagesReadFn(begin_caching_range)
+          : nullptr);
   if (!status.ok() || options_.bypass_cache) return status;
 
   cache_.PutFromRead(key_slice, Slice(*value_out),
@@ -186,14 +415,104 @@ Status PageGroupedDBImpl::Get(const Key key, std::string* value_out) {
       }
     }
   }
+  if (cache_whole_range) cache_.FinishCachingRange(range_lower, range_upper);
 
   return status;
 }
 
+Status PageGroupedDBImpl::MultiGet(const std::vector<Key>& keys,
+                                   std::vector<std::string>* values_out,
+                                   std::vector<Status>* statuses_out) {
+  values_out->clear();
+  values_out->resize(keys.size());
+  if (!mgr_.has_value()) {
+    statuses_out->assign(keys.size(), Status::NotFound("DB is empty."));
+    return Status::OK();
+  }
+  statuses_out->assign(keys.size(), Status::NotFound("Key not found."));
+  cache_.GetMasstreePointer()->thread_init(thread_id_);
+
+  // 1. Search the record cache. `to_read` holds the indices of the keys that
+  // need to be read from disk.
+  std::vector<size_t> to_read;
+  if (!options_.bypass_cache) {
+    std::vector<key_utils::IntKeyAsSlice> key_slice_helpers(keys.begin(),
+                                                            keys.end());
+    std::vector<Slice> key_slices;
+    key_slices.reserve(keys.size());
+    for (const auto& helper : key_slice_helpers) {
+      key_slices.push_back(helper.as<Slice>());
+    }
+    std::vector<format::WriteType> write_types;
+    std::vector<bool> found;
+    cache_.GetCacheValues(key_slices, values_out, &write_types, &found);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] == Manager::kMinReservedKey ||
+          keys[i] == Manager::kMaxReservedKey) {
+        (*values_out)[i].clear();
+        (*statuses_out)[i] = Status::NotFound("Reserved keys cannot be used.");
+      } else if (!found[i]) {
+        to_read.push_back(i);
+      } else if (write_types[i] == format::WriteType::kDelete) {
+        (*values_out)[i].clear();
+      } else {
+        (*statuses_out)[i] = Status::OK();
+      }
+    }
+  } else {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] == Manager::kMinReservedKey ||
+          keys[i] == Manager::kMaxReservedKey) {
+        (*statuses_out)[i] = Status::NotFound("Reserved keys cannot be used.");
+      } else {
+        to_read.push_back(i);
+      }
+    }
+  }
+  if (to_read.empty()) return Status::OK();
+
+  // 2. Go to disk, reading the keys in ascending order.
+  std::sort(to_read.begin(), to_read.end(),
+            [&keys](const size_t left, const size_t right) {
+              return keys[left] < keys[right];
+            });
+  std::vector<Key> sorted_keys;
+  sorted_keys.reserve(to_read.size());
+  for (const size_t idx : to_read) {
+    if (sorted_keys.empty() || sorted_keys.back() != keys[idx]) {
+      sorted_keys.push_back(keys[idx]);
+    }
+  }
+  std::vector<std::pair<Key, std::string>> records;
+  const Status status = mgr_->GetBatchParallel(sorted_keys, &records);
+  if (!status.ok()) return status;
+
+  // `records` is sorted and only contains the keys that exist. Cache the
+  // records that were read (we do not optimistically cache their pages).
+  auto record_it = records.begin();
+  for (const size_t idx : to_read) {
+    while (record_it != records.end() && record_it->first < keys[idx]) {
+      ++record_it;
+    }
+    if (record_it == records.end() || record_it->first != keys[idx]) continue;
+    (*values_out)[idx] = record_it->second;
+    (*statuses_out)[idx] = Status::OK();
+  }
+  if (!options_.bypass_cache) {
+    for (const auto& record : records) {
+      const key_utils::IntKeyAsSlice key_slice_helper(record.first);
+      cache_.PutFromRead(key_slice_helper.as<Slice>(), record.second,
+                         RecordCache::kDefaultPriority);
+    }
+  }
+  return Status::OK();
+}
+
 Status PageGroupedDBImpl::GetRange(
     const Key start_key, const size_t num_records,
     std::vector<std::pair<Key, std::string>>* results_out,
     bool use_experimental_prefetch) {
+  PhaseTimer timer(PhaseTimer::Phase::kGetRange);
   if (!mgr_.has_value()) {
     results_out->clear();
     return Status::OK();
@@ -205,26 +524,38 @@ Status PageGroupedDBImpl::GetRange(
         "The scan start key is reserved and cannot be used.");
   }
 
-  const key_utils::IntKeyAsSlice key_slice_helper(start_key);
+  // Serve the part of the scan that falls in fully cached key ranges directly
+  // from the record cache (without any I/O).
+  Key scan_start_key = start_key;
+  size_t records_left = num_records;
+  if (options_.optimistic_caching && !options_.bypass_cache) {
+    ScanFullyCachedRanges(&scan_start_key, &records_left, results_out);
+    if (records_left == 0 || scan_start_key == Manager::kMaxReservedKey) {
+      return Status::OK();
+    }
+  }
+
+  const key_utils::IntKeyAsSlice key_slice_helper(scan_start_key);
   const Slice key_slice = key_slice_helper.as<Slice>();
 
   std::vector<std::pair<Key, std::string>> results;
   if (use_experimental_prefetch) {
-    mgr_->ScanWithExperimentalPrefetching(start_key, num_records, &results);
+    mgr_->ScanWithExperimentalPrefetching(scan_start_key, records_left,
+                                          &results);
   } else {
-    mgr_->Scan(start_key, num_records, &results);
+    mgr_->Scan(scan_start_key, records_left, &results);
   }
 
   std::vector<uint64_t> indices;
   if (!options_.bypass_cache) {
-    cache_.GetRange(key_slice, num_records, &indices);
+    cache_.GetRange(key_slice, records_left, &indices);
   }
 
   // Merge the results while preferring records in the cache over records read
   // from disk when the keys are equal.
-  results_out->reserve(std::min(num_records, results.size() + indices.size()));
+  results_out->reserve(results_out->size() +
+                       std::min(records_left, results.size() + indices.size()));
 
-  size_t records_left = num_records;
   auto cache_it = indices.begin();
   auto disk_it = results.begin();
   while (records_left > 0 && cache_it != indices.end() &&
@@ -272,6 +603,99 @@ Status PageGroupedDBImpl::GetRange(
   return Status::OK();
 }
 
+Status PageGroupedDBImpl::ParallelScan(const Key start_key, const Key end_key,
+                                       const size_t num_threads,
+                                       const ScanCallback& callback,
+                                       bool ordered) {
+  if (start_key > end_key) {
+    return Status::InvalidArgument(
+        "The start key cannot be greater than the end key.");
+  }
+  if (start_key == Manager::kMinReservedKey ||
+      start_key == Manager::kMaxReservedKey ||
+      end_key == Manager::kMinReservedKey) {
+    return Status::InvalidArgument(
+        "Cannot use a reserved key as the start key and cannot use the minimum "
+        "reserved key as the end key.");
+  }
+  if (num_threads == 0) {
+    return Status::InvalidArgument("Must use at least one scan thread.");
+  }
+  if (!mgr_.has_value()) return Status::OK();
+
+  Manager::ScanBatchFn merge_cached = nullptr;
+  if (!options_.bypass_cache) {
+    merge_cached = std::bind(&PageGroupedDBImpl::MergeCachedRange, this,
+                             std::placeholders::_1, std::placeholders::_2,
+                             std::placeholders::_3);
+  }
+  return mgr_->ParallelScan(start_key, end_key, num_threads, ordered, callback,
+                            merge_cached);
+}
+
+void PageGroupedDBImpl::MergeCachedRange(
+    const Key lower, const Key upper,
+    std::vector<std::pair<Key, std::string>>* records) {
+  // This runs on the scan threads.
+  cache_.GetMasstreePointer()->thread_init(thread_id_);
+  const key_utils::IntKeyAsSlice lower_slice(lower), upper_slice(upper - 1);
+  std::vector<uint64_t> indices;
+  cache_.GetRange(lower_slice.as<Slice>(), upper_slice.as<Slice>(), &indices);
+  if (indices.empty()) return;
+
+  std::vector<std::pair<Key, std::string>> merged;
+  merged.reserve(records->size() + indices.size());
+  auto disk_it = records->begin();
+  for (const auto& index : indices) {
+    auto& entry = RecordCache::cache_entries[index];
+    const Key cache_record_key = key_utils::ExtractHead64(entry.GetKey());
+    for (; disk_it != records->end() && disk_it->first < cache_record_key;
+         ++disk_it) {
+      merged.push_back(std::move(*disk_it));
+    }
+    if (disk_it != records->end() && disk_it->first == cache_record_key) {
+      ++disk_it;
+    }
+    merged.emplace_back(cache_record_key, entry.GetValue().ToString());
+    entry.Unlock();
+  }
+  for (; disk_it != records->end(); ++disk_it) {
+    merged.push_back(std::move(*disk_it));
+  }
+  records->swap(merged);
+}
+
+void PageGroupedDBImpl::ScanFullyCachedRanges(
+    Key* start_key, size_t* records_left,
+    std::vector<std::pair<Key, std::string>>* results_out) {
+  std::vector<uint64_t> indices;
+  while (*records_left > 0 && *start_key != Manager::kMaxReservedKey) {
+    const auto range = cache_.GetFullyCachedRange(*start_key);
+    if (!range.has_value()) break;
+
+    const key_utils::IntKeyAsSlice lower(*start_key), upper(range->upper - 1);
+    indices.clear();
+    cache_.GetRange(lower.as<Slice>(), upper.as<Slice>(), &indices);
+
+    // The cache entries are locked, so none of them can be evicted now. But a
+    // record in the range may have been evicted before we locked the entries.
+    const bool still_cached = cache_.IsStillFullyCached(*start_key, range->id);
+    for (const auto& index : indices) {
+      auto& entry = RecordCache::cache_entries[index];
+      if (still_cached && *records_left > 0) {
+        results_out->emplace_back(key_utils::ExtractHead64(entry.GetKey()),
+                                  entry.GetValue().ToString());
+        --(*records_left);
+      }
+      entry.Unlock();
+    }
+    if (!still_cached) break;
+
+    PageGroupedDBStats::Local().BumpCacheRangeHits();
+    *start_key = range->upper;
+  }
+}
+
 void PageGroupedDBImpl::WriteBatch(const WriteOutBatch& records) {
   assert(mgr_.has_value());
   std::vector<std::pair<Key, Slice>> reformatted;
@@ -287,7 +711,195 @@ void PageGroupedDBImpl::WriteBatch(const WriteOutBatch& records) {
             [](const auto& left, const auto& right) {
               return left.first < right.first;
             });
-  mgr_->PutBatch(reformatted);
+  WriteSorted(reformatted);
+}
+
+Status PageGroupedDBImpl::WriteSorted(
+    const std::vector<std::pair<Key, Slice>>& records) {
+  if (combiner_ != nullptr) {
+    return combiner_->Write(records);
+  }
+  return PutBatch(records);
+}
+
+Status PageGroupedDBImpl::PutBatch(
+    const std::vector<std::pair<Key, Slice>>& records) {
+  assert(mgr_.has_value());
+  NoteWroteRecords();
+  return mgr_->PutBatch(records);
+}
+
+void PageGroupedDBImpl::NoteWroteRecords() {
+  // Avoid writing to the shared flag once it is set.
+  if (!wrote_records_.load(std::memory_order_relaxed)) {
+    wrote_records_.store(true, std::memory_order_release);
+  }
+}
+
+void PageGroupedDBImpl::WriteBatchParallel(const WriteOutBatch& records) {
+  assert(mgr_.has_value());
+  // `RecordCache::WriteBackDirty()` passes the records in sorted order.
+  std::vector<std::pair<Key, Slice>> reformatted;
+  reformatted.reserve(records.size());
+  for (const auto& [key, value, write_type] : records) {
+    // TODO: Deletes are not yet supported.
+    assert(write_type == format::WriteType::kWrite);
+    reformatted.emplace_back(key_utils::ExtractHead64(key), value);
+  }
+  NoteWroteRecords();
+  mgr_->PutBatchParallel(reformatted);
+}
+
+void PageGroupedDBImpl::MaybeScheduleWriteback() {
+  if (!writeback_worker_.joinable() ||
+      cache_.GetNumDirty() < writeback_high_dirty_ ||
+      writeback_scheduled_.exchange(true)) {
+    return;
+  }
+  {
+    // Acquiring the mutex ensures the worker is either waiting or has not yet
+    // checked `writeback_scheduled_` (avoids a lost wake up).
+    std::unique_lock<std::mutex> lock(writeback_mutex_);
+  }
+  writeback_cv_.notify_one();
+}
+
+void PageGroupedDBImpl::WritebackWorkerMain() {
+  const auto write_out = std::bind(&PageGroupedDBImpl::WriteBatchParallel,
+                                   this, std::placeholders::_1);
+  std::unique_lock<std::mutex> lock(writeback_mutex_);
+  while (true) {
+    writeback_cv_.wait(lock, [this]() {
+      return writeback_shutdown_ || writeback_scheduled_;
+    });
+    if (writeback_shutdown_) break;
+    lock.unlock();
+
+    while (cache_.GetNumDirty() > writeback_low_dirty_) {
+      const uint64_t written = cache_.WriteBackDirty(
+          options_.rec_cache_writeback_batch_size, write_out);
+      PageGroupedDBStats::Local().BumpCacheBackgroundWritebacks(written);
+      // The remaining dirty entries are all in use by other threads.
+      if (written == 0) break;
+    }
+    writeback_scheduled_ = false;
+
+    lock.lock();
+  }
+  PageGroupedDBStats::Local().PostToGlobal();
+}
+
+void PageGroupedDBImpl::StopWritebackWorker() {
+  if (!writeback_worker_.joinable()) return;
+  {
+    std::unique_lock<std::mutex> lock(writeback_mutex_);
+    writeback_shutdown_ = true;
+  }
+  writeback_cv_.notify_one();
+  writeback_worker_.join();
+}
+
+Status PageGroupedDBImpl::GetStats(PageGroupedDBLiveStats* stats_out) {
+  PageGroupedDBStats::RunOnLive([stats_out](const auto& live) {
+    stats_out->cache_hits = live.GetCacheHits();
+    stats_out->cache_misses = live.GetCacheMisses();
+    stats_out->overflows_created = live.GetOverflowsCreated();
+    stats_out->rewrites = live.GetRewrites();
+    stats_out->rewrite_input_pages = live.GetRewriteInputPages();
+    stats_out->rewrite_output_pages = live.GetRewriteOutputPages();
+    stats_out->page_reads_by_size.resize(PageGroupedDBStats::kMaxIOPages);
+    stats_out->page_writes_by_size.resize(PageGroupedDBStats::kMaxIOPages);
+    for (size_t i = 0; i < PageGroupedDBStats::kMaxIOPages; ++i) {
+      stats_out->page_reads_by_size[i] = live.GetPageReads(i + 1);
+      stats_out->page_writes_by_size[i] = live.GetPageWrites(i + 1);
+    }
+  });
+  const uint64_t lookups = stats_out->cache_hits + stats_out->cache_misses;
+  stats_out->cache_hit_ratio =
+      lookups == 0 ? 0.0
+                   : static_cast<double>(stats_out->cache_hits) / lookups;
+
+  stats_out->cache_capacity =
+      options_.bypass_cache ? 0 : options_.record_cache_capacity;
+  stats_out->cache_dirty_records =
+      options_.bypass_cache ? 0 : cache_.GetNumDirty();
+  stats_out->cache_dirty_ratio =
+      stats_out->cache_capacity == 0
+          ? 0.0
+          : static_cast<double>(stats_out->cache_dirty_records) /
+                stats_out->cache_capacity;
+
+  if (mgr_.has_value()) {
+    mgr_->GetSegmentStats(stats_out);
+  } else {
+    stats_out->segment_page_counts.clear();
+    stats_out->segments_by_size.clear();
+    stats_out->overflowed_segments = 0;
+    stats_out->reorg_backlog_pages = 0;
+    stats_out->free_list_entries = 0;
+    stats_out->free_list_bytes = 0;
+  }
+  return Status::OK();
+}
+
+Status PageGroupedDBImpl::GetKeyRangeStats(
+    std::vector<PageGroupedDBKeyRangeStats>* stats_out) {
+  if (!mgr_.has_value() || !mgr_->GetKeyRangeStats(stats_out)) {
+    return Status::NotSupported("Key range statistics are not enabled.");
+  }
+  return Status::OK();
+}
+
+Status PageGroupedDBImpl::GetLockContentionStats(
+    PageGroupedDBLockContentionStats* stats_out) {
+  if (!mgr_.has_value() || !mgr_->GetLockContentionStats(stats_out)) {
+    return Status::NotSupported("Lock profiling is not enabled.");
+  }
+  return Status::OK();
+}
+
+Status PageGroupedDBImpl::GetProperty(const std::string& property,
+                                      std::string* value_out) {
+  if (property == "pg.key-range-stats") {
+    std::vector<PageGroupedDBKeyRangeStats> ranges;
+    const Status status = GetKeyRangeStats(&ranges);
+    if (!status.ok()) return status;
+    std::stringstream out;
+    KeyRangeStats::PrintAsCsv(out, ranges);
+    *value_out = out.str();
+    return Status::OK();
+  }
+  if (property == "pg.lock-contention") {
+    PageGroupedDBLockContentionStats contention;
+    const Status status = GetLockContentionStats(&contention);
+    if (!status.ok()) return status;
+    std::stringstream out;
+    LockProfiler::PrintAsCsv(out, contention);
+    out << std::endl;
+    LockProfiler::PrintHotLocksAsCsv(out, contention);
+    *value_out = out.str();
+    return Status::OK();
+  }
+
+  PageGroupedDBLiveStats stats;
+  const Status status = GetStats(&stats);
+  if (!status.ok()) return status;
+  const auto properties = FormatProperties(stats);
+
+  if (property == "pg.stats") {
+    std::stringstream out;
+    for (const auto& [name, value] : properties) {
+      out << name << ": " << value << std::endl;
+    }
+    *value_out = out.str();
+    return Status::OK();
+  }
+  for (const auto& [name, value] : properties) {
+    if (name != property) continue;
+    *value_out = value;
+    return Status::OK();
+  }
+  return Status::NotFound("Unknown property.");
 }
 
 std::pair<Key, Key> PageGroupedDBImpl::GetPageBoundsFor(Key key) {
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
+#include "cache_manifest.h"
 #include "db/format.h"
 #include "manager.h"
 #include "record_cache/record_cache.h"
@@ -13,6 +20,7 @@
 #include "treeline/pg_options.h"
 #include "treeline/slice.h"
 #include "util/insert_tracker.h"
+#include "write_combiner.h"
 
 namespace tl {
 namespace pg {
@@ -30,18 +38,68 @@ class PageGroupedDBImpl : public PageGroupedDB {
   Status Put(const WriteOptions& options, const Key key,
              const Slice& value) override;
   Status Get(const Key key, std::string* value_out) override;
+  Status MultiGet(const std::vector<Key>& keys,
+                  std::vector<std::string>* values_out,
+                  std::vector<Status>* statuses_out) override;
   Status GetRange(const Key start_key, const size_t num_records,
                   std::vector<std::pair<Key, std::string>>* results_out,
                   bool use_experimental_prefetch = false) override;
+  Status ParallelScan(const Key start_key, const Key end_key,
+                      const size_t num_threads, const ScanCallback& callback,
+                      bool ordered = true) override;
 
   Status FlattenRange(
       const Key start_key = 1,
       const Key end_key = std::numeric_limits<Key>::max()) override;
 
+  Status WaitForCacheWarmUp() override;
+
+  Status GetStats(PageGroupedDBLiveStats* stats_out) override;
+  Status GetKeyRangeStats(
+      std::vector<PageGroupedDBKeyRangeStats>* stats_out) override;
+  Status GetLockContentionStats(
+      PageGroupedDBLockContentionStats* stats_out) override;
+  Status GetProperty(const std::string& property,
+                     std::string* value_out) override;
+
  private:
+  // Used by `GetRange()` to read records from fully cached key ranges (see
+  // `RecordCache::GetFullyCachedRange()`), starting at `start_key`. Advances
+  // `start_key` past the ranges that were read.
+  void ScanFullyCachedRanges(
+      Key* start_key, size_t* records_left,
+      std::vector<std::pair<Key, std::string>>* results_out);
+
+  // Used by `ParallelScan()` to merge the cached records with keys in
+  // [lower, upper) into `records` (preferring the cached records).
+  void MergeCachedRange(Key lower, Key upper,
+                        std::vector<std::pair<Key, std::string>>* records);
+
+  // Used to persist and warm up the record cache across restarts (see
+  // `PageGroupedDBOptions::rec_cache_persist`). `StartCacheWarmUp()` consumes
+  // the cache manifest and runs `WarmUpCache()` on a background thread.
+  void PersistCache();
+  void StartCacheWarmUp();
+  void WarmUpCache(const std::vector<CacheManifest::Entry>& entries,
+                   bool has_values);
+
   void WriteBatch(const WriteOutBatch& records);
+  // Writes sorted `records` to the page files, going through `combiner_` if
+  // write combining is enabled.
+  Status WriteSorted(const std::vector<std::pair<Key, Slice>>& records);
+  Status PutBatch(const std::vector<std::pair<Key, Slice>>& records);
+  // Called before records are written to the page files (see
+  // `wrote_records_`).
+  void NoteWroteRecords();
+  void WriteBatchParallel(const WriteOutBatch& records);
   std::pair<Key, Key> GetPageBoundsFor(Key key);
 
+  // Used to run the background record cache writer (see
+  // `PageGroupedDBOptions::rec_cache_background_writeback`).
+  void WritebackWorkerMain();
+  void MaybeScheduleWriteback();
+  void StopWritebackWorker();
+
   std::filesystem::path db_path_;
   PageGroupedDBOptions options_;
 
@@ -51,6 +109,25 @@ class PageGroupedDBImpl : public PageGroupedDB {
   RecordCache cache_;
 
   std::shared_ptr<InsertTracker> tracker_;
+
+  // Only set if `PageGroupedDBOptions::write_combining` is true.
+  std::unique_ptr<WriteCombiner> combiner_;
+
+  // Only valid while (or after) the record cache is warmed up. The warm-up
+  // stops using the cache manifest's values once records are written to the
+  // page files (the values may then be stale).
+  std::shared_future<void> warm_up_done_;
+  std::atomic<bool> wrote_records_;
+
+  // Background record cache writer state. The dirty entry counts are
+  // precomputed from the watermarks in `options_`.
+  uint64_t writeback_high_dirty_;
+  uint64_t writeback_low_dirty_;
+  std::atomic<bool> writeback_scheduled_;
+  bool writeback_shutdown_;
+  std::mutex writeback_mutex_;
+  std::condition_variable writeback_cv_;
+  std::thread writeback_worker_;
 };
 
 }  // namespace pg
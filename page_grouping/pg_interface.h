@@ -11,6 +11,8 @@
 
 #include "config.h"
 #include "treeline/pg_options.h"
+#include "treeline/pg_simulated_ssd.h"
+#include "treeline/pg_stats.h"
 #include "treeline/slice.h"
 #include "manager.h"
 #include "ycsbr/ycsbr.h"
@@ -30,6 +32,7 @@ class PageGroupingInterface {
   // called concurrently by each worker thread and may run concurrently with
   // `DeleteDatabase()`.
   void ShutdownWorker(const std::thread::id& worker_id) {
+    PageGroupedDBStats::Local().PostToGlobal();
     if (!pg_mgr_.has_value()) return;
 
     std::unique_lock<std::mutex> lock(mutex_);
@@ -61,6 +64,11 @@ class PageGroupingInterface {
         std::filesystem::is_directory(db_path_) &&
         !std::filesystem::is_empty(db_path_)) {
       // Reopening an existing database.
+      if (FLAGS_sim_ssd) {
+        // The segment files only exist while the simulated SSD does.
+        throw std::runtime_error(
+            "The DB directory must be empty when using a simulated SSD.");
+      }
       pg_mgr_ = Manager::Reopen(db_path_, GetOptions());
     } else {
       // No-op. Will initialize during bulk load.
@@ -106,6 +114,7 @@ class PageGroupingInterface {
 
   // Insert the specified key value pair. Return true if the insert succeeded.
   bool Insert(ycsbr::Request::Key key, const char* value, size_t value_size) {
+    pg_mgr_->RecordUserWrite(key, sizeof(key) + value_size, /*is_insert=*/true);
     write_batch_.emplace_back(key, Slice(value, value_size));
     if (write_batch_.size() >= FLAGS_write_batch_size) {
       SubmitWrites();
@@ -130,6 +139,27 @@ class PageGroupingInterface {
 
   const std::vector<size_t>& GetWriteCounts() const { return write_counts_; }
 
+  // Returns false if the per key range statistics are not being tracked.
+  bool GetKeyRangeStats(
+      std::vector<PageGroupedDBKeyRangeStats>* stats_out) const {
+    return pg_mgr_.has_value() && pg_mgr_->GetKeyRangeStats(stats_out);
+  }
+
+  // Returns false if lock profiling is disabled.
+  bool GetLockContentionStats(
+      PageGroupedDBLockContentionStats* stats_out) const {
+    return pg_mgr_.has_value() && pg_mgr_->GetLockContentionStats(stats_out);
+  }
+
+  // Retrieves and then resets the simulated SSD's statistics. Returns false if
+  // the DB does not use a simulated SSD.
+  bool TakeSimulatedSSDStats(SimulatedSSDStats* stats_out) {
+    if (ssd_ == nullptr) return false;
+    ssd_->GetStats(stats_out);
+    ssd_->ResetStats();
+    return true;
+  }
+
  private:
   PageGroupedDBOptions GetOptions() {
     PageGroupedDBOptions options;
@@ -138,6 +168,24 @@ class PageGroupingInterface {
     options.use_segments = !FLAGS_disable_segments;
     options.num_bg_threads = FLAGS_bg_threads;
     options.use_memory_based_io = FLAGS_use_memory_based_io;
+    options.io_trace_path = FLAGS_io_trace_path;
+    options.key_range_stats_buckets = FLAGS_key_range_stats_buckets;
+    options.lock_profiling_top_n = FLAGS_lock_profiling_top_n;
+    if (FLAGS_sim_ssd) {
+      if (ssd_ == nullptr) {
+        SimulatedSSDOptions ssd_options;
+        ssd_options.read_latency_us = FLAGS_sim_ssd_read_latency_us;
+        ssd_options.write_latency_us = FLAGS_sim_ssd_write_latency_us;
+        ssd_options.read_bandwidth_mib = FLAGS_sim_ssd_read_bandwidth_mib;
+        ssd_options.write_bandwidth_mib = FLAGS_sim_ssd_write_bandwidth_mib;
+        ssd_options.queue_depth = FLAGS_sim_ssd_queue_depth;
+        ssd_options.gc_interval_bytes = FLAGS_sim_ssd_gc_interval_mib << 20;
+        ssd_options.gc_stall_us = FLAGS_sim_ssd_gc_stall_us;
+        ssd_options.emulate_latency = FLAGS_sim_ssd_emulate_latency;
+        ssd_ = SimulatedSSD::Create(ssd_options);
+      }
+      options.simulated_ssd = ssd_;
+    }
     return options;
   }
 
@@ -152,6 +200,8 @@ class PageGroupingInterface {
 
   std::filesystem::path db_path_;
   std::optional<Manager> pg_mgr_;
+  // Only set if `--sim_ssd` is set.
+  std::shared_ptr<SimulatedSSD> ssd_;
 
   std::vector<std::pair<ycsbr::Request::Key, Slice>> write_batch_;
 
@@ -1,33 +1,180 @@
 #include "treeline/pg_stats.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace tl {
 namespace pg {
 
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::Reset() {
+  buckets_.fill(0);
+  count_ = 0;
+  sum_ = 0;
+  min_ = std::numeric_limits<uint64_t>::max();
+  max_ = 0;
+}
+
+uint64_t LatencyHistogram::Percentile(const double p) const {
+  if (count_ == 0) return 0;
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(p / 100.0 * count_)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen < rank) continue;
+    const uint64_t upper =
+        i + 1 < kNumBuckets ? BucketLowerBound(i + 1) - 1 : max_;
+    return std::min(upper, max_);
+  }
+  return max_;
+}
+
+uint64_t LatencyHistogram::BucketLowerBound(const size_t idx) {
+  if (idx < kSubBuckets) return idx;
+  const size_t exp = idx / kSubBuckets + kSubBucketBits - 1;
+  return (kSubBuckets + idx % kSubBuckets) << (exp - kSubBucketBits);
+}
+
 std::mutex PageGroupedDBStats::class_mutex_;
-PageGroupedDBStats PageGroupedDBStats::global_;
+PageGroupedDBStats PageGroupedDBStats::global_(/*is_local=*/false);
+std::atomic<bool> PageGroupedDBStats::latency_tracking_(false);
+std::vector<const PageGroupedDBStats*> PageGroupedDBStats::locals_;
+PageGroupedDBStats PageGroupedDBStats::exited_(/*is_local=*/false);
+
+const char* PageGroupedDBStats::LatencyPhaseName(const LatencyPhase phase) {
+  switch (phase) {
+    case LatencyPhase::kGet:
+      return "get";
+    case LatencyPhase::kGetCacheLookup:
+      return "get_cache_lookup";
+    case LatencyPhase::kGetIndexLookup:
+      return "get_index_lookup";
+    case LatencyPhase::kGetPageLock:
+      return "get_page_lock";
+    case LatencyPhase::kGetPageRead:
+      return "get_page_read";
+    case LatencyPhase::kGetPageSearch:
+      return "get_page_search";
+    case LatencyPhase::kPut:
+      return "put";
+    case LatencyPhase::kGetRange:
+      return "get_range";
+    case LatencyPhase::kScan:
+      return "scan";
+    case LatencyPhase::kWriteout:
+      return "writeout";
+    case LatencyPhase::kRewrite:
+      return "rewrite";
+    case LatencyPhase::kRewriteMerge:
+      return "rewrite_merge";
+    case LatencyPhase::kRewriteInstall:
+      return "rewrite_install";
+  }
+  return "unknown";
+}
+
+const char* PageGroupedDBStats::LockWaitModeName(const LockWaitMode mode) {
+  switch (mode) {
+    case LockWaitMode::kSegmentPageRead:
+      return "segment_page_read";
+    case LockWaitMode::kSegmentPageWrite:
+      return "segment_page_write";
+    case LockWaitMode::kSegmentReorg:
+      return "segment_reorg";
+    case LockWaitMode::kSegmentReorgExclusive:
+      return "segment_reorg_exclusive";
+    case LockWaitMode::kPageShared:
+      return "page_shared";
+    case LockWaitMode::kPageExclusive:
+      return "page_exclusive";
+  }
+  return "unknown";
+}
+
+const LatencyHistogram& PageGroupedDBStats::GetLatency(
+    const LatencyPhase phase) const {
+  static const LatencyHistogram kEmpty;
+  if (latencies_ == nullptr) return kEmpty;
+  return (*latencies_)[static_cast<size_t>(phase)];
+}
 
-PageGroupedDBStats::PageGroupedDBStats() { Reset(); }
+PageGroupedDBStats::PageGroupedDBStats(const bool is_local)
+    : is_local_(is_local) {
+  Reset();
+  if (!is_local_) return;
+  std::unique_lock<std::mutex> lock(class_mutex_);
+  locals_.push_back(this);
+}
+
+PageGroupedDBStats::~PageGroupedDBStats() {
+  if (!is_local_) return;
+  std::unique_lock<std::mutex> lock(class_mutex_);
+  AddTo(&exited_, /*include_latencies=*/false);
+  locals_.erase(std::find(locals_.begin(), locals_.end(), this));
+}
 
 void PageGroupedDBStats::PostToGlobal() const {
   std::unique_lock<std::mutex> lock(class_mutex_);
-  global_.cache_hits_ += cache_hits_;
-  global_.cache_misses_ += cache_misses_;
-  global_.cache_clean_evictions_ += cache_clean_evictions_;
-  global_.cache_dirty_evictions_ += cache_dirty_evictions_;
+  AddTo(&global_, /*include_latencies=*/true);
+}
+
+void PageGroupedDBStats::AddTo(PageGroupedDBStats* target,
+                               const bool include_latencies) const {
+  target->cache_hits_ += cache_hits_;
+  target->cache_misses_ += cache_misses_;
+  target->cache_clean_evictions_ += cache_clean_evictions_;
+  target->cache_dirty_evictions_ += cache_dirty_evictions_;
+  target->cache_background_writebacks_ += cache_background_writebacks_;
+  target->cache_range_hits_ += cache_range_hits_;
+
+  target->overflows_created_ += overflows_created_;
+  target->rewrites_ += rewrites_;
+  target->rewrite_input_pages_ += rewrite_input_pages_;
+  target->rewrite_output_pages_ += rewrite_output_pages_;
 
-  global_.overflows_created_ += overflows_created_;
-  global_.rewrites_ += rewrites_;
-  global_.rewrite_input_pages_ += rewrite_input_pages_;
-  global_.rewrite_output_pages_ += rewrite_output_pages_;
+  target->segments_ = segments_;
+  target->free_list_entries_ += free_list_entries_;
+  target->free_list_bytes_ += free_list_bytes_;
+  target->segment_index_bytes_ += segment_index_bytes_;
+  target->lock_manager_bytes_ += lock_manager_bytes_;
+  target->cache_bytes_ += cache_bytes_;
 
-  global_.segments_ = segments_;
-  global_.free_list_entries_ += free_list_entries_;
-  global_.free_list_bytes_ += free_list_bytes_;
-  global_.segment_index_bytes_ += segment_index_bytes_;
-  global_.lock_manager_bytes_ += lock_manager_bytes_; 
-  global_.cache_bytes_ += cache_bytes_;
+  target->overfetched_pages_ += overfetched_pages_;
 
-  global_.overfetched_pages_ += overfetched_pages_;
+  target->numa_local_accesses_ += numa_local_accesses_;
+  target->numa_remote_accesses_ += numa_remote_accesses_;
+
+  target->combined_write_batches_ += combined_write_batches_;
+  target->combined_write_records_ += combined_write_records_;
+
+  for (size_t i = 0; i < kNumLockWaitModes; ++i) {
+    target->lock_waits_[i] += lock_waits_[i];
+    target->lock_wait_nanos_[i] += lock_wait_nanos_[i];
+  }
+  for (size_t i = 0; i < kMaxIOPages; ++i) {
+    target->page_reads_[i] += page_reads_[i];
+    target->page_writes_[i] += page_writes_[i];
+  }
+
+  if (include_latencies && latencies_ != nullptr) {
+    if (target->latencies_ == nullptr) {
+      target->latencies_ = std::make_unique<LatencyHistograms>();
+    }
+    for (size_t i = 0; i < kNumLatencyPhases; ++i) {
+      (*target->latencies_)[i].Merge((*latencies_)[i]);
+    }
+  }
 }
 
 void PageGroupedDBStats::Reset() {
@@ -35,6 +182,8 @@ void PageGroupedDBStats::Reset() {
   cache_misses_ = 0;
   cache_clean_evictions_ = 0;
   cache_dirty_evictions_ = 0;
+  cache_background_writebacks_ = 0;
+  cache_range_hits_ = 0;
 
   overflows_created_ = 0;
   rewrites_ = 0;
@@ -49,6 +198,23 @@ void PageGroupedDBStats::Reset() {
   cache_bytes_ = 0;
 
   overfetched_pages_ = 0;
+
+  numa_local_accesses_ = 0;
+  numa_remote_accesses_ = 0;
+
+  combined_write_batches_ = 0;
+  combined_write_records_ = 0;
+
+  lock_waits_.fill(0);
+  lock_wait_nanos_.fill(0);
+  page_reads_.fill(0);
+  page_writes_.fill(0);
+
+  if (latencies_ != nullptr) {
+    for (auto& histogram : *latencies_) {
+      histogram.Reset();
+    }
+  }
 }
 
 }  // namespace pg
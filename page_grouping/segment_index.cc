@@ -1,12 +1,14 @@
 #include "segment_index.h"
 
 #include <algorithm>
-
-#include "rand_exp_backoff.h"
+#include <chrono>
 
 namespace {
 
-constexpr uint32_t kBackoffSaturate = 12;
+// There is an unlikely pathological case where the segments we are trying to
+// lock for a rewrite end up being reused in different parts of the key space.
+// To avoid causing a deadlock, we only wait this long for each segment lock.
+constexpr std::chrono::seconds kRewriteLockTimeout(1);
 
 }  // namespace
 
@@ -27,18 +29,29 @@ SegmentIndex::Entry SegmentIndex::SegmentForKey(const Key key) const {
 
 SegmentIndex::Entry SegmentIndex::SegmentForKeyWithLock(
     const Key key, LockManager::SegmentMode mode) const {
-  RandExpBackoff backoff(kBackoffSaturate);
+  // The segment whose lock we last waited for (invalid if we have not waited).
+  SegmentId waited_for;
   while (true) {
+    SegmentId seg_id;
+    LockManager::WaitTicket ticket;
     {
       std::shared_lock<std::shared_mutex> lock(mutex_);
       const auto it = SegmentForKeyImpl(key);
+      seg_id = it->second.id();
+      if (waited_for.IsValid()) {
+        lock_manager_->SwitchSegmentLockWait(waited_for, seg_id, mode);
+      }
+      ticket = lock_manager_->GetSegmentWaitTicket(seg_id);
       const bool lock_granted =
-          lock_manager_->TryAcquireSegmentLock(it->second.id(), mode);
+          lock_manager_->TryAcquireSegmentLock(seg_id, mode);
       if (lock_granted) {
         return IndexIteratorToEntry(it);
       }
     }
-    backoff.Wait();
+    // A reorganization holds the segment lock. Wait until it releases the lock
+    // (at which point the index will have been updated) and then retry.
+    lock_manager_->WaitForSegmentLock(seg_id, mode, ticket);
+    waited_for = seg_id;
   }
 }
 
@@ -55,22 +68,31 @@ std::optional<SegmentIndex::Entry> SegmentIndex::NextSegmentForKey(
 
 std::optional<SegmentIndex::Entry> SegmentIndex::NextSegmentForKeyWithLock(
     const Key key, LockManager::SegmentMode mode) const {
-  RandExpBackoff backoff(kBackoffSaturate);
+  // The segment whose lock we last waited for (invalid if we have not waited).
+  SegmentId waited_for;
   while (true) {
+    SegmentId seg_id;
+    LockManager::WaitTicket ticket;
     {
       std::shared_lock<std::shared_mutex> lock(mutex_);
       const auto it = index_.upper_bound(key);
+      if (it != index_.end()) seg_id = it->second.id();
+      if (waited_for.IsValid()) {
+        lock_manager_->SwitchSegmentLockWait(waited_for, seg_id, mode);
+      }
       if (it == index_.end()) {
         return std::optional<Entry>();
       }
+      ticket = lock_manager_->GetSegmentWaitTicket(seg_id);
       const bool lock_granted =
-          lock_manager_->TryAcquireSegmentLock(it->second.id(), mode);
+          lock_manager_->TryAcquireSegmentLock(seg_id, mode);
       if (lock_granted) {
         // Returns a copy.
         return IndexIteratorToEntry(it);
       }
     }
-    backoff.Wait();
+    lock_manager_->WaitForSegmentLock(seg_id, mode, ticket);
+    waited_for = seg_id;
   }
 }
 
@@ -171,28 +193,26 @@ SegmentIndex::FindAndLockNextOverflowRegion(const Key start_key,
 
 bool SegmentIndex::LockSegmentsForRewrite(
     const std::vector<SegmentIndex::Entry>& segments_to_lock) const {
-  // There is an unlikely pathological case where the segments we are trying to
-  // lock for a rewrite end up being reused in different parts of the key space.
-  // To avoid causing a deadlock, we attempt to acquire the segment lock a
-  // maximum number of times.
-  static constexpr size_t kMaxAttempts = 1000;
-
   // Acquire locks in order. We do not hold the index latch while doing this
   // because acquiring reorg locks may take time.
-  RandExpBackoff backoff(kBackoffSaturate);
   size_t num_granted = 0;
   for (const auto& seg : segments_to_lock) {
-    backoff.Reset();
+    const auto deadline =
+        std::chrono::steady_clock::now() + kRewriteLockTimeout;
     bool lock_granted = false;
-    for (size_t attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    while (true) {
+      const auto ticket = lock_manager_->GetSegmentWaitTicket(seg.sinfo.id());
       lock_granted = lock_manager_->TryAcquireSegmentLock(
           seg.sinfo.id(), LockManager::SegmentMode::kReorg);
       if (lock_granted) break;
-      backoff.Wait();
+      if (!lock_manager_->WaitForSegmentLock(seg.sinfo.id(),
+                                             LockManager::SegmentMode::kReorg,
+                                             ticket, deadline)) {
+        break;
+      }
     }
 
-    // We exceeded the number of acquisition attempts. Release all granted locks
-    // and retry.
+    // We waited too long for the lock. Release all granted locks and retry.
     if (!lock_granted) {
       for (size_t i = 0; i < num_granted; ++i) {
         lock_manager_->ReleaseSegmentLock(segments_to_lock[i].sinfo.id(),
@@ -291,5 +311,22 @@ uint64_t SegmentIndex::GetNumEntries() const {
   return index_.size();
 }
 
+std::vector<std::pair<Key, SegmentInfo>> SegmentIndex::GetAllEntries() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return std::vector<std::pair<Key, SegmentInfo>>(index_.begin(),
+                                                  index_.end());
+}
+
+std::vector<SegmentIndex::Entry> SegmentIndex::GetEntriesInRange(
+    const Key start_key, const Key end_key) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::vector<Entry> entries;
+  for (auto it = SegmentForKeyImpl(start_key);
+       it != index_.end() && it->first < end_key; ++it) {
+    entries.push_back(IndexIteratorToEntry(it));
+  }
+  return entries;
+}
+
 }  // namespace pg
 }  // namespace tl
@@ -4,6 +4,7 @@
 #include <optional>
 #include <shared_mutex>
 #include <utility>
+#include <vector>
 
 #include "treeline/pg_db.h"
 #include "lock_manager.h"
@@ -91,9 +92,25 @@ class SegmentIndex {
     c(index_);
   }
 
+  // Run `c` while holding a shared latch on the index.
+  template <typename Callable>
+  void RunShared(const Callable& c) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    c(index_);
+  }
+
   uint64_t GetSizeFootprint() const;
   uint64_t GetNumEntries() const;
 
+  // Returns a copy of all the index entries (segment base keys and their
+  // `SegmentInfo`s), sorted by key.
+  std::vector<std::pair<Key, SegmentInfo>> GetAllEntries() const;
+
+  // Returns copies of the entries of the segments that intersect the key range
+  // [start_key, end_key), sorted by key.
+  std::vector<Entry> GetEntriesInRange(const Key start_key,
+                                       const Key end_key) const;
+
   // Not intended for external use (used by the tests). Not thread safe.
   auto BeginIterator() const { return index_.begin(); }
   auto EndIterator() const { return index_.end(); }
@@ -0,0 +1,279 @@
+// Replays an I/O trace recorded by a page-grouped database (see
+// `PageGroupedDBOptions::io_trace_path`) against a file or raw block device.
+//
+// Each thread in the trace is replayed by its own thread so that the trace's
+// concurrency is preserved. By default, each I/O is issued at the time it was
+// issued in the trace (relative to the start of the trace); use
+// `--rate_scale` to replay the trace faster or slower.
+//
+// The segment files in the trace are laid out one after another in the target
+// (each at a 1 MiB aligned offset). The replay prints the resulting layout
+// followed by a CSV summary of the I/O latencies, grouped by operation and
+// cause.
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "page_grouping/persist/io_trace.h"
+#include "treeline/pg_latency_histogram.h"
+
+#define CHECK_ERROR(call)                                                    \
+  do {                                                                       \
+    if ((call) < 0) {                                                        \
+      const char* error = strerror(errno);                                   \
+      std::cerr << __FILE__ << ":" << __LINE__ << " " << error << std::endl; \
+      exit(1);                                                               \
+    }                                                                        \
+  } while (0)
+
+DEFINE_string(trace, "", "Path to the I/O trace to replay.");
+DEFINE_string(target, "",
+              "The file or block device to replay the trace against. A file "
+              "is created (and extended) as needed. WARNING: Writes in the "
+              "trace will overwrite the target's contents.");
+DEFINE_double(rate_scale, 1.0,
+              "Replay the trace this many times faster than it was recorded "
+              "(e.g., 2 replays it at twice the original rate). Set to 0 to "
+              "issue each thread's I/O back to back.");
+DEFINE_bool(replay_writes, true,
+            "If false, the trace's writes are issued as reads of the same "
+            "pages (e.g., to avoid overwriting a device's contents).");
+DEFINE_bool(direct_io, true, "If true, the target is opened with O_DIRECT.");
+DEFINE_uint32(seed, 42, "The seed used to generate the written data.");
+
+namespace {
+
+using namespace tl::pg;
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kFileAlignment = 1024ULL * 1024ULL;
+
+// Latencies are grouped by operation (read/write) and cause.
+constexpr size_t kNumGroups = 2 * kNumIOCauses;
+using Histograms = std::array<LatencyHistogram, kNumGroups>;
+
+size_t GroupFor(const bool is_write, const IOCause cause) {
+  return static_cast<size_t>(is_write) * kNumIOCauses +
+         static_cast<size_t>(cause);
+}
+
+struct ThreadResult {
+  Histograms latencies;
+  // How far behind schedule each I/O was issued.
+  LatencyHistogram lag;
+};
+
+// Computes where each segment file starts in the target. Returns the total
+// number of bytes needed.
+size_t ComputeLayout(const std::vector<IOTraceRecord>& records,
+                     const size_t page_size,
+                     std::vector<size_t>* file_offsets_out) {
+  std::vector<size_t> extents;
+  for (const auto& rec : records) {
+    if (rec.file_id >= extents.size()) extents.resize(rec.file_id + 1, 0);
+    extents[rec.file_id] = std::max<size_t>(
+        extents[rec.file_id], rec.offset + rec.num_pages * page_size);
+  }
+  file_offsets_out->clear();
+  size_t next_offset = 0;
+  for (const size_t extent : extents) {
+    file_offsets_out->push_back(next_offset);
+    next_offset += (extent + kFileAlignment - 1) / kFileAlignment *
+                   kFileAlignment;
+  }
+  return next_offset;
+}
+
+void ReplayThread(const int fd, const std::vector<IOTraceRecord>& records,
+                  const std::vector<size_t>& file_offsets,
+                  const size_t page_size, void* buffer,
+                  const Clock::time_point start, ThreadResult* result) {
+  for (const auto& rec : records) {
+    if (FLAGS_rate_scale > 0) {
+      const Clock::time_point scheduled =
+          start + std::chrono::nanoseconds(static_cast<uint64_t>(
+                      rec.timestamp_ns / FLAGS_rate_scale));
+      std::this_thread::sleep_until(scheduled);
+      const Clock::time_point now = Clock::now();
+      result->lag.Record(
+          now > scheduled
+              ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - scheduled)
+                    .count()
+              : 0);
+    }
+
+    const size_t offset = file_offsets[rec.file_id] + rec.offset;
+    const size_t size = rec.num_pages * page_size;
+    const bool is_write = rec.IsWrite() && FLAGS_replay_writes;
+    const Clock::time_point issued = Clock::now();
+    if (is_write) {
+      CHECK_ERROR(pwrite(fd, buffer, size, offset));
+    } else {
+      CHECK_ERROR(pread(fd, buffer, size, offset));
+    }
+    result->latencies[GroupFor(rec.IsWrite(), rec.Cause())].Record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             issued)
+            .count());
+  }
+}
+
+void PrintRow(const char* op, const char* cause, const LatencyHistogram& h) {
+  std::cout << op << "," << cause << "," << h.Count() << "," << h.Mean() / 1e3
+            << "," << h.Percentile(50) / 1e3 << "," << h.Percentile(99) / 1e3
+            << "," << h.Max() / 1e3 << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage(
+      "Replays a page-grouped database I/O trace against a file or device.");
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+  if (FLAGS_trace.empty() || FLAGS_target.empty()) {
+    std::cerr << "ERROR: Must provide a trace and a target." << std::endl;
+    return 1;
+  }
+  if (FLAGS_rate_scale < 0) {
+    std::cerr << "ERROR: --rate_scale cannot be negative." << std::endl;
+    return 1;
+  }
+
+  IOTraceHeader header;
+  std::vector<IOTraceRecord> records;
+  const tl::Status status =
+      IOTracer::ReadTrace(FLAGS_trace, &header, &records);
+  if (!status.ok()) {
+    std::cerr << "ERROR: " << status.ToString() << std::endl;
+    return 1;
+  }
+  if (records.empty()) {
+    std::cerr << "> The trace is empty." << std::endl;
+    return 0;
+  }
+  const size_t page_size = header.page_size;
+
+  // Lay out the segment files in the target.
+  std::vector<size_t> file_offsets;
+  const size_t target_size = ComputeLayout(records, page_size, &file_offsets);
+  for (size_t i = 0; i < file_offsets.size(); ++i) {
+    std::cerr << "> File " << i << " starts at byte " << file_offsets[i]
+              << std::endl;
+  }
+
+  int flags = O_CREAT | O_RDWR;
+  if (FLAGS_direct_io) flags |= O_DIRECT;
+  int fd = -1;
+  CHECK_ERROR(fd = open(FLAGS_target.c_str(), flags, S_IRUSR | S_IWUSR));
+  struct stat target_status;
+  CHECK_ERROR(fstat(fd, &target_status));
+  if (S_ISREG(target_status.st_mode)) {
+    if (static_cast<size_t>(target_status.st_size) < target_size) {
+      CHECK_ERROR(fallocate(fd, /*mode=*/0, /*offset=*/0, target_size));
+    }
+  } else {
+    off_t device_size = 0;
+    CHECK_ERROR(device_size = lseek(fd, 0, SEEK_END));
+    if (static_cast<size_t>(device_size) < target_size) {
+      std::cerr << "ERROR: The target is too small (the trace needs "
+                << target_size << " bytes)." << std::endl;
+      return 1;
+    }
+  }
+
+  // Split the trace by thread.
+  uint32_t num_threads = 0;
+  for (const auto& rec : records) {
+    num_threads = std::max(num_threads, rec.thread_id + 1);
+  }
+  std::vector<std::vector<IOTraceRecord>> per_thread(num_threads);
+  size_t max_pages = 0;
+  for (const auto& rec : records) {
+    per_thread[rec.thread_id].push_back(rec);
+    max_pages = std::max<size_t>(max_pages, rec.num_pages);
+  }
+  for (auto& thread_records : per_thread) {
+    std::stable_sort(thread_records.begin(), thread_records.end(),
+                     [](const IOTraceRecord& left, const IOTraceRecord& right) {
+                       return left.timestamp_ns < right.timestamp_ns;
+                     });
+  }
+  std::cerr << "> Replaying " << records.size() << " I/Os issued by "
+            << num_threads << " thread(s)..." << std::endl;
+
+  // Each thread gets its own (aligned) buffer filled with random data.
+  std::mt19937 prng(FLAGS_seed);
+  std::vector<std::unique_ptr<char, decltype(&free)>> buffers;
+  for (uint32_t i = 0; i < num_threads; ++i) {
+    char* buffer = static_cast<char*>(
+        aligned_alloc(page_size, max_pages * page_size));
+    for (size_t j = 0; j < max_pages * page_size; ++j) {
+      buffer[j] = static_cast<char>(prng());
+    }
+    buffers.emplace_back(buffer, &free);
+  }
+
+  std::vector<ThreadResult> results(num_threads);
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  const Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back(ReplayThread, fd, std::cref(per_thread[i]),
+                         std::cref(file_offsets), page_size,
+                         buffers[i].get(), start, &results[i]);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const auto elapsed = Clock::now() - start;
+  close(fd);
+
+  Histograms latencies;
+  LatencyHistogram lag;
+  for (const auto& result : results) {
+    for (size_t i = 0; i < kNumGroups; ++i) {
+      latencies[i].Merge(result.latencies[i]);
+    }
+    lag.Merge(result.lag);
+  }
+
+  uint64_t trace_duration_ns = 0;
+  for (const auto& rec : records) {
+    trace_duration_ns = std::max(trace_duration_ns, rec.timestamp_ns);
+  }
+  std::cerr << "> Trace duration: " << trace_duration_ns / 1e9 << " s"
+            << std::endl;
+  std::cerr << "> Replay duration: "
+            << std::chrono::duration<double>(elapsed).count() << " s"
+            << std::endl;
+  if (lag.Count() > 0) {
+    std::cerr << "> Issue lag (us): mean " << lag.Mean() / 1e3 << ", p99 "
+              << lag.Percentile(99) / 1e3 << std::endl;
+  }
+
+  std::cout << "op,cause,count,mean_us,p50_us,p99_us,max_us" << std::endl;
+  for (size_t is_write = 0; is_write < 2; ++is_write) {
+    for (size_t c = 0; c < kNumIOCauses; ++c) {
+      const IOCause cause = static_cast<IOCause>(c);
+      const LatencyHistogram& h = latencies[GroupFor(is_write, cause)];
+      if (h.Count() == 0) continue;
+      PrintRow(is_write ? "write" : "read", IOCauseName(cause), h);
+    }
+  }
+  return 0;
+}
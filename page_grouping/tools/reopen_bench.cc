@@ -0,0 +1,294 @@
+// Measures how long it takes to reopen an existing page-grouped database.
+//
+// The tool first builds a database: it bulk loads `--records` random keys,
+// optionally shuffles the segments in each segment file (like `pg_shuffle`),
+// and then optionally inserts `--insert_fraction * --records` new keys to
+// create overflows and reorganizations. It then closes and reopens the
+// database `--reopen_rounds` times and prints a CSV row for each reopen with
+// the time spent in `PageGroupedDB::Open()`, the I/O issued during the open,
+// and the memory used after the open.
+//
+// Progress is printed to stderr; the results are printed to stdout.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "page_grouping/manager.h"
+#include "page_grouping/persist/page.h"
+#include "page_grouping/persist/segment_file.h"
+#include "page_grouping/segment_builder.h"
+#include "treeline/pg_db.h"
+#include "treeline/pg_simulated_ssd.h"
+
+DEFINE_string(db_path, "",
+              "Path to the database directory. The directory must not exist "
+              "(or must be empty).");
+DEFINE_uint64(records, 10000000, "The number of records to bulk load.");
+DEFINE_uint32(record_size, 16,
+              "The size of each record in bytes (including the 8 byte key).");
+DEFINE_uint32(seed, 42, "The seed to use for the PRNG (for reproducibility).");
+
+DEFINE_bool(shuffle, false,
+            "If true, the segments in each segment file are shuffled after "
+            "the bulk load (see `pg_shuffle`).");
+DEFINE_double(insert_fraction, 0,
+              "After the bulk load, insert this many new keys (as a fraction "
+              "of `--records`) to create overflows and reorganizations.");
+
+DEFINE_uint32(reopen_rounds, 3, "The number of times to reopen the database.");
+DEFINE_bool(index_checkpoint, false,
+            "Passed to PageGroupedDBOptions::index_checkpoint when reopening "
+            "the database. The database is built without a checkpoint, so "
+            "the first reopen always scans the segment files.");
+
+DEFINE_uint32(goal, 44,
+              "Passed to PageGroupedDBOptions::records_per_page_goal.");
+DEFINE_double(epsilon, 5,
+              "Passed to PageGroupedDBOptions::records_per_page_epsilon.");
+DEFINE_bool(use_memory_based_io, false,
+            "Passed to PageGroupedDBOptions::use_memory_based_io.");
+DEFINE_uint64(bg_threads, 16,
+              "Passed to PageGroupedDBOptions::num_bg_threads.");
+DEFINE_uint64(record_cache_capacity, 1024 * 1024,
+              "Passed to PageGroupedDBOptions::record_cache_capacity.");
+
+DEFINE_bool(sim_ssd, false,
+            "If true, the segment files are stored on a simulated SSD (with "
+            "its default performance model) instead of the file system.");
+
+using namespace tl;
+using namespace tl::pg;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Reads a counter from a /proc/self file that has "<name>: <value>" lines
+// (e.g., /proc/self/io). Returns 0 if the counter is not available.
+uint64_t ReadProcCounter(const std::string& file, const std::string& name) {
+  std::ifstream in(file);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, name.size(), name) != 0 || line.size() <= name.size() ||
+        line[name.size()] != ':') {
+      continue;
+    }
+    std::istringstream fields(line.substr(name.size() + 1));
+    uint64_t value = 0;
+    fields >> value;
+    return value;
+  }
+  return 0;
+}
+
+struct ProcessIO {
+  static ProcessIO Now() {
+    ProcessIO io;
+    io.read_calls = ReadProcCounter("/proc/self/io", "syscr");
+    io.read_chars = ReadProcCounter("/proc/self/io", "rchar");
+    io.read_bytes = ReadProcCounter("/proc/self/io", "read_bytes");
+    return io;
+  }
+
+  uint64_t read_calls = 0;
+  // Bytes read by read system calls (including reads served by the page
+  // cache).
+  uint64_t read_chars = 0;
+  // Bytes fetched from the storage device.
+  uint64_t read_bytes = 0;
+};
+
+// In KiB.
+uint64_t ResidentMemory() {
+  return ReadProcCounter("/proc/self/status", "VmRSS");
+}
+
+PageGroupedDBOptions GetOptions(const std::shared_ptr<SimulatedSSD>& ssd) {
+  PageGroupedDBOptions options;
+  options.use_segments = true;
+  options.records_per_page_goal = FLAGS_goal;
+  options.records_per_page_epsilon = FLAGS_epsilon;
+  options.use_memory_based_io = FLAGS_use_memory_based_io;
+  options.num_bg_threads = FLAGS_bg_threads;
+  options.record_cache_capacity = FLAGS_record_cache_capacity;
+  options.simulated_ssd = ssd;
+  return options;
+}
+
+PageGroupedDB* OpenDB(const PageGroupedDBOptions& options) {
+  PageGroupedDB* db = nullptr;
+  const Status status = PageGroupedDB::Open(options, FLAGS_db_path, &db);
+  if (!status.ok()) {
+    throw std::runtime_error(status.ToString());
+  }
+  return db;
+}
+
+void CheckStatus(const Status& status) {
+  if (!status.ok()) {
+    throw std::runtime_error(status.ToString());
+  }
+}
+
+// Fisher-Yates shuffle at the granularity of segments, in every segment file
+// (including the single page segments in file 0). This is only safe while the
+// database has no overflow pages (overflows are stored in file 0 and are
+// referenced by their file offset).
+void ShuffleSegments(const PageGroupedDBOptions& options) {
+  std::mt19937 prng(FLAGS_seed);
+  for (size_t file_idx = 0;
+       file_idx < SegmentBuilder::SegmentPageCounts().size(); ++file_idx) {
+    const auto file =
+        Manager::OpenSegmentFile(FLAGS_db_path, file_idx, options);
+    const size_t pages_per_segment = file->PagesPerSegment();
+    const size_t bytes_per_segment = pages_per_segment * pg::Page::kSize;
+    const size_t num_segments = file->NumAllocatedSegments();
+    std::cerr << "> Shuffling " << num_segments << " segments of "
+              << pages_per_segment << " page(s)" << std::endl;
+
+    PageBuffer buffer =
+        PageMemoryAllocator::Allocate(/*num_pages=*/2 * pages_per_segment);
+    void* seg0 = buffer.get();
+    void* seg1 = buffer.get() + bytes_per_segment;
+    for (size_t i = 0; i < num_segments; ++i) {
+      std::uniform_int_distribution<size_t> dist(i, num_segments - 1);
+      const size_t swap_idx = dist(prng);
+      if (swap_idx == i) continue;
+      const size_t offset0 = i * bytes_per_segment;
+      const size_t offset1 = swap_idx * bytes_per_segment;
+      CheckStatus(file->ReadPages(offset0, seg0, pages_per_segment));
+      CheckStatus(file->ReadPages(offset1, seg1, pages_per_segment));
+      CheckStatus(file->WritePages(offset0, seg1, pages_per_segment));
+      CheckStatus(file->WritePages(offset1, seg0, pages_per_segment));
+    }
+    file->Sync();
+  }
+}
+
+void BuildDB(const std::shared_ptr<SimulatedSSD>& ssd) {
+  std::mt19937_64 prng(FLAGS_seed);
+  // Key 0 is reserved.
+  std::uniform_int_distribution<uint64_t> dist(
+      1, std::numeric_limits<uint64_t>::max() - 1);
+  std::unordered_set<uint64_t> keys;
+  keys.reserve(FLAGS_records);
+  while (keys.size() < FLAGS_records) {
+    keys.insert(dist(prng));
+  }
+  std::vector<uint64_t> sorted_keys(keys.begin(), keys.end());
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+
+  const std::string value(FLAGS_record_size - sizeof(uint64_t), 'x');
+  std::vector<Record> records;
+  records.reserve(sorted_keys.size());
+  for (const uint64_t key : sorted_keys) {
+    records.emplace_back(key, Slice(value));
+  }
+
+  const PageGroupedDBOptions options = GetOptions(ssd);
+  std::cerr << "> Bulk loading " << records.size() << " records" << std::endl;
+  PageGroupedDB* db = OpenDB(options);
+  CheckStatus(db->BulkLoad(records));
+  delete db;
+  records.clear();
+  sorted_keys.clear();
+
+  if (FLAGS_shuffle) {
+    ShuffleSegments(options);
+  }
+
+  const size_t num_inserts =
+      static_cast<size_t>(FLAGS_insert_fraction * FLAGS_records);
+  if (num_inserts == 0) return;
+  std::cerr << "> Inserting " << num_inserts << " records" << std::endl;
+  db = OpenDB(options);
+  const pg::WriteOptions write_options;
+  for (size_t inserted = 0; inserted < num_inserts;) {
+    const uint64_t key = dist(prng);
+    if (!keys.insert(key).second) continue;
+    CheckStatus(db->Put(write_options, key, Slice(value)));
+    ++inserted;
+  }
+  delete db;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage(
+      "Measures the time it takes to reopen a page-grouped database.");
+  gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
+  if (FLAGS_db_path.empty()) {
+    std::cerr << "ERROR: Must provide a database path." << std::endl;
+    return 1;
+  }
+  if (fs::exists(FLAGS_db_path) && !fs::is_empty(FLAGS_db_path)) {
+    std::cerr << "ERROR: The database directory must be empty." << std::endl;
+    return 1;
+  }
+  if (FLAGS_record_size <= sizeof(uint64_t)) {
+    std::cerr << "ERROR: The record size must be larger than 8 bytes."
+              << std::endl;
+    return 1;
+  }
+
+  const std::shared_ptr<SimulatedSSD> ssd =
+      FLAGS_sim_ssd ? SimulatedSSD::Create() : nullptr;
+  BuildDB(ssd);
+
+  std::cout << "round,open_ms,read_calls,read_chars,read_bytes,sim_ssd_reads,"
+               "sim_ssd_bytes_read,rss_before_kib,rss_after_kib,segments,"
+               "overflowed_segments,free_list_entries,segment_index_bytes"
+            << std::endl;
+
+  PageGroupedDBOptions options = GetOptions(ssd);
+  options.index_checkpoint = FLAGS_index_checkpoint;
+  for (size_t round = 0; round < FLAGS_reopen_rounds; ++round) {
+    PageGroupedDBStats::Local().Reset();
+    if (ssd != nullptr) ssd->ResetStats();
+    const uint64_t rss_before = ResidentMemory();
+    const ProcessIO io_before = ProcessIO::Now();
+
+    const auto start = std::chrono::steady_clock::now();
+    PageGroupedDB* db = OpenDB(options);
+    const auto end = std::chrono::steady_clock::now();
+
+    const ProcessIO io_after = ProcessIO::Now();
+    const uint64_t rss_after = ResidentMemory();
+    SimulatedSSDStats ssd_stats;
+    if (ssd != nullptr) ssd->GetStats(&ssd_stats);
+    PageGroupedDBLiveStats stats;
+    CheckStatus(db->GetStats(&stats));
+    uint64_t segments = 0;
+    for (const uint64_t count : stats.segments_by_size) {
+      segments += count;
+    }
+    // The segment index's size is posted when the database is closed.
+    delete db;
+
+    std::cout << round << ","
+              << std::chrono::duration<double, std::milli>(end - start).count()
+              << "," << io_after.read_calls - io_before.read_calls << ","
+              << io_after.read_chars - io_before.read_chars << ","
+              << io_after.read_bytes - io_before.read_bytes << ","
+              << ssd_stats.reads << "," << ssd_stats.bytes_read << ","
+              << rss_before << "," << rss_after << "," << segments << ","
+              << stats.overflowed_segments << "," << stats.free_list_entries
+              << ","
+              << PageGroupedDBStats::Local().GetSegmentIndexBytes()
+              << std::endl;
+  }
+
+  return 0;
+}
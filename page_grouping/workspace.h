@@ -4,6 +4,7 @@
 
 #include "bufmgr/page_memory_allocator.h"
 #include "segment_builder.h"
+#include "treeline/pg_stats.h"
 
 namespace tl {
 namespace pg {
@@ -16,19 +17,28 @@ class Workspace {
     write_counts_.resize(SegmentBuilder::SegmentPageCounts().back(), 0);
   }
 
-  PageBuffer& buffer() {
-    if (buf_ != nullptr) return buf_;
+  // The workspace is shared by all databases used by this thread, so each
+  // caller passes its own placement policy. If `numa_local` is true and the
+  // buffer was not placed on this thread's NUMA node, it is reallocated.
+  PageBuffer& buffer(const bool numa_local = false) {
+    if (buf_ != nullptr && (buf_numa_local_ || !numa_local)) return buf_;
     // Add one for the overflow page.
     buf_ = PageMemoryAllocator::Allocate(
-        /*num_pages=*/SegmentBuilder::SegmentPageCounts().back() + 1);
+        /*num_pages=*/SegmentBuilder::SegmentPageCounts().back() + 1,
+        numa_local);
+    buf_numa_local_ = numa_local;
     return buf_;
   }
 
   static constexpr size_t kPrefetchBufferPages = 80;
 
-  PageBuffer& prefetch_buffer() {
-    if (prefetch_buf_ != nullptr) return prefetch_buf_;
-    prefetch_buf_ = PageMemoryAllocator::Allocate(kPrefetchBufferPages);
+  PageBuffer& prefetch_buffer(const bool numa_local = false) {
+    if (prefetch_buf_ != nullptr && (prefetch_buf_numa_local_ || !numa_local)) {
+      return prefetch_buf_;
+    }
+    prefetch_buf_ =
+        PageMemoryAllocator::Allocate(kPrefetchBufferPages, numa_local);
+    prefetch_buf_numa_local_ = numa_local;
     return prefetch_buf_;
   }
 
@@ -37,18 +47,22 @@ class Workspace {
 
   void BumpReadCount(const size_t num_contiguous_pages_read) {
     ++read_counts_[num_contiguous_pages_read - 1];
+    PageGroupedDBStats::Local().BumpPageReads(num_contiguous_pages_read);
   }
 
   void BumpWriteCount(const size_t num_contiguous_pages_written) {
     ++write_counts_[num_contiguous_pages_written - 1];
+    PageGroupedDBStats::Local().BumpPageWrites(num_contiguous_pages_written);
   }
 
  private:
   // Lazily allocated. Always large enough to hold the largest segment.
   PageBuffer buf_;
+  bool buf_numa_local_ = false;
 
   // Lazily allocated; used for prefetching experiments.
   PageBuffer prefetch_buf_;
+  bool prefetch_buf_numa_local_ = false;
 
   // Tracks the number of page reads/writes of different sizes. The index (plus
   // one) represents the number of pages read (e.g., index 0 means 1 page, index
@@ -0,0 +1,91 @@
+#include "write_combiner.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "treeline/pg_stats.h"
+
+namespace tl {
+namespace pg {
+
+WriteCombiner::WriteCombiner(WriteBatchFn write_batch, KeyBoundsFn key_bounds,
+                             const size_t num_lanes)
+    : write_batch_(std::move(write_batch)),
+      key_bounds_(std::move(key_bounds)),
+      num_lanes_(num_lanes),
+      lanes_(std::make_unique<Lane[]>(num_lanes)) {
+  assert(num_lanes_ > 0);
+}
+
+Status WriteCombiner::Write(const std::vector<std::pair<Key, Slice>>& records) {
+  if (records.empty()) return Status::OK();
+
+  const Key page_lower = key_bounds_(records.front().first).first;
+  Lane& lane = lanes_[std::hash<Key>{}(page_lower) % num_lanes_];
+  Request request{&records, Status::OK(), /*done=*/false};
+
+  std::unique_lock<std::mutex> lock(lane.mutex);
+  lane.pending.push_back(&request);
+  while (!request.done) {
+    if (lane.combining) {
+      lane.cv.wait(lock);
+      continue;
+    }
+
+    // Become the combiner. Our own request is part of the batch, so it will be
+    // done after this round.
+    lane.combining = true;
+    std::vector<Request*> batch;
+    batch.swap(lane.pending);
+    lock.unlock();
+    Apply(batch);
+    lock.lock();
+    for (Request* r : batch) {
+      r->done = true;
+    }
+    lane.combining = false;
+    // Wakes up the writers whose records were applied, as well as the writers
+    // that published records in the meantime (one of them will become the
+    // next combiner).
+    lane.cv.notify_all();
+  }
+  return request.status;
+}
+
+void WriteCombiner::Apply(const std::vector<Request*>& batch) {
+  if (batch.size() == 1) {
+    // Nothing to combine.
+    batch.front()->status = write_batch_(*batch.front()->records);
+    PageGroupedDBStats::Local().BumpCombinedWrites(
+        batch.front()->records->size());
+    return;
+  }
+
+  std::vector<std::pair<Key, Slice>> combined;
+  for (const Request* r : batch) {
+    combined.insert(combined.end(), r->records->begin(), r->records->end());
+  }
+  // The stable sort keeps writes to the same key in publication order, so
+  // keeping the last one makes the latest write win.
+  std::stable_sort(combined.begin(), combined.end(),
+                   [](const auto& left, const auto& right) {
+                     return left.first < right.first;
+                   });
+  auto write_it = combined.begin();
+  for (auto it = combined.begin(); it != combined.end(); ++it) {
+    if (std::next(it) != combined.end() && std::next(it)->first == it->first) {
+      continue;
+    }
+    *write_it++ = *it;
+  }
+  combined.erase(write_it, combined.end());
+
+  const Status status = write_batch_(combined);
+  for (Request* r : batch) {
+    r->status = status;
+  }
+  PageGroupedDBStats::Local().BumpCombinedWrites(combined.size());
+}
+
+}  // namespace pg
+}  // namespace tl
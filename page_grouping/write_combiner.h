@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "key.h"
+#include "treeline/slice.h"
+#include "treeline/status.h"
+
+namespace tl {
+namespace pg {
+
+// Combines concurrent writes into larger sorted batches (flat combining).
+//
+// Writers publish their records to a "lane" chosen by the page that the
+// records belong to. If no other writer is currently applying writes for the
+// lane, the writer becomes the lane's combiner: it takes all the records
+// published to the lane so far, sorts them, and applies them using one call
+// to `write_batch`. Otherwise the writer waits until a combiner has applied
+// its records. This way, concurrent small writes to the same (hot) page turn
+// into one page write.
+//
+// This class is thread-safe.
+class WriteCombiner {
+ public:
+  // Writes a batch of records sorted by key (e.g., `Manager::PutBatch()`).
+  using WriteBatchFn =
+      std::function<Status(const std::vector<std::pair<Key, Slice>>&)>;
+  // Returns the (lower, upper) boundaries of the page that `key` belongs to.
+  using KeyBoundsFn = std::function<std::pair<Key, Key>(Key)>;
+
+  WriteCombiner(WriteBatchFn write_batch, KeyBoundsFn key_bounds,
+                size_t num_lanes = 64);
+
+  WriteCombiner(const WriteCombiner&) = delete;
+  WriteCombiner& operator=(const WriteCombiner&) = delete;
+
+  // Writes `records` (which must be sorted by key) and returns once they have
+  // been applied. The records are assigned to a lane based on the page that
+  // holds the first record. If the same key is written concurrently, the write
+  // that was published last wins.
+  Status Write(const std::vector<std::pair<Key, Slice>>& records);
+
+ private:
+  struct Request {
+    const std::vector<std::pair<Key, Slice>>* records;
+    Status status;
+    bool done;
+  };
+  struct alignas(64) Lane {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<Request*> pending;
+    // Set while a writer is applying the lane's records.
+    bool combining = false;
+  };
+
+  // Applies the records in `batch` using one call to `write_batch_` and sets
+  // each request's status.
+  void Apply(const std::vector<Request*>& batch);
+
+  const WriteBatchFn write_batch_;
+  const KeyBoundsFn key_bounds_;
+  const size_t num_lanes_;
+  std::unique_ptr<Lane[]> lanes_;
+};
+
+}  // namespace pg
+}  // namespace tl
@@ -1,6 +1,15 @@
 #include "record_cache.h"
 
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
 #include "treeline/pg_stats.h"
+#include "util/numa.h"
 
 namespace tl {
 
@@ -11,8 +20,13 @@ RecordCache::RecordCache(const uint64_t capacity, bool use_lru,
     : capacity_(capacity),
       use_lru_(use_lru),
       clock_(0),
+      num_dirty_(0),
+      writeback_cursor_(0),
+      numa_sample_accesses_(false),
       write_out_(std::move(write_out)),
-      key_bounds_(std::move(key_bounds)) {
+      key_bounds_(std::move(key_bounds)),
+      next_range_id_(0),
+      num_cached_ranges_(0) {
   tree_ = std::make_shared<MasstreeWrapper<RecordCacheEntry>>();
   cache_entries.resize(capacity_);
   if (use_lru_) {
@@ -34,12 +48,20 @@ RecordCache::~RecordCache() {
   for (auto i = 0; i < capacity_; ++i) {
     FreeIfValid(i);
   }
+  for (const auto& [epoch, record] : retired_records_) {
+    free(record);
+  }
   cache_entries.clear();
 }
 
 Status RecordCache::Put(const Slice& key, const Slice& value, bool is_dirty,
                         format::WriteType write_type, uint8_t priority,
                         bool safe) {
+  if (key.size() > RecordCacheEntry::kMaxKeySize ||
+      value.size() > RecordCacheEntry::kMaxValueSize) {
+    return Status::InvalidArgument("Record is too large to be cached.");
+  }
+
 retry:
   uint64_t index;
 #ifndef NDEBUG
@@ -68,6 +90,7 @@ retry:
         pg::PageGroupedDBStats::Local().BumpCacheCleanEvictions();
       }
       WriteOutIfDirty(index);
+      InvalidateCachedRange(key_utils::ExtractHead64(entry->GetKey()));
       tree_->remove_value(entry->GetKey().data(), entry->GetKey().size());
     }
   } else {
@@ -81,12 +104,20 @@ retry:
     return Status::OK();
   }
 
-  // Do we need to allocate memory? Only if record is newly-cached, or if the
-  // new value is larger.
-  if (found && entry->GetValue().size() >= value.size()) {
-    ptr = const_cast<char*>(entry->GetKey().data());
+  // Do we need to allocate memory? Only if the entry's existing allocation (if
+  // any) is too small. A replaced allocation may still be read by lock-free
+  // readers (see `GetCacheValue()`), so it is retired instead of freed.
+  const Slice old_key = entry->GetKey();
+  char* retired = nullptr;
+  if (entry->IsValid() && old_key.data() != nullptr &&
+      old_key.size() + entry->GetValue().size() >= key.size() + value.size()) {
+    ptr = const_cast<char*>(old_key.data());
+    if (!found) {
+      memcpy(ptr, key.data(), key.size());
+      entry->SetKey(Slice(ptr, key.size()));
+    }
   } else {
-    FreeIfValid(index);
+    if (entry->IsValid()) retired = const_cast<char*>(old_key.data());
     ptr = static_cast<char*>(malloc(key.size() + value.size()));
 
     // Update key.
@@ -97,10 +128,12 @@ retry:
   // Update value.
   memcpy(ptr + key.size(), value.data(), value.size());
   entry->SetValue(Slice(ptr + key.size(), value.size()));
+  // Readers that enter an epoch after this point can only reach the new copy.
+  if (retired != nullptr) RetireRecord(retired);
 
   // Update metadata.
   entry->SetValidTo(true);
-  entry->SetDirtyTo(found ? (is_dirty || entry->IsDirty()) : (is_dirty));
+  SetDirtyTo(index, found ? (is_dirty || entry->IsDirty()) : (is_dirty));
   if (is_dirty) entry->SetWriteType(write_type);
   entry->SetPriorityTo(priority);
 
@@ -109,7 +142,7 @@ retry:
 
     if (!success) {  // Another thread cached the same key concurrently.
       // Set this cache entry up for eviction.
-      entry->SetDirtyTo(false);
+      SetDirtyTo(index, false);
       entry->SetPriorityTo(0);
       if (safe) entry->Unlock();
 
@@ -158,6 +191,129 @@ Status RecordCache::GetCacheIndex(const Slice& key, bool exclusive,
   return Status::OK();
 }
 
+Status RecordCache::GetCacheValue(const Slice& key, std::string* value_out,
+                                  format::WriteType* write_type_out) {
+  static constexpr uint32_t kSpinsBeforeYield = 64;
+  uint32_t spins = 0;
+  const EpochManager::Guard guard = epochs_.Enter();
+  while (true) {
+    RecordCacheEntry* entry = tree_->get_value(key.data(), key.size());
+    if (entry == nullptr) {
+      pg::PageGroupedDBStats::Local().BumpCacheMisses();
+      return Status::NotFound("Key not in cache");
+    }
+
+    if (TryReadEntry(entry, key, value_out, write_type_out)) {
+      return Status::OK();
+    }
+    // A writer is holding the entry, or it was reused for a different key.
+    if (++spins < kSpinsBeforeYield) {
+      _mm_pause();
+    } else {
+      spins = 0;
+      std::this_thread::yield();
+    }
+  }
+}
+
+void RecordCache::GetCacheValues(
+    const std::vector<Slice>& keys, std::vector<std::string>* values_out,
+    std::vector<format::WriteType>* write_types_out,
+    std::vector<bool>* found_out) {
+  values_out->resize(keys.size());
+  write_types_out->resize(keys.size());
+  found_out->assign(keys.size(), false);
+
+  RecordCacheEntry* entries[kLookupGroupSize];
+  for (size_t start = 0; start < keys.size(); start += kLookupGroupSize) {
+    const size_t group_size = std::min(kLookupGroupSize, keys.size() - start);
+    const size_t distance =
+        std::min(kRecordPrefetchDistance, (group_size + 1) / 2);
+    const EpochManager::Guard guard = epochs_.Enter();
+
+    // The group's lookups are pipelined. In step `s`:
+    // 1. The index lookup for key `s` runs and its entry is prefetched.
+    // 2. The record of key `s - distance` is prefetched (the key and value are
+    //    stored together). Finding the record requires reading its entry, so
+    //    it is only prefetched once the entry's prefetch had `distance` steps
+    //    to complete.
+    // 3. The record of key `s - group_size` is read. If a read races with a
+    //    writer, we fall back to the unbatched lookup.
+    for (size_t step = 0; step < 2 * group_size; ++step) {
+      if (step < group_size) {
+        const Slice& key = keys[start + step];
+        entries[step] = tree_->get_value(key.data(), key.size());
+        if (entries[step] != nullptr) __builtin_prefetch(entries[step]);
+      }
+
+      if (step >= distance && step - distance < group_size) {
+        const RecordCacheEntry* entry = entries[step - distance];
+        if (entry != nullptr) __builtin_prefetch(entry->GetKey().data());
+      }
+
+      if (step < group_size) continue;
+      const size_t i = step - group_size;
+      const size_t idx = start + i;
+      if (entries[i] == nullptr) {
+        pg::PageGroupedDBStats::Local().BumpCacheMisses();
+        continue;
+      }
+      if (TryReadEntry(entries[i], keys[idx], &(*values_out)[idx],
+                       &(*write_types_out)[idx])) {
+        (*found_out)[idx] = true;
+        continue;
+      }
+      (*found_out)[idx] = GetCacheValue(keys[idx], &(*values_out)[idx],
+                                        &(*write_types_out)[idx])
+                              .ok();
+    }
+  }
+}
+
+bool RecordCache::TryReadEntry(RecordCacheEntry* entry, const Slice& key,
+                               std::string* value_out,
+                               format::WriteType* write_type_out) {
+  uint64_t version;
+  // A writer is holding the entry.
+  if (!entry->BeginOptimisticRead(&version)) return false;
+
+  // Snapshot the record's location and validate it before following it: a
+  // writer may replace the record (and change its sizes) at any time, so the
+  // sizes are only known to fit the record once the snapshot is validated.
+  const bool is_valid = entry->IsValid();
+  const Slice entry_key = entry->GetKey();
+  const Slice entry_value = entry->GetValue();
+  const format::WriteType write_type = entry->GetWriteType();
+  if (!entry->ValidateOptimisticRead(version) || !is_valid ||
+      entry_key.data() == nullptr) {
+    return false;
+  }
+
+  // The entry may have been reused for a different key since the lookup. The
+  // record is not freed while we are in an epoch, but a writer may overwrite
+  // it while we copy it (validated below).
+  const bool key_matches = entry_key.compare(key) == 0;
+  if (key_matches) {
+    value_out->assign(entry_value.data(), entry_value.size());
+  }
+  if (!entry->ValidateOptimisticRead(version) || !key_matches) return false;
+
+  if (use_lru_) {
+    lru_queue_->MoveToBack(entry->FindIndexWithin(&cache_entries));
+  } else {
+    entry->IncrementPriority();
+  }
+  *write_type_out = write_type;
+  pg::PageGroupedDBStats::Local().BumpCacheHits();
+  if (numa_sample_accesses_ && numa::ShouldSampleAccess()) {
+    const std::optional<bool> is_local = numa::IsLocal(entry);
+    if (is_local.has_value()) {
+      pg::PageGroupedDBStats::Local().BumpNumaAccesses(*is_local);
+    }
+  }
+  return true;
+}
+
 Status RecordCache::GetRange(const Slice& start_key, size_t num_records,
                              std::vector<uint64_t>* indices_out) const {
   tree_->scan(start_key.data(), start_key.size(), nullptr, 0, true, num_records,
@@ -241,7 +397,7 @@ uint64_t RecordCache::WriteOutIfDirty(uint64_t index) {
   if (!was_dirty) return 0;
   if (!write_out_) {
     // Skip the write out because a write out function was not provided.
-    entry->SetDirtyTo(false);
+    SetDirtyTo(index, false);
     return was_dirty;
   }
 
@@ -272,12 +428,132 @@ uint64_t RecordCache::WriteOutIfDirty(uint64_t index) {
   write_out_(batch);
 
   for (auto& idx : indices) {
-    cache_entries[idx].SetDirtyTo(false);
+    SetDirtyTo(idx, false);
     if (idx != index) cache_entries[idx].Unlock();
   }
   return batch.size();
 }
 
+uint64_t RecordCache::WriteBackDirty(const size_t max_records,
+                                     const WriteOutFn& write_out) {
+  if (capacity_ == 0 || max_records == 0) return 0;
+
+  // Lock a batch of dirty entries, starting from where the last call left off.
+  std::vector<uint64_t> indices;
+  indices.reserve(std::min<uint64_t>(max_records, capacity_));
+  uint64_t scanned = 0;
+  for (; scanned < capacity_ && indices.size() < max_records; ++scanned) {
+    const uint64_t index = (writeback_cursor_ + scanned) % capacity_;
+    auto& entry = cache_entries[index];
+    if (!entry.IsDirty()) continue;
+    // Do not wait for entries that are in use by other threads.
+    if (!entry.TryLock(/*exclusive = */ false)) continue;
+    if (!entry.IsValid() || !entry.IsDirty()) {
+      entry.Unlock();
+      continue;
+    }
+    indices.push_back(index);
+  }
+  writeback_cursor_ = (writeback_cursor_ + scanned) % capacity_;
+  if (indices.empty()) return 0;
+
+  // Keys are stored in big endian form, so sorting by key groups together the
+  // records that belong to the same page.
+  std::sort(indices.begin(), indices.end(), [](uint64_t left, uint64_t right) {
+    return cache_entries[left].GetKey() < cache_entries[right].GetKey();
+  });
+
+  WriteOutBatch batch;
+  batch.reserve(indices.size());
+  for (const auto& idx : indices) {
+    auto& entry = cache_entries[idx];
+    batch.emplace_back(entry.GetKey(), entry.GetValue(), entry.GetWriteType());
+  }
+  if (write_out) write_out(batch);
+
+  for (const auto& idx : indices) {
+    SetDirtyTo(idx, false);
+    cache_entries[idx].Unlock();
+  }
+  return indices.size();
+}
+
+uint64_t RecordCache::GetNumDirty() const {
+  const int64_t num_dirty = num_dirty_.load(std::memory_order_relaxed);
+  return num_dirty > 0 ? num_dirty : 0;
+}
+
+void RecordCache::SetDirtyTo(uint64_t index, bool dirty) {
+  const bool was_dirty = cache_entries[index].SetDirtyTo(dirty);
+  if (was_dirty == dirty) return;
+  num_dirty_.fetch_add(dirty ? 1 : -1, std::memory_order_relaxed);
+}
+
+void RecordCache::BeginCachingRange(const key_utils::KeyHead lower,
+                                    const key_utils::KeyHead upper) {
+  if (lower >= upper) return;
+  std::unique_lock<std::shared_mutex> lock(cached_ranges_mutex_);
+  // Remove any overlapping ranges (e.g., the page boundaries may have changed
+  // due to a reorganization).
+  auto it = cached_ranges_.upper_bound(lower);
+  if (it != cached_ranges_.begin() && std::prev(it)->second.upper > lower) {
+    --it;
+  }
+  while (it != cached_ranges_.end() && it->first < upper) {
+    it = cached_ranges_.erase(it);
+  }
+  cached_ranges_.emplace(lower, TrackedRange{upper, next_range_id_++, false});
+  num_cached_ranges_ = cached_ranges_.size();
+}
+
+void RecordCache::FinishCachingRange(const key_utils::KeyHead lower,
+                                     const key_utils::KeyHead upper) {
+  std::unique_lock<std::shared_mutex> lock(cached_ranges_mutex_);
+  const auto it = cached_ranges_.find(lower);
+  // The range will be missing if it was invalidated.
+  if (it == cached_ranges_.end() || it->second.upper != upper) return;
+  it->second.fully_cached = true;
+}
+
+std::optional<RecordCache::CachedRange> RecordCache::GetFullyCachedRange(
+    const key_utils::KeyHead key) const {
+  if (num_cached_ranges_ == 0) return std::optional<CachedRange>();
+  std::shared_lock<std::shared_mutex> lock(cached_ranges_mutex_);
+  auto it = cached_ranges_.upper_bound(key);
+  if (it == cached_ranges_.begin()) return std::optional<CachedRange>();
+  --it;
+  if (!it->second.fully_cached || key >= it->second.upper) {
+    return std::optional<CachedRange>();
+  }
+  return CachedRange{it->second.upper, it->second.id};
+}
+
+bool RecordCache::IsStillFullyCached(const key_utils::KeyHead key,
+                                     const uint64_t id) const {
+  const auto range = GetFullyCachedRange(key);
+  return range.has_value() && range->id == id;
+}
+
+void RecordCache::InvalidateCachedRange(const key_utils::KeyHead key) {
+  if (num_cached_ranges_ == 0) return;
+  const auto find_range = [this, key]() {
+    auto it = cached_ranges_.upper_bound(key);
+    if (it == cached_ranges_.begin()) return cached_ranges_.end();
+    --it;
+    return key < it->second.upper ? it : cached_ranges_.end();
+  };
+  {
+    // Check using a shared lock first to avoid serializing evictions.
+    std::shared_lock<std::shared_mutex> lock(cached_ranges_mutex_);
+    if (find_range() == cached_ranges_.end()) return;
+  }
+  std::unique_lock<std::shared_mutex> lock(cached_ranges_mutex_);
+  const auto it = find_range();
+  if (it == cached_ranges_.end()) return;
+  cached_ranges_.erase(it);
+  num_cached_ranges_ = cached_ranges_.size();
+}
+
 bool RecordCache::FreeIfValid(uint64_t index) {
   if (cache_entries[index].IsValid()) {
     auto ptr = const_cast<char*>(cache_entries[index].GetKey().data());
@@ -292,6 +568,29 @@ bool RecordCache::FreeIfValid(uint64_t index) {
   }
 }
 
+void RecordCache::RetireRecord(char* record) {
+  std::unique_lock<std::mutex> lock(retired_mutex_);
+  retired_records_.emplace_back(epochs_.Retire(), record);
+  if (retired_records_.size() < kRetiredRecordsBeforeFree) return;
+  lock.unlock();
+  FreeRetiredRecords();
+}
+
+void RecordCache::FreeRetiredRecords() {
+  const EpochManager::Epoch min_active = epochs_.MinActiveEpoch();
+  std::unique_lock<std::mutex> lock(retired_mutex_);
+  // The records are retired in epoch order.
+  const auto end =
+      std::find_if(retired_records_.begin(), retired_records_.end(),
+                   [min_active](const auto& retired) {
+                     return retired.first >= min_active;
+                   });
+  for (auto it = retired_records_.begin(); it != end; ++it) {
+    free(it->second);
+  }
+  retired_records_.erase(retired_records_.begin(), end);
+}
+
 uint64_t RecordCache::ClearCache(bool write_out_dirty) {
   clock_ = 0;
   uint64_t count = 0;
@@ -302,7 +601,7 @@ uint64_t RecordCache::ClearCache(bool write_out_dirty) {
       count += WriteOutIfDirty(i);
       cache_entries[i].Unlock();
     } else {
-      cache_entries[i].SetDirtyTo(false);
+      SetDirtyTo(i, false);
     }
   }
 
@@ -320,11 +619,34 @@ std::vector<std::pair<Slice, Slice>> RecordCache::ExtractDirty() {
     }
     dirty_records.emplace_back(cache_entries[i].GetKey(),
                                cache_entries[i].GetValue());
-    cache_entries[i].SetDirtyTo(false);
+    SetDirtyTo(i, false);
   }
   return dirty_records;
 }
 
+void RecordCache::ForEachRecord(
+    const std::function<void(const Slice& key, const Slice& value,
+                             uint8_t priority)>& fn) {
+  // NOTE: This method is not thread safe and cannot be called concurrently
+  // with any other public method. So we do not take locks.
+  for (uint64_t i = 0; i < capacity_; ++i) {
+    if (!cache_entries[i].IsValid() || cache_entries[i].IsDelete()) {
+      continue;
+    }
+    fn(cache_entries[i].GetKey(), cache_entries[i].GetValue(),
+       cache_entries[i].GetPriority());
+  }
+}
+
+void RecordCache::ConfigureNuma(const bool interleave_entries,
+                                const bool sample_accesses) {
+  if (interleave_entries) {
+    numa::InterleavePages(cache_entries.data(),
+                          cache_entries.size() * sizeof(RecordCacheEntry));
+  }
+  numa_sample_accesses_ = sample_accesses;
+}
+
 uint64_t RecordCache::GetSizeFootprintEstimate() const {
   const uint64_t entries = capacity_ * sizeof(RecordCacheEntry);
   uint64_t entry_payloads = 0;
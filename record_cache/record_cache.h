@@ -2,8 +2,14 @@
 
 #include <atomic>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "db/format.h"
@@ -12,6 +18,7 @@
 #include "third_party/masstree_wrapper/masstree_wrapper.h"
 #include "treeline/statistics.h"
 #include "treeline/status.h"
+#include "util/epoch_manager.h"
 #include "util/hash_queue.h"
 #include "util/key.h"
 
@@ -72,6 +79,9 @@ class RecordCache {
   // Also provided is the eviction `priority` of the tuple, i.e. the # of times
   // the record will be skipped by the CLOCK algorithm.
   //
+  // Returns `Status::InvalidArgument` if the key or the value is too large to
+  // be cached (see `RecordCacheEntry::kMaxKeySize` and `kMaxValueSize`).
+  //
   // Setting `safe = false` lets us switch to a thread-unsafe variant that does
   // not acquire locks. It is intended purely for performance benchmarking.
   Status Put(const Slice& key, const Slice& value, bool is_dirty = false,
@@ -94,6 +104,32 @@ class RecordCache {
   Status GetCacheIndex(const Slice& key, bool exclusive, uint64_t* index_out,
                        bool safe = true);
 
+  // Copy the value of the record associated with `key`, if any, into
+  // `value_out` without locking its cache entry. The read is validated (and
+  // retried) in case it races with a writer. If an entry is found, returns an
+  // OK status and sets `write_type_out` to the cached record's write type;
+  // otherwise, a Status::NotFound() is returned.
+  Status GetCacheValue(const Slice& key, std::string* value_out,
+                       format::WriteType* write_type_out);
+
+  // Similar to `GetCacheValue()`, but looks up a batch of `keys`. The lookups
+  // are interleaved in groups of `kLookupGroupSize` keys (software pipelined
+  // prefetching): the index lookups for a group run back to back and prefetch
+  // the cache entries, each record is prefetched (up to)
+  // `kRecordPrefetchDistance` steps after its entry, and the records are read
+  // once the whole group has been looked up. This overlaps the cache misses of
+  // independent lookups.
+  //
+  // Sets `(*found_out)[i]` to true iff `keys[i]` is cached. If so,
+  // `(*values_out)[i]` and `(*write_types_out)[i]` are set to the cached value
+  // and write type.
+  void GetCacheValues(const std::vector<Slice>& keys,
+                      std::vector<std::string>* values_out,
+                      std::vector<format::WriteType>* write_types_out,
+                      std::vector<bool>* found_out);
+  static constexpr size_t kLookupGroupSize = 16;
+  static constexpr size_t kRecordPrefetchDistance = kLookupGroupSize / 2;
+
   // Retrieve an ascending range of at most `num_records` records, starting from
   // the smallest record whose key is greater than or equal to `start_key`. The
   // cache indices holding the records are return in `indices_out`.
@@ -111,6 +147,20 @@ class RecordCache {
   // structure. Returns the number of dirty entries written out.
   uint64_t WriteOutDirty();
 
+  // Writes out up to `max_records` dirty cache entries using `write_out`. The
+  // records are passed to `write_out` in ascending key order, so records that
+  // belong to the same page are adjacent in the batch. Entries that are locked
+  // by other threads are skipped (they will be considered again on the next
+  // call). Returns the number of entries written out.
+  //
+  // This method is meant to be used by a background writer and must not run
+  // concurrently with itself. It is safe to run concurrently with the other
+  // thread-safe methods.
+  uint64_t WriteBackDirty(size_t max_records, const WriteOutFn& write_out);
+
+  // Returns the (approximate) number of dirty entries in the cache.
+  uint64_t GetNumDirty() const;
+
   // Clears the cache: any clean cache records are deleted and any dirty cached
   // records are optionally written out based on `write_out_dirty` and then also
   // deleted. The eviction clock is reset to 0. Returns the number of dirty
@@ -126,6 +176,49 @@ class RecordCache {
   // until the next call to a public method.
   std::vector<std::pair<Slice, Slice>> ExtractDirty();
 
+  // Calls `fn` on every record in the cache, except for cached deletes. The
+  // record's key and value are only valid during the call.
+  //
+  // This method is NOT thread safe and cannot run concurrently with any other
+  // public methods.
+  void ForEachRecord(
+      const std::function<void(const Slice& key, const Slice& value,
+                               uint8_t priority)>& fn);
+
+  // Tracking for "fully cached" key ranges: ranges for which all of the
+  // database's records are in the cache. A range is invalidated as soon as
+  // any cached record that falls in the range is evicted. Ranges are
+  // represented using a lower (inclusive) and upper (exclusive) bound.
+  //
+  // To mark a range as fully cached, call `BeginCachingRange()` before caching
+  // the range's records and `FinishCachingRange()` afterwards. The range will
+  // not be marked if any record in the range is evicted in the meantime.
+  void BeginCachingRange(key_utils::KeyHead lower, key_utils::KeyHead upper);
+  void FinishCachingRange(key_utils::KeyHead lower, key_utils::KeyHead upper);
+
+  struct CachedRange {
+    key_utils::KeyHead upper;
+    // Used to check that the range was not invalidated (and then marked
+    // again) while it was being used.
+    uint64_t id;
+  };
+
+  // Returns the fully cached range that contains `key`, if any.
+  std::optional<CachedRange> GetFullyCachedRange(key_utils::KeyHead key) const;
+
+  // Returns true iff the fully cached range that contains `key` is still the
+  // range identified by `id`.
+  bool IsStillFullyCached(key_utils::KeyHead key, uint64_t id) const;
+
+  // Configures the cache's NUMA placement. If `interleave_entries` is true, the
+  // cache entries are interleaved across the NUMA nodes. If `sample_accesses`
+  // is true, the cache samples hits to record whether the entries are on the
+  // accessing thread's NUMA node (see `pg::PageGroupedDBStats`).
+  //
+  // This method is NOT thread safe and should be called before the cache is
+  // used.
+  void ConfigureNuma(bool interleave_entries, bool sample_accesses);
+
   // Get an estimate of the cache's size footprint. The returned size is missing
   // the size of ART. This method is NOT thread safe and cannot run concurrently
   // with any other public methods.
@@ -135,6 +228,14 @@ class RecordCache {
   std::shared_ptr<MasstreeWrapper<RecordCacheEntry>> GetMasstreePointer();
 
  private:
+  // Used by `GetCacheValue()` and `GetCacheValues()` to optimistically read
+  // `entry`, which was found by looking up `key`. Returns false if the read
+  // raced with a writer or if the entry was reused for a different key (the
+  // caller should look up the key again). The caller must have entered
+  // `epochs_` so that the entry's record is not freed during the read.
+  bool TryReadEntry(RecordCacheEntry* entry, const Slice& key,
+                    std::string* value_out, format::WriteType* write_type_out);
+
   // Implements `GetRange` but adds private functionality to avoid locking a
   // specific cache entry (used during writeout).
   Status GetRangeImpl(
@@ -159,10 +260,25 @@ class RecordCache {
   // (at least in non-exclusive mode).
   uint64_t WriteOutIfDirty(uint64_t index);
 
+  // Sets the dirty bit of the cache entry at `index` to `dirty`, keeping
+  // `num_dirty_` up to date. The caller should hold the entry's lock.
+  void SetDirtyTo(uint64_t index, bool dirty);
+
+  // Removes the tracked key range (see `BeginCachingRange()`) that contains
+  // `key`, if any. Called when a record with `key` is evicted.
+  void InvalidateCachedRange(key_utils::KeyHead key);
+
   // Frees the cache-owned copy of the record stored in the cache entry at
   // `index`, if the entry is valid. Returns true if the entry was valid.
   bool FreeIfValid(uint64_t index);
 
+  // Frees `record` (a cache-owned copy of a record that is no longer reachable
+  // from any cache entry) once no lock-free reader can still be reading it.
+  void RetireRecord(char* record);
+  // Frees the retired records that no reader can reach anymore.
+  void FreeRetiredRecords();
+  static constexpr size_t kRetiredRecordsBeforeFree = 64;
+
   // The number of cache entries.
   const uint64_t capacity_;
 
@@ -183,6 +299,16 @@ class RecordCache {
   // The index of the next cache entry to be considered for eviction.
   std::atomic<uint64_t> clock_;
 
+  // The number of dirty cache entries. This is a signed counter because
+  // callers may manipulate the dirty bits directly (e.g., in the tests).
+  std::atomic<int64_t> num_dirty_;
+
+  // The index of the next cache entry to be considered by `WriteBackDirty()`.
+  uint64_t writeback_cursor_;
+
+  // Whether to sample cache hits for NUMA statistics.
+  bool numa_sample_accesses_;
+
   // The function to run when the cache needs to write out records (e.g.,
   // because they need to be evicted). This member can be "empty", which
   // indicates that no persistence guarantees are provided (data will be lost
@@ -198,6 +324,29 @@ class RecordCache {
   std::shared_ptr<MasstreeWrapper<RecordCacheEntry>> tree_;
 
   std::unique_ptr<HashQueue<uint64_t>> lru_queue_;
+
+  // Tracked key ranges, keyed by their lower bound. Maps to the range's upper
+  // bound, its ID, and whether the range is fully cached (the range is
+  // "pending" between calls to `BeginCachingRange()` and
+  // `FinishCachingRange()`). The ranges do not overlap.
+  struct TrackedRange {
+    key_utils::KeyHead upper;
+    uint64_t id;
+    bool fully_cached;
+  };
+  std::map<key_utils::KeyHead, TrackedRange> cached_ranges_;
+  mutable std::shared_mutex cached_ranges_mutex_;
+  uint64_t next_range_id_;
+  // Used to skip acquiring `cached_ranges_mutex_` on evictions when there are
+  // no tracked ranges.
+  std::atomic<size_t> num_cached_ranges_;
+
+  // Lock-free readers (see `GetCacheValue()`) enter an epoch before reading a
+  // cache entry. Records replaced by `Put()` are freed once all the readers
+  // that may have reached them have exited.
+  EpochManager epochs_;
+  std::mutex retired_mutex_;
+  std::vector<std::pair<EpochManager::Epoch, char*>> retired_records_;
 };
 
 }  // namespace tl
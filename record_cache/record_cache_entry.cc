@@ -1,7 +1,19 @@
 #include "record_cache_entry.h"
 
+#include <immintrin.h>
+
+#include <limits>
+#include <thread>
+
 #include "assert.h"
 
+namespace {
+
+// The number of times to spin on a contended entry lock before yielding.
+constexpr uint32_t kSpinsBeforeYield = 64;
+
+}  // namespace
+
 namespace tl {
 
 const uint8_t RecordCacheEntry::kValidMask = 0x80;      // 1000 0000
@@ -9,17 +21,21 @@ const uint8_t RecordCacheEntry::kDirtyMask = 0x40;      // 0100 0000
 const uint8_t RecordCacheEntry::kWriteTypeMask = 0x20;  // 0010 0000
 const uint8_t RecordCacheEntry::kPriorityMask = 0x07;   // 0000 0111
 
-RecordCacheEntry::RecordCacheEntry() : metadata_(0) {
-  pthread_rwlock_init(&rwlock_, nullptr);
-}
+const uint64_t RecordCacheEntry::kExclusiveBit = 1ULL;
+const uint64_t RecordCacheEntry::kReaderIncrement = 1ULL << 1;
+const uint64_t RecordCacheEntry::kReaderMask = 0xFFFFFFFEULL;
+const uint64_t RecordCacheEntry::kVersionIncrement = 1ULL << 32;
 
-RecordCacheEntry::~RecordCacheEntry() { pthread_rwlock_destroy(&rwlock_); }
+RecordCacheEntry::RecordCacheEntry()
+    : lock_(0), data_(nullptr), value_size_(0), key_size_(0), metadata_(0) {}
 
-RecordCacheEntry::RecordCacheEntry(RecordCacheEntry&& other) noexcept {
-  pthread_rwlock_init(&rwlock_, nullptr);
+RecordCacheEntry::~RecordCacheEntry() = default;
+
+RecordCacheEntry::RecordCacheEntry(RecordCacheEntry&& other) noexcept
+    : lock_(0), data_(nullptr), value_size_(0), key_size_(0) {
   metadata_ = other.metadata_.load();
-  key_ = Slice(other.GetKey());
-  value_ = Slice(other.GetValue());
+  SetKey(other.GetKey());
+  SetValue(other.GetValue());
 
   other.metadata_ = 0;
   other.SetKey(Slice(nullptr, 0));
@@ -29,12 +45,10 @@ RecordCacheEntry::RecordCacheEntry(RecordCacheEntry&& other) noexcept {
 RecordCacheEntry& RecordCacheEntry::operator=(
     RecordCacheEntry&& other) noexcept {
   if (this != &other) {
-    pthread_rwlock_destroy(&rwlock_);
-
-    pthread_rwlock_init(&rwlock_, nullptr);
+    lock_ = 0;
     metadata_ = other.metadata_.load();
-    key_ = Slice(other.GetKey());
-    value_ = Slice(other.GetValue());
+    SetKey(other.GetKey());
+    SetValue(other.GetValue());
 
     other.metadata_ = 0;
     other.SetKey(Slice(nullptr, 0));
@@ -48,8 +62,10 @@ void RecordCacheEntry::SetValidTo(bool val) {
 }
 bool RecordCacheEntry::IsValid() { return (metadata_ & kValidMask); }
 
-void RecordCacheEntry::SetDirtyTo(bool val) {
-  val ? (metadata_ |= kDirtyMask) : (metadata_ &= ~kDirtyMask);
+bool RecordCacheEntry::SetDirtyTo(bool val) {
+  const uint8_t prev = val ? metadata_.fetch_or(kDirtyMask)
+                           : metadata_.fetch_and(~kDirtyMask);
+  return (prev & kDirtyMask);
 }
 bool RecordCacheEntry::IsDirty() { return (metadata_ & kDirtyMask); }
 
@@ -142,21 +158,80 @@ uint8_t RecordCacheEntry::DecrementPriority(bool return_post) {
   }
 }
 
-Slice RecordCacheEntry::GetKey() const { return key_; }
-void RecordCacheEntry::SetKey(Slice key) { key_ = key; }
+// The record fields are accessed with relaxed atomics: writers hold the lock,
+// and optimistic readers order their loads using the lock word (see
+// `ValidateOptimisticRead()`).
+Slice RecordCacheEntry::GetKey() const {
+  return Slice(data_.load(std::memory_order_relaxed),
+               key_size_.load(std::memory_order_relaxed));
+}
+void RecordCacheEntry::SetKey(Slice key) {
+  assert(key.size() <= kMaxKeySize);
+  data_.store(key.data(), std::memory_order_relaxed);
+  key_size_.store(key.size(), std::memory_order_relaxed);
+}
 
-Slice RecordCacheEntry::GetValue() const { return value_; }
-void RecordCacheEntry::SetValue(Slice value) { value_ = value; }
+Slice RecordCacheEntry::GetValue() const {
+  return Slice(data_.load(std::memory_order_relaxed) +
+                   key_size_.load(std::memory_order_relaxed),
+               value_size_.load(std::memory_order_relaxed));
+}
+void RecordCacheEntry::SetValue(Slice value) {
+  assert(value.size() == 0 ||
+         value.data() == data_.load(std::memory_order_relaxed) +
+                             key_size_.load(std::memory_order_relaxed));
+  assert(value.size() <= kMaxValueSize);
+  value_size_.store(value.size(), std::memory_order_relaxed);
+}
 
 void RecordCacheEntry::Lock(const bool exclusive) {
-  exclusive ? pthread_rwlock_wrlock(&rwlock_) : pthread_rwlock_rdlock(&rwlock_);
+  uint32_t spins = 0;
+  while (!TryLock(exclusive)) {
+    if (++spins < kSpinsBeforeYield) {
+      _mm_pause();
+    } else {
+      spins = 0;
+      std::this_thread::yield();
+    }
+  }
 }
 bool RecordCacheEntry::TryLock(const bool exclusive) {
-  auto ret = exclusive ? pthread_rwlock_trywrlock(&rwlock_)
-                       : pthread_rwlock_tryrdlock(&rwlock_);
-  return (ret == 0);
+  uint64_t word = lock_.load(std::memory_order_relaxed);
+  if (exclusive) {
+    if ((word & (kExclusiveBit | kReaderMask)) != 0) return false;
+    return lock_.compare_exchange_strong(word, word | kExclusiveBit,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+  }
+  do {
+    if ((word & kExclusiveBit) != 0) return false;
+  } while (!lock_.compare_exchange_weak(word, word + kReaderIncrement,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed));
+  return true;
+}
+void RecordCacheEntry::Unlock() {
+  // Only the exclusive holder can be holding the lock when the exclusive bit
+  // is set.
+  if ((lock_.load(std::memory_order_relaxed) & kExclusiveBit) != 0) {
+    lock_.fetch_add(kVersionIncrement - kExclusiveBit,
+                    std::memory_order_release);
+  } else {
+    lock_.fetch_sub(kReaderIncrement, std::memory_order_release);
+  }
+}
+
+bool RecordCacheEntry::BeginOptimisticRead(uint64_t* version) const {
+  const uint64_t word = lock_.load(std::memory_order_acquire);
+  if ((word & kExclusiveBit) != 0) return false;
+  *version = word & ~kReaderMask;
+  return true;
+}
+bool RecordCacheEntry::ValidateOptimisticRead(uint64_t version) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t word = lock_.load(std::memory_order_relaxed);
+  return (word & ~kReaderMask) == version;
 }
-void RecordCacheEntry::Unlock() { pthread_rwlock_unlock(&rwlock_); }
 
 uint64_t RecordCacheEntry::FindIndexWithin(std::vector<RecordCacheEntry>* vec) {
   return ((reinterpret_cast<uint8_t*>(this) -
@@ -1,9 +1,9 @@
 #pragma once
 
-#include <pthread.h>
 #include <stdint.h>
 
 #include <atomic>
+#include <limits>
 #include <vector>
 
 #include "db/format.h"
@@ -13,6 +13,10 @@ namespace tl {
 
 class RecordCacheEntry {
  public:
+  // The largest key and value sizes (in bytes) that an entry can store.
+  static constexpr size_t kMaxKeySize = std::numeric_limits<uint16_t>::max();
+  static constexpr size_t kMaxValueSize = std::numeric_limits<uint32_t>::max();
+
   RecordCacheEntry();
   ~RecordCacheEntry();
 
@@ -32,8 +36,8 @@ class RecordCacheEntry {
   void SetValidTo(bool val);
   bool IsValid();
 
-  // Set/query the dirty bit
-  void SetDirtyTo(bool val);
+  // Set/query the dirty bit. `SetDirtyTo()` returns the previous value.
+  bool SetDirtyTo(bool val);
   bool IsDirty();
 
   // Modify write type
@@ -52,7 +56,9 @@ class RecordCacheEntry {
   uint8_t IncrementPriority(bool return_post = true);  // With upper bound.
   uint8_t DecrementPriority(bool return_post = true);  // With lower bound.
 
-  // Access/modify key
+  // Access/modify key. The key and value are stored contiguously (the value
+  // must immediately follow the key in memory). The key and value must not be
+  // larger than `kMaxKeySize` and `kMaxValueSize`.
   Slice GetKey() const;
   void SetKey(Slice key);
 
@@ -66,6 +72,13 @@ class RecordCacheEntry {
   bool TryLock(const bool exclusive);  // Returns true iff successful.
   void Unlock();
 
+  // Optimistic (lock-free) reads. `BeginOptimisticRead()` returns false if a
+  // writer currently holds the lock. Otherwise, the caller can read the entry
+  // and must then call `ValidateOptimisticRead()` with the returned `version`.
+  // The data read is only consistent if validation succeeds.
+  bool BeginOptimisticRead(uint64_t* version) const;
+  bool ValidateOptimisticRead(uint64_t version) const;
+
   // Retrieves the index of a `RecordCacheEntry` within a vector `vec`.
   uint64_t FindIndexWithin(std::vector<RecordCacheEntry>* vec);
 
@@ -80,14 +93,27 @@ class RecordCacheEntry {
   // the encoding of `metadata_`.
   uint8_t ExtractPriority(uint8_t flags);
 
-  // A read-write lock to be held when accessing this entry.
-  pthread_rwlock_t rwlock_;
-
-  // The key of the record stored in this entry.
-  Slice key_;
+  // Bitmasks for the lock word.
+  static const uint64_t kExclusiveBit;
+  static const uint64_t kReaderIncrement;
+  static const uint64_t kReaderMask;
+  static const uint64_t kVersionIncrement;
 
-  // The value of the record stored in this entry.
-  Slice value_;
+  // A spinning read-write lock to be held when accessing this entry.
+  //
+  //  bits      63 ... 32 | 31 ... 1 |     0
+  //  field      version  | readers  | exclusive
+  //
+  // The version is incremented each time an exclusive holder releases the
+  // lock, which allows readers to validate optimistic (lock-free) reads.
+  std::atomic<uint64_t> lock_;
+
+  // The record stored in this entry (the key, immediately followed by the
+  // value). These fields are atomic because optimistic readers load them while
+  // a writer may be updating them.
+  std::atomic<const char*> data_;
+  std::atomic<uint32_t> value_size_;
+  std::atomic<uint16_t> key_size_;
 
   // The metadata associated with this entry.
   //
@@ -0,0 +1,58 @@
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "util/epoch_manager.h"
+
+namespace {
+
+using namespace tl;
+
+TEST(EpochManagerTest, ReclaimAfterReadersExit) {
+  EpochManager m;
+
+  // No readers: anything retired can be reclaimed right away.
+  const EpochManager::Epoch first = m.Retire();
+  ASSERT_GT(m.MinActiveEpoch(), first);
+
+  std::optional<EpochManager::Guard> reader1(m.Enter());
+  const EpochManager::Epoch second = m.Retire();
+  // `reader1` entered before the retirement, so it may still read the data.
+  ASSERT_LE(m.MinActiveEpoch(), second);
+
+  // Readers that enter after the retirement do not hold it back.
+  std::optional<EpochManager::Guard> reader2(m.Enter());
+  const EpochManager::Epoch third = m.Retire();
+  ASSERT_LE(m.MinActiveEpoch(), second);
+
+  reader1.reset();
+  ASSERT_GT(m.MinActiveEpoch(), second);
+  ASSERT_LE(m.MinActiveEpoch(), third);
+
+  reader2.reset();
+  ASSERT_GT(m.MinActiveEpoch(), third);
+}
+
+TEST(EpochManagerTest, ConcurrentReaders) {
+  EpochManager m;
+  constexpr size_t kNumThreads = 8;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&m]() {
+      for (size_t i = 0; i < 1000; ++i) {
+        const auto guard = m.Enter();
+        if (i % 10 == 0) m.Retire();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // All readers exited.
+  const EpochManager::Epoch last = m.Retire();
+  ASSERT_GT(m.MinActiveEpoch(), last);
+}
+
+}  // namespace
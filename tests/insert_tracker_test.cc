@@ -5,6 +5,7 @@
 #include <optional>
 #include <random>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -158,6 +159,48 @@ TEST(InsertTrackerTest, TwoCompletedEpochsOnePartition) {
   ASSERT_EQ(num_inserts_future_epochs, 84);
 }
 
+TEST(InsertTrackerTest, ConcurrentInserts) {
+  const size_t num_threads = 4;
+  const size_t num_inserts_per_thread = 100000;
+  const size_t num_inserts_per_epoch = 10000;
+  const size_t num_partitions = 10;
+  const size_t sample_size = 1000;
+
+  InsertTracker tracker(num_inserts_per_epoch, num_partitions, sample_size,
+                        /*random_seed=*/42, /*num_shards=*/num_threads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&tracker, t]() {
+      std::mt19937 gen(t);
+      std::uniform_int_distribution<uint64_t> dist(0, 3999999);
+      for (size_t i = 0; i < num_inserts_per_thread; ++i) {
+        tracker.Add(dist(gen));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Each epoch should have about `num_inserts_per_epoch` inserts (the shards
+  // publish their inserts in batches), spread evenly over the key space (keys
+  // smaller than the first partition boundary are not counted).
+  ASSERT_EQ(tracker.NumCompletedEpochs(),
+            (num_threads * num_inserts_per_thread - sample_size) /
+                num_inserts_per_epoch);
+  double num_inserts_future_epochs;
+  ASSERT_TRUE(tracker.GetNumInsertsInKeyRangeForNumFutureEpochs(
+      0, std::numeric_limits<uint64_t>::max(), /*num_future_epochs=*/1,
+      &num_inserts_future_epochs));
+  ASSERT_GE(num_inserts_future_epochs, 0.9 * num_inserts_per_epoch);
+  ASSERT_LE(num_inserts_future_epochs, 1.1 * num_inserts_per_epoch);
+
+  ASSERT_TRUE(tracker.GetNumInsertsInKeyRangeForNumFutureEpochs(
+      0, 2000000, /*num_future_epochs=*/1, &num_inserts_future_epochs));
+  ASSERT_GE(num_inserts_future_epochs, 0.4 * num_inserts_per_epoch);
+  ASSERT_LE(num_inserts_future_epochs, 0.6 * num_inserts_per_epoch);
+}
+
 // TEST(InsertTrackerTest, Perf) {
 //   InsertTracker tracker(/*num_inserts_per_epoch=*/1000,
 //   /*num_partitions=*/100,
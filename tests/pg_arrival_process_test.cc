@@ -0,0 +1,59 @@
+#include <chrono>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "page_grouping/arrival_process.h"
+
+namespace {
+
+using namespace tl;
+using namespace tl::pg;
+
+using Nanos = ArrivalProcess::Nanos;
+
+TEST(PGArrivalProcessTest, PoissonRate) {
+  ArrivalProcess::Options options;
+  options.kind = ArrivalProcess::Kind::kPoisson;
+  options.rate = 50000;
+  ArrivalProcess process(options, /*seed=*/42);
+
+  constexpr size_t kArrivals = 200000;
+  Nanos prev(0), last(0);
+  for (size_t i = 0; i < kArrivals; ++i) {
+    last = process.Next();
+    ASSERT_GE(last, prev);
+    prev = last;
+  }
+  const double rate = kArrivals / std::chrono::duration<double>(last).count();
+  ASSERT_NEAR(rate, options.rate, options.rate * 0.02);
+}
+
+TEST(PGArrivalProcessTest, BurstyRate) {
+  ArrivalProcess::Options options;
+  options.kind = ArrivalProcess::Kind::kBursty;
+  options.rate = 50000;
+  options.burst_factor = 4;
+  options.burst_duty = 0.2;
+  options.burst_period = std::chrono::milliseconds(10);
+  ArrivalProcess process(options, /*seed=*/42);
+
+  constexpr size_t kArrivals = 200000;
+  size_t in_burst = 0;
+  Nanos prev(0), last(0);
+  const int64_t period = options.burst_period.count();
+  const int64_t burst_end = period * options.burst_duty;
+  for (size_t i = 0; i < kArrivals; ++i) {
+    last = process.Next();
+    ASSERT_GE(last, prev);
+    prev = last;
+    if (last.count() % period < burst_end) ++in_burst;
+  }
+  const double rate = kArrivals / std::chrono::duration<double>(last).count();
+  ASSERT_NEAR(rate, options.rate, options.rate * 0.02);
+
+  // 20% of the time is spent in bursts at 4x the mean rate, so 80% of the
+  // arrivals should fall in a burst.
+  ASSERT_NEAR(static_cast<double>(in_burst) / kArrivals, 0.8, 0.01);
+}
+
+}  // namespace
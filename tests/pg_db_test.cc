@@ -1,12 +1,22 @@
 #include "treeline/pg_db.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <numeric>
+#include <random>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
 #include "treeline/pg_options.h"
+#include "treeline/pg_simulated_ssd.h"
+#include "treeline/pg_stats.h"
 
 namespace {
 
@@ -182,6 +192,138 @@ TEST_F(PGDBTest, ScanAmount) {
   db = nullptr;
 }
 
+TEST_F(PGDBTest, MultiGet) {
+  for (const bool bypass_cache : {false, true}) {
+    std::filesystem::remove_all(kDBDir);
+    std::filesystem::create_directory(kDBDir);
+    PageGroupedDB* db = nullptr;
+    auto options = GetCommonTestOptions();
+    options.records_per_page_goal = 44;
+    options.records_per_page_epsilon = 5;
+    options.bypass_cache = bypass_cache;
+    ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+    ASSERT_NE(db, nullptr);
+
+    // Load.
+    const std::string value = "Test 1";
+    const auto dataset = GetRangeDataset(10, 1000, value);
+    ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+    // Update some records (these are cached if the cache is used).
+    const std::string new_value = "Test 2";
+    for (size_t i = 0; i < dataset.size(); i += 7) {
+      ASSERT_TRUE(db->Put(WriteOptions(), dataset[i].first, new_value).ok());
+    }
+
+    // Look up existing and non-existent keys in a random order, including
+    // duplicates and a reserved key.
+    std::vector<Key> keys;
+    for (const auto& rec : dataset) {
+      keys.push_back(rec.first);
+      keys.push_back(rec.first + 5);
+    }
+    keys.push_back(dataset[3].first);
+    keys.push_back(std::numeric_limits<Key>::max());
+    std::mt19937 prng(42);
+    std::shuffle(keys.begin(), keys.end(), prng);
+
+    std::vector<std::string> values;
+    std::vector<Status> statuses;
+    ASSERT_TRUE(db->MultiGet(keys, &values, &statuses).ok());
+    ASSERT_EQ(values.size(), keys.size());
+    ASSERT_EQ(statuses.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      std::string expected_value;
+      const Status expected = db->Get(keys[i], &expected_value);
+      ASSERT_EQ(statuses[i].ok(), expected.ok());
+      if (!expected.ok()) {
+        ASSERT_TRUE(statuses[i].IsNotFound());
+        continue;
+      }
+      ASSERT_EQ(values[i], expected_value);
+      const size_t idx = keys[i] / 10 - 1;
+      ASSERT_EQ(values[i], idx % 7 == 0 ? new_value : value);
+    }
+
+    // Close the DB.
+    delete db;
+    db = nullptr;
+  }
+}
+
+TEST_F(PGDBTest, ParallelScan) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.records_per_page_goal = 44;
+  options.records_per_page_epsilon = 5;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  // Load.
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 10000, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+  // Write (update and insert). These records are in the record cache, so the
+  // scan needs to merge them with the records on disk.
+  const std::string new_value = "Test 2";
+  std::map<Key, std::string> expected;
+  for (const auto& rec : dataset) {
+    expected[rec.first] = rec.second.ToString();
+  }
+  for (size_t i = 0; i < dataset.size(); i += 100) {
+    ASSERT_TRUE(db->Put(WriteOptions(), dataset[i].first, new_value).ok());
+    ASSERT_TRUE(db->Put(WriteOptions(), dataset[i].first + 1, new_value).ok());
+    expected[dataset[i].first] = new_value;
+    expected[dataset[i].first + 1] = new_value;
+  }
+
+  const Key start_key = 105, end_key = 90005;
+  const std::vector<std::pair<Key, std::string>> expected_range(
+      expected.lower_bound(start_key), expected.lower_bound(end_key));
+
+  // Ordered scan.
+  std::vector<std::pair<Key, std::string>> scan_out;
+  const auto append = [&scan_out](auto batch) {
+    scan_out.insert(scan_out.end(), std::make_move_iterator(batch.begin()),
+                    std::make_move_iterator(batch.end()));
+  };
+  ASSERT_TRUE(
+      db->ParallelScan(start_key, end_key, /*num_threads=*/4, append).ok());
+  ASSERT_EQ(scan_out, expected_range);
+
+  // Unordered scan (the batches themselves are still sorted).
+  std::mutex mutex;
+  scan_out.clear();
+  ASSERT_TRUE(
+      db->ParallelScan(
+            start_key, end_key, /*num_threads=*/4,
+            [&scan_out,
+             &mutex](std::vector<std::pair<Key, std::string>> batch) {
+              ASSERT_TRUE(std::is_sorted(batch.begin(), batch.end()));
+              std::unique_lock<std::mutex> lock(mutex);
+              scan_out.insert(scan_out.end(),
+                              std::make_move_iterator(batch.begin()),
+                              std::make_move_iterator(batch.end()));
+            },
+            /*ordered=*/false)
+          .ok());
+  std::sort(scan_out.begin(), scan_out.end());
+  ASSERT_EQ(scan_out, expected_range);
+
+  // Invalid arguments.
+  ASSERT_TRUE(
+      db->ParallelScan(start_key, end_key, /*num_threads=*/0, [](auto) {})
+          .IsInvalidArgument());
+  ASSERT_TRUE(db->ParallelScan(end_key, start_key, /*num_threads=*/4,
+                               [](auto) {})
+                  .IsInvalidArgument());
+
+  // Close the DB.
+  delete db;
+  db = nullptr;
+}
+
 TEST_F(PGDBTest, LoadParallelFlushReopenScan) {
   PageGroupedDB* db = nullptr;
   auto options = GetCommonTestOptions();
@@ -232,6 +374,589 @@ TEST_F(PGDBTest, LoadParallelFlushReopenScan) {
   db = nullptr;
 }
 
+TEST_F(PGDBTest, BackgroundWritebackReopenScan) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.records_per_page_goal = 44;
+  options.records_per_page_epsilon = 5;
+  options.record_cache_capacity = 64;
+  options.rec_cache_background_writeback = true;
+  options.rec_cache_writeback_high_watermark = 0.5;
+  options.rec_cache_writeback_low_watermark = 0.25;
+  options.rec_cache_writeback_batch_size = 8;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  // The live statistics include earlier tests' background writebacks.
+  const auto background_writebacks = []() {
+    uint64_t writebacks = 0;
+    PageGroupedDBStats::RunOnLive([&writebacks](const auto& live) {
+      writebacks = live.GetCacheBackgroundWritebacks();
+    });
+    return writebacks;
+  };
+  const uint64_t writebacks_before = background_writebacks();
+
+  // Load.
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 1000, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+  // Update 40 records. They fit in the cache (so they stay dirty until they
+  // are written out), but exceed the high watermark. So the background writer
+  // must write out some of them.
+  const std::string new_value = "Test 2";
+  const size_t num_cached_updates = 40;
+  std::vector<Record> expected(dataset);
+  for (size_t i = 0; i < 2 * num_cached_updates; i += 2) {
+    ASSERT_TRUE(db->Put(WriteOptions(), expected[i].first, new_value).ok());
+    expected[i].second = new_value;
+  }
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (background_writebacks() == writebacks_before &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  ASSERT_GT(background_writebacks(), writebacks_before);
+
+  // Update the rest of every other record (more records than fit in the
+  // cache).
+  for (size_t i = 2 * num_cached_updates; i < expected.size(); i += 2) {
+    ASSERT_TRUE(db->Put(WriteOptions(), expected[i].first, new_value).ok());
+    expected[i].second = new_value;
+  }
+
+  // Read while the background writer may still be running.
+  std::string value_out;
+  for (const auto& rec : expected) {
+    ASSERT_TRUE(db->Get(rec.first, &value_out).ok());
+    ASSERT_EQ(rec.second.compare(value_out), 0);
+  }
+
+  // Reopen.
+  delete db;
+  db = nullptr;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  // Scan.
+  std::vector<std::pair<Key, std::string>> scan_out;
+  ASSERT_TRUE(db->GetRange(1, 2000, &scan_out).ok());
+  ASSERT_EQ(scan_out.size(), expected.size());
+  for (size_t i = 0; i < scan_out.size(); ++i) {
+    ASSERT_EQ(scan_out[i].first, expected[i].first);
+    ASSERT_EQ(expected[i].second.compare(scan_out[i].second), 0);
+  }
+
+  // Close the DB.
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, BackgroundWritebackInvalidWatermarks) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.rec_cache_background_writeback = true;
+  for (const auto& [low, high] :
+       std::vector<std::pair<double, double>>{
+           {0.0, 0.0}, {-0.5, 0.0}, {0.5, 0.5}, {0.6, 0.5}, {-0.1, 0.5},
+           {0.5, 1.5}}) {
+    options.rec_cache_writeback_low_watermark = low;
+    options.rec_cache_writeback_high_watermark = high;
+    ASSERT_TRUE(
+        PageGroupedDB::Open(options, kDBDir, &db).IsInvalidArgument());
+    ASSERT_EQ(db, nullptr);
+  }
+
+  // The watermarks are not used if background writeback is disabled.
+  options.rec_cache_background_writeback = false;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, CacheOnlyScan) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.records_per_page_goal = 44;
+  options.records_per_page_epsilon = 5;
+  options.optimistic_caching = true;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  // Load.
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 1000, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+  // Reading a record caches its entire page.
+  std::string value_out;
+  ASSERT_TRUE(db->Get(100, &value_out).ok());
+
+  // Update a record on the same page; it should be visible to the scan.
+  const std::string new_value = "Test 2";
+  ASSERT_TRUE(db->Put(WriteOptions(), 110, new_value).ok());
+  std::vector<Record> expected(dataset);
+  expected[10].second = new_value;
+
+  // A short scan should be served entirely by the cache.
+  PageGroupedDBStats::Local().Reset();
+  std::vector<std::pair<Key, std::string>> scan_out;
+  ASSERT_TRUE(db->GetRange(100, 5, &scan_out).ok());
+  ASSERT_GE(PageGroupedDBStats::Local().GetCacheRangeHits(), 1);
+  ASSERT_EQ(scan_out.size(), 5);
+  for (size_t i = 0; i < scan_out.size(); ++i) {
+    ASSERT_EQ(scan_out[i].first, expected[i + 9].first);
+    ASSERT_EQ(expected[i + 9].second.compare(scan_out[i].second), 0);
+  }
+
+  // A longer scan continues past the cached page(s) using the disk.
+  scan_out.clear();
+  ASSERT_TRUE(db->GetRange(100, 500, &scan_out).ok());
+  ASSERT_EQ(scan_out.size(), 500);
+  for (size_t i = 0; i < scan_out.size(); ++i) {
+    ASSERT_EQ(scan_out[i].first, expected[i + 9].first);
+    ASSERT_EQ(expected[i + 9].second.compare(scan_out[i].second), 0);
+  }
+
+  // Close the DB.
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, PersistCacheReopenRead) {
+  for (const bool persist_values : {false, true}) {
+    std::filesystem::remove_all(kDBDir);
+    std::filesystem::create_directory(kDBDir);
+
+    PageGroupedDB* db = nullptr;
+    auto options = GetCommonTestOptions();
+    options.rec_cache_persist = true;
+    options.rec_cache_persist_values = persist_values;
+    ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+    ASSERT_NE(db, nullptr);
+
+    // Load.
+    const std::string value = "Test 1";
+    const auto dataset = GetRangeDataset(10, 1000, value);
+    ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+    // Cache some records, one of which is dirty.
+    std::string value_out;
+    for (size_t i = 0; i < dataset.size(); i += 10) {
+      ASSERT_TRUE(db->Get(dataset[i].first, &value_out).ok());
+    }
+    const std::string new_value = "Test 2";
+    ASSERT_TRUE(db->Put(WriteOptions(), dataset[20].first, new_value).ok());
+
+    // Close the DB (writes the cache manifest).
+    delete db;
+    db = nullptr;
+    ASSERT_TRUE(std::filesystem::exists(kDBDir / "CACHE_MANIFEST"));
+
+    // Reopen. The cache manifest should be consumed.
+    ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+    ASSERT_NE(db, nullptr);
+    ASSERT_FALSE(std::filesystem::exists(kDBDir / "CACHE_MANIFEST"));
+    ASSERT_TRUE(db->WaitForCacheWarmUp().ok());
+
+    // The records should be served by the cache.
+    PageGroupedDBStats::Local().Reset();
+    for (size_t i = 0; i < dataset.size(); i += 10) {
+      ASSERT_TRUE(db->Get(dataset[i].first, &value_out).ok());
+      if (i == 20) {
+        ASSERT_EQ(new_value.compare(value_out), 0);
+      } else {
+        ASSERT_EQ(value.compare(value_out), 0);
+      }
+    }
+    ASSERT_EQ(PageGroupedDBStats::Local().GetCacheHits(), dataset.size() / 10);
+    ASSERT_EQ(PageGroupedDBStats::Local().GetCacheMisses(), 0);
+
+    // Close the DB.
+    delete db;
+    db = nullptr;
+  }
+}
+
+TEST_F(PGDBTest, PersistCacheStaleManifest) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.rec_cache_persist = true;
+  options.rec_cache_persist_values = true;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 100, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+  std::string value_out;
+  ASSERT_TRUE(db->Get(dataset[5].first, &value_out).ok());
+  delete db;
+  db = nullptr;
+  ASSERT_TRUE(std::filesystem::exists(kDBDir / "CACHE_MANIFEST"));
+
+  // Reopening without cache persistence should discard the manifest, since
+  // this run's writes make it stale.
+  options.rec_cache_persist = false;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+  ASSERT_FALSE(std::filesystem::exists(kDBDir / "CACHE_MANIFEST"));
+  const std::string new_value = "Test 2";
+  ASSERT_TRUE(db->Put(WriteOptions(), dataset[5].first, new_value).ok());
+  delete db;
+  db = nullptr;
+
+  // The cache should not serve the old value.
+  options.rec_cache_persist = true;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+  ASSERT_TRUE(db->Get(dataset[5].first, &value_out).ok());
+  ASSERT_EQ(new_value.compare(value_out), 0);
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, NumaAwareReadWrite) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.numa_aware = true;
+  options.rec_cache_numa_interleave = true;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  // Load.
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 1000, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+  // Read every record a few times (mostly cache hits).
+  PageGroupedDBStats::Local().Reset();
+  std::string value_out;
+  for (size_t round = 0; round < 3; ++round) {
+    for (const auto& rec : dataset) {
+      ASSERT_TRUE(db->Get(rec.first, &value_out).ok());
+      ASSERT_EQ(value.compare(value_out), 0);
+    }
+  }
+
+  // Some accesses should have been sampled.
+  const auto& stats = PageGroupedDBStats::Local();
+  ASSERT_GT(stats.GetNumaLocalAccesses() + stats.GetNumaRemoteAccesses(), 0);
+  ASSERT_GE(stats.GetNumaRemoteAccessRatio(), 0.0);
+  ASSERT_LE(stats.GetNumaRemoteAccessRatio(), 1.0);
+
+  // Close the DB.
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, WriteCombiningConcurrentPuts) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.records_per_page_goal = 44;
+  options.records_per_page_epsilon = 5;
+  options.bypass_cache = true;
+  options.write_combining = true;
+  // Slow page writes make concurrent writes to the same page overlap, so that
+  // they are combined.
+  SimulatedSSDOptions ssd_options;
+  ssd_options.read_latency_us = 0;
+  ssd_options.write_latency_us = 500;
+  options.simulated_ssd = SimulatedSSD::Create(ssd_options);
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  // Load.
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 1000, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+  // Concurrently update the existing records and insert new ones. The threads
+  // write interleaved keys so that they often write to the same pages.
+  PageGroupedDBStats::RunOnGlobal([](auto& stats) { stats.Reset(); });
+  const std::string new_value = "Test 2";
+  constexpr size_t kNumThreads = 4;
+  std::atomic<size_t> failed_puts(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([db, t, &dataset, &new_value, &failed_puts]() {
+      PageGroupedDBStats::Local().Reset();
+      for (size_t i = t; i < dataset.size(); i += kNumThreads) {
+        if (!db->Put(WriteOptions(), dataset[i].first, new_value).ok()) {
+          ++failed_puts;
+        }
+        if (!db->Put(WriteOptions(), dataset[i].first + 1, new_value).ok()) {
+          ++failed_puts;
+        }
+      }
+      PageGroupedDBStats::Local().PostToGlobal();
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(failed_puts, 0);
+
+  // Every write should have been applied by a combiner exactly once (all the
+  // written keys are distinct), and some writes should have been combined.
+  uint64_t combined_records = 0, combined_batches = 0;
+  PageGroupedDBStats::RunOnGlobal(
+      [&combined_records, &combined_batches](const auto& stats) {
+        combined_records = stats.GetCombinedWriteRecords();
+        combined_batches = stats.GetCombinedWriteBatches();
+      });
+  ASSERT_EQ(combined_records, dataset.size() * 2);
+  ASSERT_GT(combined_batches, 0);
+  ASSERT_LT(combined_batches, combined_records);
+
+  // Read.
+  std::string value_out;
+  for (const auto& rec : dataset) {
+    ASSERT_TRUE(db->Get(rec.first, &value_out).ok());
+    ASSERT_EQ(new_value.compare(value_out), 0);
+    ASSERT_TRUE(db->Get(rec.first + 1, &value_out).ok());
+    ASSERT_EQ(new_value.compare(value_out), 0);
+  }
+
+  // Close the DB.
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, LiveStats) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.records_per_page_goal = 44;
+  options.records_per_page_epsilon = 5;
+  options.record_cache_capacity = 2000;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  // Load.
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 1000, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+  PageGroupedDBLiveStats before;
+  ASSERT_TRUE(db->GetStats(&before).ok());
+  ASSERT_EQ(before.overflowed_segments, 0);
+  ASSERT_EQ(before.reorg_backlog_pages, 0);
+  ASSERT_EQ(before.segments_by_size.size(), before.segment_page_counts.size());
+  uint64_t total_pages = 0;
+  for (size_t i = 0; i < before.segments_by_size.size(); ++i) {
+    total_pages += before.segments_by_size[i] * before.segment_page_counts[i];
+  }
+  // There are 44 +/- 5 records per page.
+  ASSERT_GE(total_pages, dataset.size() / 49);
+
+  // Write some records (they stay dirty in the cache) and read every record on
+  // a different thread. The counters of threads that have exited should still
+  // be included.
+  const std::string new_value = "Test 2";
+  for (size_t i = 0; i < 100; ++i) {
+    ASSERT_TRUE(db->Put(WriteOptions(), dataset[i].first, new_value).ok());
+  }
+  std::thread([db, &dataset]() {
+    std::string value_out;
+    for (const auto& rec : dataset) {
+      ASSERT_TRUE(db->Get(rec.first, &value_out).ok());
+    }
+  }).join();
+
+  PageGroupedDBLiveStats after;
+  ASSERT_TRUE(db->GetStats(&after).ok());
+  ASSERT_GE(after.cache_hits + after.cache_misses,
+            before.cache_hits + before.cache_misses + dataset.size());
+  ASSERT_GT(after.cache_hits, before.cache_hits);
+  ASSERT_GT(after.page_reads_by_size[0], before.page_reads_by_size[0]);
+  ASSERT_EQ(after.cache_capacity, 2000);
+  ASSERT_EQ(after.cache_dirty_records, 100);
+  ASSERT_DOUBLE_EQ(after.cache_dirty_ratio, 0.05);
+
+  std::string property;
+  ASSERT_TRUE(db->GetProperty("pg.cache-dirty-ratio", &property).ok());
+  ASSERT_DOUBLE_EQ(std::stod(property), 0.05);
+  ASSERT_TRUE(db->GetProperty("pg.segments-by-size", &property).ok());
+  ASSERT_EQ(property.find("1:"), 0);
+  ASSERT_TRUE(db->GetProperty("pg.stats", &property).ok());
+  ASSERT_NE(property.find("pg.reorg-backlog-pages: 0\n"), std::string::npos);
+  ASSERT_TRUE(db->GetProperty("pg.unknown", &property).IsNotFound());
+  ASSERT_TRUE(db->GetProperty("pg.key-range-stats", &property)
+                  .IsNotSupportedError());
+  ASSERT_TRUE(db->GetProperty("pg.lock-contention", &property)
+                  .IsNotSupportedError());
+
+  // Close the DB.
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, KeyRangeStats) {
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.records_per_page_goal = 44;
+  options.records_per_page_epsilon = 5;
+  options.bypass_cache = true;
+  options.key_range_stats_buckets = 4;
+  options.forecasting.num_inserts_per_epoch = 100;
+  options.forecasting.num_partitions = 5;
+  options.forecasting.sample_size = 50;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  // Load the keys 10, 20, ..., 10000.
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 1000, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+  // Insert new keys in between the keys in [10, 4000].
+  size_t num_inserts = 0;
+  for (Key base = 10; base <= 4000; base += 10) {
+    for (Key offset = 1; offset <= 4; ++offset) {
+      ASSERT_TRUE(db->Put(WriteOptions(), base + offset, value).ok());
+      ++num_inserts;
+    }
+  }
+
+  std::vector<PageGroupedDBKeyRangeStats> ranges;
+  ASSERT_TRUE(db->GetKeyRangeStats(&ranges).ok());
+  ASSERT_GE(ranges.size(), 2);
+  ASSERT_LE(ranges.size(), 4);
+  ASSERT_LE(ranges.front().lower, 10);
+  ASSERT_EQ(ranges.back().upper, std::numeric_limits<Key>::max());
+
+  uint64_t user_writes = 0, user_bytes = 0, page_bytes = 0;
+  uint64_t actual_inserts = 0;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const auto& range = ranges[i];
+    if (i + 1 < ranges.size()) {
+      ASSERT_EQ(range.upper, ranges[i + 1].lower);
+    }
+    user_writes += range.user_writes;
+    user_bytes += range.user_bytes;
+    page_bytes += range.PageBytesWritten();
+    actual_inserts += range.actual_inserts;
+    ASSERT_EQ(range.forecast_epochs, ranges.front().forecast_epochs);
+
+    // No writes were made past key 4004.
+    if (range.lower > 4004) {
+      ASSERT_EQ(range.user_writes, 0);
+      ASSERT_EQ(range.PageBytesWritten(), 0);
+      ASSERT_EQ(range.rewrites, 0);
+      ASSERT_EQ(range.actual_inserts, 0);
+    }
+  }
+  ASSERT_EQ(user_writes, num_inserts);
+  ASSERT_EQ(user_bytes, num_inserts * (sizeof(Key) + value.size()));
+  // Every write goes to disk (as a whole page) since the cache is bypassed.
+  ASSERT_GT(page_bytes, user_bytes);
+
+  // The insert tracker completes an epoch every 100 inserts (after sampling
+  // the first 50 inserts).
+  ASSERT_GT(ranges.front().forecast_epochs, 0);
+  ASSERT_GT(actual_inserts, 0);
+  ASSERT_LE(actual_inserts, num_inserts);
+
+  std::string property;
+  ASSERT_TRUE(db->GetProperty("pg.key-range-stats", &property).ok());
+  ASSERT_EQ(property.find("lower,upper,"), 0);
+  ASSERT_EQ(std::count(property.begin(), property.end(), '\n'),
+            ranges.size() + 1);
+
+  // Close the DB.
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, SimulatedSSD) {
+  SimulatedSSDOptions ssd_options;
+  ssd_options.emulate_latency = false;
+  auto options = GetCommonTestOptions();
+  options.simulated_ssd = SimulatedSSD::Create(ssd_options);
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 1000, value);
+
+  PageGroupedDB* db = nullptr;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+  delete db;
+  db = nullptr;
+
+  // The segment files are only stored on the simulated device.
+  for (const auto& entry : std::filesystem::directory_iterator(kDBDir)) {
+    ASSERT_NE(entry.path().filename().string().find("sf-"), 0);
+  }
+  SimulatedSSDStats stats;
+  options.simulated_ssd->GetStats(&stats);
+  ASSERT_GT(stats.writes, 0);
+  ASSERT_GT(options.simulated_ssd->StoredBytes(), 0);
+
+  // Reopen the DB on the same device.
+  options.simulated_ssd->ResetStats();
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  std::string value_out;
+  for (const auto& record : dataset) {
+    ASSERT_TRUE(db->Get(record.first, &value_out).ok());
+    ASSERT_EQ(value_out, value);
+  }
+  options.simulated_ssd->GetStats(&stats);
+  ASSERT_GE(stats.reads, dataset.size() / 50);
+  ASSERT_EQ(stats.read_latency.Count(), stats.reads);
+
+  delete db;
+  db = nullptr;
+}
+
+TEST_F(PGDBTest, LockContentionStats) {
+  using Mode = PageGroupedDBStats::LockWaitMode;
+  PageGroupedDB* db = nullptr;
+  auto options = GetCommonTestOptions();
+  options.bypass_cache = true;
+  options.lock_profiling_top_n = 5;
+  ASSERT_TRUE(PageGroupedDB::Open(options, kDBDir, &db).ok());
+  ASSERT_NE(db, nullptr);
+
+  const std::string value = "Test 1";
+  const auto dataset = GetRangeDataset(10, 1000, value);
+  ASSERT_TRUE(db->BulkLoad(dataset).ok());
+
+  // A single thread never has to wait for a lock.
+  const size_t num_ops = 100;
+  std::string value_out;
+  for (Key key = 10; key <= num_ops * 10; key += 10) {
+    ASSERT_TRUE(db->Put(WriteOptions(), key, value).ok());
+    ASSERT_TRUE(db->Get(key, &value_out).ok());
+  }
+
+  PageGroupedDBLockContentionStats stats;
+  ASSERT_TRUE(db->GetLockContentionStats(&stats).ok());
+  ASSERT_GE(stats.Get(Mode::kSegmentPageRead).acquisitions, num_ops);
+  ASSERT_GE(stats.Get(Mode::kPageShared).acquisitions, num_ops);
+  for (const auto& mode : stats.modes) {
+    ASSERT_EQ(mode.contended_acquisitions, 0);
+    ASSERT_EQ(mode.failed_tries, 0);
+    ASSERT_EQ(mode.latency.Count(), mode.acquisitions);
+    ASSERT_EQ(mode.latency.Max(), 0);
+  }
+  ASSERT_TRUE(stats.hot_segments.empty());
+  ASSERT_TRUE(stats.hot_pages.empty());
+
+  // One row per lock mode, a blank line, and the (empty) hot lock table.
+  std::string property;
+  ASSERT_TRUE(db->GetProperty("pg.lock-contention", &property).ok());
+  ASSERT_EQ(property.find("mode,acquisitions,"), 0);
+  ASSERT_NE(property.find("\n\nkind,"), std::string::npos);
+  ASSERT_EQ(std::count(property.begin(), property.end(), '\n'),
+            PageGroupedDBStats::kNumLockWaitModes + 3);
+
+  // Close the DB.
+  delete db;
+  db = nullptr;
+}
+
 TEST_F(PGDBTest, InsertSmaller) {
   PageGroupedDB* db = nullptr;
   auto options = GetCommonTestOptions();
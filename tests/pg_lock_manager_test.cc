@@ -1,8 +1,13 @@
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <thread>
 
 #include "gtest/gtest.h"
 #include "page_grouping/lock_manager.h"
+#include "page_grouping/lock_profiler.h"
+#include "page_grouping/segment_index.h"
+#include "treeline/pg_stats.h"
 
 namespace {
 
@@ -208,4 +213,258 @@ TEST(PGLockManagerTest, SegmentLockDistinct) {
   m.ReleaseSegmentLock(sid2, LockManager::SegmentMode::kPageWrite);
 }
 
+TEST(PGLockManagerTest, SegmentLockBlockingWait) {
+  LockManager m;
+  const SegmentId sid(0, 16);
+
+  // Simulate a reorganization that holds the segment lock.
+  ASSERT_TRUE(m.TryAcquireSegmentLock(sid, LockManager::SegmentMode::kReorg));
+
+  // The writer should block until the reorganization releases its lock. The
+  // writer records its results for the main thread to check.
+  std::atomic<bool> released(false);
+  bool all_waits_succeeded = true, acquired_after_release = false;
+  uint64_t waits = 0, wait_nanos = 0;
+  std::thread writer([&]() {
+    PageGroupedDBStats::Local().Reset();
+    while (true) {
+      const auto ticket = m.GetSegmentWaitTicket(sid);
+      if (m.TryAcquireSegmentLock(sid, LockManager::SegmentMode::kPageWrite)) {
+        break;
+      }
+      all_waits_succeeded &= m.WaitForSegmentLock(
+          sid, LockManager::SegmentMode::kPageWrite, ticket);
+    }
+    acquired_after_release = released;
+    const auto& stats = PageGroupedDBStats::Local();
+    waits = stats.GetLockWaits(
+        PageGroupedDBStats::LockWaitMode::kSegmentPageWrite);
+    wait_nanos = stats.GetLockWaitNanos(
+        PageGroupedDBStats::LockWaitMode::kSegmentPageWrite);
+    m.ReleaseSegmentLock(sid, LockManager::SegmentMode::kPageWrite);
+  });
+
+  // Only release the lock once the writer is blocked on it.
+  while (m.NumSegmentLockWaiters(sid) == 0) {
+    std::this_thread::yield();
+  }
+  released = true;
+  m.ReleaseSegmentLock(sid, LockManager::SegmentMode::kReorg);
+  writer.join();
+  ASSERT_TRUE(all_waits_succeeded);
+  ASSERT_TRUE(acquired_after_release);
+  ASSERT_EQ(waits, 1);
+  ASSERT_GT(wait_nanos, 0);
+  ASSERT_EQ(m.NumSegmentLockWaiters(sid), 0);
+
+  // Waits should time out if the lock is not released.
+  ASSERT_TRUE(m.TryAcquireSegmentLock(sid, LockManager::SegmentMode::kReorg));
+  const auto ticket = m.GetSegmentWaitTicket(sid);
+  ASSERT_FALSE(
+      m.TryAcquireSegmentLock(sid, LockManager::SegmentMode::kPageWrite));
+  ASSERT_FALSE(m.WaitForSegmentLock(
+      sid, LockManager::SegmentMode::kPageWrite, ticket,
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+  m.ReleaseSegmentLock(sid, LockManager::SegmentMode::kReorg);
+
+  // A release after the ticket was taken means the caller should not block,
+  // even though releases without registered waiters keep the ticket valid.
+  const auto stale_ticket = m.GetSegmentWaitTicket(sid);
+  ASSERT_TRUE(m.TryAcquireSegmentLock(sid, LockManager::SegmentMode::kReorg));
+  m.ReleaseSegmentLock(sid, LockManager::SegmentMode::kReorg);
+  ASSERT_EQ(m.GetSegmentWaitTicket(sid), stale_ticket);
+  ASSERT_TRUE(m.WaitForSegmentLock(sid, LockManager::SegmentMode::kPageWrite,
+                                   stale_ticket));
+}
+
+TEST(PGLockManagerTest, Profiling) {
+  using Mode = PageGroupedDBStats::LockWaitMode;
+  LockManager m(std::make_unique<LockProfiler>(/*top_n=*/1));
+  ASSERT_NE(m.profiler(), nullptr);
+  const SegmentId hot_sid(1, 32), cold_sid(0, 16);
+
+  // Uncontended acquisitions.
+  ASSERT_TRUE(
+      m.TryAcquireSegmentLock(cold_sid, LockManager::SegmentMode::kPageWrite));
+  m.ReleaseSegmentLock(cold_sid, LockManager::SegmentMode::kPageWrite);
+  m.AcquirePageLock(cold_sid, 0, LockManager::PageMode::kShared);
+  m.ReleasePageLock(cold_sid, 0, LockManager::PageMode::kShared);
+
+  // The writer has to wait for the reorganization's lock (twice as long as the
+  // reader has to wait for the exclusive page lock).
+  ASSERT_TRUE(
+      m.TryAcquireSegmentLock(hot_sid, LockManager::SegmentMode::kReorg));
+  m.AcquirePageLock(hot_sid, 3, LockManager::PageMode::kExclusive);
+  std::thread writer([&m, &hot_sid]() {
+    while (true) {
+      const auto ticket = m.GetSegmentWaitTicket(hot_sid);
+      if (m.TryAcquireSegmentLock(hot_sid,
+                                  LockManager::SegmentMode::kPageWrite)) {
+        break;
+      }
+      m.WaitForSegmentLock(hot_sid, LockManager::SegmentMode::kPageWrite,
+                           ticket);
+    }
+    m.ReleaseSegmentLock(hot_sid, LockManager::SegmentMode::kPageWrite);
+  });
+  std::thread reader([&m, &hot_sid]() {
+    m.AcquirePageLock(hot_sid, 3, LockManager::PageMode::kShared);
+    m.ReleasePageLock(hot_sid, 3, LockManager::PageMode::kShared);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  m.ReleasePageLock(hot_sid, 3, LockManager::PageMode::kExclusive);
+  reader.join();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  m.ReleaseSegmentLock(hot_sid, LockManager::SegmentMode::kReorg);
+  writer.join();
+
+  PageGroupedDBLockContentionStats stats;
+  m.profiler()->GetStats(&stats);
+
+  const auto& page_write = stats.Get(Mode::kSegmentPageWrite);
+  ASSERT_EQ(page_write.acquisitions, 2);
+  ASSERT_EQ(page_write.contended_acquisitions, 1);
+  ASSERT_GE(page_write.failed_tries, 1);
+  ASSERT_EQ(page_write.latency.Count(), 2);
+  ASSERT_EQ(page_write.latency.Min(), 0);
+  ASSERT_GE(page_write.latency.Max(), 15 * 1000 * 1000);
+
+  const auto& reorg = stats.Get(Mode::kSegmentReorg);
+  ASSERT_EQ(reorg.acquisitions, 1);
+  ASSERT_EQ(reorg.contended_acquisitions, 0);
+  ASSERT_EQ(reorg.failed_tries, 0);
+
+  const auto& page_shared = stats.Get(Mode::kPageShared);
+  ASSERT_EQ(page_shared.acquisitions, 2);
+  ASSERT_EQ(page_shared.contended_acquisitions, 1);
+  ASSERT_GE(page_shared.latency.Max(), 5 * 1000 * 1000);
+  ASSERT_EQ(stats.Get(Mode::kPageExclusive).acquisitions, 1);
+
+  ASSERT_EQ(stats.hot_segments.size(), 1);
+  ASSERT_EQ(stats.hot_segments[0].file_id, 1);
+  ASSERT_EQ(stats.hot_segments[0].segment_offset, 32);
+  ASSERT_EQ(stats.hot_segments[0].contended_acquisitions, 1);
+  ASSERT_EQ(stats.hot_segments[0].wait_nanos, page_write.latency.Max());
+  ASSERT_EQ(stats.hot_pages.size(), 1);
+  ASSERT_EQ(stats.hot_pages[0].segment_offset, 32);
+  ASSERT_EQ(stats.hot_pages[0].page_idx, 3);
+  ASSERT_GE(stats.hot_pages[0].failed_tries, 1);
+}
+
+TEST(PGLockManagerTest, ProfilingPendingWaitsArePerLock) {
+  using Mode = PageGroupedDBStats::LockWaitMode;
+  using SegmentMode = LockManager::SegmentMode;
+  LockManager m(std::make_unique<LockProfiler>(/*top_n=*/2));
+  const SegmentId sid1(0, 16), sid2(0, 32), sid3(0, 48);
+
+  // Give up on a lock after its deadline passes (like a rewrite does). The
+  // wait should not be charged to the next acquisition in the same mode.
+  ASSERT_TRUE(m.TryAcquireSegmentLock(sid1, SegmentMode::kReorg));
+  const auto ticket = m.GetSegmentWaitTicket(sid1);
+  ASSERT_FALSE(m.TryAcquireSegmentLock(sid1, SegmentMode::kReorg));
+  ASSERT_FALSE(m.WaitForSegmentLock(
+      sid1, SegmentMode::kReorg, ticket,
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+  ASSERT_TRUE(m.TryAcquireSegmentLock(sid2, SegmentMode::kReorg));
+  m.ReleaseSegmentLock(sid2, SegmentMode::kReorg);
+
+  // While waiting for one lock, acquiring a different lock (in the same mode)
+  // is uncontended.
+  ASSERT_FALSE(m.TryAcquireSegmentLock(sid1, SegmentMode::kPageWrite));
+  ASSERT_TRUE(m.TryAcquireSegmentLock(sid3, SegmentMode::kPageWrite));
+  m.ReleaseSegmentLock(sid3, SegmentMode::kPageWrite);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  m.ReleaseSegmentLock(sid1, SegmentMode::kReorg);
+  ASSERT_TRUE(m.TryAcquireSegmentLock(sid1, SegmentMode::kPageWrite));
+  m.ReleaseSegmentLock(sid1, SegmentMode::kPageWrite);
+
+  PageGroupedDBLockContentionStats stats;
+  m.profiler()->GetStats(&stats);
+
+  const auto& reorg = stats.Get(Mode::kSegmentReorg);
+  ASSERT_EQ(reorg.acquisitions, 2);
+  ASSERT_EQ(reorg.contended_acquisitions, 0);
+  ASSERT_EQ(reorg.failed_tries, 1);
+  ASSERT_EQ(reorg.latency.Max(), 0);
+
+  const auto& page_write = stats.Get(Mode::kSegmentPageWrite);
+  ASSERT_EQ(page_write.acquisitions, 2);
+  ASSERT_EQ(page_write.contended_acquisitions, 1);
+  ASSERT_GE(page_write.latency.Max(), 5 * 1000 * 1000);
+
+  // Only `sid1` had to be waited for.
+  ASSERT_EQ(stats.hot_segments.size(), 1);
+  ASSERT_EQ(stats.hot_segments[0].segment_offset, 16);
+  ASSERT_EQ(stats.hot_segments[0].failed_tries, 2);
+  ASSERT_EQ(stats.hot_segments[0].contended_acquisitions, 1);
+}
+
+TEST(PGLockManagerTest, ProfilingWaitAcrossReorg) {
+  using Mode = PageGroupedDBStats::LockWaitMode;
+  using SegmentMode = LockManager::SegmentMode;
+  const auto m = std::make_shared<LockManager>(
+      std::make_unique<LockProfiler>(/*top_n=*/2));
+  SegmentIndex index(m);
+  const SegmentId old_sid(0, 16), new_sid(0, 32);
+  const std::vector<std::pair<Key, SegmentInfo>> entries = {
+      {0, SegmentInfo(old_sid, std::optional<plr::Line64>())}};
+  index.BulkLoadFromEmpty(entries.begin(), entries.end());
+
+  // A reorganization holds the lock on `old_sid`. The writer waits for it and
+  // is then granted the segment that replaced it.
+  ASSERT_TRUE(m->TryAcquireSegmentLock(old_sid, SegmentMode::kReorg));
+  SegmentId granted_sid;
+  bool reused_sid_granted = false;
+  std::thread writer([&]() {
+    granted_sid = index.SegmentForKeyWithLock(100, SegmentMode::kPageWrite)
+                      .sinfo.id();
+    m->ReleaseSegmentLock(granted_sid, SegmentMode::kPageWrite);
+    // The old segment's ID may be reused (e.g., from the free list).
+    reused_sid_granted =
+        m->TryAcquireSegmentLock(old_sid, SegmentMode::kPageWrite);
+    if (reused_sid_granted) {
+      m->ReleaseSegmentLock(old_sid, SegmentMode::kPageWrite);
+    }
+  });
+
+  // Wait until the writer has failed to acquire the lock.
+  PageGroupedDBLockContentionStats stats;
+  do {
+    std::this_thread::yield();
+    m->profiler()->GetStats(&stats);
+  } while (stats.Get(Mode::kSegmentPageWrite).failed_tries == 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+  index.RunExclusive([&new_sid](auto& raw_index) {
+    raw_index.erase(0);
+    raw_index.insert({0, SegmentInfo(new_sid, std::optional<plr::Line64>())});
+  });
+  m->ReleaseSegmentLock(old_sid, SegmentMode::kReorg);
+  writer.join();
+
+  ASSERT_EQ(granted_sid, new_sid);
+  ASSERT_TRUE(reused_sid_granted);
+  m->profiler()->GetStats(&stats);
+
+  // The wait is charged to the acquisition of the new segment, and not to the
+  // later acquisition of the old segment's ID.
+  const auto& page_write = stats.Get(Mode::kSegmentPageWrite);
+  ASSERT_EQ(page_write.acquisitions, 2);
+  ASSERT_EQ(page_write.contended_acquisitions, 1);
+  ASSERT_EQ(page_write.failed_tries, 1);
+  ASSERT_GE(page_write.latency.Max(), 5 * 1000 * 1000);
+
+  ASSERT_EQ(stats.hot_segments.size(), 2);
+  for (const auto& hot : stats.hot_segments) {
+    if (hot.segment_offset == new_sid.GetOffset()) {
+      ASSERT_EQ(hot.contended_acquisitions, 1);
+      ASSERT_EQ(hot.wait_nanos, page_write.latency.Max());
+    } else {
+      ASSERT_EQ(hot.segment_offset, old_sid.GetOffset());
+      ASSERT_EQ(hot.failed_tries, 1);
+      ASSERT_EQ(hot.contended_acquisitions, 0);
+    }
+  }
+}
+
 }  // namespace
@@ -1,6 +1,9 @@
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <numeric>
+#include <random>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -323,4 +326,290 @@ TEST_F(PGManagerRewriteTest, InsertMiddlePages) {
   }
 }
 
+std::vector<std::pair<Key, SegmentInfo>> GetIndexEntries(const Manager& m) {
+  return std::vector<std::pair<Key, SegmentInfo>>(m.IndexBeginIterator(),
+                                                  m.IndexEndIterator());
+}
+
+void ValidateIndexEntries(
+    const std::vector<std::pair<Key, SegmentInfo>>& expected,
+    const std::vector<std::pair<Key, SegmentInfo>>& actual) {
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    ASSERT_EQ(actual[i].first, expected[i].first);
+    ASSERT_EQ(actual[i].second.id(), expected[i].second.id());
+    ASSERT_EQ(actual[i].second.model(), expected[i].second.model());
+    ASSERT_EQ(actual[i].second.HasOverflow(), expected[i].second.HasOverflow());
+  }
+}
+
+// Inserts records into the middle of a sequential dataset. The first four
+// batches each trigger a rewrite. The remaining (small) batches are written
+// in place and create an overflow page.
+class CheckpointWorkload {
+ public:
+  CheckpointWorkload() : inserted_value_(u8"08+bytes") {
+    std::vector<uint64_t> new_keys;
+    new_keys.reserve(Datasets::kSequentialKeys.size());
+    for (const auto& k : Datasets::kSequentialKeys) {
+      new_keys.push_back(k * 1000);
+    }
+    dataset_ = BuildRecords(new_keys, u8"08 bytes");
+
+    std::mt19937 prng(1337);
+    const size_t mid = new_keys.size() / 2;
+    const auto add_batches = [this, &new_keys, &prng](
+                                 const size_t idx, const size_t num_keys,
+                                 const size_t batch_size) {
+      std::vector<uint64_t> keys = Datasets::FloydSample(
+          num_keys, new_keys[idx] + 1, new_keys[idx + 1] - 1, prng);
+      std::sort(keys.begin(), keys.end());
+      for (size_t start = 0; start < keys.size(); start += batch_size) {
+        std::vector<std::pair<uint64_t, Slice>> inserts;
+        for (size_t i = start; i < keys.size() && i < start + batch_size;
+             ++i) {
+          inserts.emplace_back(keys[i], inserted_value_);
+        }
+        all_records_.insert(all_records_.end(), inserts.begin(),
+                            inserts.end());
+        batches_.push_back(std::move(inserts));
+      }
+    };
+    for (size_t i = 0; i < 4; ++i) {
+      add_batches(mid - 100 + i * 50, /*num_keys=*/400, /*batch_size=*/400);
+    }
+    add_batches(mid + 300, /*num_keys=*/220, /*batch_size=*/10);
+    all_records_.insert(all_records_.end(), dataset_.begin(), dataset_.end());
+    std::sort(all_records_.begin(), all_records_.end(),
+              [](const auto& left, const auto& right) {
+                return left.first < right.first;
+              });
+  }
+
+  const std::vector<std::pair<uint64_t, Slice>>& dataset() const {
+    return dataset_;
+  }
+  const std::vector<std::vector<std::pair<uint64_t, Slice>>>& batches() const {
+    return batches_;
+  }
+
+  void ValidateContents(Manager& m) const {
+    std::vector<std::pair<uint64_t, std::string>> values;
+    m.Scan(1, all_records_.size() + 1000000, &values);
+    ASSERT_EQ(values.size(), all_records_.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      ASSERT_EQ(values[i].first, all_records_[i].first);
+      ASSERT_EQ(all_records_[i].second.compare(values[i].second), 0);
+    }
+  }
+
+ private:
+  const std::string inserted_value_;
+  std::vector<std::pair<uint64_t, Slice>> dataset_;
+  std::vector<std::vector<std::pair<uint64_t, Slice>>> batches_;
+  std::vector<std::pair<uint64_t, Slice>> all_records_;
+};
+
+TEST_F(PGManagerRewriteTest, CheckpointReopenSegments) {
+  auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/true);
+  options.num_bg_threads = 2;
+  options.index_checkpoint = true;
+  const CheckpointWorkload workload;
+
+  std::vector<std::pair<Key, SegmentInfo>> index_entries;
+  {
+    Manager m = Manager::LoadIntoNew(kDBDir, workload.dataset(), options);
+    for (const auto& batch : workload.batches()) {
+      ASSERT_TRUE(m.PutBatch(batch).ok());
+    }
+    index_entries = GetIndexEntries(m);
+  }
+  ASSERT_TRUE(std::filesystem::exists(kDBDir / "INDEX_CHECKPOINT"));
+
+  // The index should be loaded from the checkpoint.
+  {
+    Manager m = Manager::Reopen(kDBDir, options);
+    ValidateIndexEntries(index_entries, GetIndexEntries(m));
+    workload.ValidateContents(m);
+  }
+
+  // Reopening without using the checkpoint should produce the same index (and
+  // should remove the checkpoint).
+  options.index_checkpoint = false;
+  {
+    Manager m = Manager::Reopen(kDBDir, options);
+    ASSERT_FALSE(std::filesystem::exists(kDBDir / "INDEX_CHECKPOINT"));
+    ValidateIndexEntries(index_entries, GetIndexEntries(m));
+    workload.ValidateContents(m);
+  }
+}
+
+TEST_F(PGManagerRewriteTest, CheckpointRecoverAfterCrash) {
+  auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/true);
+  options.num_bg_threads = 2;
+  options.index_checkpoint = true;
+  // The last checkpoint is written after the third rewrite.
+  options.index_checkpoint_interval = 3;
+  const CheckpointWorkload workload;
+  const std::filesystem::path crash_dir = kDBDir.string() + "-crash";
+  const std::filesystem::path scan_dir = kDBDir.string() + "-scan";
+  std::filesystem::remove_all(crash_dir);
+  std::filesystem::remove_all(scan_dir);
+
+  std::vector<std::pair<Key, SegmentInfo>> index_entries;
+  {
+    Manager m = Manager::LoadIntoNew(kDBDir, workload.dataset(), options);
+    for (const auto& batch : workload.batches()) {
+      ASSERT_TRUE(m.PutBatch(batch).ok());
+    }
+    ASSERT_TRUE(std::filesystem::exists(kDBDir / "INDEX_CHECKPOINT"));
+    index_entries = GetIndexEntries(m);
+
+    // Copying the files while the database is running simulates a crash (the
+    // checkpoint in the copy may be stale).
+    std::filesystem::copy(kDBDir, crash_dir);
+    std::filesystem::copy(kDBDir, scan_dir);
+  }
+
+  // Validate the checkpoint and recover the index from it.
+  {
+    Manager m = Manager::Reopen(crash_dir, options);
+    ValidateIndexEntries(index_entries, GetIndexEntries(m));
+    workload.ValidateContents(m);
+  }
+
+  // The recovered index should match the index rebuilt by reading every
+  // segment.
+  {
+    auto scan_options = options;
+    scan_options.index_checkpoint = false;
+    Manager m = Manager::Reopen(scan_dir, scan_options);
+    ValidateIndexEntries(index_entries, GetIndexEntries(m));
+    workload.ValidateContents(m);
+  }
+
+  // The recovered database should still be usable after reopening it again.
+  {
+    Manager m = Manager::Reopen(crash_dir, options);
+    ValidateIndexEntries(index_entries, GetIndexEntries(m));
+    workload.ValidateContents(m);
+  }
+
+  std::filesystem::remove_all(crash_dir);
+  std::filesystem::remove_all(scan_dir);
+}
+
+TEST_F(PGManagerRewriteTest, SnapshotScanConcurrentRewrites) {
+  auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/true);
+  options.num_bg_threads = 2;
+  options.snapshot_scans = true;
+
+  // Load keys 10, 20, ..., 10000.
+  std::vector<uint64_t> keys(1000);
+  std::iota(keys.begin(), keys.end(), 1ULL);
+  for (auto& key : keys) {
+    key *= 10;
+  }
+  // Large values so that the inserts cause overflows and reorganizations.
+  const std::string value(120, 'v');
+  const auto dataset = BuildRecords(keys, value);
+  Manager m = Manager::LoadIntoNew(kDBDir, dataset, options);
+
+  // Concurrently insert keys between the loaded keys (in batches that cause
+  // reorganizations) while scanning.
+  std::atomic<bool> scanning(false), done_writing(false);
+  std::thread writer([&m, &keys, &value, &scanning, &done_writing]() {
+    while (!scanning) std::this_thread::yield();
+    for (uint64_t offset = 1; offset < 10; ++offset) {
+      for (size_t start = 0; start < keys.size(); start += 100) {
+        std::vector<std::pair<uint64_t, Slice>> batch;
+        for (size_t i = start; i < start + 100; ++i) {
+          batch.emplace_back(keys[i] + offset, value);
+        }
+        ASSERT_TRUE(m.PutBatch(batch).ok());
+      }
+    }
+    done_writing = true;
+  });
+
+  // Every scan should return sorted records that include all the loaded keys.
+  std::vector<std::pair<Key, std::string>> scanned;
+  size_t num_scans = 0;
+  while (!done_writing || num_scans == 0) {
+    scanning = true;
+    ASSERT_TRUE(m.Scan(1, 10000, &scanned).ok());
+    ++num_scans;
+    size_t loaded_found = 0;
+    for (size_t i = 0; i < scanned.size(); ++i) {
+      if (i > 0) ASSERT_LT(scanned[i - 1].first, scanned[i].first);
+      ASSERT_EQ(scanned[i].second, value);
+      if (scanned[i].first % 10 == 0) ++loaded_found;
+    }
+    ASSERT_EQ(loaded_found, keys.size());
+  }
+  writer.join();
+
+  // After the writes finish, the scan should see every record.
+  ASSERT_TRUE(m.Scan(1, 20000, &scanned).ok());
+  ASSERT_EQ(scanned.size(), keys.size() * 10);
+}
+
+TEST_F(PGManagerRewriteTest, PrefetchScanConcurrentRewrites) {
+  auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/true);
+  options.num_bg_threads = 2;
+  options.prefetch_scans = true;
+
+  // Load keys 10, 20, ..., 10000.
+  std::vector<uint64_t> keys(1000);
+  std::iota(keys.begin(), keys.end(), 1ULL);
+  for (auto& key : keys) {
+    key *= 10;
+  }
+  const std::string value(120, 'v');
+  const auto dataset = BuildRecords(keys, value);
+  Manager m = Manager::LoadIntoNew(kDBDir, dataset, options);
+
+  // Concurrently insert keys between the loaded keys while scanning. The
+  // scans read more pages than fit in the prefetch buffer.
+  std::atomic<bool> scanning(false), done_writing(false);
+  std::thread writer([&m, &keys, &value, &scanning, &done_writing]() {
+    while (!scanning) std::this_thread::yield();
+    for (uint64_t offset = 1; offset < 10; ++offset) {
+      for (size_t start = 0; start < keys.size(); start += 100) {
+        std::vector<std::pair<uint64_t, Slice>> batch;
+        for (size_t i = start; i < start + 100; ++i) {
+          batch.emplace_back(keys[i] + offset, value);
+        }
+        ASSERT_TRUE(m.PutBatch(batch).ok());
+      }
+    }
+    done_writing = true;
+  });
+
+  std::vector<std::pair<Key, std::string>> scanned;
+  size_t num_scans = 0;
+  while (!done_writing || num_scans == 0) {
+    scanning = true;
+    ASSERT_TRUE(m.Scan(1, 10000, &scanned).ok());
+    ++num_scans;
+    size_t loaded_found = 0;
+    for (size_t i = 0; i < scanned.size(); ++i) {
+      if (i > 0) ASSERT_LT(scanned[i - 1].first, scanned[i].first);
+      ASSERT_EQ(scanned[i].second, value);
+      if (scanned[i].first % 10 == 0) ++loaded_found;
+    }
+    ASSERT_EQ(loaded_found, keys.size());
+  }
+  writer.join();
+
+  // Scans that start in the middle of the key space and stop early.
+  ASSERT_TRUE(m.Scan(5001, 123, &scanned).ok());
+  ASSERT_EQ(scanned.size(), 123);
+  for (size_t i = 0; i < scanned.size(); ++i) {
+    ASSERT_EQ(scanned[i].first, 5001 + i);
+  }
+  ASSERT_TRUE(m.Scan(1, 20000, &scanned).ok());
+  ASSERT_EQ(scanned.size(), keys.size() * 10);
+}
+
 }  // namespace
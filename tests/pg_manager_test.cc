@@ -1,11 +1,15 @@
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 #include <random>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
 #include "page_grouping/key.h"
 #include "page_grouping/manager.h"
+#include "page_grouping/persist/io_trace.h"
 #include "page_grouping/segment_info.h"
 #include "pg_datasets.h"
 #include "treeline/pg_options.h"
@@ -119,6 +123,43 @@ TEST_F(PGManagerTest, CreateReopenPages) {
   }
 }
 
+TEST_F(PGManagerTest, CreateReopenParallelScan) {
+  auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/true);
+
+  std::vector<std::pair<uint64_t, Slice>> dataset =
+      BuildRecords(Datasets::kUniformKeys, u8"08 bytes");
+  std::vector<std::pair<Key, SegmentInfo>> index_entries;
+  {
+    Manager m = Manager::LoadIntoNew(kDBDir, dataset, options);
+    for (auto it = m.IndexBeginIterator(); it != m.IndexEndIterator(); ++it) {
+      index_entries.push_back(*it);
+    }
+  }
+
+  // The segment files are scanned using the background threads.
+  options.num_bg_threads = 4;
+  {
+    Manager m = Manager::Reopen(kDBDir, options);
+    ASSERT_EQ(m.NumSegmentFiles(), 5);
+    std::vector<std::pair<Key, SegmentInfo>> deserialized_entries(
+        m.IndexBeginIterator(), m.IndexEndIterator());
+    ASSERT_EQ(deserialized_entries.size(), index_entries.size());
+    for (size_t i = 0; i < deserialized_entries.size(); ++i) {
+      const std::pair<Key, SegmentInfo>& orig = index_entries[i];
+      const std::pair<Key, SegmentInfo>& deser = deserialized_entries[i];
+      ASSERT_EQ(deser.first, orig.first);
+      ASSERT_EQ(deser.second.id(), orig.second.id());
+      ASSERT_EQ(deser.second.model(), orig.second.model());
+    }
+
+    std::string out;
+    for (const auto& rec : dataset) {
+      ASSERT_TRUE(m.Get(rec.first, &out).ok());
+      ASSERT_EQ(rec.second.compare(out), 0);
+    }
+  }
+}
+
 TEST_F(PGManagerTest, PointReadSegments) {
   auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/true);
 
@@ -343,6 +384,28 @@ TEST_F(PGManagerTest, ScanSegmentsSequentialPrefetch) {
   }
 }
 
+TEST_F(PGManagerTest, ScanSegmentsLockedPrefetch) {
+  auto options = GetOptions(/*goal=*/15, /*delta=*/5, /*use_segments=*/true);
+  options.num_bg_threads = 16;  // Must be non-zero for prefetching.
+  options.prefetch_scans = true;
+
+  std::vector<std::pair<uint64_t, Slice>> dataset =
+      BuildRecords(Datasets::kUniformKeys, u8"08 bytes");
+
+  Manager m = Manager::LoadIntoNew(kDBDir, dataset, options);
+  ASSERT_EQ(m.NumSegmentFiles(), 5);
+
+  std::vector<std::pair<uint64_t, std::string>> scanned;
+  for (const auto& [start_idx, scan_amount] : kScanRequests) {
+    m.Scan(dataset[start_idx].first, scan_amount, &scanned);
+    ValidateScanResults(start_idx, scan_amount, dataset, scanned);
+  }
+
+  // This scan needs more pages than fit in the prefetch buffer.
+  m.Scan(dataset.front().first, dataset.size(), &scanned);
+  ValidateScanResults(0, dataset.size(), dataset, scanned);
+}
+
 TEST_F(PGManagerTest, ScanPages) {
   auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/false);
 
@@ -442,6 +505,51 @@ TEST_F(PGManagerTest, BatchedUpdateSegments) {
   }
 }
 
+// `PageGroupedDBImpl::Get()` relies on writes to the pages it read being
+// ordered after its `GetWithPages()` callback (it registers the pages' key
+// range in the record cache there).
+TEST_F(PGManagerTest, GetWithPagesCallbackPrecedesWrites) {
+  auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/true);
+  const std::vector<std::pair<uint64_t, Slice>> dataset =
+      BuildRecords(Datasets::kUniformKeys, u8"08 bytes");
+  Manager m = Manager::LoadIntoNew(kDBDir, dataset, options);
+
+  const Key read_key = dataset[10].first;
+  const std::string new_value = u8"08-bytes";
+  std::atomic<bool> write_done(false);
+  bool write_done_during_callback = true;
+  Key new_key = 0;
+  Status write_status;
+  std::thread writer;
+
+  std::string out;
+  const auto result = m.GetWithPages(
+      read_key, &out,
+      [&](const Status& status, const std::vector<pg::Page>& pages) {
+        // Insert a new key into the page that was just read.
+        pg::Page page = pages[0];
+        new_key = key_utils::ExtractHead64(page.GetLowerBoundary()) + 1;
+        while (true) {
+          const key_utils::IntKeyAsSlice key_slice(new_key);
+          if (!page.Get(key_slice.as<Slice>(), &out).ok()) break;
+          ++new_key;
+        }
+        writer = std::thread([&]() {
+          write_status = m.PutBatch({{new_key, Slice(new_value)}});
+          write_done = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        write_done_during_callback = write_done;
+      });
+  writer.join();
+
+  ASSERT_TRUE(result.first.ok());
+  ASSERT_FALSE(write_done_during_callback);
+  ASSERT_TRUE(write_status.ok());
+  ASSERT_TRUE(m.Get(new_key, &out).ok());
+  ASSERT_EQ(Slice(out).compare(new_value), 0);
+}
+
 TEST_F(PGManagerTest, BatchedUpdatePages) {
   auto options = GetOptions(/*goal=*/15, /*epsilon=*/5, /*use_segments=*/false);
 
@@ -562,6 +670,61 @@ TEST_F(PGManagerTest, InsertOverflowSegments) {
   }
 }
 
+TEST_F(PGManagerTest, IOTrace) {
+  auto options = GetOptions(/*goal=*/4, /*epsilon=*/1, /*use_segments=*/true);
+  options.io_trace_path = kDBDir / "io_trace";
+
+  std::string value;
+  value.resize(512);
+  std::vector<std::pair<uint64_t, Slice>> dataset = {
+      {1, value}, {2, value}, {3, value}, {4, value},
+      {5, value}, {6, value}, {7, value}};
+  std::vector<std::pair<uint64_t, Slice>> inserts = {{8, value},  {9, value},
+                                                     {10, value}, {11, value},
+                                                     {12, value}, {13, value}};
+
+  {
+    Manager m = Manager::LoadIntoNew(kDBDir, dataset, options);
+    ASSERT_TRUE(m.PutBatch(inserts).ok());
+    std::string out;
+    for (const auto& rec : inserts) {
+      ASSERT_TRUE(m.Get(rec.first, &out).ok());
+    }
+    std::vector<std::pair<uint64_t, std::string>> scan_out;
+    ASSERT_TRUE(m.Scan(1, 15, &scan_out).ok());
+  }
+
+  IOTraceHeader header;
+  std::vector<IOTraceRecord> records;
+  ASSERT_TRUE(
+      IOTracer::ReadTrace(options.io_trace_path, &header, &records).ok());
+  ASSERT_EQ(header.page_size, pg::Page::kSize);
+
+  std::vector<size_t> reads(kNumIOCauses, 0), writes(kNumIOCauses, 0);
+  for (const auto& rec : records) {
+    ASSERT_EQ(rec.offset % pg::Page::kSize, 0);
+    ASSERT_GT(rec.num_pages, 0);
+    ASSERT_LT(rec.file_id, 5);
+    const size_t cause = static_cast<size_t>(rec.Cause());
+    ASSERT_LT(cause, kNumIOCauses);
+    if (rec.IsWrite()) {
+      ++writes[cause];
+    } else {
+      ++reads[cause];
+    }
+  }
+  // All of the I/O should be attributed to an operation.
+  ASSERT_EQ(reads[static_cast<size_t>(IOCause::kUnknown)], 0);
+  ASSERT_EQ(writes[static_cast<size_t>(IOCause::kUnknown)], 0);
+  ASSERT_GT(writes[static_cast<size_t>(IOCause::kLoad)], 0);
+  ASSERT_EQ(reads[static_cast<size_t>(IOCause::kLoad)], 0);
+  ASSERT_GT(writes[static_cast<size_t>(IOCause::kWriteout)], 0);
+  ASSERT_GE(reads[static_cast<size_t>(IOCause::kGet)], inserts.size());
+  ASSERT_EQ(writes[static_cast<size_t>(IOCause::kGet)], 0);
+  ASSERT_GT(reads[static_cast<size_t>(IOCause::kScan)], 0);
+  ASSERT_EQ(writes[static_cast<size_t>(IOCause::kScan)], 0);
+}
+
 TEST_F(PGManagerTest, InsertOverflowPages) {
   auto options = GetOptions(/*goal=*/4, /*epsilon=*/1, /*use_segments=*/false);
 
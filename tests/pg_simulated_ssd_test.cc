@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "page_grouping/persist/page.h"
+#include "page_grouping/persist/segment_file.h"
+#include "page_grouping/persist/simulated_ssd.h"
+#include "treeline/pg_simulated_ssd.h"
+#include "util/key.h"
+
+namespace {
+
+using namespace tl;
+using namespace tl::pg;
+
+std::unique_ptr<SegmentFile> OpenFile(const std::shared_ptr<SimulatedSSD>& ssd,
+                                      const std::string& path,
+                                      const size_t pages_per_segment) {
+  auto* device = static_cast<SimulatedSSDImpl*>(ssd.get());
+  return std::make_unique<SegmentFile>(device->OpenFile(path),
+                                       pages_per_segment);
+}
+
+TEST(PGSimulatedSSDTest, StoresPages) {
+  SimulatedSSDOptions options;
+  options.emulate_latency = false;
+  const auto ssd = SimulatedSSD::Create(options);
+  const std::string path = "/sim/sf-2";
+  ASSERT_FALSE(static_cast<SimulatedSSDImpl*>(ssd.get())->FileExists(path));
+
+  PageBuffer buf = PageMemoryAllocator::Allocate(/*num_pages=*/4);
+  {
+    auto file = OpenFile(ssd, path, /*pages_per_segment=*/4);
+    ASSERT_EQ(file->NumAllocatedSegments(), 0);
+    const size_t offset0 = file->AllocateSegment();
+    const size_t offset1 = file->AllocateSegment();
+    ASSERT_EQ(offset0, 0);
+    ASSERT_EQ(offset1, 4 * pg::Page::kSize);
+
+    // Write a valid page at the start of the second segment.
+    memset(buf.get(), 0, 4 * pg::Page::kSize);
+    const key_utils::IntKeyAsSlice lower(10), upper(20), key(15);
+    pg::Page page(buf.get(), lower.as<Slice>(), upper.as<Slice>());
+    ASSERT_TRUE(page.Put(key.as<Slice>(), "hello").ok());
+    ASSERT_TRUE(file->WritePages(offset1, buf.get(), /*num_pages=*/4).ok());
+    ASSERT_FALSE(
+        file->ReadPages(offset1 + 4 * pg::Page::kSize, buf.get(), 1).ok());
+  }
+  ASSERT_TRUE(static_cast<SimulatedSSDImpl*>(ssd.get())->FileExists(path));
+  ASSERT_GE(ssd->StoredBytes(), 8 * pg::Page::kSize);
+
+  // The data should survive reopening the file.
+  auto file = OpenFile(ssd, path, /*pages_per_segment=*/4);
+  ASSERT_EQ(file->NumAllocatedSegments(), 2);
+  memset(buf.get(), 0, 4 * pg::Page::kSize);
+  ASSERT_TRUE(file->ReadPages(4 * pg::Page::kSize, buf.get(), 1).ok());
+  pg::Page page(buf.get());
+  ASSERT_TRUE(page.IsValid());
+  const key_utils::IntKeyAsSlice key(15);
+  std::string value;
+  ASSERT_TRUE(page.Get(key.as<Slice>(), &value).ok());
+  ASSERT_EQ(value, "hello");
+}
+
+TEST(PGSimulatedSSDTest, ModeledLatency) {
+  SimulatedSSDOptions options;
+  options.read_latency_us = 100;
+  options.write_latency_us = 10;
+  options.read_bandwidth_mib = 1000;
+  options.write_bandwidth_mib = 500;
+  options.gc_interval_bytes = 2 * pg::Page::kSize;
+  options.gc_stall_us = 1000;
+  options.emulate_latency = false;
+  const auto ssd = SimulatedSSD::Create(options);
+  auto file = OpenFile(ssd, "/sim/sf-0", /*pages_per_segment=*/1);
+  const size_t offset = file->AllocateSegment();
+
+  PageBuffer buf = PageMemoryAllocator::Allocate(/*num_pages=*/1);
+  memset(buf.get(), 0, pg::Page::kSize);
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(file->WritePages(offset, buf.get(), /*num_pages=*/1).ok());
+  }
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(file->ReadPages(offset, buf.get(), /*num_pages=*/1).ok());
+  }
+
+  const uint64_t read_ns =
+      100 * 1000 + pg::Page::kSize * 1000000000ULL / (1000ULL << 20);
+  const uint64_t write_ns =
+      10 * 1000 + pg::Page::kSize * 1000000000ULL / (500ULL << 20);
+  SimulatedSSDStats stats;
+  ssd->GetStats(&stats);
+  ASSERT_EQ(stats.reads, 3);
+  ASSERT_EQ(stats.writes, 4);
+  ASSERT_EQ(stats.bytes_read, 3 * pg::Page::kSize);
+  ASSERT_EQ(stats.bytes_written, 4 * pg::Page::kSize);
+  // Every second write triggers a garbage collection.
+  ASSERT_EQ(stats.gc_stalls, 2);
+  ASSERT_EQ(stats.read_latency.Count(), 3);
+  ASSERT_EQ(stats.read_latency.Min(), read_ns);
+  ASSERT_EQ(stats.read_latency.Max(), read_ns);
+  ASSERT_EQ(stats.write_latency.Count(), 4);
+  ASSERT_EQ(stats.write_latency.Min(), write_ns);
+  ASSERT_EQ(stats.write_latency.Max(), write_ns + 1000 * 1000);
+
+  ssd->ResetStats();
+  ssd->GetStats(&stats);
+  ASSERT_EQ(stats.reads, 0);
+  ASSERT_EQ(stats.write_latency.Count(), 0);
+}
+
+TEST(PGSimulatedSSDTest, EmulatedLatency) {
+  SimulatedSSDOptions options;
+  options.read_latency_us = 2000;
+  options.queue_depth = 1;
+  const auto ssd = SimulatedSSD::Create(options);
+  auto file = OpenFile(ssd, "/sim/sf-0", /*pages_per_segment=*/1);
+  const size_t offset = file->AllocateSegment();
+  PageBuffer buf = PageMemoryAllocator::Allocate(/*num_pages=*/1);
+
+  // With one channel, the reads are serviced one after another.
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(file->ReadPages(offset, buf.get(), /*num_pages=*/1).ok());
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  ASSERT_GE(elapsed, std::chrono::microseconds(3 * 2000));
+
+  SimulatedSSDStats stats;
+  ssd->GetStats(&stats);
+  ASSERT_EQ(stats.reads, 3);
+  ASSERT_GE(stats.read_latency.Min(), 2000 * 1000);
+}
+
+}  // namespace
@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "page_grouping/latency_timer.h"
+#include "treeline/pg_latency_histogram.h"
+#include "treeline/pg_stats.h"
+
+namespace {
+
+using namespace tl;
+using namespace tl::pg;
+
+using LatencyPhase = PageGroupedDBStats::LatencyPhase;
+
+TEST(PGStatsTest, LatencyHistogramPercentiles) {
+  LatencyHistogram h;
+  ASSERT_EQ(h.Count(), 0);
+  ASSERT_EQ(h.Percentile(50), 0);
+
+  // Small values are recorded exactly.
+  for (uint64_t i = 1; i <= 10; ++i) {
+    h.Record(i);
+  }
+  ASSERT_EQ(h.Count(), 10);
+  ASSERT_EQ(h.Min(), 1);
+  ASSERT_EQ(h.Max(), 10);
+  ASSERT_DOUBLE_EQ(h.Mean(), 5.5);
+  ASSERT_EQ(h.Percentile(50), 5);
+  ASSERT_EQ(h.Percentile(100), 10);
+
+  // Larger values are recorded to within the bucket precision.
+  h.Reset();
+  for (uint64_t i = 1; i <= 100000; ++i) {
+    h.Record(i * 100);
+  }
+  const double precision = 1.0 / LatencyHistogram::kSubBuckets;
+  for (const double p : {1.0, 50.0, 90.0, 99.0, 99.9}) {
+    const double expected = p / 100.0 * 100000 * 100;
+    const uint64_t actual = h.Percentile(p);
+    ASSERT_GE(actual, expected);
+    ASSERT_LE(actual, expected * (1.0 + precision));
+  }
+  ASSERT_EQ(h.Percentile(100), 100000 * 100);
+
+  // Very large values are clamped to the last bucket.
+  h.Reset();
+  h.Record(UINT64_MAX);
+  ASSERT_EQ(h.Percentile(50), UINT64_MAX);
+}
+
+TEST(PGStatsTest, LatencyHistogramMerge) {
+  LatencyHistogram h1, h2;
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    h1.Record(i);
+    h2.Record(i + 1000);
+  }
+  h1.Merge(h2);
+  ASSERT_EQ(h1.Count(), 2000);
+  ASSERT_EQ(h1.Min(), 1);
+  ASSERT_EQ(h1.Max(), 2000);
+  const double precision = 1.0 / LatencyHistogram::kSubBuckets;
+  ASSERT_LE(h1.Percentile(50), 1000 * (1.0 + precision));
+  ASSERT_GE(h1.Percentile(50), 1000);
+}
+
+TEST(PGStatsTest, PhaseTimersPostToGlobal) {
+  const auto global_count = [](LatencyPhase phase) {
+    uint64_t count = 0;
+    PageGroupedDBStats::RunOnGlobal([&count, phase](const auto& stats) {
+      count = stats.GetLatency(phase).Count();
+    });
+    return count;
+  };
+  const uint64_t get_before = global_count(LatencyPhase::kGet);
+  const uint64_t read_before = global_count(LatencyPhase::kGetPageRead);
+
+  // Nothing is recorded while latency tracking is disabled.
+  std::thread([]() {
+    PageGroupedDBStats::SetLatencyTracking(false);
+    { PhaseTimer timer(LatencyPhase::kGet); }
+    PageGroupedDBStats::Local().PostToGlobal();
+  }).join();
+  ASSERT_EQ(global_count(LatencyPhase::kGet), get_before);
+
+  std::thread([]() {
+    PageGroupedDBStats::SetLatencyTracking(true);
+    {
+      PhaseTimer timer(LatencyPhase::kGet);
+      timer.Next(LatencyPhase::kGetPageRead);
+      timer.Stop();
+      // The phase already ended, so this should not record anything.
+      timer.Stop();
+    }
+    PageGroupedDBStats::SetLatencyTracking(false);
+    ASSERT_EQ(
+        PageGroupedDBStats::Local().GetLatency(LatencyPhase::kGet).Count(), 1);
+    PageGroupedDBStats::Local().PostToGlobal();
+  }).join();
+  ASSERT_EQ(global_count(LatencyPhase::kGet), get_before + 1);
+  ASSERT_EQ(global_count(LatencyPhase::kGetPageRead), read_before + 1);
+}
+
+}  // namespace
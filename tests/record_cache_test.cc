@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #define private public
@@ -40,6 +46,191 @@ TEST(RecordCacheTest, SimplePutDuplicate) {
 }
 #endif
 
+TEST(RecordCacheTest, GetCacheValue) {
+  const uint64_t capacity = 5;
+  auto rc = RecordCache(capacity);
+  Slice key = "aaa";
+  Slice value = "bbb";
+  Slice deleted_key = "ccc";
+
+  rc.Put(key, value, /*is_dirty = */ true);
+  rc.Put(deleted_key, Slice(""), /*is_dirty = */ true,
+         format::WriteType::kDelete);
+
+  std::string value_out;
+  format::WriteType write_type;
+  ASSERT_TRUE(rc.GetCacheValue(key, &value_out, &write_type).ok());
+  ASSERT_EQ(value.compare(Slice(value_out)), 0);
+  ASSERT_EQ(write_type, format::WriteType::kWrite);
+
+  ASSERT_TRUE(rc.GetCacheValue(deleted_key, &value_out, &write_type).ok());
+  ASSERT_EQ(write_type, format::WriteType::kDelete);
+
+  ASSERT_TRUE(rc.GetCacheValue(Slice("ddd"), &value_out, &write_type)
+                  .IsNotFound());
+}
+
+TEST(RecordCacheTest, ConcurrentGetCacheValue) {
+  const uint64_t capacity = 8;
+  auto rc = RecordCache(capacity);
+  const std::string key = "key";
+  const std::string value_a(64, 'a');
+  const std::string value_b(64, 'b');
+  rc.Put(Slice(key), Slice(value_a), /*is_dirty = */ true);
+
+  // A writer alternates between two values while a reader checks that it
+  // never observes a torn value.
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    rc.GetMasstreePointer()->thread_init(1);
+    for (size_t i = 0; i < 20000; ++i) {
+      rc.Put(Slice(key), Slice(i % 2 == 0 ? value_b : value_a),
+             /*is_dirty = */ true);
+    }
+    done = true;
+  });
+
+  rc.GetMasstreePointer()->thread_init(2);
+  std::string value_out;
+  format::WriteType write_type;
+  while (!done) {
+    ASSERT_TRUE(rc.GetCacheValue(Slice(key), &value_out, &write_type).ok());
+    ASSERT_TRUE(value_out == value_a || value_out == value_b);
+  }
+  writer.join();
+}
+
+TEST(RecordCacheTest, ConcurrentGetCacheValueGrowing) {
+  const uint64_t capacity = 8;
+  auto rc = RecordCache(capacity);
+  const std::string key = "key";
+  rc.Put(Slice(key), Slice("a"), /*is_dirty = */ true);
+
+  // Each write needs a larger allocation, so the writer keeps replacing the
+  // record that the reader is copying.
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    rc.GetMasstreePointer()->thread_init(1);
+    for (size_t size = 2; size <= 4096; ++size) {
+      const std::string value(size, 'a' + size % 26);
+      rc.Put(Slice(key), Slice(value), /*is_dirty = */ true);
+    }
+    done = true;
+  });
+
+  rc.GetMasstreePointer()->thread_init(2);
+  std::string value_out;
+  format::WriteType write_type;
+  while (!done) {
+    ASSERT_TRUE(rc.GetCacheValue(Slice(key), &value_out, &write_type).ok());
+    ASSERT_FALSE(value_out.empty());
+    ASSERT_EQ(value_out, std::string(value_out.size(), value_out[0]));
+  }
+  writer.join();
+}
+
+TEST(RecordCacheTest, GetCacheValues) {
+  const uint64_t capacity = 64;
+  auto rc = RecordCache(capacity);
+
+  // More keys than fit in one lookup group; every third key is not cached and
+  // every fifth cached key is a delete.
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < RecordCache::kLookupGroupSize * 3 + 5; ++i) {
+    keys.push_back("key" + std::to_string(100 + i));
+    if (i % 3 == 0) continue;
+    if (i % 5 == 0) {
+      rc.Put(Slice(keys.back()), Slice(""), /*is_dirty = */ true,
+             format::WriteType::kDelete);
+    } else {
+      rc.Put(Slice(keys.back()), Slice("value" + std::to_string(i)),
+             /*is_dirty = */ true);
+    }
+  }
+
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+  std::vector<std::string> values;
+  std::vector<format::WriteType> write_types;
+  std::vector<bool> found;
+  rc.GetCacheValues(key_slices, &values, &write_types, &found);
+  ASSERT_EQ(found.size(), keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i % 3 == 0) {
+      ASSERT_FALSE(found[i]);
+      continue;
+    }
+    ASSERT_TRUE(found[i]);
+    if (i % 5 == 0) {
+      ASSERT_EQ(write_types[i], format::WriteType::kDelete);
+    } else {
+      ASSERT_EQ(write_types[i], format::WriteType::kWrite);
+      ASSERT_EQ(values[i], "value" + std::to_string(i));
+    }
+  }
+}
+
+TEST(RecordCacheTest, FullyCachedRanges) {
+  const uint64_t capacity = 10;
+  auto rc = RecordCache(capacity);
+
+  // The range is not usable until it is finished.
+  rc.BeginCachingRange(100, 200);
+  ASSERT_FALSE(rc.GetFullyCachedRange(150).has_value());
+  for (uint64_t key = 100; key < 110; ++key) {
+    key_utils::IntKeyAsSlice key_slice(key);
+    rc.PutFromRead(key_slice.as<Slice>(), Slice("value"));
+  }
+  rc.FinishCachingRange(100, 200);
+
+  const auto range = rc.GetFullyCachedRange(150);
+  ASSERT_TRUE(range.has_value());
+  ASSERT_EQ(range->upper, 200);
+  ASSERT_TRUE(rc.IsStillFullyCached(100, range->id));
+  ASSERT_FALSE(rc.GetFullyCachedRange(99).has_value());
+  ASSERT_FALSE(rc.GetFullyCachedRange(200).has_value());
+
+  // Evicting a record in the range invalidates the range.
+  key_utils::IntKeyAsSlice other_key(1000);
+  rc.PutFromRead(other_key.as<Slice>(), Slice("value"));
+  ASSERT_FALSE(rc.GetFullyCachedRange(150).has_value());
+  ASSERT_FALSE(rc.IsStillFullyCached(100, range->id));
+
+  // Evictions during caching prevent the range from being marked.
+  rc.BeginCachingRange(1000, 1100);
+  for (uint64_t key = 1001; key < 1020; ++key) {
+    key_utils::IntKeyAsSlice key_slice(key);
+    rc.PutFromRead(key_slice.as<Slice>(), Slice("value"));
+  }
+  rc.FinishCachingRange(1000, 1100);
+  ASSERT_FALSE(rc.GetFullyCachedRange(1000).has_value());
+}
+
+TEST(RecordCacheTest, CompactEntries) {
+  // The per-entry synchronization and record pointers should stay compact.
+  ASSERT_LE(sizeof(RecordCacheEntry), 32);
+}
+
+TEST(RecordCacheTest, RejectOversizedRecords) {
+  const uint64_t capacity = 5;
+  auto rc = RecordCache(capacity);
+  const std::string large_key(RecordCacheEntry::kMaxKeySize + 1, 'a');
+  Slice value = "bbb";
+  ASSERT_TRUE(
+      rc.Put(large_key, value, /*is_dirty = */ true).IsInvalidArgument());
+  ASSERT_TRUE(rc.PutFromRead(large_key, value).IsInvalidArgument());
+
+  // The value is rejected before it is read, so its data can be shorter than
+  // its size.
+  Slice key = "aaa";
+  const Slice large_value(value.data(), RecordCacheEntry::kMaxValueSize + 1);
+  ASSERT_TRUE(
+      rc.Put(key, large_value, /*is_dirty = */ true).IsInvalidArgument());
+
+  uint64_t index_out;
+  ASSERT_TRUE(rc.GetCacheIndex(key, false, &index_out).IsNotFound());
+  ASSERT_EQ(rc.GetNumDirty(), 0);
+}
+
 TEST(RecordCacheTest, SimpleMiss) {
   const uint64_t capacity = 5;
   auto rc = RecordCache(capacity);
@@ -214,4 +405,48 @@ TEST(RecordCacheTest, PreferNonDirtyEviction) {
   }
 }
 
+TEST(RecordCacheTest, WriteBackDirty) {
+  const uint64_t capacity = 30;
+  auto rc = RecordCache(capacity);
+
+  // Insert 20 dirty records in descending key order and 5 clean records.
+  for (auto i = 119; i >= 100; --i) {
+    std::string key_s = "a" + std::to_string(i);
+    std::string val_s = "b" + std::to_string(i);
+    rc.Put(Slice(key_s), Slice(val_s), /*is_dirty = */ true);
+  }
+  for (auto i = 120; i < 125; ++i) {
+    std::string key_s = "a" + std::to_string(i);
+    std::string val_s = "b" + std::to_string(i);
+    rc.Put(Slice(key_s), Slice(val_s), /*is_dirty = */ false);
+  }
+  ASSERT_EQ(rc.GetNumDirty(), 20);
+
+  std::vector<std::string> written;
+  const auto write_out = [&written](const WriteOutBatch& batch) {
+    for (const auto& [key, value, write_type] : batch) {
+      ASSERT_EQ(write_type, format::WriteType::kWrite);
+      written.push_back(key.ToString());
+    }
+  };
+
+  // Each batch should be sorted by key.
+  ASSERT_EQ(rc.WriteBackDirty(/*max_records=*/15, write_out), 15);
+  ASSERT_EQ(written.size(), 15);
+  ASSERT_TRUE(std::is_sorted(written.begin(), written.end()));
+  ASSERT_EQ(rc.GetNumDirty(), 5);
+
+  written.clear();
+  ASSERT_EQ(rc.WriteBackDirty(/*max_records=*/15, write_out), 5);
+  ASSERT_EQ(written.size(), 5);
+  ASSERT_TRUE(std::is_sorted(written.begin(), written.end()));
+  ASSERT_EQ(rc.GetNumDirty(), 0);
+
+  // Nothing left to write.
+  ASSERT_EQ(rc.WriteBackDirty(/*max_records=*/15, write_out), 0);
+  for (uint64_t i = 0; i < capacity; ++i) {
+    ASSERT_FALSE(rc.cache_entries[i].IsDirty());
+  }
+}
+
 }  // namespace
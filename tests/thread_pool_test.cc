@@ -1,6 +1,9 @@
 #include "util/thread_pool.h"
 
+#include <array>
+#include <atomic>
 #include <stdexcept>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -47,3 +50,58 @@ TEST(ThreadPoolTest, SubmitNoWait) {
   ASSERT_EQ(val1, 2);
   ASSERT_EQ(val2, 100);
 }
+
+TEST(ThreadPoolTest, SubmitWithLatch) {
+  tl::ThreadPool pool(3);
+  std::vector<int> results(100, 0);
+  tl::Latch latch(results.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    pool.Submit(latch, [&results, i]() { results[i] = Square(i); });
+  }
+  pool.Wait(latch);
+  for (size_t i = 0; i < results.size(); ++i) {
+    ASSERT_EQ(results[i], Square(i));
+  }
+}
+
+TEST(ThreadPoolTest, SubmitWithLatchException) {
+  tl::ThreadPool pool(2);
+  int result = 0;
+  tl::Latch latch(2);
+  pool.Submit(latch, [&result]() { result = SafeIntDivide(10, 2); });
+  pool.Submit(latch, []() { SafeIntDivide(3, 0); });
+  ASSERT_THROW(pool.Wait(latch), std::invalid_argument);
+  ASSERT_EQ(result, 5);
+}
+
+TEST(ThreadPoolTest, NestedWait) {
+  // Tasks that wait on other tasks submitted to the same pool should not
+  // deadlock, even if every thread in the pool is waiting.
+  tl::ThreadPool pool(2);
+  std::atomic<int> sum(0);
+  tl::Latch outer(4);
+  for (int i = 0; i < 4; ++i) {
+    pool.Submit(outer, [&pool, &sum]() {
+      tl::Latch inner(10);
+      for (int j = 0; j < 10; ++j) {
+        pool.Submit(inner, [&sum, j]() { sum += j; });
+      }
+      pool.Wait(inner);
+    });
+  }
+  pool.Wait(outer);
+  ASSERT_EQ(sum.load(), 4 * 45);
+}
+
+TEST(ThreadPoolTest, LargeTask) {
+  // Tasks that do not fit inline should still run correctly.
+  tl::ThreadPool pool(2);
+  std::array<int, 64> values;
+  values.fill(3);
+  auto f = pool.Submit([values]() {
+    int sum = 0;
+    for (const auto& v : values) sum += v;
+    return sum;
+  });
+  ASSERT_EQ(f.get(), 3 * 64);
+}
@@ -0,0 +1,61 @@
+#include "epoch_manager.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace tl {
+
+EpochManager::EpochManager()
+    : global_epoch_(0), slots_(std::make_unique<Slot[]>(kNumSlots)) {}
+
+EpochManager::Guard::~Guard() {
+  if (slot_ == nullptr) return;
+  slot_->store(kInactive);
+}
+
+EpochManager::Guard EpochManager::Enter() {
+  // Threads start probing at different slots to reduce contention.
+  const size_t start =
+      std::hash<std::thread::id>{}(std::this_thread::get_id()) % kNumSlots;
+  std::atomic<Epoch>* slot = nullptr;
+  while (slot == nullptr) {
+    for (size_t i = 0; i < kNumSlots; ++i) {
+      std::atomic<Epoch>& candidate = slots_[(start + i) % kNumSlots].epoch;
+      Epoch expected = kInactive;
+      if (candidate.load() == kInactive &&
+          candidate.compare_exchange_strong(expected, global_epoch_.load())) {
+        slot = &candidate;
+        break;
+      }
+    }
+    if (slot == nullptr) std::this_thread::yield();
+  }
+
+  // If the global epoch advanced while we were publishing our epoch, a
+  // concurrent `MinActiveEpoch()` call may have missed us. Republish until the
+  // epoch is stable: then either `MinActiveEpoch()` sees our epoch, or we
+  // observed the advanced epoch (and so we will also observe the state changes
+  // that happened before it advanced).
+  while (true) {
+    const Epoch published = slot->load();
+    const Epoch current = global_epoch_.load();
+    if (published == current) break;
+    slot->store(current);
+  }
+  return Guard(slot);
+}
+
+EpochManager::Epoch EpochManager::Retire() {
+  return global_epoch_.fetch_add(1);
+}
+
+EpochManager::Epoch EpochManager::MinActiveEpoch() const {
+  Epoch min_epoch = kInactive;
+  for (size_t i = 0; i < kNumSlots; ++i) {
+    min_epoch = std::min(min_epoch, slots_[i].epoch.load());
+  }
+  return min_epoch;
+}
+
+}  // namespace tl
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace tl {
+
+// Used for epoch-based reclamation. Readers "enter" the current epoch before
+// accessing shared state and exit it once they are done. Data that is removed
+// from the shared state (so that new readers can no longer reach it) is
+// "retired" with the epoch returned by `Retire()`, and it can be reclaimed
+// once `MinActiveEpoch()` is larger than that epoch (i.e., once all the readers
+// that may have reached the data have exited).
+//
+// Entering and exiting an epoch does not acquire any locks. This class's
+// methods are safe to call concurrently.
+class EpochManager {
+ public:
+  using Epoch = uint64_t;
+
+  // Keeps the thread in the epoch it entered until destroyed.
+  class Guard {
+   public:
+    ~Guard();
+    Guard(Guard&& other) noexcept : slot_(other.slot_) {
+      other.slot_ = nullptr;
+    }
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+    Guard& operator=(Guard&&) = delete;
+
+   private:
+    friend class EpochManager;
+    explicit Guard(std::atomic<Epoch>* slot) : slot_(slot) {}
+    std::atomic<Epoch>* slot_;
+  };
+
+  EpochManager();
+
+  // Enters the current epoch. Shared state that the caller reads after this
+  // method returns will not be reclaimed until the returned guard is destroyed.
+  Guard Enter();
+
+  // Advances the global epoch. Data removed from the shared state before this
+  // call can be reclaimed once `MinActiveEpoch()` is larger than the returned
+  // epoch.
+  Epoch Retire();
+
+  // Returns the smallest epoch that an active reader entered, or the largest
+  // possible epoch if there are no active readers.
+  Epoch MinActiveEpoch() const;
+
+ private:
+  // Marks an unused reader slot.
+  static constexpr Epoch kInactive = std::numeric_limits<Epoch>::max();
+  // The maximum number of concurrently active readers. Additional readers will
+  // wait for a slot to become free.
+  static constexpr size_t kNumSlots = 128;
+
+  struct alignas(64) Slot {
+    std::atomic<Epoch> epoch = kInactive;
+  };
+
+  std::atomic<Epoch> global_epoch_;
+  std::unique_ptr<Slot[]> slots_;
+};
+
+}  // namespace tl
@@ -1,11 +1,16 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <random>
+#include <thread>
 #include <vector>
 
 namespace tl {
@@ -15,20 +20,53 @@ namespace tl {
 // maintained using reservoir sampling. The inserts are tracked per "epoch"
 // which is defined as a certain number of inserts. Queries always return the
 // statistics of the last completed epoch (if such an epoch exists).
+//
+// To keep `Add()` cheap when many threads insert concurrently, each thread
+// records its inserts in one of `num_shards` cache line aligned shards (the
+// shard's reservoir sample and its per-partition counters for the current
+// epoch). `Add()` does not acquire any locks and only modifies the thread's
+// shard. A shard publishes its number of inserts at least every
+// `kPublishBatchSize` inserts, and as soon as its inserts may complete the
+// current epoch. The thread whose publication completes an epoch merges the
+// shards' counters into the epoch's histogram and computes the next epoch's
+// boundaries from the shards' samples.
+//
+// With one inserting thread, each epoch has exactly `num_inserts_per_epoch`
+// inserts. With concurrent inserts, up to `kPublishBatchSize` unpublished
+// inserts per shard may be counted in the following epoch, and an epoch may
+// only be finished after more inserts have been published (e.g., if the
+// finishing thread gets descheduled). In that case the epoch also covers the
+// epochs that ended in the meantime, and its counters are scaled to
+// `num_inserts_per_epoch` inserts.
 class InsertTracker {
  public:
+  // If `num_shards` is 0, one shard per hardware thread is used.
   InsertTracker(const size_t num_inserts_per_epoch, const size_t num_partitions,
-                const size_t sample_size, const size_t random_seed = 42)
+                const size_t sample_size, const size_t random_seed = 42,
+                const size_t num_shards = 0)
       : num_inserts_per_epoch_(num_inserts_per_epoch),
         num_partitions_(num_partitions),
-        num_inserts_(0),
-        num_inserts_curr_epoch_(0),
         sample_size_(sample_size),
-        last_epoch_is_valid_(false),
-        next_(sample_size_ + 1),
-        gen_(random_seed) {
-    std::uniform_real_distribution<double> real_dist(0.0, 1.0);
-    w_ = exp(log(real_dist(gen_)) / sample_size_);
+        random_seed_(random_seed),
+        num_shards_(num_shards > 0
+                        ? num_shards
+                        : std::max(1U, std::thread::hardware_concurrency())),
+        shards_(new Shard[num_shards_]),
+        num_shards_initialized_(0),
+        phase_(0),
+        phase_end_(sample_size),
+        num_completed_epochs_(0),
+        num_published_(0),
+        phase_start_(0),
+        merge_gen_(random_seed),
+        last_epoch_version_(0),
+        last_epoch_counters_(new std::atomic<size_t>[num_partitions_]()),
+        last_epoch_boundaries_(
+            new std::atomic<uint64_t>[num_partitions_ + 1]()) {
+    assert(num_inserts_per_epoch_ > 0);
+    for (auto& boundaries : boundaries_) {
+      boundaries.reset(new std::atomic<uint64_t>[num_partitions_ + 1]());
+    }
   }
 
   // Forbid copying and moving.
@@ -37,109 +75,414 @@ class InsertTracker {
   InsertTracker(InsertTracker&&) = delete;
   InsertTracker& operator=(InsertTracker&&) = delete;
 
-  // Tracks an insert. Should be called for each individual insert.
+  // Tracks an insert. Should be called for each individual insert. This method
+  // is thread safe.
   void Add(const uint64_t key) {
-    const std::lock_guard<std::mutex> lock(mutex_);
-
-    ++num_inserts_;
-
-    if (reservoir_sample_.size() < sample_size_) {
-      // Fill up the sample.
-      reservoir_sample_.push_back(key);
-
-      if (reservoir_sample_.size() == sample_size_) {
-        InitializeCurrEpoch();
+    Shard& shard = shards_[LocalShardIndex()];
+    AddKeyToSample(shard, key);
+
+    const size_t phase = phase_.load(std::memory_order_acquire);
+    if (phase > 0) {
+      const size_t parity = phase % 2;
+      const std::optional<size_t> partition = FindPartition(parity, key);
+      if (partition.has_value()) {
+        shard.counters[parity][*partition].fetch_add(
+            1, std::memory_order_relaxed);
       }
+    }
 
+    const size_t num_unpublished =
+        shard.num_unpublished.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (num_unpublished < kPublishBatchSize &&
+        shard.num_published_seen.load(std::memory_order_relaxed) +
+                num_unpublished <
+            phase_end_.load(std::memory_order_relaxed)) {
       return;
     }
+    Publish(shard);
+  }
 
-    // Reservoir sample is full and boundaries are set.
-
-    ++num_inserts_curr_epoch_;
-    AddKeyToSample(key);
-    AddKeyToCurrEpoch(key);
-
-    if (num_inserts_curr_epoch_ == num_inserts_per_epoch_) {
-      // "Freeze" current epoch and start a new epoch.
-      partition_counters_last_epoch_.swap(partition_counters_curr_epoch_);
-      partition_boundaries_last_epoch_.swap(partition_boundaries_curr_epoch_);
-      InitializeCurrEpoch();
-
-      num_inserts_curr_epoch_ = 0;
-      // From now on one can query the last epoch.
-      last_epoch_is_valid_ = true;
-    }
+  // Returns the number of epochs that have been completed so far. This method
+  // is thread safe.
+  size_t NumCompletedEpochs() const {
+    return num_completed_epochs_.load(std::memory_order_acquire);
   }
 
   // Extrapolates inserts during the last epoch to `num_future_epochs` future
   // epochs. `range_end` is exclusive. Returns false if the last epoch hasn't
-  // been initialized yet.
+  // been initialized yet. This method is thread safe.
   bool GetNumInsertsInKeyRangeForNumFutureEpochs(
       const uint64_t range_start, const uint64_t range_end,
       const size_t num_future_epochs, double* num_inserts_future_epochs) {
-    const std::lock_guard<std::mutex> lock(mutex_);
-
-    double num_inserts_last_epoch;
-    if (!GetNumInsertsInLastEpoch(range_start, range_end,
-                                  &num_inserts_last_epoch)) {
+    if (last_epoch_version_.load(std::memory_order_acquire) == 0) {
+      // Last epoch hasn't been initialized.
       return false;
     }
-    *num_inserts_future_epochs = num_inserts_last_epoch * num_future_epochs;
+    static thread_local Histogram last_epoch;
+    ReadLastEpoch(&last_epoch);
+    *num_inserts_future_epochs =
+        GetNumInserts(last_epoch, range_start, range_end) * num_future_epochs;
     return true;
   }
 
  private:
+  // The partition boundaries are the inclusive lower bounds of each partition.
+  // The last boundary is uint64_t::max.
+  struct Histogram {
+    std::vector<size_t> counters;
+    std::vector<uint64_t> boundaries;
+  };
+
+  // A shard publishes its inserts (at least) this often.
+  static constexpr size_t kPublishBatchSize = 64;
+
+  // Values of `Shard::state`.
+  static constexpr int kShardUninitialized = 0;
+  static constexpr int kShardInitializing = 1;
+  static constexpr int kShardReady = 2;
+
+  // Stored in `Shard::next` while a thread replaces a sampled key.
+  static constexpr size_t kNextClaimed = std::numeric_limits<size_t>::max();
+
+  // Usually only one thread uses a shard, but threads share shards if there
+  // are more threads than shards. So the shard's state is still updated
+  // atomically.
+  struct alignas(64) Shard {
+    std::atomic<int> state{kShardUninitialized};
+
+    // Number of inserts recorded by this shard.
+    std::atomic<size_t> num_inserts{0};
+
+    // Reservoir sample of the keys inserted into this shard. The first
+    // `min(num_inserts, sample_size_)` slots are used.
+    std::unique_ptr<std::atomic<uint64_t>[]> reservoir_sample;
+    // The insert count at which the next key replaces a sampled key. The
+    // thread that performs the replacement claims `next` (see
+    // `kNextClaimed`); `w` and `gen` are only accessed by the thread holding
+    // the claim.
+    std::atomic<size_t> next{0};
+    double w = 0.0;
+    std::mt19937 gen;
+
+    // Per-partition insert counts, indexed by the phase's parity (see
+    // `phase_`).
+    std::unique_ptr<std::atomic<size_t>[]> counters[2];
+    // Number of inserts that have not been added to `num_published_` yet.
+    std::atomic<size_t> num_unpublished{0};
+    // The value of `num_published_` after this shard's last publication.
+    std::atomic<size_t> num_published_seen{0};
+  };
+
+  // Threads are assigned to shards in round-robin order.
+  size_t LocalShardIndex() const {
+    static std::atomic<size_t> next_thread_index(0);
+    static thread_local const size_t thread_index =
+        next_thread_index.fetch_add(1, std::memory_order_relaxed);
+    return thread_index % num_shards_;
+  }
+
+  // Shards are seeded in the order they are first used, so that the sampling
+  // is deterministic when there is only one inserting thread.
+  void InitializeShard(Shard& shard) {
+    int state = kShardUninitialized;
+    if (!shard.state.compare_exchange_strong(state, kShardInitializing,
+                                             std::memory_order_acquire)) {
+      // Another thread is initializing the shard.
+      while (shard.state.load(std::memory_order_acquire) != kShardReady) {
+        std::this_thread::yield();
+      }
+      return;
+    }
+    shard.gen.seed(random_seed_ + num_shards_initialized_.fetch_add(
+                                      1, std::memory_order_relaxed));
+    std::uniform_real_distribution<double> real_dist(0.0, 1.0);
+    shard.w = exp(log(real_dist(shard.gen)) / sample_size_);
+    shard.next.store(sample_size_ + 1, std::memory_order_relaxed);
+    shard.reservoir_sample.reset(new std::atomic<uint64_t>[sample_size_]());
+    for (auto& counters : shard.counters) {
+      counters.reset(new std::atomic<size_t>[num_partitions_]());
+    }
+    shard.state.store(kShardReady, std::memory_order_release);
+  }
+
   // See Algorithm L: https://en.wikipedia.org/wiki/Reservoir_sampling
-  void AddKeyToSample(const uint64_t key) {
-    if (num_inserts_ == next_) {
-      // Replace random item with `key`.
-      std::uniform_int_distribution<size_t> int_dist(0, sample_size_ - 1);
-      reservoir_sample_[int_dist(gen_)] = key;
+  void AddKeyToSample(Shard& shard, const uint64_t key) {
+    if (shard.state.load(std::memory_order_acquire) != kShardReady) {
+      InitializeShard(shard);
+    }
+    const size_t num_inserts =
+        shard.num_inserts.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (num_inserts <= sample_size_) {
+      // Fill up the sample.
+      shard.reservoir_sample[num_inserts - 1].store(key,
+                                                    std::memory_order_relaxed);
+      return;
+    }
 
-      // Update `next_` and `w_`.
-      std::uniform_real_distribution<double> real_dist(0.0, 1.0);
-      next_ += static_cast<size_t>(log(real_dist(gen_)) / (log(1.0 - w_))) + 1;
-      w_ *= exp(log(real_dist(gen_)) / sample_size_);
+    // With one thread per shard, `num_inserts` reaches `next` exactly. Other
+    // threads may pass `next` while its replacement is in progress, in which
+    // case the next insert after the replacement claims `next`.
+    size_t next = shard.next.load(std::memory_order_acquire);
+    if (num_inserts < next ||
+        !shard.next.compare_exchange_strong(next, kNextClaimed,
+                                            std::memory_order_acquire)) {
+      return;
     }
+
+    // Replace random item with `key`.
+    std::uniform_int_distribution<size_t> int_dist(0, sample_size_ - 1);
+    shard.reservoir_sample[int_dist(shard.gen)].store(
+        key, std::memory_order_relaxed);
+
+    // Update `next` and `w`.
+    std::uniform_real_distribution<double> real_dist(0.0, 1.0);
+    next +=
+        static_cast<size_t>(log(real_dist(shard.gen)) / (log(1.0 - shard.w))) +
+        1;
+    shard.w *= exp(log(real_dist(shard.gen)) / sample_size_);
+    shard.next.store(next, std::memory_order_release);
   }
 
-  void AddKeyToCurrEpoch(const uint64_t key) {
-    // Find partition and increase counter.
-    const auto it =
-        std::upper_bound(partition_boundaries_curr_epoch_.begin(),
-                         partition_boundaries_curr_epoch_.end(), key);
+  // Returns the partition of `key` according to the boundaries at `parity`,
+  // if `key` is in range.
+  std::optional<size_t> FindPartition(const size_t parity,
+                                      const uint64_t key) const {
+    const std::atomic<uint64_t>* boundaries = boundaries_[parity].get();
+    // Find the first boundary that is larger than `key`.
+    size_t lo = 0, hi = num_partitions_ + 1;
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (boundaries[mid].load(std::memory_order_relaxed) <= key) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
 
-    if (it == partition_boundaries_curr_epoch_.begin()) {
+    if (lo == 0) {
       // `key` is out of range (first boundary is larger than `key`).
-      return;
+      return std::optional<size_t>();
     }
 
-    if (it == partition_boundaries_curr_epoch_.end()) {
+    if (lo == num_partitions_ + 1) {
       // `key` is out of range (all boundaries are smaller than `key`). Can't
-      // happen since the bonudary of the last partition is uint64_t::max.
+      // happen since the boundary of the last partition is uint64_t::max.
       std::cerr << "Reached unreachable code" << std::endl;
       assert(false);
-      return;
+      return std::optional<size_t>();
     }
 
-    // `index` marks the upper boundary, the key actually belongs to the
-    // partition at `index - 1` as the upper boundary is exclusive.
-    const size_t index =
-        std::distance(partition_boundaries_curr_epoch_.begin(), it);
-    ++partition_counters_curr_epoch_[index - 1];
+    // `lo` marks the upper boundary, the key actually belongs to the
+    // partition at `lo - 1` as the upper boundary is exclusive.
+    return lo - 1;
   }
 
-  // Starts a new epoch and sets equi-depth partition boundaries according to
-  // the current sample.
-  void InitializeCurrEpoch() {
-    partition_counters_curr_epoch_.resize(num_partitions_);
-    partition_boundaries_curr_epoch_.resize(num_partitions_ + 1);
-    std::fill(partition_counters_curr_epoch_.begin(),
-              partition_counters_curr_epoch_.end(), 0);
+  // Adds the shard's unpublished inserts to `num_published_`, and finishes the
+  // phase(s) that the publication completes.
+  void Publish(Shard& shard) {
+    const size_t num_inserts =
+        shard.num_unpublished.exchange(0, std::memory_order_relaxed);
+    if (num_inserts == 0) return;
+    const size_t num_published =
+        num_published_.fetch_add(num_inserts, std::memory_order_acq_rel) +
+        num_inserts;
+    shard.num_published_seen.store(num_published, std::memory_order_relaxed);
+    // If another thread is finishing a phase, it checks for completed phases
+    // again after releasing `epoch_mutex_`.
+    while (num_published_.load(std::memory_order_seq_cst) >=
+           phase_end_.load(std::memory_order_acquire)) {
+      std::unique_lock<std::mutex> lock(epoch_mutex_, std::try_to_lock);
+      if (!lock.owns_lock()) return;
+      while (num_published_.load(std::memory_order_acquire) >=
+             phase_end_.load(std::memory_order_relaxed)) {
+        FinishPhase();
+      }
+    }
+  }
+
+  // Phase 0 fills up the samples; each later phase is an epoch. Finishing a
+  // phase "freezes" its epoch (if any) and sets the next epoch's boundaries.
+  // The next phase ends at the first epoch end after the inserts published so
+  // far. The caller must hold `epoch_mutex_`.
+  //
+  // Inserts keep going while the boundaries are computed. So (except after
+  // phase 0) the inserts are counted in the next phase's counters first, using
+  // a copy of the finished phase's boundaries. Inserts that read the phase
+  // just before it changes may still update the finished phase's counters
+  // (they are then counted two epochs later), or read boundaries that are
+  // being replaced. This only affects the estimates.
+  void FinishPhase() {
+    const size_t phase = phase_.load(std::memory_order_relaxed);
+    const size_t parity = phase % 2;
+    size_t num_published = 0;
+    if (phase > 0) {
+      for (size_t i = 0; i <= num_partitions_; ++i) {
+        boundaries_[1 - parity][i].store(
+            boundaries_[parity][i].load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+      }
+      num_published = num_published_.load(std::memory_order_acquire);
+      phase_.store(phase + 1, std::memory_order_release);
+
+      Histogram last_epoch;
+      last_epoch.counters.assign(num_partitions_, 0);
+      last_epoch.boundaries.resize(num_partitions_ + 1);
+      for (size_t i = 0; i <= num_partitions_; ++i) {
+        last_epoch.boundaries[i] =
+            boundaries_[parity][i].load(std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < num_shards_; ++i) {
+        Shard& shard = shards_[i];
+        if (shard.state.load(std::memory_order_acquire) != kShardReady) {
+          continue;
+        }
+        for (size_t p = 0; p < num_partitions_; ++p) {
+          last_epoch.counters[p] +=
+              shard.counters[parity][p].exchange(0, std::memory_order_relaxed);
+        }
+      }
+      // Scale the counters to one epoch's worth of inserts.
+      const size_t num_phase_inserts = num_published - phase_start_;
+      if (num_phase_inserts != num_inserts_per_epoch_) {
+        for (size_t& counter : last_epoch.counters) {
+          counter = static_cast<size_t>(std::llround(
+              static_cast<double>(counter) * num_inserts_per_epoch_ /
+              num_phase_inserts));
+        }
+      }
+      PublishLastEpoch(last_epoch);
+    }
+
+    const std::vector<uint64_t> boundaries = ComputeBoundaries();
+    for (size_t i = 0; i <= num_partitions_; ++i) {
+      boundaries_[1 - parity][i].store(boundaries[i],
+                                       std::memory_order_relaxed);
+    }
+    if (phase == 0) {
+      num_published = num_published_.load(std::memory_order_acquire);
+      phase_.store(phase + 1, std::memory_order_release);
+    }
+    phase_start_ = num_published;
+    const size_t num_completed_epochs =
+        (num_published - sample_size_) / num_inserts_per_epoch_;
+    phase_end_.store(
+        sample_size_ + (num_completed_epochs + 1) * num_inserts_per_epoch_,
+        std::memory_order_release);
+    num_completed_epochs_.store(num_completed_epochs,
+                                std::memory_order_release);
+  }
+
+  // The last epoch is published using a seqlock so that queries do not block
+  // (or get blocked by) epoch transitions. The caller must hold
+  // `epoch_mutex_`.
+  void PublishLastEpoch(const Histogram& last_epoch) {
+    last_epoch_version_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < num_partitions_; ++i) {
+      last_epoch_counters_[i].store(last_epoch.counters[i],
+                                    std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i <= num_partitions_; ++i) {
+      last_epoch_boundaries_[i].store(last_epoch.boundaries[i],
+                                      std::memory_order_relaxed);
+    }
+    last_epoch_version_.fetch_add(1, std::memory_order_release);
+  }
+
+  void ReadLastEpoch(Histogram* last_epoch) const {
+    last_epoch->counters.resize(num_partitions_);
+    last_epoch->boundaries.resize(num_partitions_ + 1);
+    while (true) {
+      const uint64_t version =
+          last_epoch_version_.load(std::memory_order_acquire);
+      if (version % 2 == 0) {
+        for (size_t i = 0; i < num_partitions_; ++i) {
+          last_epoch->counters[i] =
+              last_epoch_counters_[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i <= num_partitions_; ++i) {
+          last_epoch->boundaries[i] =
+              last_epoch_boundaries_[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (last_epoch_version_.load(std::memory_order_relaxed) == version) {
+          return;
+        }
+      }
+      // An epoch transition is in progress.
+      std::this_thread::yield();
+    }
+  }
+
+  // Merges the shards' samples into one sample of (at most) `sample_size_`
+  // keys, where each shard contributes keys in proportion to the number of
+  // inserts it recorded. The caller must hold `epoch_mutex_`.
+  std::vector<uint64_t> MergeSamples() {
+    std::vector<std::vector<uint64_t>> samples(num_shards_);
+    std::vector<size_t> num_inserts(num_shards_, 0);
+    size_t total_sampled = 0, total_inserts = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      const Shard& shard = shards_[i];
+      if (shard.state.load(std::memory_order_acquire) != kShardReady) continue;
+      // Inserting threads keep updating the sample while it is copied (and a
+      // slot may be read just before a concurrent insert fills it). This only
+      // affects the estimated boundaries.
+      num_inserts[i] = shard.num_inserts.load(std::memory_order_relaxed);
+      samples[i].resize(std::min(num_inserts[i], sample_size_));
+      for (size_t j = 0; j < samples[i].size(); ++j) {
+        samples[i][j] =
+            shard.reservoir_sample[j].load(std::memory_order_relaxed);
+      }
+      total_sampled += samples[i].size();
+      total_inserts += num_inserts[i];
+    }
+
+    std::vector<uint64_t> merged;
+    merged.reserve(std::min(total_sampled, sample_size_));
+    if (total_sampled <= sample_size_) {
+      for (const auto& sample : samples) {
+        merged.insert(merged.end(), sample.begin(), sample.end());
+      }
+      return merged;
+    }
+
+    // Compute each shard's quota, then hand out any remaining slots to the
+    // shards with spare sampled keys.
+    std::vector<size_t> quotas(num_shards_, 0);
+    size_t assigned = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+      quotas[i] = std::min(
+          samples[i].size(),
+          static_cast<size_t>(static_cast<double>(sample_size_) *
+                              num_inserts[i] / total_inserts));
+      assigned += quotas[i];
+    }
+    for (size_t i = 0; assigned < sample_size_; i = (i + 1) % num_shards_) {
+      if (quotas[i] < samples[i].size()) {
+        ++quotas[i];
+        ++assigned;
+      }
+    }
+
+    for (size_t i = 0; i < num_shards_; ++i) {
+      auto& sample = samples[i];
+      // Select `quotas[i]` keys at random (partial Fisher-Yates shuffle).
+      for (size_t j = 0; j < quotas[i] && quotas[i] < sample.size(); ++j) {
+        std::uniform_int_distribution<size_t> int_dist(j, sample.size() - 1);
+        std::swap(sample[j], sample[int_dist(merge_gen_)]);
+      }
+      merged.insert(merged.end(), sample.begin(), sample.begin() + quotas[i]);
+    }
+    return merged;
+  }
+
+  // Sets equi-depth partition boundaries according to the current sample. The
+  // caller must hold `epoch_mutex_`.
+  std::vector<uint64_t> ComputeBoundaries() {
+    std::vector<uint64_t> boundaries(num_partitions_ + 1);
 
     // Create a sorted copy of the sample.
-    std::vector<uint64_t> sorted_sample(reservoir_sample_);
+    std::vector<uint64_t> sorted_sample = MergeSamples();
     std::sort(sorted_sample.begin(), sorted_sample.end());
 
     const size_t num_records_per_partition =
@@ -147,25 +490,20 @@ class InsertTracker {
 
     for (int i = 0; i < num_partitions_; ++i) {
       const uint64_t start_key = sorted_sample[i * num_records_per_partition];
-      partition_boundaries_curr_epoch_[i] = start_key;
+      boundaries[i] = start_key;
     }
 
     // Add an extra key at the end (uint64_t::max).
-    partition_boundaries_curr_epoch_[num_partitions_] =
-        std::numeric_limits<uint64_t>::max();
+    boundaries[num_partitions_] = std::numeric_limits<uint64_t>::max();
+    return boundaries;
   }
 
-  bool GetNumInsertsInLastEpoch(const uint64_t range_start,
-                                const uint64_t range_end,
-                                double* num_inserts_last_epoch) {
-    if (!last_epoch_is_valid_) {
-      // Last epoch hasn't been initialized.
-      return false;
-    }
-    *num_inserts_last_epoch = 0;
+  double GetNumInserts(const Histogram& epoch, const uint64_t range_start,
+                       const uint64_t range_end) const {
+    double num_inserts = 0;
     for (int i = 0; i < num_partitions_; ++i) {
-      const uint64_t partition_start = partition_boundaries_last_epoch_[i];
-      const uint64_t partition_end = partition_boundaries_last_epoch_[i + 1];
+      const uint64_t partition_start = epoch.boundaries[i];
+      const uint64_t partition_end = epoch.boundaries[i + 1];
 
       if (range_start < partition_end && range_end > partition_start) {
         // Interpolate within partition (e.g., if 50% of a partition
@@ -178,47 +516,51 @@ class InsertTracker {
         const double overlap =
             static_cast<double>(query_range) / partition_range;  // (0,1]
 
-        const double interpolated_inserts =
-            partition_counters_last_epoch_[i] * overlap;
+        const double interpolated_inserts = epoch.counters[i] * overlap;
 
-        *num_inserts_last_epoch += interpolated_inserts;
+        num_inserts += interpolated_inserts;
       }
     }
-    return true;
+    return num_inserts;
   }
 
-  // The maximum number of inserts per epoch. Once that number has been
-  // reached, we will start a new epoch.
-  size_t num_inserts_per_epoch_;
+  // The number of inserts per epoch. Once that number has been reached, we
+  // will start a new epoch.
+  const size_t num_inserts_per_epoch_;
   // Number of equi-depth partitions according to the sample.
-  size_t num_partitions_;
-  // Total number of inserts.
-  size_t num_inserts_;
-  // Number of inserts in the current epoch.
-  size_t num_inserts_curr_epoch_;
+  const size_t num_partitions_;
   // Size of the reservoir sample.
-  size_t sample_size_;
-
-  // Whether we have observed at least one epoch, i.e., the last epoch is
-  // valid.
-  bool last_epoch_is_valid_;
-
-  // The following vectors track the number of inserts in the current / last
-  // epoch per partition of the equi-depth histogram. The boundary values are
-  // the inclusive lower bounds of each partition.
-  std::vector<size_t> partition_counters_curr_epoch_;
-  std::vector<uint64_t> partition_boundaries_curr_epoch_;
-  std::vector<size_t> partition_counters_last_epoch_;
-  std::vector<uint64_t> partition_boundaries_last_epoch_;
-
-  // Reservoir sample.
-  std::vector<uint64_t> reservoir_sample_;
-  double w_;
-  size_t next_;
-  std::mt19937 gen_;
-
-  // Global mutex.
-  std::mutex mutex_;
+  const size_t sample_size_;
+  const size_t random_seed_;
+
+  const size_t num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+  std::atomic<size_t> num_shards_initialized_;
+
+  // The current phase (see `FinishPhase()`), whose parity selects the
+  // counters and boundaries that inserts use.
+  std::atomic<size_t> phase_;
+  // The current phase ends once this many inserts have been published.
+  std::atomic<size_t> phase_end_;
+  std::atomic<size_t> num_completed_epochs_;
+  // Number of inserts published by the shards.
+  std::atomic<size_t> num_published_;
+  // The value of `num_published_` when the current phase started counting
+  // inserts. Protected by `epoch_mutex_`.
+  size_t phase_start_;
+  // The partition boundaries of the current and the previous phase, indexed by
+  // the phase's parity.
+  std::unique_ptr<std::atomic<uint64_t>[]> boundaries_[2];
+
+  // Serializes epoch transitions.
+  std::mutex epoch_mutex_;
+  std::mt19937 merge_gen_;
+
+  // The statistics of the last completed epoch, protected by a seqlock (the
+  // version is odd while the epoch is being published).
+  std::atomic<uint64_t> last_epoch_version_;
+  std::unique_ptr<std::atomic<size_t>[]> last_epoch_counters_;
+  std::unique_ptr<std::atomic<uint64_t>[]> last_epoch_boundaries_;
 };
 
 }  // namespace tl
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+namespace tl {
+
+// A single-use counter that lets a thread wait for a group of tasks to finish.
+// Each task calls `CountDown()` once it completes, and `Wait()` returns once
+// the counter reaches zero.
+//
+// This is meant to replace waiting on a vector of `std::future`s when the tasks
+// do not return values (it avoids allocating a shared state per task).
+class Latch {
+ public:
+  explicit Latch(size_t count) : count_(count) {}
+
+  Latch(const Latch&) = delete;
+  Latch& operator=(const Latch&) = delete;
+
+  // Decrements the counter. Wakes up any waiting threads when the counter
+  // reaches zero.
+  void CountDown() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      cv_.notify_all();
+    }
+  }
+
+  // Records an exception thrown by one of the tasks. The exception is rethrown
+  // by `Wait()` (if multiple tasks fail, only the first exception is kept).
+  void SetException(std::exception_ptr exception) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (exception_ == nullptr) exception_ = std::move(exception);
+  }
+
+  // Returns true iff the counter has reached zero. Callers should still call
+  // `Wait()` before destroying the latch.
+  bool IsReady() const { return count_.load(std::memory_order_acquire) == 0; }
+
+  // Blocks until the counter reaches zero.
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return IsReady(); });
+    if (exception_ != nullptr) {
+      std::rethrow_exception(exception_);
+    }
+  }
+
+ private:
+  std::atomic<size_t> count_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::exception_ptr exception_;
+};
+
+}  // namespace tl
@@ -0,0 +1,178 @@
+#include "numa.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+// Memory policy constants from `linux/mempolicy.h`.
+constexpr int kMpolPreferred = 1;
+constexpr int kMpolInterleave = 3;
+constexpr unsigned kMpolFNode = 1 << 0;
+constexpr unsigned kMpolFAddr = 1 << 1;
+constexpr unsigned kMpolMfMove = 1 << 1;
+
+// The maximum number of NUMA nodes supported by the node masks below.
+constexpr size_t kMaxNodes = 64;
+
+// Parses a Linux "cpulist" (e.g., "0-3,8-11").
+std::vector<uint32_t> ParseList(const std::string& list) {
+  std::vector<uint32_t> values;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty() || range == "\n") continue;
+    const size_t dash = range.find('-');
+    const uint32_t start = std::stoul(range.substr(0, dash));
+    const uint32_t end =
+        dash == std::string::npos ? start : std::stoul(range.substr(dash + 1));
+    for (uint32_t v = start; v <= end; ++v) {
+      values.push_back(v);
+    }
+  }
+  return values;
+}
+
+struct Topology {
+  Topology() {
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    if (online && std::getline(online, list)) {
+      for (const uint32_t node : ParseList(list)) {
+        if (node >= kMaxNodes) continue;
+        std::ifstream cpus("/sys/devices/system/node/node" +
+                           std::to_string(node) + "/cpulist");
+        std::string cpu_list;
+        std::getline(cpus, cpu_list);
+        const std::vector<uint32_t> node_cores = ParseList(cpu_list);
+        if (node_cores.empty()) continue;
+        node_ids.push_back(node);
+        cores.push_back(node_cores);
+      }
+    }
+    if (cores.empty()) {
+      // Fall back to a single node that holds all cores.
+      node_ids = {0};
+      cores.emplace_back();
+      const long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+      for (long i = 0; i < std::max(num_cores, 1L); ++i) {
+        cores[0].push_back(i);
+      }
+    }
+  }
+
+  // The kernel's ids for the nodes that have cores (the index into this vector
+  // is the "node" used in the public interface).
+  std::vector<uint32_t> node_ids;
+  std::vector<std::vector<uint32_t>> cores;
+};
+
+const Topology& GetTopology() {
+  static const Topology topology;
+  return topology;
+}
+
+// Returns the range of whole pages that lie in [addr, addr + length).
+std::pair<void*, size_t> PageAlignedRange(void* addr, size_t length) {
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  const uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+  const uintptr_t aligned_start = (start + page_size - 1) & ~(page_size - 1);
+  const uintptr_t aligned_end = (start + length) & ~(page_size - 1);
+  if (aligned_end <= aligned_start) return {nullptr, 0};
+  return {reinterpret_cast<void*>(aligned_start), aligned_end - aligned_start};
+}
+
+bool SetPolicy(void* addr, size_t length, int mode, uint64_t node_mask,
+               unsigned flags) {
+  const auto [start, aligned_length] = PageAlignedRange(addr, length);
+  if (aligned_length == 0) return false;
+  return syscall(SYS_mbind, start, aligned_length, mode, &node_mask,
+                 kMaxNodes + 1, flags) == 0;
+}
+
+}  // namespace
+
+namespace tl {
+namespace numa {
+
+size_t NumNodes() { return GetTopology().cores.size(); }
+
+const std::vector<uint32_t>& CoresOnNode(size_t node) {
+  return GetTopology().cores[node % NumNodes()];
+}
+
+size_t NodeOfCore(uint32_t core_id) {
+  const Topology& topology = GetTopology();
+  for (size_t node = 0; node < topology.cores.size(); ++node) {
+    for (const uint32_t core : topology.cores[node]) {
+      if (core == core_id) return node;
+    }
+  }
+  return 0;
+}
+
+size_t CurrentNode() {
+  if (NumNodes() == 1) return 0;
+  unsigned cpu = 0, kernel_node = 0;
+  if (syscall(SYS_getcpu, &cpu, &kernel_node, nullptr) != 0) return 0;
+  const Topology& topology = GetTopology();
+  for (size_t node = 0; node < topology.node_ids.size(); ++node) {
+    if (topology.node_ids[node] == kernel_node) return node;
+  }
+  return 0;
+}
+
+std::optional<size_t> NodeOfAddress(const void* addr) {
+  if (NumNodes() == 1) return 0;
+  int kernel_node = -1;
+  if (syscall(SYS_get_mempolicy, &kernel_node, nullptr, 0, addr,
+              kMpolFNode | kMpolFAddr) != 0) {
+    return std::optional<size_t>();
+  }
+  const Topology& topology = GetTopology();
+  for (size_t node = 0; node < topology.node_ids.size(); ++node) {
+    if (static_cast<int>(topology.node_ids[node]) == kernel_node) return node;
+  }
+  return std::optional<size_t>();
+}
+
+std::vector<size_t> SpreadAcrossNodes(size_t num_threads) {
+  std::vector<size_t> thread_to_core;
+  thread_to_core.reserve(num_threads);
+  std::vector<size_t> next_core_on_node(NumNodes(), 0);
+  for (size_t i = 0; i < num_threads; ++i) {
+    const size_t node = i % NumNodes();
+    const std::vector<uint32_t>& cores = CoresOnNode(node);
+    thread_to_core.push_back(cores[next_core_on_node[node]++ % cores.size()]);
+  }
+  return thread_to_core;
+}
+
+bool PreferNode(void* addr, size_t length, size_t node) {
+  if (NumNodes() == 1) return false;
+  const uint64_t node_mask = 1ULL << GetTopology().node_ids[node % NumNodes()];
+  return SetPolicy(addr, length, kMpolPreferred, node_mask, /*flags=*/0);
+}
+
+bool InterleavePages(void* addr, size_t length) {
+  if (NumNodes() == 1) return false;
+  uint64_t node_mask = 0;
+  for (const uint32_t kernel_node : GetTopology().node_ids) {
+    node_mask |= 1ULL << kernel_node;
+  }
+  return SetPolicy(addr, length, kMpolInterleave, node_mask, kMpolMfMove);
+}
+
+std::optional<bool> IsLocal(const void* addr) {
+  const std::optional<size_t> node = NodeOfAddress(addr);
+  if (!node.has_value()) return std::optional<bool>();
+  return *node == CurrentNode();
+}
+
+}  // namespace numa
+}  // namespace tl
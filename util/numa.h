@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace tl {
+namespace numa {
+
+// Helpers used to place threads and memory on specific NUMA nodes. These use
+// the kernel's interfaces directly (no dependency on libnuma). On machines
+// with a single NUMA node (or if the topology cannot be determined), the
+// placement helpers do nothing and return false.
+
+// Returns the number of NUMA nodes (at least 1).
+size_t NumNodes();
+
+// Returns the ids of the cores on NUMA node `node`.
+const std::vector<uint32_t>& CoresOnNode(size_t node);
+
+// Returns the NUMA node that core `core_id` belongs to.
+size_t NodeOfCore(uint32_t core_id);
+
+// Returns the NUMA node that the current thread is running on.
+size_t CurrentNode();
+
+// Returns the NUMA node that holds the page containing `addr`, if known.
+std::optional<size_t> NodeOfAddress(const void* addr);
+
+// Returns a list of `num_threads` core ids that spreads threads across the
+// NUMA nodes in round-robin order (thread `i` runs on node `i % NumNodes()`).
+// Meant to be used with `ThreadPool`'s `thread_to_core` constructor.
+std::vector<size_t> SpreadAcrossNodes(size_t num_threads);
+
+// Asks the kernel to place the pages in [addr, addr + length) on `node`
+// ("preferred" placement, so allocations still succeed if the node runs out of
+// memory). Only the pages that lie entirely in the range are affected. Returns
+// true if the policy was applied.
+bool PreferNode(void* addr, size_t length, size_t node);
+
+// Interleaves the pages in [addr, addr + length) across all NUMA nodes. Pages
+// that have already been touched are migrated. Only the pages that lie entirely
+// in the range are affected. Returns true if the policy was applied.
+bool InterleavePages(void* addr, size_t length);
+
+// Returns true once every `kAccessSampleInterval` calls on the current thread.
+// Used to sample memory accesses when computing remote access statistics
+// (looking up the node of an address requires a system call).
+constexpr uint32_t kAccessSampleInterval = 1024;
+inline bool ShouldSampleAccess() {
+  static thread_local uint32_t num_accesses = 0;
+  return (++num_accesses % kAccessSampleInterval) == 0;
+}
+
+// Returns true if `addr` is on the current thread's NUMA node, false if it is
+// on a remote node, or an empty optional if the node is unknown.
+std::optional<bool> IsLocal(const void* addr);
+
+}  // namespace numa
+}  // namespace tl
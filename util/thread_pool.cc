@@ -3,31 +3,65 @@
 #include <cassert>
 
 #include "util/affinity.h"
+#include "util/numa.h"
+
+namespace {
+
+// The number of times an idle worker looks for work before going to sleep.
+constexpr size_t kIdleSpinsBeforeSleep = 16;
+
+}  // namespace
 
 namespace tl {
 
+thread_local ThreadPool* ThreadPool::current_pool_ = nullptr;
+thread_local size_t ThreadPool::current_index_ = 0;
+
 ThreadPool::ThreadPool(size_t num_threads, std::function<void()> run_on_exit)
-    : shutdown_(false), run_on_exit_(std::move(run_on_exit)) {
+    : num_threads_(num_threads),
+      queues_(new WorkQueue[num_threads]),
+      next_queue_(0),
+      num_pending_(0),
+      num_sleeping_(0),
+      shutdown_(false),
+      run_on_exit_(std::move(run_on_exit)) {
   assert(num_threads > 0);
   for (size_t i = 0; i < num_threads; ++i) {
-    threads_.emplace_back(&ThreadPool::ThreadMain, this);
+    threads_.emplace_back(&ThreadPool::ThreadMain, this, i);
   }
 }
 
 ThreadPool::ThreadPool(size_t num_threads,
-                       const std::vector<size_t>& thread_to_core)
-    : shutdown_(false) {
+                       const std::vector<size_t>& thread_to_core,
+                       std::function<void()> run_on_exit)
+    : num_threads_(num_threads),
+      queues_(new WorkQueue[num_threads]),
+      next_queue_(0),
+      num_pending_(0),
+      num_sleeping_(0),
+      shutdown_(false),
+      run_on_exit_(std::move(run_on_exit)) {
   assert(num_threads > 0);
   assert(num_threads == thread_to_core.size());
+  if (numa::NumNodes() > 1) {
+    node_workers_.resize(numa::NumNodes());
+    size_t nodes_used = 0;
+    for (size_t i = 0; i < num_threads; ++i) {
+      auto& workers = node_workers_[numa::NodeOfCore(thread_to_core[i])];
+      if (workers.empty()) ++nodes_used;
+      workers.push_back(i);
+    }
+    if (nodes_used <= 1) node_workers_.clear();
+  }
   for (size_t i = 0; i < num_threads; ++i) {
-    threads_.emplace_back(&ThreadPool::ThreadMainOnCore, this,
+    threads_.emplace_back(&ThreadPool::ThreadMainOnCore, this, i,
                           thread_to_core[i]);
   }
 }
 
 ThreadPool::~ThreadPool() {
   {
-    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
     shutdown_ = true;
   }
   cv_.notify_all();
@@ -36,27 +70,121 @@ ThreadPool::~ThreadPool() {
   }
 }
 
-void ThreadPool::ThreadMainOnCore(size_t core_id) {
+void ThreadPool::Push(Task task, const Latch* latch) {
+  // Workers add tasks to their own queue. Other threads spread their tasks
+  // over the workers (on their NUMA node, if possible).
+  size_t index;
+  if (current_pool_ == this) {
+    index = current_index_;
+  } else {
+    const size_t next = next_queue_.fetch_add(1, std::memory_order_relaxed);
+    const std::vector<size_t>* local_workers =
+        node_workers_.empty() ? nullptr : &node_workers_[numa::CurrentNode()];
+    index = local_workers == nullptr || local_workers->empty()
+                ? next % num_threads_
+                : (*local_workers)[next % local_workers->size()];
+  }
+  {
+    std::unique_lock<std::mutex> lock(queues_[index].mutex);
+    queues_[index].tasks.push_back(QueuedTask{std::move(task), latch});
+  }
+  num_pending_.fetch_add(1);
+  if (num_sleeping_.load() > 0) {
+    // Acquiring the mutex ensures that a worker that is about to sleep either
+    // observes the new task or is already waiting on `cv_`.
+    { std::unique_lock<std::mutex> lock(sleep_mutex_); }
+    cv_.notify_one();
+  }
+}
+
+template <typename Predicate>
+bool ThreadPool::TakeTask(WorkQueue& queue, Predicate pred, Task* task_out) {
+  for (auto it = queue.tasks.begin(); it != queue.tasks.end(); ++it) {
+    if (!pred(*it)) continue;
+    *task_out = std::move(it->task);
+    queue.tasks.erase(it);
+    return true;
+  }
+  return false;
+}
+
+bool ThreadPool::TryRunTask(const size_t index) {
+  const auto any_task = [](const QueuedTask&) { return true; };
+  Task task;
+  bool found = false;
+  // Check this worker's queue first, then try to steal from the others.
+  for (size_t i = 0; !found && i < num_threads_; ++i) {
+    WorkQueue& queue = queues_[(index + i) % num_threads_];
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    found = TakeTask(queue, any_task, &task);
+  }
+  if (!found) return false;
+
+  num_pending_.fetch_sub(1);
+  task();
+  return true;
+}
+
+bool ThreadPool::TryRunTaskFor(const Latch& latch) {
+  const auto latch_task = [&latch](const QueuedTask& queued) {
+    return queued.latch == &latch;
+  };
+  Task task;
+  bool found = false;
+  for (size_t i = 0; !found && i < num_threads_; ++i) {
+    WorkQueue& queue = queues_[(current_index_ + i) % num_threads_];
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    found = TakeTask(queue, latch_task, &task);
+  }
+  if (!found) return false;
+
+  num_pending_.fetch_sub(1);
+  task();
+  return true;
+}
+
+void ThreadPool::Wait(Latch& latch) {
+  if (current_pool_ == this) {
+    // Only run tasks that count down `latch`. Running unrelated tasks here
+    // could deadlock (e.g., if the caller holds locks that they need).
+    while (!latch.IsReady() && TryRunTaskFor(latch)) {
+    }
+  }
+  latch.Wait();
+}
+
+void ThreadPool::ThreadMainOnCore(size_t index, size_t core_id) {
   affinity::PinToCore(core_id);
-  ThreadMain();
+  ThreadMain(index);
 }
 
-void ThreadPool::ThreadMain() {
-  std::unique_ptr<Task> next_job = nullptr;
+void ThreadPool::ThreadMain(size_t index) {
+  current_pool_ = this;
+  current_index_ = index;
+
+  size_t idle_spins = 0;
   while (true) {
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      // Need a loop here to handle spurious wakeup
-      while (!shutdown_ && work_queue_.empty()) {
-        cv_.wait(lock);
-      }
-      if (shutdown_ && work_queue_.empty()) break;
-      next_job.reset(work_queue_.front().release());
-      work_queue_.pop();
+    if (TryRunTask(index)) {
+      idle_spins = 0;
+      continue;
     }
-    (*next_job)();
-    next_job.reset(nullptr);
+    if (++idle_spins < kIdleSpinsBeforeSleep) {
+      std::this_thread::yield();
+      continue;
+    }
+    idle_spins = 0;
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    num_sleeping_.fetch_add(1);
+    // Need a loop here to handle spurious wakeup
+    while (!shutdown_ && num_pending_.load() <= 0) {
+      cv_.wait(lock);
+    }
+    num_sleeping_.fetch_sub(1);
+    if (shutdown_ && num_pending_.load() <= 0) break;
   }
+
+  current_pool_ = nullptr;
   if (run_on_exit_) {
     run_on_exit_();
   }
@@ -1,17 +1,29 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <thread>
 #include <type_traits>
 #include <vector>
 
+#include "util/latch.h"
+
 namespace tl {
 
-// A thread pool that supports thread-to-core pinning.
+// A work-stealing thread pool that supports thread-to-core pinning.
+//
+// Each worker thread has its own task queue. Tasks submitted by threads
+// outside the pool are spread over the queues in round-robin order, whereas
+// tasks submitted by a worker thread are added to its own queue. Idle workers
+// steal tasks from the other workers' queues. Small tasks are stored inline in
+// the queues (no per-task heap allocation).
 //
 // Acknowledgements: This implementation is based on other existing thread pools
 //   - https://github.com/fbastos1/thread_pool_cpp17
@@ -30,7 +42,12 @@ class ThreadPool {
   // The `thread_to_core` vector must be of size `num_threads`. The value at
   // `thread_to_core[i]` represents the core id that thread `i` should be pinned
   // to, where `0 <= i < num_threads`.
-  ThreadPool(size_t num_threads, const std::vector<size_t>& thread_to_core);
+  //
+  // On machines with multiple NUMA nodes, tasks submitted by threads outside
+  // the pool are added to the queues of the workers on the submitting thread's
+  // node (if there are any).
+  ThreadPool(size_t num_threads, const std::vector<size_t>& thread_to_core,
+             std::function<void()> run_on_exit = std::function<void()>());
 
   // Waits for all submitted functions to execute before returning.
   ~ThreadPool();
@@ -44,6 +61,16 @@ class ThreadPool {
                              bool> = true>
   auto Submit(Function&& f, Args&&... args);
 
+  // Schedule `f()` to run on a thread in this thread pool and count down
+  // `latch` once it has run. If `f` throws, the exception is rethrown when
+  // waiting on `latch`.
+  //
+  // This is cheaper than `Submit()` when the caller only needs to wait for a
+  // group of functions to run. Use `Wait()` to wait on `latch`.
+  template <typename Function,
+            std::enable_if_t<std::is_invocable<Function&&>::value, bool> = true>
+  void Submit(Latch& latch, Function&& f);
+
   // Similar to `Submit()`, but instead does not provide a future that can be
   // used to wait on the function's result.
   template <typename Function, typename... Args,
@@ -51,37 +78,175 @@ class ThreadPool {
                              bool> = true>
   void SubmitNoWait(Function&& f, Args&&... args);
 
+  // Blocks until `latch` reaches zero. When called from one of this pool's
+  // threads, the thread runs the not-yet-started tasks that count down `latch`
+  // itself instead of blocking (so tasks can safely wait on other tasks that
+  // they submit to the same pool).
+  void Wait(Latch& latch);
+
+  size_t NumThreads() const { return num_threads_; }
+
  private:
+  // A type-erased, move-only callable. Callables that are small enough are
+  // stored inline; larger ones are stored on the heap.
   class Task {
    public:
-    virtual ~Task() = default;
-    virtual void operator()() = 0;
-  };
+    Task() : ops_(nullptr) {}
+    template <typename Function,
+              std::enable_if_t<
+                  !std::is_same<std::decay_t<Function>, Task>::value, bool> =
+                  true>
+    explicit Task(Function&& f);
+    ~Task() { Reset(); }
 
-  template <typename Function>
-  class TaskContainer : public Task {
-   public:
-    TaskContainer(Function&& f) : f_(std::forward<Function>(f)) {}
-    void operator()() override { f_(); }
+    Task(Task&& other) noexcept;
+    Task& operator=(Task&& other) noexcept;
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    void operator()() { ops_->invoke(&storage_); }
 
    private:
-    Function f_;
+    static constexpr size_t kInlineSize = 48;
+    using Storage =
+        std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)>;
+
+    template <typename Function>
+    static constexpr bool kStoredInline =
+        sizeof(Function) <= kInlineSize &&
+        alignof(Function) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible<Function>::value;
+
+    struct Ops {
+      void (*invoke)(void* storage);
+      void (*move)(void* dest, void* src);
+      void (*destroy)(void* storage);
+    };
+    template <typename Function>
+    static const Ops kInlineOps;
+    template <typename Function>
+    static const Ops kHeapOps;
+
+    void Reset();
+
+    Storage storage_;
+    const Ops* ops_;
+  };
+
+  // Each worker's task queue. Tasks are taken from the front of the queues so
+  // that they run in (roughly) the order they were submitted.
+  struct QueuedTask {
+    Task task;
+    // The latch that the task counts down, if any.
+    const Latch* latch;
   };
+  struct alignas(64) WorkQueue {
+    std::mutex mutex;
+    std::deque<QueuedTask> tasks;
+  };
+
+  // Adds `task` to a work queue and wakes up a worker if needed.
+  void Push(Task task, const Latch* latch = nullptr);
+
+  // Runs one task from worker `index`'s own queue, or one stolen from another
+  // worker. Returns false if there were no tasks to run.
+  bool TryRunTask(size_t index);
+
+  // Runs one not-yet-started task that counts down `latch`, if any. Returns
+  // false if there were no such tasks.
+  bool TryRunTaskFor(const Latch& latch);
+
+  // Removes the first task in `queue` that satisfies `pred` and stores it in
+  // `task_out`. The caller must hold `queue.mutex`.
+  template <typename Predicate>
+  static bool TakeTask(WorkQueue& queue, Predicate pred, Task* task_out);
 
   // Worker threads run this code.
-  void ThreadMain();
+  void ThreadMain(size_t index);
 
   // Ensures the worker thread runs `ThreadMain()` on core `core_id`.
-  void ThreadMainOnCore(size_t core_id);
+  void ThreadMainOnCore(size_t index, size_t core_id);
 
-  std::mutex mutex_;
+  // The pool (and worker index) that the current thread belongs to, if any.
+  static thread_local ThreadPool* current_pool_;
+  static thread_local size_t current_index_;
+
+  const size_t num_threads_;
+  std::unique_ptr<WorkQueue[]> queues_;
+  std::atomic<size_t> next_queue_;
+
+  // The workers pinned to each NUMA node. Empty unless the workers are pinned
+  // to cores on more than one node.
+  std::vector<std::vector<size_t>> node_workers_;
+
+  // The number of queued tasks. This can be temporarily negative because
+  // tasks are counted after they are added to a queue.
+  std::atomic<int64_t> num_pending_;
+  std::atomic<size_t> num_sleeping_;
+  std::mutex sleep_mutex_;
   std::condition_variable cv_;
   bool shutdown_;
-  std::queue<std::unique_ptr<Task>> work_queue_;
+
   std::vector<std::thread> threads_;
   std::function<void()> run_on_exit_;
 };
 
+template <typename Function>
+const ThreadPool::Task::Ops ThreadPool::Task::kInlineOps = {
+    [](void* storage) { (*static_cast<Function*>(storage))(); },
+    [](void* dest, void* src) {
+      new (dest) Function(std::move(*static_cast<Function*>(src)));
+      static_cast<Function*>(src)->~Function();
+    },
+    [](void* storage) { static_cast<Function*>(storage)->~Function(); }};
+
+template <typename Function>
+const ThreadPool::Task::Ops ThreadPool::Task::kHeapOps = {
+    [](void* storage) { (**static_cast<Function**>(storage))(); },
+    [](void* dest, void* src) {
+      *static_cast<Function**>(dest) = *static_cast<Function**>(src);
+    },
+    [](void* storage) { delete *static_cast<Function**>(storage); }};
+
+template <typename Function,
+          std::enable_if_t<
+              !std::is_same<std::decay_t<Function>, ThreadPool::Task>::value,
+              bool>>
+ThreadPool::Task::Task(Function&& f) {
+  using F = std::decay_t<Function>;
+  if constexpr (kStoredInline<F>) {
+    new (&storage_) F(std::forward<Function>(f));
+    ops_ = &kInlineOps<F>;
+  } else {
+    *reinterpret_cast<F**>(&storage_) = new F(std::forward<Function>(f));
+    ops_ = &kHeapOps<F>;
+  }
+}
+
+inline ThreadPool::Task::Task(Task&& other) noexcept : ops_(other.ops_) {
+  if (ops_ != nullptr) {
+    ops_->move(&storage_, &other.storage_);
+    other.ops_ = nullptr;
+  }
+}
+
+inline ThreadPool::Task& ThreadPool::Task::operator=(Task&& other) noexcept {
+  if (this == &other) return *this;
+  Reset();
+  ops_ = other.ops_;
+  if (ops_ != nullptr) {
+    ops_->move(&storage_, &other.storage_);
+    other.ops_ = nullptr;
+  }
+  return *this;
+}
+
+inline void ThreadPool::Task::Reset() {
+  if (ops_ == nullptr) return;
+  ops_->destroy(&storage_);
+  ops_ = nullptr;
+}
+
 template <
     typename Function, typename... Args,
     std::enable_if_t<std::is_invocable<Function&&, Args&&...>::value, bool>>
@@ -92,28 +257,33 @@ auto ThreadPool::Submit(Function&& f, Args&&... args) {
         return std::apply(std::move(runnable), std::move(task_args));
       });
   auto future = task.get_future();
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    work_queue_.emplace(new TaskContainer(std::move(task)));
-  }
-  cv_.notify_one();
+  Push(Task(std::move(task)));
   return future;
 }
 
+template <typename Function,
+          std::enable_if_t<std::is_invocable<Function&&>::value, bool>>
+void ThreadPool::Submit(Latch& latch, Function&& f) {
+  Push(Task([latch = &latch, runnable = std::forward<Function>(f)]() mutable {
+         try {
+           runnable();
+         } catch (...) {
+           latch->SetException(std::current_exception());
+         }
+         latch->CountDown();
+       }),
+       &latch);
+}
+
 template <
     typename Function, typename... Args,
     std::enable_if_t<std::is_invocable<Function&&, Args&&...>::value, bool>>
 void ThreadPool::SubmitNoWait(Function&& f, Args&&... args) {
-  auto task = [runnable = std::move(f),
-               task_args =
-                   std::make_tuple(std::forward<Args>(args)...)]() mutable {
+  Push(Task([runnable = std::move(f),
+             task_args =
+                 std::make_tuple(std::forward<Args>(args)...)]() mutable {
     std::apply(std::move(runnable), std::move(task_args));
-  };
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    work_queue_.emplace(new TaskContainer(std::move(task)));
-  }
-  cv_.notify_one();
+  }));
 }
 
 }  // namespace tl